@@ -11,6 +11,7 @@
 #include <QSettings>
 #include <QLabel>
 #include <QPixmap>
+#include <QScrollBar>
 #include "networkmanager.h"
 #include "SetNickname.h"
 
@@ -38,6 +39,16 @@ MainWindow::MainWindow(QWidget *parent)
             this, &MainWindow::onSetNicknameResult);
     connect(&NetworkManager::instance(), &NetworkManager::checkUserStatusResult,
             this, &MainWindow::onCheckUserStatusResult);
+    connect(&NetworkManager::instance(), &NetworkManager::aiReplyPartial,
+            this, &MainWindow::onAIReplyPartial);
+    connect(&NetworkManager::instance(), &NetworkManager::aiReplyQueued,
+            this, &MainWindow::onAIReplyQueued);
+    connect(&NetworkManager::instance(), &NetworkManager::aiReplyFinished,
+            this, &MainWindow::onAIReplyFinished);
+    connect(&NetworkManager::instance(), &NetworkManager::historyReceived,
+            this, &MainWindow::onHistoryReceived);
+    connect(ui->chatHistoryListWidget->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &MainWindow::onChatHistoryScrolled);
 
     // --- 添加初始的假数据 ---////////////////////////
     /////////////////////////////////////////////////
@@ -203,6 +214,11 @@ void MainWindow::on_conversationListWidget_itemClicked(QListWidgetItem *item)
     qDebug() << "切换到对话:" << m_currentConversationId;
     updateChatHistoryView();
 
+    // 第一次打开这个对话时从服务器取最近一页历史消息
+    if (!m_historyCursors.contains(conversationId)) {
+        requestHistoryPage(conversationId);
+    }
+
     // 3. 如果是好友，查询用户状态
     // 判断：如果是数字（私聊），并且不是群聊
     bool ok;
@@ -337,10 +353,12 @@ void MainWindow::on_sendButton_clicked()
 
 void MainWindow::updateChatHistoryView()
 {
+    m_refreshingChatView = true;
     ui->chatHistoryListWidget->clear();
     ui->chatHistoryListWidget->setSpacing(5);
 
     if (m_currentConversationId == "-1" || !m_chatHistories.contains(m_currentConversationId)) {
+        m_refreshingChatView = false;
         return;
     }
 
@@ -421,6 +439,7 @@ void MainWindow::updateChatHistoryView()
         }
     }
     ui->chatHistoryListWidget->scrollToBottom();
+    m_refreshingChatView = false;
 }
 
 
@@ -561,6 +580,136 @@ void MainWindow::onNewMessageReceived(const ChatMessage &message, const QString&
     }
 }
 
+// 请求对话的下一页历史消息（第一次请求时游标为空，从最新一条开始）
+void MainWindow::requestHistoryPage(const QString& conversationId)
+{
+    if (m_historyLoading.contains(conversationId)) {
+        return;
+    }
+    if (NetworkManager::instance().sendHistoryRequest(conversationId,
+                                                      m_groups.contains(conversationId),
+                                                      m_historyCursors.value(conversationId))) {
+        m_historyLoading.insert(conversationId);
+    }
+}
+
+// 收到一页历史消息：放到本地聊天记录的最前面
+// 第一页里本次登录后已经收到的消息本地已有，只取比本地最早一条还早的
+void MainWindow::onHistoryReceived(const QString& conversationId,
+                                   const QList<ChatMessage>& messages,
+                                   const QMap<QDateTime, QByteArray>& images,
+                                   bool hasMore,
+                                   const QString& nextCursor)
+{
+    bool firstPage = !m_historyCursors.contains(conversationId);
+    m_historyLoading.remove(conversationId);
+    m_historyCursors[conversationId] = nextCursor;
+    if (hasMore) {
+        m_historyHasMore.insert(conversationId);
+    } else {
+        m_historyHasMore.remove(conversationId);
+    }
+
+    QList<ChatMessage>& history = m_chatHistories[conversationId];
+    QList<ChatMessage> older;
+    for (const ChatMessage& msg : messages) {
+        if (history.isEmpty() || msg.timestamp < history.first().timestamp) {
+            older.append(msg);
+        }
+    }
+    if (older.isEmpty()) {
+        return;
+    }
+    history = older + history;
+
+    // 聊天记录前面插入了消息，正在流式接收的AI回复的下标跟着后移
+    QString prefix = conversationId + "/";
+    for (auto it = m_streamingReplies.begin(); it != m_streamingReplies.end(); ++it) {
+        if (it.key().startsWith(prefix)) {
+            it.value() += older.size();
+        }
+    }
+    for (auto it = images.constBegin(); it != images.constEnd(); ++it) {
+        m_imageHistory.insert(it.key(), it.value());
+    }
+
+    if (conversationId == m_currentConversationId) {
+        updateChatHistoryView();
+        if (!firstPage) {
+            // 翻到更早的一页时停在原来最上面那条消息，而不是跳到底部
+            ui->chatHistoryListWidget->scrollToItem(ui->chatHistoryListWidget->item(older.size()),
+                                                    QAbstractItemView::PositionAtTop);
+        }
+    }
+}
+
+void MainWindow::onChatHistoryScrolled(int value)
+{
+    if (m_refreshingChatView || m_currentConversationId == "-1") {
+        return;
+    }
+    if (value == ui->chatHistoryListWidget->verticalScrollBar()->minimum()
+        && m_historyHasMore.contains(m_currentConversationId)) {
+        requestHistoryPage(m_currentConversationId);
+    }
+}
+
+// AI流式回复：每个请求的第一段新建一条消息，之后的段追加到这个请求的那条消息上
+void MainWindow::onAIReplyPartial(const QString& conversationId, const QString& requestId, const QString& delta)
+{
+    QString key = conversationId + "/" + requestId;
+    QList<ChatMessage>& history = m_chatHistories[conversationId];
+    if (!m_streamingReplies.contains(key) || m_streamingReplies.value(key) >= history.size()) {
+        ChatMessage msg;
+        msg.senderId = conversationId.toInt();
+        msg.timestamp = QDateTime::currentDateTime();
+        history.append(msg);
+        m_streamingReplies[key] = history.size() - 1;
+    }
+    if (m_queuedReplies.remove(key)) {
+        history[m_streamingReplies.value(key)].text.clear();  // 第一段到达，去掉排队提示
+    }
+    history[m_streamingReplies.value(key)].text += delta;
+
+    if (conversationId == m_currentConversationId) {
+        updateChatHistoryView();
+    }
+}
+
+// AI请求正在排队：先显示一条排队提示，第一段回复到达时替换掉
+void MainWindow::onAIReplyQueued(const QString& conversationId, const QString& requestId, int ahead)
+{
+    onAIReplyPartial(conversationId, requestId, QString());
+    QString key = conversationId + "/" + requestId;
+    int index = m_streamingReplies.value(key);
+    m_chatHistories[conversationId][index].text =
+        QString("（正在排队，前面还有%1个请求）").arg(ahead);
+    m_queuedReplies.insert(key);
+
+    if (conversationId == m_currentConversationId) {
+        updateChatHistoryView();
+    }
+}
+
+// AI的完整回复：替换掉这个请求流式接收时显示的那一条；没有流式显示过（缓存命中、离线消息）时按新消息处理
+void MainWindow::onAIReplyFinished(const ChatMessage &message, const QString& conversationId, const QString& requestId)
+{
+    QString key = conversationId + "/" + requestId;
+    m_queuedReplies.remove(key);
+    if (m_streamingReplies.contains(key)) {
+        int index = m_streamingReplies.take(key);
+        QList<ChatMessage>& history = m_chatHistories[conversationId];
+        if (index < history.size()) {
+            history[index] = message;
+            if (conversationId == m_currentConversationId) {
+                updateChatHistoryView();
+            }
+            return;
+        }
+    }
+    onNewMessageReceived(message, conversationId);
+}
+
 void MainWindow::updateConversationItem(const QString& conversationId)
 {
     if (!m_conversationItems.contains(conversationId)) {
@@ -7,6 +7,7 @@
 #include <QList>      // <-- 新增：我们需要用到 QList
 #include <QDateTime>  // <-- 新增：用于记录消息时间
 #include <QVector>
+#include <QSet>
 #include <QMainWindow>
 #include "addfrienddialog.h"    // 包含头文件
 #include "creategroupdialog.h"  // 包含头文件
@@ -64,6 +65,15 @@ private slots:
 
     void onSetNicknameResult(bool success);
     void onCheckUserStatusResult(uint8_t userId, const QString& nickname, bool isOnline);
+    void onAIReplyPartial(const QString& conversationId, const QString& requestId, const QString& delta);
+    void onAIReplyQueued(const QString& conversationId, const QString& requestId, int ahead);
+    void onAIReplyFinished(const ChatMessage &message, const QString& conversationId, const QString& requestId);
+    void onHistoryReceived(const QString& conversationId,
+                           const QList<ChatMessage>& messages,
+                           const QMap<QDateTime, QByteArray>& images,
+                           bool hasMore,
+                           const QString& nextCursor);
+    void onChatHistoryScrolled(int value); // 滚动到顶部时加载更早的历史消息
 
 private:
     Ui::MainWindow *ui;
@@ -80,6 +90,14 @@ private:
     // 新增数据结构 - 需要声明
     QHash<QString, int> m_unreadCounts;  // 未读消息计数
     QHash<QString, QListWidgetItem*> m_conversationItems; // 对话项指针映射
+    // 正在流式接收的AI回复在聊天记录中的下标（键为 对话ID/请求编号，同一对话可以同时有多个请求）
+    QHash<QString, int> m_streamingReplies;
+    QSet<QString> m_queuedReplies;           // 还显示着排队提示的AI回复（键同上）
+    // 历史消息翻页状态（键为对话ID）：下一页的游标、是否还有更早的、是否有请求在路上
+    QHash<QString, QString> m_historyCursors;
+    QSet<QString> m_historyHasMore;
+    QSet<QString> m_historyLoading;
+    bool m_refreshingChatView = false;       // 正在重建聊天记录列表，这期间的滚动不触发翻页
 
     // [修改] 当前会话ID，从 int 改为 QString
     QString m_currentConversationId = "-1";
@@ -104,5 +122,6 @@ private:
     void setItemUnreadStyle(QListWidgetItem* item, int unreadCount);
 
     void updateWelcomeMessage();
+    void requestHistoryPage(const QString& conversationId);
 };
 #endif // MAINWINDOW_H
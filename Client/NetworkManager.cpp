@@ -235,7 +235,13 @@ void NetworkManager::onReadyRead()
                 QString conversationId = QString::number(senderId);
 
                 qDebug() << "收到 NormalMsg (私聊). 对话ID:" << conversationId << "发送者:" << senderId;
-                emit newMessageReceived(msg, conversationId);
+                // AI的完整回复带着请求编号，用来替换流式接收时显示的那一条
+                QString requestId = QString::fromStdString(receivedPacket.getField3Str());
+                if (!requestId.isEmpty()) {
+                    emit aiReplyFinished(msg, conversationId, requestId);
+                } else {
+                    emit newMessageReceived(msg, conversationId);
+                }
                 break;
             }
                 // [新增] 处理群聊消息
@@ -362,6 +368,85 @@ void NetworkManager::onReadyRead()
                 break;
             }
 
+            // AI流式回复的一段
+            case MsgType::AIPartial:
+            {
+                QString conversationId = QString::number(receivedPacket.getsendid());
+                QString delta = QString::fromStdString(receivedPacket.getField1Str());
+                QString requestId = QString::fromStdString(receivedPacket.getField2Str());
+                emit aiReplyPartial(conversationId, requestId, delta);
+                break;
+            }
+
+            // AI请求正在排队
+            case MsgType::AIQueued:
+            {
+                QString conversationId = QString::number(receivedPacket.getsendid());
+                int ahead = QString::fromStdString(receivedPacket.getField1Str()).toInt();
+                QString requestId = QString::fromStdString(receivedPacket.getField2Str());
+                emit aiReplyQueued(conversationId, requestId, ahead);
+                break;
+            }
+
+            // 历史消息：field4非空为一条消息（原类型、序号、时间戳），为空为这一页的结束包
+            case MsgType::HistoryRe:
+            {
+                const std::vector<uint8_t>& meta = receivedPacket.getField4();
+                if (meta.empty()) {
+                    QString conversationId = QString::fromStdString(receivedPacket.getField1Str());
+                    QString nextCursor = QString::fromStdString(receivedPacket.getField2Str());
+                    bool hasMore = receivedPacket.success();
+                    qDebug() << "收到历史消息，对话ID:" << conversationId
+                             << "条数:" << m_historyPages.value(conversationId).size()
+                             << "还有更早的:" << hasMore;
+                    emit historyReceived(conversationId,
+                                         m_historyPages.take(conversationId),
+                                         m_historyImages.take(conversationId),
+                                         hasMore, nextCursor);
+                    break;
+                }
+                if (meta.size() < 17) {
+                    qDebug() << "历史消息项格式错误，长度:" << meta.size();
+                    break;
+                }
+                MsgType originalType = static_cast<MsgType>(meta[0]);
+                quint64 timestampMs = 0;
+                for (int i = 0; i < 8; ++i) {
+                    timestampMs = (timestampMs << 8) | meta[9 + i];
+                }
+
+                uint8_t senderId = receivedPacket.getsendid();
+                uint8_t recvId = receivedPacket.getrecvid();
+                ChatMessage msg;
+                msg.senderId = senderId;
+                msg.timestamp = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(timestampMs));
+
+                QString conversationId;
+                if (originalType == MsgType::NormalMsg) {
+                    conversationId = QString::number(senderId == selfId() ? recvId : senderId);
+                    msg.text = QString::fromStdString(receivedPacket.getField1Str());
+                } else if (originalType == MsgType::GroupMsg) {
+                    conversationId = QString::fromStdString(receivedPacket.getField2Str());
+                    msg.text = QString::fromStdString(receivedPacket.getField1Str());
+                } else if (originalType == MsgType::ImageMsg) {
+                    if (receivedPacket.success()) {
+                        conversationId = QString::fromStdString(receivedPacket.getField3Str());
+                    } else {
+                        conversationId = QString::number(senderId == selfId() ? recvId : senderId);
+                    }
+                    const std::vector<uint8_t>& imageDataVec = receivedPacket.getField1();
+                    m_historyImages[conversationId].insert(msg.timestamp, QByteArray(
+                        reinterpret_cast<const char*>(imageDataVec.data()),
+                        imageDataVec.size()));
+                    msg.text = QString("[image:%1]").arg(msg.timestamp.toSecsSinceEpoch());
+                } else {
+                    qDebug() << "历史消息项类型未知:" << static_cast<int>(meta[0]);
+                    break;
+                }
+                m_historyPages[conversationId].append(msg);
+                break;
+            }
+
 
             default:
                 qDebug() << "Received unknown message type:" << static_cast<int>(receivedPacket.type());
@@ -570,3 +655,20 @@ void NetworkManager::sendCheckUserStatusRequest(uint8_t targetId)
     }
 }
 
+
+// 请求一页历史消息
+bool NetworkManager::sendHistoryRequest(const QString& conversationId, bool isGroup, const QString& cursor)
+{
+    if (m_socket->state() != QAbstractSocket::ConnectedState) {
+        qDebug() << "无法请求历史消息：未连接到服务器";
+        return false;
+    }
+
+    Packet p = Packet::makeHistoryReq(selfId(), isGroup, conversationId.toStdString(),
+                                      cursor.toStdString(), 50);
+    if (!p.sendTo(m_socket)) {
+        return false;
+    }
+    qDebug() << "已请求历史消息，对话ID:" << conversationId << "游标:" << cursor;
+    return true;
+}
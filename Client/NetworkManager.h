@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QTcpSocket>
 #include <QTimer>      // <--- 1. 添加 QTimer 头文件
+#include <QHash>
 #include "chatMsg.hpp" // <-- 改成这个正确的文件名
 #include "mainwindow.h"
 //static uint8_t selfId();
@@ -39,6 +40,8 @@ public:
     void sendSetNicknameRequest(const QString& nickname);
     // 查询用户状态
     void sendCheckUserStatusRequest(uint8_t targetId);
+    // 请求一页历史消息（cursor为空表示从最新一条开始往前取）
+    bool sendHistoryRequest(const QString& conversationId, bool isGroup, const QString& cursor = QString());
 
 signals:
     // --- 信号 (用来通知UI) ---
@@ -63,6 +66,18 @@ signals:
     void setNicknameResult(bool success);
     // 查询用户状态结果
     void checkUserStatusResult(uint8_t userId, const QString& nickname, bool isOnline);
+    // AI流式回复的一段（requestId区分同一对话中同时进行的多个请求，完整的回复随后通过aiReplyFinished送达）
+    void aiReplyPartial(const QString& conversationId, const QString& requestId, const QString& delta);
+    // AI请求正在排队（ahead为前面大约还有多少个请求，之后仍会收到aiReplyPartial或aiReplyFinished）
+    void aiReplyQueued(const QString& conversationId, const QString& requestId, int ahead);
+    // AI的完整回复（带请求编号的NormalMsg）
+    void aiReplyFinished(const ChatMessage &message, const QString& conversationId, const QString& requestId);
+    // 一页历史消息（按从旧到新排列，图片消息的数据按时间戳放在images里）
+    void historyReceived(const QString& conversationId,
+                         const QList<ChatMessage>& messages,
+                         const QMap<QDateTime, QByteArray>& images,
+                         bool hasMore,
+                         const QString& nextCursor);
 
 public slots:
     // --- 公共槽 (给其他类调用, 比如UI) ---
@@ -93,6 +108,9 @@ private:
     QTimer* m_heartbeatTimer;
     // === 新增：用于存储当前用户ID的成员变量 ===
     uint8_t m_currentUserId = 0; // 默认给一个无效值0
+    // 正在接收的历史消息页（键为对话ID，收到结束包时一起交给UI）
+    QHash<QString, QList<ChatMessage>> m_historyPages;
+    QHash<QString, QMap<QDateTime, QByteArray>> m_historyImages;
 
 };
 
@@ -31,7 +31,11 @@ enum class MsgType : uint8_t
     GroupMsg     = 0x11,  // 群聊消息
     ImageMsg     = 0x12,  // 图片消息
     SetName      = 0x13,  //[新增]设置用户名
-    CheckUser    = 0x14   //[新增]查询用户状态
+    CheckUser    = 0x14,  //[新增]查询用户状态
+    HistoryReq   = 0x15,  // 历史消息翻页请求
+    HistoryRe    = 0x16,  // 历史消息翻页反馈（field4非空为消息项，为空为一页的结束包）
+    AIPartial    = 0x17,  // AI回复的一段（field1为新增的文本，field2为请求编号；完整的回复最后仍以NormalMsg发送，field3为同一个请求编号）
+    AIQueued     = 0x18   // AI请求正在排队（field1为前面大约还有多少个请求，field2为请求编号）
 };
 
 #pragma pack(push,1)
@@ -198,8 +202,8 @@ public:
     static Packet makeAddFriendRe(uint8_t sendId, uint8_t targetId, bool s)
     {
         Packet p(MsgType::AddFriendRe);
-        p.hdr.sendid = targetId;   // 这里sendId是最初发起请求的人
-        p.hdr.recvid = sendId; // 这里recvid通常是做出响应的人（被添加者）
+        p.hdr.sendid = targetId;   // 做出响应的人（被添加者，即自己）
+        p.hdr.recvid = sendId;     // 最初发起请求的人
         p.hdr.success = s;
         p.finish();
         return p;
@@ -305,6 +309,25 @@ public:
         return p;
     }
 
+    /* 方法：历史消息翻页请求 */
+    // 私聊时conversation填对方ID，群聊时填群名；cursor为空表示从最新一条开始往前取
+    static Packet makeHistoryReq(uint8_t selfId, bool isGroup, const std::string& conversation,
+                                 const std::string& cursor, int pageSize)
+    {
+        Packet p(MsgType::HistoryReq);
+        p.hdr.sendid = selfId;
+        p.hdr.success = isGroup;
+        if (isGroup) {
+            p.writeField1(conversation);
+        } else {
+            p.hdr.recvid = static_cast<uint8_t>(std::stoi(conversation));
+        }
+        p.writeField2(cursor);
+        p.writeField3(std::to_string(pageSize));
+        p.finish();
+        return p;
+    }
+
     uint8_t getsendid()
     {
         return hdr.sendid;
@@ -0,0 +1,616 @@
+#include "headers/accountStore.h"
+#include "headers/userControl.h"
+#include "headers/logger.h"
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <map>
+
+// 全局账号存储实例
+AccountStore g_accountStore;
+
+// 存储参数
+static const char* ACCOUNT_FOLDER = "data";
+static const uint32_t WAL_RECORD_MAGIC = 0x4C415757;        // "WWAL"
+static const uint32_t SNAPSHOT_MAGIC = 0x4E534341;          // "ACSN"
+static const uint32_t SNAPSHOT_VERSION = 1;
+static const uint64_t SNAPSHOT_INTERVAL_RECORDS = 10000;    // 日志超过这么多条就写一次新快照
+
+// 日志记录类型
+enum WalOp : uint8_t {
+    WAL_SIGNUP = 1,
+    WAL_SET_NAME = 2,
+    WAL_CREATE_GROUP = 3,
+    WAL_DELETE_USER = 4,
+};
+
+#pragma pack(push,1)
+// 日志记录头部，后面紧跟length字节的记录内容
+struct WalRecordHeader {
+    uint32_t magic;
+    uint32_t length;
+    uint32_t checksum;  // 记录内容的FNV-1a校验值
+    uint64_t lsn;
+    uint8_t  op;
+};
+
+// 快照文件头部，后面依次是所有用户和所有群聊
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t lsn;         // 快照包含到的日志序号
+    uint32_t userCount;
+    uint32_t groupCount;
+    uint32_t checksum;    // 快照正文的FNV-1a校验值
+};
+#pragma pack(pop)
+
+// FNV-1a校验（只用来发现写坏的记录）
+static uint32_t Checksum(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 二进制写入辅助函数
+static void PutU8(std::vector<char>& out, uint8_t v) {
+    out.push_back(static_cast<char>(v));
+}
+static void PutU16(std::vector<char>& out, uint16_t v) {
+    out.insert(out.end(), reinterpret_cast<const char*>(&v), reinterpret_cast<const char*>(&v) + sizeof(v));
+}
+static void PutString(std::vector<char>& out, const std::string& s) {
+    PutU16(out, static_cast<uint16_t>(s.size()));
+    out.insert(out.end(), s.begin(), s.begin() + static_cast<uint16_t>(s.size()));
+}
+
+// 二进制读取辅助类（越界时ok变为false，后续读取都返回空值）
+struct ByteReader {
+    const char* data;
+    size_t size;
+    size_t offset = 0;
+    bool ok = true;
+
+    ByteReader(const char* d, size_t s) : data(d), size(s) {}
+
+    uint8_t U8() {
+        if (!ok || offset + 1 > size) { ok = false; return 0; }
+        return static_cast<uint8_t>(data[offset++]);
+    }
+    uint16_t U16() {
+        uint16_t v = 0;
+        if (!ok || offset + sizeof(v) > size) { ok = false; return 0; }
+        memcpy(&v, data + offset, sizeof(v));
+        offset += sizeof(v);
+        return v;
+    }
+    std::string String() {
+        uint16_t len = U16();
+        if (!ok || offset + len > size) { ok = false; return ""; }
+        std::string s(data + offset, len);
+        offset += len;
+        return s;
+    }
+};
+
+// 把一个文件整个只读映射进来（用完调用UnmapFile）
+struct MappedFile {
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+static bool MapFile(const std::string& path, MappedFile& mapped) {
+    mapped.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mapped.file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(mapped.file, &fileSize) || fileSize.QuadPart == 0) {
+        return true;  // 空文件：没有内容可读，但不算错误
+    }
+    mapped.size = static_cast<size_t>(fileSize.QuadPart);
+    mapped.mapping = CreateFileMappingA(mapped.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapped.mapping) {
+        return false;
+    }
+    mapped.data = static_cast<const char*>(MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0));
+    return mapped.data != nullptr;
+}
+
+static void UnmapFile(MappedFile& mapped) {
+    if (mapped.data) UnmapViewOfFile(mapped.data);
+    if (mapped.mapping) CloseHandle(mapped.mapping);
+    if (mapped.file != INVALID_HANDLE_VALUE) CloseHandle(mapped.file);
+    mapped = MappedFile();
+}
+
+// 日志文件名带上第一条记录的序号，按文件名排序就是重放顺序
+static std::string LogFileName(uint64_t startLsn) {
+    char name[48];
+    snprintf(name, sizeof(name), "wal_%020llu.log", static_cast<unsigned long long>(startLsn));
+    return name;
+}
+
+AccountStore::AccountStore()
+    : logFile_(INVALID_HANDLE_VALUE),
+      logStartLsn_(1),
+      logSize_(0),
+      logHealthy_(true),
+      nextLsn_(1),
+      durableLsn_(0),
+      snapshotLsn_(0),
+      opened_(false),
+      stopping_(false) {
+}
+
+AccountStore::~AccountStore() {
+    Close();
+}
+
+bool AccountStore::Open(const std::string& directory) {
+    directory_ = directory;
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // 1. 加载快照
+    if (!LoadSnapshot()) {
+        return false;
+    }
+
+    // 2. 按顺序重放快照之后的日志
+    std::vector<std::string> logFiles;
+    for (const auto& item : std::filesystem::directory_iterator(directory_, ec)) {
+        std::string name = item.path().filename().string();
+        if (name.rfind("wal_", 0) == 0) {
+            logFiles.push_back(name);
+        }
+    }
+    std::sort(logFiles.begin(), logFiles.end());
+    uint64_t replayFrom = nextLsn_;
+    for (const std::string& name : logFiles) {
+        ReplayLog(directory_ + "/" + name);
+    }
+
+    // 3. 恢复出的数据就是已落盘的数据，复制到全局map中
+    {
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        g_userCredentials = durableCredentials_;
+        g_userName = durableNames_;
+        g_groupChat = durableGroups_;
+        for (const auto& pair : durableCredentials_) {
+            g_userSessions[pair.first] = nullptr;
+        }
+    }
+
+    // 4. 每次启动新开一个日志文件，不续写可能被截断的旧文件
+    durableLsn_ = nextLsn_ - 1;
+    if (!OpenLogFile(nextLsn_)) {
+        WriteLog(LogLevel::FATAL, "无法创建账号日志文件: " + directory_ + "/" + LogFileName(nextLsn_));
+        return false;
+    }
+
+    opened_ = true;
+    stopping_ = false;
+    flushThread_ = std::thread(&AccountStore::FlushThread, this);
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+    WriteLog(LogLevel::INFO, "账号存储已加载: 用户 " + std::to_string(g_userCredentials.size()) +
+             " 个, 群聊 " + std::to_string(g_groupChat.size()) +
+             " 个, 重放日志 " + std::to_string(nextLsn_ - replayFrom) +
+             " 条, 耗时 " + std::to_string(elapsed) + "ms");
+    return true;
+}
+
+void AccountStore::Close() {
+    {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        if (!opened_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    pendingCv_.notify_all();
+    if (flushThread_.joinable()) {
+        flushThread_.join();
+    }
+    {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        if (logFile_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(logFile_);
+            logFile_ = INVALID_HANDLE_VALUE;
+        }
+        opened_ = false;
+    }
+    durableCv_.notify_all();  // 还在等待的调用不再等下去
+}
+
+bool AccountStore::LoadSnapshot() {
+    std::string path = directory_ + "/snapshot.dat";
+    if (!std::filesystem::exists(path)) {
+        return true;  // 第一次启动，没有快照
+    }
+
+    MappedFile mapped;
+    if (!MapFile(path, mapped) || mapped.size < sizeof(SnapshotHeader)) {
+        UnmapFile(mapped);
+        WriteLog(LogLevel::FATAL, "账号快照无法读取: " + path);
+        return false;
+    }
+
+    SnapshotHeader header;
+    memcpy(&header, mapped.data, sizeof(header));
+    const char* body = mapped.data + sizeof(header);
+    size_t bodySize = mapped.size - sizeof(header);
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        Checksum(body, bodySize) != header.checksum) {
+        UnmapFile(mapped);
+        WriteLog(LogLevel::FATAL, "账号快照已损坏: " + path);
+        return false;
+    }
+
+    ByteReader reader(body, bodySize);
+    for (uint32_t i = 0; i < header.userCount && reader.ok; ++i) {
+        uint8_t userID = reader.U8();
+        std::string password = reader.String();
+        std::string userName = reader.String();
+        durableCredentials_[userID] = password;
+        durableNames_[userID] = userName;
+    }
+    for (uint32_t i = 0; i < header.groupCount && reader.ok; ++i) {
+        std::string groupName = reader.String();
+        uint16_t memberCount = reader.U16();
+        std::vector<uint8_t> members;
+        members.reserve(memberCount);
+        for (uint16_t j = 0; j < memberCount && reader.ok; ++j) {
+            members.push_back(reader.U8());
+        }
+        durableGroups_[groupName] = members;
+    }
+    UnmapFile(mapped);
+
+    if (!reader.ok) {
+        WriteLog(LogLevel::FATAL, "账号快照内容不完整: " + path);
+        return false;
+    }
+    snapshotLsn_ = header.lsn;
+    nextLsn_ = header.lsn + 1;
+    return true;
+}
+
+void AccountStore::ReplayLog(const std::string& path) {
+    MappedFile mapped;
+    if (!MapFile(path, mapped)) {
+        UnmapFile(mapped);
+        WriteLog(LogLevel::WARN, "账号日志无法读取: " + path);
+        return;
+    }
+
+    size_t offset = 0;
+    while (offset + sizeof(WalRecordHeader) <= mapped.size) {
+        WalRecordHeader header;
+        memcpy(&header, mapped.data + offset, sizeof(header));
+        const char* payload = mapped.data + offset + sizeof(header);
+        if (header.magic != WAL_RECORD_MAGIC || offset + sizeof(header) + header.length > mapped.size ||
+            Checksum(payload, header.length) != header.checksum) {
+            // 崩溃时写了一半的尾部（这部分调用方还没收到落盘确认）
+            WriteLog(LogLevel::WARN, "账号日志尾部损坏, 已忽略: " + path);
+            break;
+        }
+        // 快照里已经包含的记录跳过
+        if (header.lsn >= nextLsn_) {
+            if (!ApplyRecord(header.op, payload, header.length)) {
+                WriteLog(LogLevel::WARN, "账号日志记录无法解析, 序号: " + std::to_string(header.lsn));
+            }
+            nextLsn_ = header.lsn + 1;
+        }
+        offset += sizeof(header) + header.length;
+    }
+    UnmapFile(mapped);
+}
+
+// 把一条日志记录应用到已落盘的账号数据上（Open时或刷盘线程中调用）
+bool AccountStore::ApplyRecord(uint8_t op, const char* data, size_t size) {
+    ByteReader reader(data, size);
+    switch (op) {
+        case WAL_SIGNUP: {
+            uint8_t userID = reader.U8();
+            std::string password = reader.String();
+            if (!reader.ok) return false;
+            durableCredentials_[userID] = password;
+            durableNames_[userID] = "Anonymous";
+            return true;
+        }
+        case WAL_SET_NAME: {
+            uint8_t userID = reader.U8();
+            std::string userName = reader.String();
+            if (!reader.ok) return false;
+            durableNames_[userID] = userName;
+            return true;
+        }
+        case WAL_CREATE_GROUP: {
+            std::string groupName = reader.String();
+            uint16_t memberCount = reader.U16();
+            std::vector<uint8_t> members;
+            for (uint16_t i = 0; i < memberCount && reader.ok; ++i) {
+                members.push_back(reader.U8());
+            }
+            if (!reader.ok) return false;
+            durableGroups_[groupName] = members;
+            return true;
+        }
+        case WAL_DELETE_USER: {
+            uint8_t userID = reader.U8();
+            if (!reader.ok) return false;
+            durableCredentials_.erase(userID);
+            durableNames_.erase(userID);
+            for (auto& group : durableGroups_) {
+                auto& memberList = group.second;
+                memberList.erase(std::remove(memberList.begin(), memberList.end(), userID), memberList.end());
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// 把刚写成功的一批记录应用到已落盘的账号数据上（只在刷盘线程中调用，批内的记录是AppendRecord写的，格式完整）
+void AccountStore::ApplyBatch(const std::vector<char>& batch) {
+    size_t offset = 0;
+    while (offset + sizeof(WalRecordHeader) <= batch.size()) {
+        WalRecordHeader header;
+        memcpy(&header, batch.data() + offset, sizeof(header));
+        ApplyRecord(header.op, batch.data() + offset + sizeof(header), header.length);
+        offset += sizeof(header) + header.length;
+    }
+}
+
+bool AccountStore::OpenLogFile(uint64_t startLsn) {
+    HANDLE file = CreateFileA((directory_ + "/" + LogFileName(startLsn)).c_str(), GENERIC_WRITE, FILE_SHARE_READ,
+                              nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    if (logFile_ != INVALID_HANDLE_VALUE) {
+        CloseHandle(logFile_);
+    }
+    logFile_ = file;
+    logStartLsn_ = startLsn;
+    logSize_ = 0;
+    logHealthy_ = true;
+    return true;
+}
+
+// 写盘失败后让日志文件重新以完整的记录结尾：截回logSize_，截不回去就从nextLsn开始换一个新文件
+// （只在刷盘线程中调用）
+bool AccountStore::RecoverLogFile(uint64_t nextLsn) {
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(logSize_);
+    if (SetFilePointerEx(logFile_, position, nullptr, FILE_BEGIN) && SetEndOfFile(logFile_)) {
+        logHealthy_ = true;
+        return true;
+    }
+    if (OpenLogFile(nextLsn)) {
+        WriteLog(LogLevel::WARN, "账号日志无法截断, 已换用新日志文件: " + LogFileName(nextLsn));
+        return true;
+    }
+    logHealthy_ = false;
+    WriteLog(LogLevel::FATAL, "账号日志无法截断也无法换新文件, 之后的修改都不会保存, 错误码: " +
+             std::to_string(GetLastError()));
+    return false;
+}
+
+bool AccountStore::IsFailed(uint64_t lsn) const {
+    for (const auto& range : failedRanges_) {
+        if (lsn >= range.first && lsn <= range.second) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t AccountStore::AppendRecord(uint8_t op, const std::vector<char>& payload) {
+    WalRecordHeader header = {};
+    header.magic = WAL_RECORD_MAGIC;
+    header.length = static_cast<uint32_t>(payload.size());
+    header.checksum = Checksum(payload.data(), payload.size());
+    header.op = op;
+
+    uint64_t lsn = 0;
+    {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        if (!opened_) {
+            return 0;
+        }
+        lsn = nextLsn_++;
+        header.lsn = lsn;
+        const char* raw = reinterpret_cast<const char*>(&header);
+        pending_.insert(pending_.end(), raw, raw + sizeof(header));
+        pending_.insert(pending_.end(), payload.begin(), payload.end());
+    }
+    pendingCv_.notify_one();
+    return lsn;
+}
+
+uint64_t AccountStore::LogSignup(uint8_t userID, const std::string& password) {
+    std::vector<char> payload;
+    PutU8(payload, userID);
+    PutString(payload, password);
+    return AppendRecord(WAL_SIGNUP, payload);
+}
+
+uint64_t AccountStore::LogSetName(uint8_t userID, const std::string& userName) {
+    std::vector<char> payload;
+    PutU8(payload, userID);
+    PutString(payload, userName);
+    return AppendRecord(WAL_SET_NAME, payload);
+}
+
+uint64_t AccountStore::LogCreateGroup(const std::string& groupName, const std::vector<uint8_t>& memberList) {
+    std::vector<char> payload;
+    PutString(payload, groupName);
+    PutU16(payload, static_cast<uint16_t>(memberList.size()));
+    for (uint8_t memberID : memberList) {
+        PutU8(payload, memberID);
+    }
+    return AppendRecord(WAL_CREATE_GROUP, payload);
+}
+
+uint64_t AccountStore::LogDeleteUser(uint8_t userID) {
+    std::vector<char> payload;
+    PutU8(payload, userID);
+    return AppendRecord(WAL_DELETE_USER, payload);
+}
+
+bool AccountStore::WaitDurable(uint64_t lsn) {
+    if (lsn == 0) {
+        return true;
+    }
+    mutex_.lock(LOCK_SITE);
+    std::unique_lock<InstrumentedMutex> lock(mutex_, std::adopt_lock);
+    durableCv_.wait(lock, [this, lsn] { return durableLsn_ >= lsn || IsFailed(lsn) || !opened_; });
+    return durableLsn_ >= lsn && !IsFailed(lsn);
+}
+
+// 刷盘线程：把等待期间攒下的所有记录一次写出并刷盘（组提交）
+void AccountStore::FlushThread() {
+    uint64_t previousLastLsn = 0;  // 上一批的最后一个序号（这一批从它的下一个开始）
+    {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        previousLastLsn = nextLsn_ - 1;
+    }
+    while (true) {
+        std::vector<char> batch;
+        uint64_t batchLastLsn = 0;
+        {
+            mutex_.lock(LOCK_SITE);
+            std::unique_lock<InstrumentedMutex> lock(mutex_, std::adopt_lock);
+            pendingCv_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            if (pending_.empty() && stopping_) {
+                break;
+            }
+            batch.swap(pending_);
+            batchLastLsn = nextLsn_ - 1;
+        }
+
+        uint64_t batchFirstLsn = previousLastLsn + 1;
+        previousLastLsn = batchLastLsn;
+
+        // 上一次失败后日志文件末尾不完整时先恢复，恢复不了这一批也不写
+        bool ok = logHealthy_ || RecoverLogFile(batchFirstLsn);
+        if (ok) {
+            DWORD written = 0;
+            ok = WriteFile(logFile_, batch.data(), static_cast<DWORD>(batch.size()), &written, nullptr) &&
+                 written == batch.size() && FlushFileBuffers(logFile_);
+            if (!ok) {
+                WriteLog(LogLevel::FATAL, "账号日志写入失败, 序号 " + std::to_string(batchFirstLsn) + "-" +
+                         std::to_string(batchLastLsn) + " 的修改未保存, 错误码: " + std::to_string(GetLastError()));
+                RecoverLogFile(batchLastLsn + 1);
+            }
+        }
+
+        {
+            InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+            if (ok) {
+                durableLsn_ = batchLastLsn;
+                logSize_ += batch.size();
+            } else if (!failedRanges_.empty() && failedRanges_.back().second + 1 == batchFirstLsn) {
+                failedRanges_.back().second = batchLastLsn;  // 连续失败的批次合并成一个区间
+            } else {
+                // 区间不丢弃：丢掉后，等待其中记录的调用会在之后某一批成功时误以为自己的记录已经落盘
+                failedRanges_.push_back({batchFirstLsn, batchLastLsn});
+            }
+        }
+        durableCv_.notify_all();
+
+        if (ok) {
+            ApplyBatch(batch);
+            // 快照只在一批写成功后写出，这时已落盘的数据正好包含到batchLastLsn，之后的记录都写进新日志文件
+            if (batchLastLsn - snapshotLsn_ >= SNAPSHOT_INTERVAL_RECORDS) {
+                WriteSnapshot(batchLastLsn);
+            }
+        }
+    }
+}
+
+// 把已落盘的账号数据（包含到lsn）写成新快照，然后换新日志文件并删除快照已经覆盖的旧日志（只在刷盘线程中调用）
+void AccountStore::WriteSnapshot(uint64_t lsn) {
+    const std::map<uint8_t, std::string>& credentials = durableCredentials_;
+    const std::map<uint8_t, std::string>& userNames = durableNames_;
+    const std::map<std::string, std::vector<uint8_t>>& groups = durableGroups_;
+
+    std::vector<char> body;
+    for (const auto& pair : credentials) {
+        PutU8(body, pair.first);
+        PutString(body, pair.second);
+        auto nameIt = userNames.find(pair.first);
+        PutString(body, nameIt != userNames.end() ? nameIt->second : "Anonymous");
+    }
+    for (const auto& pair : groups) {
+        PutString(body, pair.first);
+        PutU16(body, static_cast<uint16_t>(pair.second.size()));
+        for (uint8_t memberID : pair.second) {
+            PutU8(body, memberID);
+        }
+    }
+
+    SnapshotHeader header = {};
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.lsn = lsn;
+    header.userCount = static_cast<uint32_t>(credentials.size());
+    header.groupCount = static_cast<uint32_t>(groups.size());
+    header.checksum = Checksum(body.data(), body.size());
+
+    // 先写临时文件并刷盘，再原子替换
+    std::string path = directory_ + "/snapshot.dat";
+    std::string tempPath = path + ".tmp";
+    HANDLE file = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        WriteLog(LogLevel::WARN, "无法创建账号快照文件");
+        return;
+    }
+    DWORD written = 0;
+    bool ok = WriteFile(file, &header, sizeof(header), &written, nullptr) && written == sizeof(header) &&
+              WriteFile(file, body.data(), static_cast<DWORD>(body.size()), &written, nullptr) &&
+              written == body.size() && FlushFileBuffers(file);
+    CloseHandle(file);
+    if (!ok || !MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        WriteLog(LogLevel::WARN, "账号快照写入失败, 错误码: " + std::to_string(GetLastError()));
+        return;
+    }
+
+    // 快照已覆盖到lsn，换新日志文件后旧日志都可以删掉
+    {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        snapshotLsn_ = lsn;
+    }
+    if (!OpenLogFile(lsn + 1)) {
+        WriteLog(LogLevel::WARN, "无法创建新的账号日志文件，继续使用旧文件");
+        return;
+    }
+    std::error_code ec;
+    for (const auto& item : std::filesystem::directory_iterator(directory_, ec)) {
+        std::string name = item.path().filename().string();
+        if (name.rfind("wal_", 0) == 0 && name != LogFileName(logStartLsn_)) {
+            std::filesystem::remove(item.path(), ec);
+        }
+    }
+    WriteLog(LogLevel::INFO, "账号快照已更新, 序号: " + std::to_string(lsn));
+}
+
+void InitializeAccountStore() {
+    if (!g_accountStore.Open(ACCOUNT_FOLDER)) {
+        WriteLog(LogLevel::FATAL, "账号存储初始化失败，账号和群聊修改将不会被保存");
+    }
+}
@@ -0,0 +1,126 @@
+#include "headers/aiCache.h"
+#include <cstdio>
+
+// 每个条目除了键和回复之外的固定开销（链表节点、索引节点、字符串对象）
+static const size_t AI_CACHE_ENTRY_OVERHEAD = 128;
+
+// 64位FNV-1a哈希
+static uint64_t HashKey(const std::string& key) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string MakeAICacheKey(const std::string& model, float temperature, const std::string& prompt) {
+    char temperatureText[32];
+    snprintf(temperatureText, sizeof(temperatureText), "%.3f", temperature);
+
+    std::string key;
+    key.reserve(model.size() + prompt.size() + 16);
+    key += model;
+    key += '\n';
+    key += temperatureText;
+    key += '\n';
+
+    // 规范化提问：去掉首尾空白，连续的空白合并为一个空格
+    bool pendingSpace = false;
+    for (char c : prompt) {
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            pendingSpace = true;
+            continue;
+        }
+        if (pendingSpace && key.back() != '\n') {
+            key += ' ';
+        }
+        pendingSpace = false;
+        key += c;
+    }
+    return key;
+}
+
+AIResponseCache::AIResponseCache()
+    : mutex_("aiCache"), bytes_(0), maxBytes_(0), ttl_(0) {
+}
+
+void AIResponseCache::Configure(size_t maxBytes, int ttlSeconds) {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    maxBytes_ = maxBytes;
+    ttl_ = std::chrono::seconds(ttlSeconds > 0 ? ttlSeconds : 0);
+    while (!lru_.empty() && (bytes_ > maxBytes_ || ttl_.count() == 0)) {
+        EraseLocked(std::prev(lru_.end()));
+    }
+}
+
+size_t AIResponseCache::EntryBytes(const Entry& entry) {
+    return entry.key.size() + entry.reply.size() + AI_CACHE_ENTRY_OVERHEAD;
+}
+
+void AIResponseCache::EraseLocked(std::list<Entry>::iterator it) {
+    bytes_ -= EntryBytes(*it);
+    index_.erase(it->hash);
+    lru_.erase(it);
+}
+
+bool AIResponseCache::Lookup(const std::string& key, std::string& reply) {
+    uint64_t hash = HashKey(key);
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    auto found = index_.find(hash);
+    if (found == index_.end()) {
+        return false;
+    }
+    auto it = found->second;
+    if (it->key != key) {
+        return false;  // 哈希冲突
+    }
+    if (std::chrono::steady_clock::now() >= it->expires) {
+        EraseLocked(it);
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it);  // 移到表头
+    reply = it->reply;
+    return true;
+}
+
+void AIResponseCache::Insert(const std::string& key, const std::string& reply) {
+    uint64_t hash = HashKey(key);
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    if (maxBytes_ == 0 || ttl_.count() == 0) {
+        return;
+    }
+
+    auto found = index_.find(hash);
+    if (found != index_.end()) {
+        EraseLocked(found->second);  // 同一个键（或哈希冲突的旧键）被新回复替换
+    }
+
+    Entry entry;
+    entry.hash = hash;
+    entry.key = key;
+    entry.reply = reply;
+    entry.expires = std::chrono::steady_clock::now() + ttl_;
+    size_t entryBytes = EntryBytes(entry);
+    if (entryBytes > maxBytes_) {
+        return;  // 单条就超过上限，不缓存
+    }
+
+    // 从最久未用的条目开始淘汰，直到放得下
+    while (!lru_.empty() && bytes_ + entryBytes > maxBytes_) {
+        EraseLocked(std::prev(lru_.end()));
+    }
+    lru_.push_front(std::move(entry));
+    index_[hash] = lru_.begin();
+    bytes_ += entryBytes;
+}
+
+size_t AIResponseCache::Bytes() {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    return bytes_;
+}
+
+size_t AIResponseCache::Entries() {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    return lru_.size();
+}
@@ -0,0 +1,150 @@
+#include "headers/aiContext.h"
+
+// 每条消息在请求中的固定开销（role等字段）
+static const uint32_t AI_MESSAGE_TOKEN_OVERHEAD = 4;
+
+// 每轮问答除了文本之外的内存开销（环中的元素、字符串对象）
+static const size_t AI_TURN_BYTES_OVERHEAD = 96;
+
+// 摘要中每轮提问最多保留的字节数
+static const size_t AI_SUMMARY_SNIPPET_BYTES = 60;
+
+uint32_t EstimateTokens(const std::string& text) {
+    uint32_t asciiChars = 0;
+    uint32_t otherChars = 0;
+    for (unsigned char c : text) {
+        if (c < 0x80) {
+            asciiChars++;
+        } else if ((c & 0xC0) != 0x80) {
+            otherChars++;  // UTF-8的首字节，后续字节不计数
+        }
+    }
+    return (asciiChars + 3) / 4 + otherChars;
+}
+
+// 截取文本开头不超过maxBytes字节，不截断UTF-8字符
+static std::string Utf8Prefix(const std::string& text, size_t maxBytes) {
+    if (text.size() <= maxBytes) {
+        return text;
+    }
+    size_t end = maxBytes;
+    while (end > 0 && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+        end--;
+    }
+    return text.substr(0, end) + "...";
+}
+
+AIContextStore::AIContextStore()
+    : mutex_("aiContext"), bytes_(0), maxBytes_(0), tokenBudget_(0), clock_(0) {
+}
+
+void AIContextStore::Configure(size_t tokenBudget, size_t maxBytes) {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    tokenBudget_ = tokenBudget;
+    maxBytes_ = (tokenBudget == 0) ? 0 : maxBytes;
+    EvictLocked();
+}
+
+size_t AIContextStore::TurnBytes(const AIContextTurn& turn) {
+    return turn.user.size() + turn.assistant.size() + AI_TURN_BYTES_OVERHEAD;
+}
+
+void AIContextStore::EvictLocked() {
+    while (bytes_ > maxBytes_) {
+        UserContext* oldest = nullptr;
+        for (UserContext& context : users_) {
+            if (!context.turns.empty() && (oldest == nullptr || context.lastUsed < oldest->lastUsed)) {
+                oldest = &context;
+            }
+        }
+        if (oldest == nullptr) {
+            bytes_ = 0;
+            return;
+        }
+        bytes_ -= TurnBytes(oldest->turns.front());
+        oldest->turns.pop_front();
+    }
+}
+
+void AIContextStore::Collect(uint8_t userID, std::vector<AIContextTurn>& turns, std::string& summary) {
+    turns.clear();
+    summary.clear();
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    const std::deque<AIContextTurn>& history = users_[userID].turns;
+
+    // 全部放得下时不需要摘要；放不下时先给摘要留出四分之一的预算，窗口只用剩下的部分，
+    // 窗口和摘要加起来不超过预算
+    size_t total = 0;
+    for (const AIContextTurn& turn : history) {
+        total += turn.tokens;
+    }
+    size_t summaryBudget = total <= tokenBudget_ ? 0 : tokenBudget_ / 4;
+    size_t windowBudget = tokenBudget_ - summaryBudget;
+
+    // 从最新的一轮往前取，直到放不下
+    size_t used = 0;
+    size_t first = history.size();
+    while (first > 0 && used + history[first - 1].tokens <= windowBudget) {
+        used += history[first - 1].tokens;
+        first--;
+    }
+    turns.assign(history.begin() + first, history.end());
+
+    // 窗口之前的各轮：从最近的往前取提问的开头，合成摘要（摘要消息的前缀和固定开销也算在摘要的预算内）
+    static const char* const SUMMARY_PREFIX = "此前用户还问过：";
+    size_t summaryTokens = EstimateTokens(SUMMARY_PREFIX) + AI_MESSAGE_TOKEN_OVERHEAD;
+    std::vector<std::string> snippets;
+    for (size_t i = first; i > 0; --i) {
+        std::string snippet = Utf8Prefix(history[i - 1].user, AI_SUMMARY_SNIPPET_BYTES);
+        uint32_t tokens = EstimateTokens(snippet) + 1;
+        if (summaryTokens + tokens > summaryBudget) {
+            break;
+        }
+        summaryTokens += tokens;
+        snippets.push_back(std::move(snippet));
+    }
+    if (!snippets.empty()) {
+        summary = SUMMARY_PREFIX;
+        for (size_t i = snippets.size(); i > 0; --i) {
+            summary += snippets[i - 1];
+            if (i > 1) {
+                summary += "；";
+            }
+        }
+    }
+}
+
+void AIContextStore::Append(uint8_t userID, const std::string& userText, const std::string& assistantText) {
+    AIContextTurn turn;
+    turn.user = userText;
+    turn.assistant = assistantText;
+    turn.tokens = EstimateTokens(userText) + EstimateTokens(assistantText) + 2 * AI_MESSAGE_TOKEN_OVERHEAD;
+
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    if (maxBytes_ == 0) {
+        return;
+    }
+    UserContext& context = users_[userID];
+    if (context.turns.size() >= AI_CONTEXT_MAX_TURNS) {
+        bytes_ -= TurnBytes(context.turns.front());
+        context.turns.pop_front();
+    }
+    bytes_ += TurnBytes(turn);
+    context.turns.push_back(std::move(turn));
+    context.lastUsed = ++clock_;
+    EvictLocked();
+}
+
+void AIContextStore::Clear(uint8_t userID) {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    UserContext& context = users_[userID];
+    for (const AIContextTurn& turn : context.turns) {
+        bytes_ -= TurnBytes(turn);
+    }
+    context.turns.clear();
+}
+
+size_t AIContextStore::Bytes() {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    return bytes_;
+}
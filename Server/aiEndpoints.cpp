@@ -0,0 +1,133 @@
+#include "headers/aiEndpoints.h"
+#include <algorithm>
+
+// 首字节时间指数平均的权重
+static const double AI_LATENCY_EWMA_ALPHA = 0.2;
+
+AIEndpointPool::AIEndpointPool() : nextAttempt_(0), hedgeBudget_(AI_HEDGE_BUDGET_MAX), openCount_(0) {
+}
+
+void AIEndpointPool::Configure(size_t count) {
+    endpoints_.assign(std::min(count, AI_MAX_ENDPOINTS), Endpoint());
+    hedgeBudget_ = AI_HEDGE_BUDGET_MAX;
+    openCount_.store(0, std::memory_order_relaxed);
+}
+
+int AIEndpointPool::Pick(uint32_t excludeMask, Clock::time_point now, uint64_t& attempt) {
+    int best = -1;
+    double bestScore = 0;
+    for (size_t i = 0; i < endpoints_.size(); ++i) {
+        Endpoint& endpoint = endpoints_[i];
+        if (excludeMask & (1u << i)) {
+            continue;
+        }
+        if (endpoint.state == State::OPEN) {
+            if (now < endpoint.openUntil) {
+                continue;
+            }
+            endpoint.state = State::HALF_OPEN;  // 断开时间到了，允许一个探测请求
+            openCount_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        if (endpoint.state == State::HALF_OPEN && endpoint.probing) {
+            continue;
+        }
+        double score = endpoint.ewmaMs * (endpoint.inFlight + 1);
+        if (best < 0 || score < bestScore) {
+            best = static_cast<int>(i);
+            bestScore = score;
+        }
+    }
+    if (best >= 0) {
+        Endpoint& endpoint = endpoints_[best];
+        endpoint.inFlight++;
+        attempt = ++nextAttempt_;
+        if (endpoint.state == State::HALF_OPEN) {
+            endpoint.probing = true;
+            endpoint.probeAttempt = attempt;
+        }
+    }
+    return best;
+}
+
+// 一次尝试结束；返回它是否是正在进行的探测请求（只有探测请求结束时才清除探测状态）
+bool AIEndpointPool::Finish(Endpoint& endpoint, uint64_t attempt) {
+    if (endpoint.inFlight > 0) {
+        endpoint.inFlight--;
+    }
+    if (!endpoint.probing || endpoint.probeAttempt != attempt) {
+        return false;
+    }
+    endpoint.probing = false;
+    endpoint.probeAttempt = 0;
+    return true;
+}
+
+void AIEndpointPool::Open(Endpoint& endpoint, Clock::time_point now) {
+    if (endpoint.state != State::OPEN) {
+        openCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+    endpoint.state = State::OPEN;
+    endpoint.openUntil = now + std::chrono::milliseconds(endpoint.openMs);
+    endpoint.openMs = std::min(endpoint.openMs * 2, AI_BREAKER_OPEN_MAX_MS);
+}
+
+bool AIEndpointPool::OnSuccess(int index, uint64_t attempt, double firstByteMs) {
+    Endpoint& endpoint = endpoints_[index];
+    bool probe = Finish(endpoint, attempt);
+    endpoint.consecutiveFailures = 0;
+    endpoint.ewmaMs += AI_LATENCY_EWMA_ALPHA * (firstByteMs - endpoint.ewmaMs);
+    if (endpoint.samples.size() < AI_LATENCY_WINDOW) {
+        endpoint.samples.push_back(static_cast<float>(firstByteMs));
+    } else {
+        endpoint.samples[endpoint.nextSample] = static_cast<float>(firstByteMs);
+        endpoint.nextSample = (endpoint.nextSample + 1) % AI_LATENCY_WINDOW;
+    }
+    // 只有探测成功才恢复（断开前发出的旧请求成功了不算，端点仍按原计划等待探测）
+    if (endpoint.state != State::HALF_OPEN || !probe) {
+        return false;
+    }
+    endpoint.state = State::CLOSED;
+    endpoint.openMs = AI_BREAKER_OPEN_MS;
+    return true;
+}
+
+bool AIEndpointPool::OnFailure(int index, uint64_t attempt, double elapsedMs, Clock::time_point now) {
+    Endpoint& endpoint = endpoints_[index];
+    bool probe = Finish(endpoint, attempt);
+    endpoint.consecutiveFailures++;
+    // 失败前等待的时间也计入平均延迟（超时的端点不会因为没有成功样本而一直显得很快）
+    endpoint.ewmaMs += AI_LATENCY_EWMA_ALPHA * (std::max(elapsedMs, endpoint.ewmaMs) - endpoint.ewmaMs);
+    if ((endpoint.state == State::HALF_OPEN && probe) ||
+        (endpoint.state == State::CLOSED && endpoint.consecutiveFailures >= AI_BREAKER_FAILURES)) {
+        Open(endpoint, now);
+        return true;
+    }
+    return false;
+}
+
+void AIEndpointPool::OnCancel(int index, uint64_t attempt) {
+    Finish(endpoints_[index], attempt);
+}
+
+long AIEndpointPool::HedgeDelayMs(int index) const {
+    const std::vector<float>& samples = endpoints_[index].samples;
+    if (samples.size() < AI_HEDGE_MIN_SAMPLES) {
+        return AI_HEDGE_DEFAULT_MS;
+    }
+    std::vector<float> sorted(samples);
+    size_t rank = sorted.size() * 95 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return std::min(AI_HEDGE_MAX_MS, std::max(AI_HEDGE_MIN_MS, static_cast<long>(sorted[rank])));
+}
+
+void AIEndpointPool::CreditHedgeBudget() {
+    hedgeBudget_ = std::min(AI_HEDGE_BUDGET_MAX, hedgeBudget_ + AI_HEDGE_BUDGET_RATIO);
+}
+
+bool AIEndpointPool::TakeHedgeBudget() {
+    if (hedgeBudget_ < 1) {
+        return false;
+    }
+    hedgeBudget_ -= 1;
+    return true;
+}
@@ -0,0 +1,478 @@
+#include "headers/aiJson.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define AI_JSON_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// 掩码中最低的置位
+static inline size_t LowestBit(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<size_t>(__builtin_ctz(mask));
+#endif
+}
+
+// 从pos开始找第一个需要转义的字节（引号、反斜杠、小于0x20的控制字符），没有时返回size
+static size_t FindEscape(const char* data, size_t pos, size_t size) {
+#ifdef AI_JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    while (pos + 16 <= size) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        // 无符号比较c <= 0x1F：min(c, 0x1F) == c
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                       _mm_cmpeq_epi8(_mm_min_epu8(chunk, control), chunk));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask != 0) {
+            return pos + LowestBit(mask);
+        }
+        pos += 16;
+    }
+#endif
+    while (pos < size) {
+        unsigned char c = static_cast<unsigned char>(data[pos]);
+        if (c == '"' || c == '\\' || c < 0x20) {
+            return pos;
+        }
+        pos++;
+    }
+    return size;
+}
+
+// 从pos开始找字符串中第一个引号或反斜杠，没有时返回size
+static size_t FindStringSpecial(const char* data, size_t pos, size_t size) {
+#ifdef AI_JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    while (pos + 16 <= size) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask != 0) {
+            return pos + LowestBit(mask);
+        }
+        pos += 16;
+    }
+#endif
+    while (pos < size && data[pos] != '"' && data[pos] != '\\') {
+        pos++;
+    }
+    return pos;
+}
+
+void AppendJsonEscaped(std::string& out, const char* text, size_t size) {
+    size_t start = 0;
+    while (start < size) {
+        size_t pos = FindEscape(text, start, size);
+        out.append(text + start, pos - start);
+        if (pos == size) {
+            break;
+        }
+        char c = text[pos];
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                char buffer[8];
+                snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned char>(c));
+                out += buffer;
+                break;
+            }
+        }
+        start = pos + 1;
+    }
+}
+
+// ---------------- 写出 ----------------
+
+JsonWriter::JsonWriter(size_t reserve) : needComma_(false) {
+    out_.reserve(reserve);
+}
+
+void JsonWriter::Separator() {
+    if (needComma_) {
+        out_ += ',';
+    }
+    needComma_ = true;
+}
+
+void JsonWriter::BeginObject() {
+    Separator();
+    out_ += '{';
+    needComma_ = false;
+}
+
+void JsonWriter::EndObject() {
+    out_ += '}';
+    needComma_ = true;
+}
+
+void JsonWriter::BeginArray() {
+    Separator();
+    out_ += '[';
+    needComma_ = false;
+}
+
+void JsonWriter::EndArray() {
+    out_ += ']';
+    needComma_ = true;
+}
+
+void JsonWriter::Key(const char* key) {
+    Separator();
+    out_ += '"';
+    AppendJsonEscaped(out_, key, strlen(key));
+    out_ += "\":";
+    needComma_ = false;
+}
+
+void JsonWriter::String(const std::string& value) {
+    Separator();
+    out_ += '"';
+    AppendJsonEscaped(out_, value.data(), value.size());
+    out_ += '"';
+}
+
+void JsonWriter::Int(long long value) {
+    Separator();
+    out_ += std::to_string(value);
+}
+
+void JsonWriter::Double(double value) {
+    Separator();
+    if (!std::isfinite(value)) {
+        out_ += "null";  // JSON没有NaN和无穷大
+        return;
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.6g", value);
+    out_ += buffer;
+}
+
+void JsonWriter::Bool(bool value) {
+    Separator();
+    out_ += value ? "true" : "false";
+}
+
+void JsonWriter::Null() {
+    Separator();
+    out_ += "null";
+}
+
+// ---------------- 读取 ----------------
+
+JsonReader::JsonReader(const char* data, size_t size)
+    : data_(data), size_(size), pos_(0), first_(false), failed_(false) {
+}
+
+bool JsonReader::Fail() {
+    failed_ = true;
+    return false;
+}
+
+void JsonReader::SkipSpace() {
+    while (pos_ < size_ && (data_[pos_] == ' ' || data_[pos_] == '\t' || data_[pos_] == '\r' || data_[pos_] == '\n')) {
+        pos_++;
+    }
+}
+
+bool JsonReader::EnterObject() {
+    SkipSpace();
+    if (failed_ || pos_ >= size_ || data_[pos_] != '{') {
+        return Fail();
+    }
+    pos_++;
+    first_ = true;
+    return true;
+}
+
+bool JsonReader::EnterArray() {
+    SkipSpace();
+    if (failed_ || pos_ >= size_ || data_[pos_] != '[') {
+        return Fail();
+    }
+    pos_++;
+    first_ = true;
+    return true;
+}
+
+bool JsonReader::NextKey(std::string& key) {
+    SkipSpace();
+    if (failed_ || pos_ >= size_) {
+        return Fail();
+    }
+    if (data_[pos_] == '}') {
+        pos_++;
+        first_ = false;
+        return false;
+    }
+    if (!first_) {
+        if (data_[pos_] != ',') {
+            return Fail();
+        }
+        pos_++;
+        SkipSpace();
+    }
+    key.clear();
+    if (!ParseString(&key)) {
+        return Fail();
+    }
+    SkipSpace();
+    if (pos_ >= size_ || data_[pos_] != ':') {
+        return Fail();
+    }
+    pos_++;
+    first_ = false;
+    return true;
+}
+
+bool JsonReader::NextElement() {
+    SkipSpace();
+    if (failed_ || pos_ >= size_) {
+        return Fail();
+    }
+    if (data_[pos_] == ']') {
+        pos_++;
+        first_ = false;
+        return false;
+    }
+    if (!first_) {
+        if (data_[pos_] != ',') {
+            return Fail();
+        }
+        pos_++;
+    }
+    first_ = false;
+    return true;
+}
+
+bool JsonReader::ReadString(std::string& out) {
+    SkipSpace();
+    if (failed_ || pos_ >= size_ || data_[pos_] != '"') {
+        return false;
+    }
+    out.clear();
+    return ParseString(&out) || Fail();
+}
+
+bool JsonReader::ReadBool(bool& value) {
+    SkipSpace();
+    if (failed_) {
+        return false;
+    }
+    if (size_ - pos_ >= 4 && memcmp(data_ + pos_, "true", 4) == 0) {
+        value = true;
+        pos_ += 4;
+    } else if (size_ - pos_ >= 5 && memcmp(data_ + pos_, "false", 5) == 0) {
+        value = false;
+        pos_ += 5;
+    } else {
+        return false;
+    }
+    first_ = false;
+    return true;
+}
+
+// 读取4位十六进制数，失败返回-1
+static long ParseHex4(const char* data, size_t pos, size_t size) {
+    if (pos + 4 > size) {
+        return -1;
+    }
+    long value = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        char c = data[pos + i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+    return value;
+}
+
+static void AppendUtf8(std::string& out, unsigned long codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+bool JsonReader::ParseString(std::string* out) {
+    if (pos_ >= size_ || data_[pos_] != '"') {
+        return false;
+    }
+    pos_++;
+    while (true) {
+        size_t special = FindStringSpecial(data_, pos_, size_);
+        if (special >= size_) {
+            return false;  // 字符串没有结束
+        }
+        if (out) {
+            out->append(data_ + pos_, special - pos_);
+        }
+        pos_ = special + 1;
+        if (data_[special] == '"') {
+            first_ = false;
+            return true;
+        }
+
+        // 转义序列
+        if (pos_ >= size_) {
+            return false;
+        }
+        char escape = data_[pos_++];
+        char plain = 0;
+        switch (escape) {
+            case '"':  plain = '"'; break;
+            case '\\': plain = '\\'; break;
+            case '/':  plain = '/'; break;
+            case 'b':  plain = '\b'; break;
+            case 'f':  plain = '\f'; break;
+            case 'n':  plain = '\n'; break;
+            case 'r':  plain = '\r'; break;
+            case 't':  plain = '\t'; break;
+            case 'u': {
+                long unit = ParseHex4(data_, pos_, size_);
+                if (unit < 0) {
+                    return false;
+                }
+                pos_ += 4;
+                unsigned long codePoint = static_cast<unsigned long>(unit);
+                if (unit >= 0xD800 && unit <= 0xDBFF) {
+                    // 高代理项：后面应该紧跟\uDC00-\uDFFF的低代理项
+                    long low = (pos_ + 1 < size_ && data_[pos_] == '\\' && data_[pos_ + 1] == 'u')
+                                   ? ParseHex4(data_, pos_ + 2, size_) : -1;
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        codePoint = 0x10000 + ((static_cast<unsigned long>(unit) - 0xD800) << 10) +
+                                    (static_cast<unsigned long>(low) - 0xDC00);
+                        pos_ += 6;
+                    } else {
+                        codePoint = 0xFFFD;
+                    }
+                } else if (unit >= 0xDC00 && unit <= 0xDFFF) {
+                    codePoint = 0xFFFD;  // 单独的低代理项
+                }
+                if (out) {
+                    AppendUtf8(*out, codePoint);
+                }
+                continue;
+            }
+            default:
+                return false;
+        }
+        if (out) {
+            *out += plain;
+        }
+    }
+}
+
+bool JsonReader::Skip() {
+    SkipSpace();
+    if (failed_ || pos_ >= size_) {
+        return Fail();
+    }
+    char c = data_[pos_];
+    if (c == '"') {
+        return ParseString(nullptr) || Fail();
+    }
+    if (c == '{' || c == '[') {
+        // 嵌套的对象和数组：只数括号，字符串整段跳过（其中的括号不算）
+        size_t depth = 0;
+        while (pos_ < size_) {
+            c = data_[pos_];
+            if (c == '"') {
+                if (!ParseString(nullptr)) {
+                    return Fail();
+                }
+                continue;
+            }
+            pos_++;
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (--depth == 0) {
+                    first_ = false;
+                    return true;
+                }
+            }
+        }
+        return Fail();
+    }
+    // 数字、true、false、null
+    size_t start = pos_;
+    while (pos_ < size_ && data_[pos_] != ',' && data_[pos_] != '}' && data_[pos_] != ']' &&
+           data_[pos_] != ' ' && data_[pos_] != '\t' && data_[pos_] != '\r' && data_[pos_] != '\n') {
+        pos_++;
+    }
+    if (pos_ == start) {
+        return Fail();
+    }
+    first_ = false;
+    return true;
+}
+
+bool ReadChatContent(const char* data, size_t size, const char* container, std::string& content) {
+    // {"choices":[{"message":{"content":"..."}}]}，只读到第一个choice中的content为止
+    JsonReader reader(data, size);
+    std::string key;
+    if (!reader.EnterObject()) {
+        return false;
+    }
+    while (reader.NextKey(key)) {
+        if (key != "choices") {
+            reader.Skip();
+            continue;
+        }
+        if (!reader.EnterArray() || !reader.NextElement() || !reader.EnterObject()) {
+            return false;
+        }
+        while (reader.NextKey(key)) {
+            if (key != container) {
+                reader.Skip();
+                continue;
+            }
+            if (!reader.EnterObject()) {
+                return false;
+            }
+            while (reader.NextKey(key)) {
+                if (key == "content") {
+                    return reader.ReadString(content) && !content.empty();
+                }
+                reader.Skip();
+            }
+            return false;
+        }
+        return false;
+    }
+    return false;
+}
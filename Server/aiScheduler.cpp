@@ -0,0 +1,110 @@
+#include "headers/aiScheduler.h"
+#include <algorithm>
+
+AIScheduler::AIScheduler()
+    : cursor_(0), running_(0), maxConcurrent_(0), maxQueuedPerUser_(0), depth_(0) {
+}
+
+void AIScheduler::ConfigureBucket(Bucket& bucket, uint32_t perMinute, Clock::time_point now) {
+    bucket.perMs = perMinute / 60000.0;
+    bucket.capacity = std::max(1.0, bucket.perMs * AI_RATE_BURST_SECONDS * 1000);
+    bucket.tokens = bucket.capacity;  // 启动时允许一次突发
+    bucket.lastRefill = now;
+}
+
+void AIScheduler::Configure(size_t maxConcurrent, uint32_t requestsPerMinute, uint32_t tokensPerMinute,
+                            size_t maxQueuedPerUser) {
+    Clock::time_point now = Clock::now();
+    maxConcurrent_ = std::max<size_t>(1, maxConcurrent);
+    maxQueuedPerUser_ = std::max<size_t>(1, maxQueuedPerUser);
+    ConfigureBucket(requests_, requestsPerMinute, now);
+    ConfigureBucket(tokens_, tokensPerMinute, now);
+}
+
+void AIScheduler::Refill(Bucket& bucket, Clock::time_point now) {
+    if (bucket.perMs <= 0) {
+        return;
+    }
+    double elapsedMs = std::chrono::duration<double, std::milli>(now - bucket.lastRefill).count();
+    bucket.tokens = std::min(bucket.capacity, bucket.tokens + elapsedMs * bucket.perMs);
+    bucket.lastRefill = now;
+}
+
+long AIScheduler::WaitFor(const Bucket& bucket, double cost) {
+    if (bucket.perMs <= 0 || bucket.tokens >= cost) {
+        return 0;
+    }
+    return static_cast<long>((cost - bucket.tokens) / bucket.perMs) + 1;
+}
+
+bool AIScheduler::Enqueue(uint8_t userID, void* item, uint32_t tokens, Clock::time_point submitTime) {
+    std::deque<Entry>& queue = queues_[userID];
+    if (queue.size() >= maxQueuedPerUser_) {
+        return false;
+    }
+    queue.push_back({item, tokens, submitTime});
+    depth_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void* AIScheduler::Next(Clock::time_point now, long& waitMs) {
+    waitMs = -1;
+    if (running_ >= maxConcurrent_ || Depth() == 0) {
+        return nullptr;  // 有请求结束时事件循环会再调用
+    }
+
+    // 从上次停下的用户开始找下一个有请求排队的用户
+    uint16_t user = cursor_;
+    while (queues_[user].empty()) {
+        user = (user + 1) & 0xFF;
+    }
+    Entry& head = queues_[user].front();
+
+    // 令牌不够时整体等待，不跳过这个用户去取更便宜的请求（否则长提问的用户可能一直排不上）
+    Refill(requests_, now);
+    Refill(tokens_, now);
+    double tokenCost = tokens_.perMs > 0 ? std::min<double>(head.tokens, tokens_.capacity) : 0;
+    long wait = std::max(WaitFor(requests_, 1), WaitFor(tokens_, tokenCost));
+    if (wait > 0) {
+        waitMs = wait;
+        return nullptr;
+    }
+    if (requests_.perMs > 0) {
+        requests_.tokens -= 1;
+    }
+    tokens_.tokens -= tokenCost;
+
+    void* item = head.item;
+    wait_.Record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - head.enqueueTime).count()));
+    queues_[user].pop_front();
+    depth_.fetch_sub(1, std::memory_order_relaxed);
+    cursor_ = (user + 1) & 0xFF;
+    running_++;
+    return item;
+}
+
+void AIScheduler::Release() {
+    if (running_ > 0) {
+        running_--;
+    }
+}
+
+bool AIScheduler::Position(uint8_t userID, const void* item, size_t& ahead) const {
+    // 轮转时每个用户每轮最多取一个：排在用户队列第n个的请求之前，每个用户最多有n个请求先取出
+    const std::deque<Entry>& own = queues_[userID];
+    size_t rounds = 0;
+    while (rounds < own.size() && own[rounds].item != item) {
+        rounds++;
+    }
+    if (rounds == own.size()) {
+        return false;
+    }
+    rounds++;
+    size_t total = 0;
+    for (const std::deque<Entry>& queue : queues_) {
+        total += std::min(queue.size(), rounds);
+    }
+    ahead = total - 1;  // 不算自己
+    return true;
+}
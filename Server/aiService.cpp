@@ -1,216 +1,940 @@
 #include "headers/aiService.h"
 #include "headers/logger.h"
+#include "headers/metrics.h"
+#include "headers/trace.h"
+#include "headers/aiJson.h"
+#include "headers/aiTiming.h"
 #include <fstream>
-#include <sstream>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
 #include <curl/curl.h>
 
 // 全局AI服务实例
 AIService g_aiService;
 
+// 等待一次API调用结果的请求
+struct AIWaiter {
+    uint8_t userID;
+    std::string message;            // 这个用户的提问（成功后记入他的对话上下文）
+    AIQueuedCallback onQueued;
+    AIPartialCallback onPartial;
+    AICompletion onComplete;
+};
+
+// 一次正在进行的API调用（flightMutex_保护）
+struct AIService::Flight {
+    std::string textSoFar;          // 已经交出的流式文本（后加入的请求先补上这部分）
+    long queuedAhead = -1;          // 还在排队时前面的请求数（后加入的请求也先收到排队通知），-1表示没有排队
+    std::vector<AIWaiter> waiters;
+};
+
+// 每个端点都有可用的密钥（自己的或API_KEY）
+static bool HasCredentials(const AIConfig& config) {
+    if (config.endpoints.empty()) {
+        return false;
+    }
+    for (const AIEndpointConfig& endpoint : config.endpoints) {
+        if (endpoint.apiKey.empty() && config.apiKey.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 // 构造函数
-AIService::AIService() : configured_(false) {
+AIService::AIService()
+    : configured_(false), multi_(nullptr), share_(nullptr), pendingMutex_("aiService.pending"),
+      flightMutex_("aiService.flights") {
     config_.apiKey = "";
-    config_.apiEndpoint = "https://api.openai.com/v1/chat/completions";
+    config_.endpoints.push_back({"https://api.openai.com/v1/chat/completions", ""});
     config_.model = "gpt-3.5-turbo";
     config_.maxTokens = 500;
     config_.temperature = 0.7f;
+    config_.stream = true;
+    config_.cacheMaxBytes = 0;
+    config_.cacheTtlSeconds = 0;
+    config_.contextTokens = 0;
+    config_.contextMaxBytes = 0;
+    config_.maxConcurrent = 16;
+    config_.rateLimitRpm = 0;
+    config_.rateLimitTpm = 0;
+    config_.maxQueuedPerUser = 8;
+    ConfigureScheduler();
 }
 
 AIService::AIService(const AIConfig& config) 
-    : config_(config), configured_(!config.apiKey.empty()) {
+    : config_(config), configured_(HasCredentials(config)), multi_(nullptr), share_(nullptr),
+      pendingMutex_("aiService.pending"), flightMutex_("aiService.flights") {
+    cache_.Configure(config_.cacheMaxBytes, config_.cacheTtlSeconds);
+    context_.Configure(static_cast<size_t>(config_.contextTokens), config_.contextMaxBytes);
+    ConfigureScheduler();
 }
 
 void AIService::Configure(const AIConfig& config) {
     config_ = config;
-    configured_ = !config_.apiKey.empty();
+    configured_ = HasCredentials(config_);
+    cache_.Configure(config_.cacheMaxBytes, config_.cacheTtlSeconds);
+    context_.Configure(static_cast<size_t>(config_.contextTokens), config_.contextMaxBytes);
+    ConfigureScheduler();
     
     if (configured_) {
-        WriteLog(LogLevel::INFO, "AI服务已配置 - 模型: " + config_.model);
+        WriteLog(LogLevel::INFO, "AI服务已配置 - 模型: " + config_.model + "，端点数: " + std::to_string(config_.endpoints.size()));
     }
 }
 
+void AIService::ConfigureScheduler() {
+    scheduler_.Configure(static_cast<size_t>(std::max(1, config_.maxConcurrent)),
+                         static_cast<uint32_t>(std::max(0, config_.rateLimitRpm)),
+                         static_cast<uint32_t>(std::max(0, config_.rateLimitTpm)),
+                         static_cast<size_t>(std::max(1, config_.maxQueuedPerUser)));
+}
+
 bool AIService::IsConfigured() const {
     return configured_;
 }
 
-std::string AIService::GetAIResponse(const std::string& userMessage) {
+void AIService::ClearContext(uint8_t userID) {
+    context_.Clear(userID);
+}
+
+void AIService::GetAIResponseAsync(uint8_t userID, const std::string& userMessage, AIQueuedCallback onQueued,
+                                   AIPartialCallback onPartial, AICompletion onComplete) {
     if (!configured_) {
         WriteLog(LogLevel::WARN, "AI服务未配置，无法获取回复");
-        return "AI服务未配置，请联系管理员。";
+        onComplete("AI服务未配置，请联系管理员。");
+        return;
     }
     
     if (userMessage.empty()) {
-        return "消息不能为空。";
+        onComplete("消息不能为空。");
+        return;
     }
     
-    WriteLog(LogLevel::INFO, "发送AI请求: " + userMessage);
+    // 取出这个用户的对话上下文（窗口内的历史对话和更早对话的摘要）
+    std::vector<AIContextTurn> turns;
+    std::string summary;
+    context_.Collect(userID, turns, summary);
+    
+    // 相同的上下文和提问最近回答过：直接返回缓存的回复
+    std::string keyText = summary;
+    for (const AIContextTurn& turn : turns) {
+        keyText += '\n';
+        keyText += turn.user;
+        keyText += '\n';
+        keyText += turn.assistant;
+    }
+    keyText += '\n';
+    keyText += userMessage;
+    std::string key = MakeAICacheKey(config_.model, config_.temperature, keyText);
+    std::string cachedReply;
+    if (cache_.Lookup(key, cachedReply)) {
+        g_metricAICache.Inc(1, METRIC_CACHE_HIT);
+        // 只记录提问的长度，提问内容不写入日志
+        WriteLog(LogLevel::INFO, "AI请求命中缓存: 用户 " + std::to_string(userID) + ", " +
+                                 std::to_string(userMessage.size()) + " 字节");
+        context_.Append(userID, userMessage, cachedReply);
+        onComplete(cachedReply);
+        return;
+    }
+    
+    // 相同的提问正在请求：合并到那次API调用上
+    std::shared_ptr<Flight> flight;
+    {
+        InstrumentedLockGuard lock(flightMutex_, LOCK_SITE);
+        auto it = flights_.find(key);
+        if (it != flights_.end()) {
+            g_metricAICache.Inc(1, METRIC_CACHE_COALESCED);
+            // 补发已有的进度和登记在同一个临界区里，补发的内容一定排在之后的新片段前面
+            // （这里在客户端线程上，回调只是放进发送队列，不会阻塞）
+            if (onQueued && it->second->queuedAhead >= 0) {
+                onQueued(static_cast<size_t>(it->second->queuedAhead));
+            }
+            if (onPartial && !it->second->textSoFar.empty()) {
+                onPartial(it->second->textSoFar);  // 先补上已经生成的部分
+            }
+            it->second->waiters.push_back({userID, userMessage, std::move(onQueued), std::move(onPartial),
+                                           std::move(onComplete)});
+            return;
+        }
+        flight = std::make_shared<Flight>();
+        flight->waiters.push_back({userID, userMessage, std::move(onQueued), std::move(onPartial),
+                                   std::move(onComplete)});
+        flights_[key] = flight;
+    }
+    g_metricAICache.Inc(1, METRIC_CACHE_MISS);
+    
+    WriteLog(LogLevel::INFO, "发送AI请求: 用户 " + std::to_string(userID) + ", " + std::to_string(userMessage.size()) +
+                             " 字节");
     
     try {
         // 构造请求JSON
-        std::string requestJson = BuildRequestJSON(userMessage);
-        
-        // 发送HTTP请求
-        std::string response = SendHttpRequest(config_.apiEndpoint, requestJson);
-        
-        if (response.empty()) {
-            WriteLog(LogLevel::WARN, "AI API响应为空");
-            return "抱歉，AI服务暂时不可用。";
-        }
+        std::string requestJson = BuildRequestJSON(summary, turns, userMessage);
         
-        // 解析响应JSON
-        std::string aiReply = ParseResponseJSON(response);
-        
-        if (aiReply.empty()) {
-            WriteLog(LogLevel::WARN, "无法解析AI响应");
-            return "抱歉，无法理解AI的回复。";
-        }
+        // 这次调用估算消耗的token数：请求体加上回复的上限
+        uint32_t tokens = EstimateTokens(requestJson) + static_cast<uint32_t>(std::max(0, config_.maxTokens));
         
-        WriteLog(LogLevel::INFO, "AI回复成功");
-        return aiReply;
+        // 交给事件循环线程排队发送，回复由FinishTransfer交回
+        // 进度回调在事件循环线程上调用：只在锁内更新状态、复制等待者的回调，解锁后再调用
+        SubmitHttpRequest(userID, tokens, requestJson,
+            [this, flight](size_t ahead) {
+                std::vector<AIQueuedCallback> callbacks;
+                {
+                    InstrumentedLockGuard lock(flightMutex_, LOCK_SITE);
+                    flight->queuedAhead = static_cast<long>(ahead);
+                    for (const AIWaiter& waiter : flight->waiters) {
+                        if (waiter.onQueued) {
+                            callbacks.push_back(waiter.onQueued);
+                        }
+                    }
+                }
+                for (const AIQueuedCallback& callback : callbacks) {
+                    callback(ahead);
+                }
+            },
+            [this, flight](const std::string& delta) {
+                std::vector<AIPartialCallback> callbacks;
+                {
+                    InstrumentedLockGuard lock(flightMutex_, LOCK_SITE);
+                    flight->queuedAhead = -1;
+                    flight->textSoFar += delta;
+                    for (const AIWaiter& waiter : flight->waiters) {
+                        if (waiter.onPartial) {
+                            callbacks.push_back(waiter.onPartial);
+                        }
+                    }
+                }
+                for (const AIPartialCallback& callback : callbacks) {
+                    callback(delta);
+                }
+            },
+            [this, key, flight](const std::string& reply, bool success) {
+                CompleteFlight(key, flight, reply, success);
+            });
         
     } catch (const std::exception& e) {
         WriteLog(LogLevel::FATAL, std::string("AI服务异常: ") + e.what());
-        return "抱歉，处理您的请求时出现错误。";
+        g_metricAIRequests.Inc(1, METRIC_RESULT_FAILURE);
+        CompleteFlight(key, flight, "抱歉，处理您的请求时出现错误。", false);
     }
 }
 
-std::string AIService::BuildRequestJSON(const std::string& userMessage) {
-    // 转义JSON特殊字符
-    std::string escapedMessage = userMessage;
-    size_t pos = 0;
-    while ((pos = escapedMessage.find("\"", pos)) != std::string::npos) {
-        escapedMessage.replace(pos, 1, "\\\"");
-        pos += 2;
-    }
-    pos = 0;
-    while ((pos = escapedMessage.find("\n", pos)) != std::string::npos) {
-        escapedMessage.replace(pos, 1, "\\n");
-        pos += 2;
-    }
-    
-    // 构造JSON请求
-    std::ostringstream json;
-    json << "{"
-         << "\"model\":\"" << config_.model << "\","
-         << "\"messages\":[{\"role\":\"user\",\"content\":\"" << escapedMessage << "\"}],"
-         << "\"max_tokens\":" << config_.maxTokens << ","
-         << "\"temperature\":" << config_.temperature
-         << "}";
-    
-    return json.str();
+void AIService::CompleteFlight(const std::string& key, const std::shared_ptr<Flight>& flight,
+                               const std::string& reply, bool success) {
+    // 先放进缓存再结束这次调用，之后到达的相同请求直接命中缓存
+    if (success) {
+        cache_.Insert(key, reply);
+    }
+    std::vector<AIWaiter> waiters;
+    {
+        InstrumentedLockGuard lock(flightMutex_, LOCK_SITE);
+        flights_.erase(key);
+        waiters.swap(flight->waiters);
+    }
+    for (const AIWaiter& waiter : waiters) {
+        if (success) {
+            context_.Append(waiter.userID, waiter.message, reply);
+        }
+        waiter.onComplete(reply);
+    }
+}
+
+std::string AIService::BuildRequestJSON(const std::string& summary, const std::vector<AIContextTurn>& turns,
+                                        const std::string& userMessage) {
+    // 构造JSON请求：摘要作为system消息，之后是窗口内的历史对话，最后是这次的提问
+    size_t textBytes = summary.size() + userMessage.size();
+    for (const AIContextTurn& turn : turns) {
+        textBytes += turn.user.size() + turn.assistant.size();
+    }
+    JsonWriter json(textBytes + textBytes / 8 + 256);  // 转义后略长，再加上字段名
+    json.BeginObject();
+    json.Key("model");
+    json.String(config_.model);
+    json.Key("messages");
+    json.BeginArray();
+    auto message = [&json](const char* role, const std::string& content) {
+        json.BeginObject();
+        json.Key("role");
+        json.String(role);
+        json.Key("content");
+        json.String(content);
+        json.EndObject();
+    };
+    if (!summary.empty()) {
+        message("system", summary);
+    }
+    for (const AIContextTurn& turn : turns) {
+        message("user", turn.user);
+        message("assistant", turn.assistant);
+    }
+    message("user", userMessage);
+    json.EndArray();
+    json.Key("max_tokens");
+    json.Int(config_.maxTokens);
+    json.Key("temperature");
+    json.Double(config_.temperature);
+    if (config_.stream) {
+        json.Key("stream");
+        json.Bool(true);
+    }
+    json.EndObject();
+    
+    return json.Take();
 }
 
 std::string AIService::ParseResponseJSON(const std::string& responseJson) {
-    // 简单的JSON解析 - 查找 "content": "..."
-    size_t contentPos = responseJson.find("\"content\"");
-    if (contentPos == std::string::npos) {
-        return "";
+    std::string content;
+    ReadChatContent(responseJson.data(), responseJson.size(), "message", content);
+    return content;
+}
+
+std::string AIService::ParseStreamDelta(const char* eventJson, size_t size) {
+    // 流式事件的文本在choices[0].delta.content中（第一个事件通常只有role，最后一个事件delta为空）
+    std::string content;
+    ReadChatContent(eventJson, size, "delta", content);
+    return content;
+}
+
+// 一次API调用：从调度器取出后开始，可能同时有主请求和对冲请求两次HTTP尝试，先收到数据的一方胜出
+// 请求体和流式回复的状态属于调用，不属于某一次尝试
+struct AIService::Request {
+    std::string postData;
+    ResultCallback onComplete;
+    AIQueuedCallback onQueued;
+    AIPartialCallback onPartial;
+    uint8_t userID = 0;
+    uint32_t tokens = 0;       // 估算消耗的token数
+    bool admitted = false;     // 已经从调度器取出（结束时要释放并发名额）
+    bool traceSampled = false; // 提交这次调用的消息被追踪采样（事件循环线程上记录HTTP区段）
+    
+    // 多端点
+    std::vector<Transfer*> attempts;   // 正在进行的尝试
+    Transfer* winner = nullptr;        // 第一个收到200响应数据的尝试，之后其他尝试取消
+    uint32_t triedMask = 0;            // 已经尝试过的端点
+    int attemptCount = 0;
+    bool hedged = false;               // 已经考虑过对冲（每个调用最多对冲一次）
+    std::chrono::steady_clock::time_point hedgeAt;
+    
+    // 流式输出（SSE）
+    bool stream = false;
+    std::string reply;         // 到目前为止收到的全部文本
+    std::string pendingDelta;  // 还没有交出的文本
+    bool flushedAny = false;   // 是否已经交出过（第一段不等待合并）
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point lastFlush;
+};
+
+// 一次HTTP尝试（或启动时的预热请求）：响应缓冲区要在整个传输期间保持有效
+struct AIService::Transfer {
+    CURL* curl = nullptr;      // 开始传输时从池中取得
+    Request* request = nullptr;  // 所属的调用（预热请求为空）
+    int endpoint = 0;
+    uint64_t attempt = 0;      // 端点池分配的尝试编号（报告结果时传回）
+    bool hedge = false;        // 对冲发出的尝试
+    bool warmup = false;       // 启动时的预热请求（只为建立连接，结果不交给任何人，不经过调度器）
+    std::string responseBuffer;  // 非流式的响应体，或错误响应的开头（用于日志）
+    std::string sseBuffer;     // 还没有凑成完整一行的数据
+    bool gotData = false;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point firstByteTime;
+};
+
+// 池中的句柄最多保留这么多个（超过同时进行的请求数时多余的直接释放）
+static const size_t AI_IDLE_HANDLES_MAX = 64;
+
+// 错误响应和流式响应中保留的原始数据上限（只用于出错时记录日志）
+static const size_t AI_STREAM_RAW_KEEP = 4096;
+
+// 每个调用最多的HTTP尝试次数（主请求加一次对冲或换端点重试）
+static const int AI_MAX_ATTEMPTS = 2;
+
+static double MillisecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// 接收响应数据的回调
+size_t AIService::WriteCallback(char* ptr, size_t size, size_t nmemb, void* userdata) {
+    size_t totalSize = size * nmemb;
+    Transfer* transfer = static_cast<Transfer*>(userdata);
+    Request* request = transfer->request;
+    if (!transfer->gotData) {
+        transfer->gotData = true;
+        transfer->firstByteTime = std::chrono::steady_clock::now();
     }
     
-    // 找到内容开始的引号
-    size_t startQuote = responseJson.find("\"", contentPos + 9);
-    if (startQuote == std::string::npos) {
-        return "";
+    // 第一个收到200响应数据的尝试胜出；另一个尝试已经胜出时中止这次传输（回调中不能移除句柄）
+    if (request != nullptr && request->winner == nullptr) {
+        long httpCode = 0;
+        curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &httpCode);
+        if (httpCode == 200) {
+            request->winner = transfer;
+        }
+    }
+    if (request != nullptr && request->winner != nullptr && request->winner != transfer) {
+        return 0;
     }
     
-    // 找到内容结束的引号（需要跳过转义的引号）
-    size_t endQuote = startQuote + 1;
-    while (endQuote < responseJson.length()) {
-        if (responseJson[endQuote] == '\"' && responseJson[endQuote - 1] != '\\') {
-            break;
+    // 预热请求和错误响应只保留开头
+    if (request == nullptr || request->winner != transfer) {
+        if (transfer->responseBuffer.size() < AI_STREAM_RAW_KEEP) {
+            transfer->responseBuffer.append(ptr, std::min(totalSize, AI_STREAM_RAW_KEEP - transfer->responseBuffer.size()));
         }
-        endQuote++;
+        return totalSize;
+    }
+    if (!request->stream) {
+        transfer->responseBuffer.append(ptr, totalSize);
+        return totalSize;
     }
     
-    if (endQuote >= responseJson.length()) {
-        return "";
+    // 流式响应：按行切分SSE事件，每个 "data: {...}" 行是一段增量
+    if (transfer->responseBuffer.size() < AI_STREAM_RAW_KEEP) {
+        transfer->responseBuffer.append(ptr, std::min(totalSize, AI_STREAM_RAW_KEEP - transfer->responseBuffer.size()));
     }
+    transfer->sseBuffer.append(ptr, totalSize);
+    size_t lineStart = 0;
+    size_t lineEnd = 0;
+    while ((lineEnd = transfer->sseBuffer.find('\n', lineStart)) != std::string::npos) {
+        size_t length = lineEnd - lineStart;
+        if (length > 0 && transfer->sseBuffer[lineEnd - 1] == '\r') {
+            length--;
+        }
+        if (length > 5 && transfer->sseBuffer.compare(lineStart, 5, "data:") == 0) {
+            // 直接在缓冲区上解析这一行，不复制
+            const char* data = transfer->sseBuffer.data() + lineStart + 5;
+            size_t dataSize = length - 5;
+            while (dataSize > 0 && *data == ' ') {
+                data++;
+                dataSize--;
+            }
+            if (!(dataSize == 6 && memcmp(data, "[DONE]", 6) == 0)) {
+                std::string delta = ParseStreamDelta(data, dataSize);
+                request->reply += delta;
+                request->pendingDelta += delta;
+            }
+        }
+        lineStart = lineEnd + 1;
+    }
+    transfer->sseBuffer.erase(0, lineStart);
+    return totalSize;
+}
+
+void AIService::SubmitHttpRequest(uint8_t userID, uint32_t tokens, const std::string& postData,
+                                  AIQueuedCallback onQueued, AIPartialCallback onPartial, ResultCallback onComplete) {
+    TraceSpan traceSpan("AIService::SubmitHttpRequest");
+    if (multi_ == nullptr) {
+        WriteLog(LogLevel::FATAL, "AI服务事件循环未启动");
+        g_metricAIRequests.Inc(1, METRIC_RESULT_FAILURE);
+        onComplete("抱歉，AI服务暂时不可用。", false);
+        return;
+    }
+    
+    Request* request = new Request();
+    request->postData = postData;
+    request->onComplete = std::move(onComplete);
+    request->stream = config_.stream;
+    request->onPartial = std::move(onPartial);
+    request->userID = userID;
+    request->tokens = tokens;
+    request->onQueued = std::move(onQueued);
+    request->traceSampled = IsTraceSampled();
+    request->startTime = std::chrono::steady_clock::now();
+    
+    // curl句柄、调度器和端点状态只在事件循环线程上操作，这里只放进待处理列表并唤醒事件循环
+    g_metricAIInFlight.Add(1);
+    {
+        InstrumentedLockGuard lock(pendingMutex_, LOCK_SITE);
+        pending_.push_back(request);
+    }
+    curl_multi_wakeup(static_cast<CURLM*>(multi_));
+}
+
+bool AIService::StartTransfer(Transfer* transfer) {
+    CURL* curl = nullptr;
+    if (!idleHandles_.empty()) {
+        curl = static_cast<CURL*>(idleHandles_.back());
+        idleHandles_.pop_back();
+    } else {
+        // 初始化curl，设置所有请求都相同的选项（复用句柄时保留）
+        curl = curl_easy_init();
+        if (!curl) {
+            WriteLog(LogLevel::FATAL, "无法初始化CURL");
+            return false;
+        }
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &AIService::WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_SHARE, static_cast<CURLSH*>(share_));
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    
+        // HTTP/2：同一主机的并发请求在一条连接上多路复用，等待已有连接而不是另开新连接
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+        curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
     
-    // 提取内容
-    std::string content = responseJson.substr(startQuote + 1, endQuote - startQuote - 1);
+        // 连接保活：空闲的连接留在连接缓存里，TCP keep-alive防止中间设备把它断开
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 30L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 15L);
+        curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, 300L);
+        curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, 300L);
     
-    // 反转义特殊字符
-    size_t pos = 0;
-    while ((pos = content.find("\\n", pos)) != std::string::npos) {
-        content.replace(pos, 2, "\n");
-        pos += 1;
+        // 设置SSL验证（生产环境应该启用）
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+    
+        // 设置超时
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
     }
-    pos = 0;
-    while ((pos = content.find("\\\"", pos)) != std::string::npos) {
-        content.replace(pos, 2, "\"");
-        pos += 1;
+    transfer->curl = curl;
+    transfer->startTime = std::chrono::steady_clock::now();
+    
+    // 设置这次请求的选项（各端点的URL和认证头不同）
+    curl_easy_setopt(curl, CURLOPT_URL, config_.endpoints[transfer->endpoint].url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, static_cast<curl_slist*>(endpointHeaders_[transfer->endpoint]));
+    if (transfer->warmup) {
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);  // HEAD请求，只为完成DNS、TCP和TLS握手
+    } else {
+        const std::string& postData = transfer->request->postData;
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(postData.size()));
     }
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, transfer);
     
-    return content;
+    CURLMcode code = curl_multi_add_handle(static_cast<CURLM*>(multi_), curl);
+    if (code != CURLM_OK) {
+        WriteLog(LogLevel::FATAL, std::string("无法添加AI请求: ") + curl_multi_strerror(code));
+        ReleaseHandle(curl);
+        transfer->curl = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void AIService::ReleaseHandle(void* curl) {
+    if (idleHandles_.size() < AI_IDLE_HANDLES_MAX) {
+        idleHandles_.push_back(curl);
+    } else {
+        curl_easy_cleanup(static_cast<CURL*>(curl));
+    }
+}
+
+bool AIService::StartAttempt(Request* request, int endpoint, uint64_t attempt, bool hedge) {
+    Transfer* transfer = new Transfer();
+    transfer->request = request;
+    transfer->endpoint = endpoint;
+    transfer->attempt = attempt;
+    transfer->hedge = hedge;
+    request->triedMask |= 1u << endpoint;
+    request->attemptCount++;
+    if (!StartTransfer(transfer)) {
+        endpoints_.OnCancel(endpoint, attempt);
+        delete transfer;
+        return false;
+    }
+    request->attempts.push_back(transfer);
+    if (request->attemptCount == 1) {
+        request->hedgeAt = transfer->startTime + std::chrono::milliseconds(endpoints_.HedgeDelayMs(endpoint));
+    }
+    return true;
+}
+
+void AIService::StartRequest(Request* request) {
+    running_.push_back(request);
+    endpoints_.CreditHedgeBudget();
+    uint64_t attempt = 0;
+    int endpoint = endpoints_.Pick(0, std::chrono::steady_clock::now(), attempt);
+    if (endpoint < 0) {
+        // 所有端点都在熔断中：立即失败，不让用户等到超时
+        WriteLog(LogLevel::WARN, "所有AI端点都暂停使用中，请求直接失败");
+        CompleteRequest(request, "抱歉，AI服务暂时不可用，请稍后再试。", false);
+        return;
+    }
+    if (!StartAttempt(request, endpoint, attempt, false)) {
+        CompleteRequest(request, "抱歉，AI服务暂时不可用。", false);
+    }
+}
+
+void AIService::CancelAttempt(Transfer* transfer) {
+    Request* request = transfer->request;
+    request->attempts.erase(std::find(request->attempts.begin(), request->attempts.end(), transfer));
+    curl_multi_remove_handle(static_cast<CURLM*>(multi_), transfer->curl);
+    ReleaseHandle(transfer->curl);
+    endpoints_.OnCancel(transfer->endpoint, transfer->attempt);
+    delete transfer;
+}
+
+long AIService::CheckHedges() {
+    if (endpoints_.Size() < 2) {
+        return -1;
+    }
+    auto now = std::chrono::steady_clock::now();
+    long waitMs = -1;
+    for (Request* request : running_) {
+        if (request->winner != nullptr || request->hedged || request->attempts.size() != 1 ||
+            request->attemptCount >= AI_MAX_ATTEMPTS) {
+            continue;
+        }
+        if (now < request->hedgeAt) {
+            long untilMs = static_cast<long>(MillisecondsBetween(now, request->hedgeAt)) + 1;
+            if (waitMs < 0 || untilMs < waitMs) {
+                waitMs = untilMs;
+            }
+            continue;
+        }
+        // 主请求在p95时间内还没有数据：向另一个端点再发一次
+        request->hedged = true;
+        if (!endpoints_.TakeHedgeBudget()) {
+            continue;
+        }
+        uint64_t attempt = 0;
+        int endpoint = endpoints_.Pick(request->triedMask, now, attempt);
+        if (endpoint >= 0 && StartAttempt(request, endpoint, attempt, true)) {
+            g_metricAIHedges.Inc(1, METRIC_HEDGE_SENT);
+        }
+    }
+    return waitMs;
+}
+
+void AIService::FlushPartial(Request* request, bool force) {
+    if (request->pendingDelta.empty()) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (request->flushedAny && !force && now - request->lastFlush < std::chrono::milliseconds(AI_STREAM_FLUSH_MS)) {
+        return;
+    }
+    if (!request->flushedAny) {
+        auto firstTokenMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - request->startTime).count();
+        WriteLog(LogLevel::INFO, "AI首段回复用时: " + std::to_string(firstTokenMs) + "ms");
+    }
+    request->flushedAny = true;
+    request->lastFlush = now;
+    if (request->onPartial) {
+        request->onPartial(request->pendingDelta);
+    }
+    request->pendingDelta.clear();
+}
+
+long AIService::AdmitRequests() {
+    long waitMs = -1;
+    void* item = nullptr;
+    while ((item = scheduler_.Next(std::chrono::steady_clock::now(), waitMs)) != nullptr) {
+        Request* request = static_cast<Request*>(item);
+        request->admitted = true;
+        StartRequest(request);
+    }
+    return waitMs;
 }
 
-std::string AIService::SendHttpRequest(const std::string& url, const std::string& postData) {
-    CURL* curl;
-    CURLcode res;
-    std::string responseBuffer;
+void AIService::EventLoop() {
+    SetTraceThreadName("ai event loop");
+    CURLM* multi = static_cast<CURLM*>(multi_);
+    std::vector<Request*> added;
+    std::vector<std::pair<uint8_t, Request*>> queued;  // 这一轮放进调度器的请求（已经结束的请求已经释放，只按指针查找）
     
-    // 初始化curl
-    curl = curl_easy_init();
-    if (!curl) {
-        WriteLog(LogLevel::FATAL, "无法初始化CURL");
-        return "";
+    // 预热：先建立到每个API端点的连接，第一个用户请求不用再等握手
+    for (size_t i = 0; i < config_.endpoints.size(); ++i) {
+        Transfer* warmup = new Transfer();
+        warmup->endpoint = static_cast<int>(i);
+        warmup->warmup = true;
+        if (!StartTransfer(warmup)) {
+            delete warmup;
+        }
     }
     
-    // 设置回调函数用于接收响应数据
-    auto writeCallback = [](char* ptr, size_t size, size_t nmemb, void* userdata) -> size_t {
-        size_t totalSize = size * nmemb;
-        std::string* buffer = static_cast<std::string*>(userdata);
-        buffer->append(ptr, totalSize);
-        return totalSize;
-    };
+    while (true) {
+        // 把新提交的请求交给调度器
+        {
+            InstrumentedLockGuard lock(pendingMutex_, LOCK_SITE);
+            added.swap(pending_);
+        }
+        for (Request* request : added) {
+            if (scheduler_.Enqueue(request->userID, request, request->tokens, request->startTime)) {
+                queued.push_back({request->userID, request});
+            } else {
+                // 这个用户排队的请求已满：不排队，直接回复提示
+                WriteLogFmt(LogLevel::WARN, LogFmt::AI_USER_QUEUE_FULL, request->userID);
+                g_metricAIScheduled.Inc(1, METRIC_SCHEDULE_REJECTED);
+                CompleteRequest(request, "您的AI请求太多了，请等前面的回复完成后再发送。", false);
+            }
+        }
+        added.clear();
     
-    // 设置请求选项
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, postData.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, +writeCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &responseBuffer);
+        // 能开始的请求直接开始，其余的告诉用户正在排队
+        long waitMs = AdmitRequests();
+        for (const auto& entry : queued) {
+            size_t ahead = 0;
+            if (!scheduler_.Position(entry.first, entry.second, ahead)) {
+                g_metricAIScheduled.Inc(1, METRIC_SCHEDULE_IMMEDIATE);
+                continue;
+            }
+            g_metricAIScheduled.Inc(1, METRIC_SCHEDULE_QUEUED);
+            if (entry.second->onQueued) {
+                entry.second->onQueued(ahead);
+            }
+        }
+        queued.clear();
     
-    // 设置HTTP头
-    struct curl_slist* headers = nullptr;
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    std::string authHeader = "Authorization: Bearer " + config_.apiKey;
-    headers = curl_slist_append(headers, authHeader.c_str());
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        // 推进所有传输
+        int running = 0;
+        curl_multi_perform(multi, &running);
     
-    // 设置SSL验证（生产环境应该启用）
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+        // 对冲的两次尝试已经决出胜负：取消落败的一方；交出流式传输中攒够时间的文本
+        for (Request* request : running_) {
+            if (request->winner != nullptr && request->attempts.size() > 1) {
+                std::vector<Transfer*> attempts = request->attempts;
+                for (Transfer* attempt : attempts) {
+                    if (attempt != request->winner) {
+                        CancelAttempt(attempt);
+                    }
+                }
+            }
+            FlushPartial(request, false);
+        }
+    
+        // 处理完成的传输
+        CURLMsg* message = nullptr;
+        int pendingMessages = 0;
+        while ((message = curl_multi_info_read(multi, &pendingMessages)) != nullptr) {
+            if (message->msg != CURLMSG_DONE) {
+                continue;
+            }
+            CURL* curl = message->easy_handle;
+            CURLcode result = message->data.result;  // 移除句柄后message失效，先取出结果
+            Transfer* transfer = nullptr;
+            curl_easy_getinfo(curl, CURLINFO_PRIVATE, &transfer);
+            curl_multi_remove_handle(multi, curl);
+            FinishTransfer(transfer, result);
+        }
     
-    // 设置超时
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+        // 结束的请求空出了并发名额，排队的请求接着开始；到时间的请求发出对冲
+        long refillMs = AdmitRequests();
+        long hedgeMs = CheckHedges();
+        for (long ms : {refillMs, hedgeMs}) {
+            if (ms >= 0 && (waitMs < 0 || ms < waitMs)) {
+                waitMs = ms;
+            }
+        }
     
-    // 执行请求
-    res = curl_easy_perform(curl);
+        // 等待网络事件或新请求（SubmitHttpRequest会唤醒）；有流式传输时按合并间隔醒来交出文本，
+        // 令牌不够时在补充够的时候醒来，有等待对冲的请求时在对冲时间醒来
+        long timeoutMs = running_.empty() ? 1000 : AI_STREAM_FLUSH_MS;
+        if (waitMs >= 0 && waitMs < timeoutMs) {
+            timeoutMs = waitMs;
+        }
+        curl_multi_poll(multi, nullptr, 0, static_cast<int>(timeoutMs), nullptr);
+    }
+}
+
+// 一次尝试超过这个时间时把各阶段耗时写入日志
+static const long AI_SLOW_ATTEMPT_MS = 5000;
+
+// 读出curl记录的这次尝试的各阶段时间点
+static AITransferTimes ReadTransferTimes(CURL* curl, bool warmup) {
+    AITransferTimes times;
+    curl_off_t value = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &value) == CURLE_OK) {
+        times.nameLookupUs = value;
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &value) == CURLE_OK) {
+        times.connectUs = value;
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &value) == CURLE_OK) {
+        times.appConnectUs = value;
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &value) == CURLE_OK) {
+        times.preTransferUs = value;
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &value) == CURLE_OK) {
+        times.startTransferUs = value;
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &value) == CURLE_OK) {
+        times.totalUs = value;
+    }
+    long connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    times.newConnection = connects > 0;
+    times.warmup = warmup;
+    return times;
+}
+
+// 各阶段耗时的文字说明（用于慢请求的日志）
+static std::string DescribeTransferTimes(const AITransferTimes& times) {
+    char text[256];
+    int64_t connectEndUs = times.appConnectUs > 0 ? times.appConnectUs : times.connectUs;
+    snprintf(text, sizeof(text), "连接%s %.0fms，首字节 %.0fms，传输 %.0fms，共 %.0fms",
+             times.newConnection ? "（新建）" : "（复用）", connectEndUs / 1000.0,
+             times.startTransferUs > 0 ? (times.startTransferUs - times.preTransferUs) / 1000.0 : 0.0,
+             times.startTransferUs > 0 ? (times.totalUs - times.startTransferUs) / 1000.0 : 0.0, times.totalUs / 1000.0);
+    return text;
+}
+
+void AIService::FinishTransfer(Transfer* transfer, int result) {
+    const std::string& url = config_.endpoints[transfer->endpoint].url;
+    long httpCode = 0;
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &httpCode);
+    AITransferTimes times = ReadTransferTimes(transfer->curl, transfer->warmup);
+    ReleaseHandle(transfer->curl);  // 句柄放回池中
     
-    // 清理
-    curl_slist_free_all(headers);
+    if (transfer->warmup) {
+        // 预热请求：API服务器通常会对HEAD返回405之类的状态码，只要连接建立就算成功
+        if (result == CURLE_OK) {
+            WriteLog(LogLevel::INFO, "AI服务连接预热完成: " + url);
+        } else {
+            WriteLog(LogLevel::WARN, "AI服务连接预热失败: " + url + " " + curl_easy_strerror(static_cast<CURLcode>(result)));
+        }
+        RecordAITransferTimes(static_cast<size_t>(transfer->endpoint), times);
+        delete transfer;
+        return;
+    }
     
-    if (res != CURLE_OK) {
-        WriteLog(LogLevel::FATAL, std::string("CURL请求失败: ") + curl_easy_strerror(res));
-        curl_easy_cleanup(curl);
-        return "";
+    Request* request = transfer->request;
+    request->attempts.erase(std::find(request->attempts.begin(), request->attempts.end(), transfer));
+    if (request->winner != nullptr && request->winner != transfer) {
+        // 对冲中落败、被写回调中止的一方（耗时不完整，不记录）
+        endpoints_.OnCancel(transfer->endpoint, transfer->attempt);
+        delete transfer;
+        return;
+    }
+    if (request->traceSampled) {
+        RecordTraceSpan("AIService::SendHttpRequest", transfer->startTime, std::chrono::steady_clock::now(), "status",
+                        httpCode);
+    }
+    RecordAITransferTimes(static_cast<size_t>(transfer->endpoint), times);
+    if (times.totalUs >= AI_SLOW_ATTEMPT_MS * 1000) {
+        WriteLog(LogLevel::WARN, "AI请求较慢: " + url + " " + DescribeTransferTimes(times));
     }
     
-    // 获取HTTP响应码
-    long httpCode = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpCode);
+    std::string reply;
+    std::string failureReply = "抱歉，AI服务暂时不可用。";
+    bool success = false;
     
-    curl_easy_cleanup(curl);
+    if (result != CURLE_OK) {
+        WriteLog(LogLevel::FATAL, "CURL请求失败: " + url + " " + curl_easy_strerror(static_cast<CURLcode>(result)));
+    } else if (httpCode != 200) {
+        WriteLog(LogLevel::WARN, "AI API返回非200状态码: " + std::to_string(httpCode) + " " + url);
+        WriteLog(LogLevel::WARN, "响应内容: " + transfer->responseBuffer);
+    } else {
+        // 解析响应JSON（流式响应在接收时已经拼好）
+        reply = request->stream ? request->reply : ParseResponseJSON(transfer->responseBuffer);
+        if (reply.empty()) {
+            WriteLog(LogLevel::WARN, "无法解析AI响应");
+            failureReply = "抱歉，无法理解AI的回复。";
+        } else {
+            success = true;
+        }
+    }
     
-    if (httpCode != 200) {
-        WriteLog(LogLevel::WARN, "AI API返回非200状态码: " + std::to_string(httpCode));
-        WriteLog(LogLevel::WARN, "响应内容: " + responseBuffer);
-        return "";
+    // 记录端点的健康状况
+    auto now = std::chrono::steady_clock::now();
+    if (success) {
+        if (endpoints_.OnSuccess(transfer->endpoint, transfer->attempt,
+                                 MillisecondsBetween(transfer->startTime, transfer->firstByteTime))) {
+            WriteLog(LogLevel::INFO, "AI端点已恢复: " + url);
+        }
+        if (transfer->hedge) {
+            g_metricAIHedges.Inc(1, METRIC_HEDGE_WON);
+        }
+    } else if (endpoints_.OnFailure(transfer->endpoint, transfer->attempt, MillisecondsBetween(transfer->startTime, now),
+                                    now)) {
+        WriteLog(LogLevel::WARN, "AI端点连续失败，暂停使用: " + url);
     }
+    bool wasWinner = request->winner == transfer;
+    delete transfer;
     
-    return responseBuffer;
+    if (success) {
+        CompleteRequest(request, reply, true);
+        return;
+    }
+    if (wasWinner) {
+        CompleteRequest(request, failureReply, false);  // 已经开始向用户输出，不能换端点重来
+        return;
+    }
+    if (!request->attempts.empty()) {
+        return;  // 另一次尝试还在进行
+    }
+    // 换一个没有试过的端点重试
+    if (request->attemptCount < AI_MAX_ATTEMPTS) {
+        uint64_t attempt = 0;
+        int endpoint = endpoints_.Pick(request->triedMask, now, attempt);
+        if (endpoint >= 0 && StartAttempt(request, endpoint, attempt, false)) {
+            WriteLog(LogLevel::INFO, "AI请求改用端点: " + config_.endpoints[endpoint].url);
+            return;
+        }
+    }
+    CompleteRequest(request, failureReply, false);
+}
+
+void AIService::CompleteRequest(Request* request, const std::string& reply, bool success) {
+    std::vector<Transfer*> attempts = request->attempts;
+    for (Transfer* attempt : attempts) {
+        CancelAttempt(attempt);
+    }
+    auto it = std::find(running_.begin(), running_.end(), request);
+    if (it != running_.end()) {
+        running_.erase(it);
+    }
+    if (request->admitted) {
+        scheduler_.Release();  // 空出并发名额
+    }
+    
+    if (success) {
+        WriteLog(LogLevel::INFO, "AI回复成功");
+        g_metricAIRequests.Inc(1, METRIC_RESULT_SUCCESS);
+    } else {
+        g_metricAIRequests.Inc(1, METRIC_RESULT_FAILURE);
+    }
+    ResultCallback onComplete = std::move(request->onComplete);
+    delete request;
+    g_metricAIInFlight.Sub(1);
+    
+    onComplete(reply, success);
+}
+
+bool AIService::Start() {
+    CURLM* multi = curl_multi_init();
+    CURLSH* share = curl_share_init();
+    if (multi == nullptr || share == nullptr) {
+        WriteLog(LogLevel::FATAL, "无法初始化CURL multi句柄，AI服务无法启动");
+        return false;
+    }
+    
+    // 同一主机的请求优先在已有的HTTP/2连接上多路复用
+    // 端点只支持HTTP/1.1时每个请求占一条连接，连接数上限不能低于调度器的并发数，否则调度器放行的请求还要在curl里排队
+    // 对冲请求发往另一个端点（另一台主机），不受同一主机的上限影响
+    long maxConnections = std::max(8L, static_cast<long>(config_.maxConcurrent));
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, maxConnections);
+    curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, maxConnections * 2 * static_cast<long>(config_.endpoints.size()));
+    
+    // DNS和TLS会话在所有句柄间共享（只有事件循环线程使用，不设置锁回调）
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    
+    // 设置每个端点的HTTP头（端点没有单独的密钥时使用API_KEY）
+    for (const AIEndpointConfig& endpoint : config_.endpoints) {
+        struct curl_slist* headers = nullptr;
+        headers = curl_slist_append(headers, "Content-Type: application/json");
+        std::string authHeader = "Authorization: Bearer " + (endpoint.apiKey.empty() ? config_.apiKey : endpoint.apiKey);
+        headers = curl_slist_append(headers, authHeader.c_str());
+        endpointHeaders_.push_back(headers);
+    }
+    endpoints_.Configure(config_.endpoints.size());
+    
+    // 分阶段耗时按端点统计
+    std::vector<std::string> endpointNames;
+    for (const AIEndpointConfig& endpoint : config_.endpoints) {
+        endpointNames.push_back(endpoint.url);
+    }
+    ConfigureAITimings(endpointNames, config_.model);
+    
+    multi_ = multi;
+    share_ = share;
+    
+    std::thread(&AIService::EventLoop, this).detach();
+    return true;
 }
 
 void InitializeAIService() {
@@ -230,10 +954,18 @@ void InitializeAIService() {
     // 读取配置文件
     std::string line;
     config.apiKey = "";
-    config.apiEndpoint = "";
     config.model = "";
     config.maxTokens = 0;
     config.temperature = 0.0f;
+    config.stream = true;
+    config.cacheMaxBytes = 16 * 1024 * 1024;
+    config.cacheTtlSeconds = 600;
+    config.contextTokens = -1;  // 未配置时按MAX_TOKENS计算
+    config.contextMaxBytes = 8 * 1024 * 1024;
+    config.maxConcurrent = 16;
+    config.rateLimitRpm = 0;
+    config.rateLimitTpm = 0;
+    config.maxQueuedPerUser = 8;
     
     while (std::getline(configFile, line)) {
         // 跳过注释和空行
@@ -256,7 +988,18 @@ void InitializeAIService() {
             if (key == "API_KEY") {
                 config.apiKey = value;
             } else if (key == "API_ENDPOINT") {
-                config.apiEndpoint = value;
+                // 可以写多行，每行一个端点："URL [密钥]"，没有密钥的端点使用API_KEY
+                AIEndpointConfig endpoint;
+                size_t space = value.find_first_of(" \t");
+                endpoint.url = value.substr(0, space);
+                if (space != std::string::npos) {
+                    endpoint.apiKey = value.substr(value.find_first_not_of(" \t", space));
+                }
+                if (config.endpoints.size() >= AI_MAX_ENDPOINTS) {
+                    WriteLog(LogLevel::WARN, "API_ENDPOINT过多，忽略: " + endpoint.url);
+                } else if (!endpoint.url.empty()) {
+                    config.endpoints.push_back(endpoint);
+                }
             } else if (key == "MODEL") {
                 config.model = value;
             } else if (key == "MAX_TOKENS") {
@@ -273,20 +1016,75 @@ void InitializeAIService() {
                     WriteLog(LogLevel::WARN, "TEMPERATURE配置无效，使用默认值0.7");
                     config.temperature = 0.7f;
                 }
+            } else if (key == "STREAM") {
+                config.stream = (value == "true" || value == "1");
+            } else if (key == "CACHE_MAX_MB") {
+                try {
+                    config.cacheMaxBytes = static_cast<size_t>(std::stoul(value)) * 1024 * 1024;
+                } catch (...) {
+                    WriteLog(LogLevel::WARN, "CACHE_MAX_MB配置无效，使用默认值16");
+                }
+            } else if (key == "CONTEXT_TOKENS") {
+                try {
+                    config.contextTokens = std::stoi(value);
+                } catch (...) {
+                    WriteLog(LogLevel::WARN, "CONTEXT_TOKENS配置无效，使用默认值（MAX_TOKENS的2倍）");
+                }
+            } else if (key == "CONTEXT_MAX_MB") {
+                try {
+                    config.contextMaxBytes = static_cast<size_t>(std::stoul(value)) * 1024 * 1024;
+                } catch (...) {
+                    WriteLog(LogLevel::WARN, "CONTEXT_MAX_MB配置无效，使用默认值8");
+                }
+            } else if (key == "MAX_CONCURRENT") {
+                try {
+                    config.maxConcurrent = std::stoi(value);
+                } catch (...) {
+                    WriteLog(LogLevel::WARN, "MAX_CONCURRENT配置无效，使用默认值16");
+                }
+            } else if (key == "RATE_LIMIT_RPM") {
+                try {
+                    config.rateLimitRpm = std::stoi(value);
+                } catch (...) {
+                    WriteLog(LogLevel::WARN, "RATE_LIMIT_RPM配置无效，不限制请求速率");
+                }
+            } else if (key == "RATE_LIMIT_TPM") {
+                try {
+                    config.rateLimitTpm = std::stoi(value);
+                } catch (...) {
+                    WriteLog(LogLevel::WARN, "RATE_LIMIT_TPM配置无效，不限制token速率");
+                }
+            } else if (key == "MAX_QUEUED_PER_USER") {
+                try {
+                    config.maxQueuedPerUser = std::stoi(value);
+                } catch (...) {
+                    WriteLog(LogLevel::WARN, "MAX_QUEUED_PER_USER配置无效，使用默认值8");
+                }
+            } else if (key == "CACHE_TTL_SECONDS") {
+                try {
+                    config.cacheTtlSeconds = std::stoi(value);
+                } catch (...) {
+                    WriteLog(LogLevel::WARN, "CACHE_TTL_SECONDS配置无效，使用默认值600");
+                }
             }
         }
     }
     configFile.close();
     
     // 验证必需配置
-    if (config.apiKey.empty() || config.apiKey == "your-api-key-here") {
-        WriteLog(LogLevel::FATAL, "配置文件错误：API_KEY未配置或无效");
-        return;
-    }
-    if (config.apiEndpoint.empty()) {
+    if (config.endpoints.empty()) {
         WriteLog(LogLevel::FATAL, "配置文件错误：API_ENDPOINT未配置");
         return;
     }
+    if (config.apiKey == "your-api-key-here") {
+        config.apiKey = "";
+    }
+    for (const AIEndpointConfig& endpoint : config.endpoints) {
+        if (endpoint.apiKey.empty() && config.apiKey.empty()) {
+            WriteLog(LogLevel::FATAL, "配置文件错误：API_KEY未配置或无效（端点" + endpoint.url + "没有单独的密钥）");
+            return;
+        }
+    }
     if (config.model.empty()) {
         WriteLog(LogLevel::FATAL, "配置文件错误：MODEL未配置");
         return;
@@ -299,7 +1097,34 @@ void InitializeAIService() {
         WriteLog(LogLevel::WARN, "配置文件错误：TEMPERATURE无效，使用默认值0.7");
         config.temperature = 0.7f;
     }
+    if (config.contextTokens < 0) {
+        // 历史对话的预算随回复长度走：回复越长，带的历史越多
+        config.contextTokens = config.maxTokens * 2;
+    }
+    if (config.maxConcurrent <= 0) {
+        WriteLog(LogLevel::WARN, "配置文件错误：MAX_CONCURRENT无效，使用默认值16");
+        config.maxConcurrent = 16;
+    }
     
     g_aiService.Configure(config);
+    RegisterGaugeCallback("chat_ai_cache_bytes", "Estimated memory used by the AI reply cache",
+                          [] { return static_cast<double>(g_aiService.Cache().Bytes()); });
+    RegisterGaugeCallback("chat_ai_cache_entries", "Replies held in the AI reply cache",
+                          [] { return static_cast<double>(g_aiService.Cache().Entries()); });
+    RegisterGaugeCallback("chat_ai_context_bytes", "Estimated memory used by per-user AI conversation context",
+                          [] { return static_cast<double>(g_aiService.ContextBytes()); });
+    RegisterGaugeCallback("chat_ai_queue_depth", "AI requests waiting in the scheduler queues",
+                          [] { return static_cast<double>(g_aiService.Scheduler().Depth()); });
+    RegisterGaugeCallback("chat_ai_queue_wait_p50_seconds", "Median time AI requests waited in the scheduler queues",
+                          [] { return SummarizeHistogram(g_aiService.Scheduler().WaitHistogram()).p50Ns / 1e9; });
+    RegisterGaugeCallback("chat_ai_queue_wait_p99_seconds", "99th percentile time AI requests waited in the scheduler queues",
+                          [] { return SummarizeHistogram(g_aiService.Scheduler().WaitHistogram()).p99Ns / 1e9; });
+    RegisterGaugeCallback("chat_ai_queue_wait_max_seconds", "Longest time an AI request waited in the scheduler queues",
+                          [] { return SummarizeHistogram(g_aiService.Scheduler().WaitHistogram()).maxNs / 1e9; });
+    RegisterGaugeCallback("chat_ai_endpoints_open", "AI endpoints currently skipped by the circuit breaker",
+                          [] { return static_cast<double>(g_aiService.OpenEndpoints()); });
+    if (!g_aiService.Start()) {
+        return;
+    }
     WriteLog(LogLevel::INFO, "AI服务初始化完成");
 }
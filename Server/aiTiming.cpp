@@ -0,0 +1,132 @@
+#include "headers/aiTiming.h"
+#include <atomic>
+#include <cstdio>
+
+// 直方图[端点][阶段]
+static LatencyHistogram g_aiTimings[AI_MAX_ENDPOINTS][AI_PHASE_COUNT];
+
+// 端点名和模型名在配置时写好，之后只读；g_aiTimingEndpoints最后写入，读者先读它
+static std::string g_aiTimingNames[AI_MAX_ENDPOINTS];
+static std::string g_aiTimingModel;
+static std::atomic<size_t> g_aiTimingEndpoints{0};
+
+void ConfigureAITimings(const std::vector<std::string>& endpointNames, const std::string& model) {
+    size_t count = endpointNames.size() < AI_MAX_ENDPOINTS ? endpointNames.size() : AI_MAX_ENDPOINTS;
+    for (size_t i = 0; i < count; ++i) {
+        g_aiTimingNames[i] = endpointNames[i];
+    }
+    g_aiTimingModel = model;
+    g_aiTimingEndpoints.store(count, std::memory_order_release);
+}
+
+// 记录from到to之间的耗时（两个时间点都有效且不倒退时才记录）
+static void RecordPhase(size_t endpoint, AIPhase phase, int64_t fromUs, int64_t toUs) {
+    if (toUs <= 0 || toUs < fromUs) {
+        return;
+    }
+    g_aiTimings[endpoint][static_cast<size_t>(phase)].Record(static_cast<uint64_t>(toUs - fromUs) * 1000);
+}
+
+void RecordAITransferTimes(size_t endpoint, const AITransferTimes& times) {
+    if (endpoint >= g_aiTimingEndpoints.load(std::memory_order_acquire)) {
+        return;
+    }
+    if (times.newConnection) {
+        RecordPhase(endpoint, AIPhase::DNS, 0, times.nameLookupUs);
+        RecordPhase(endpoint, AIPhase::CONNECT, times.nameLookupUs, times.connectUs);
+        if (times.appConnectUs > 0) {
+            RecordPhase(endpoint, AIPhase::TLS, times.connectUs, times.appConnectUs);
+        }
+    }
+    if (times.warmup) {
+        return;
+    }
+    if (times.startTransferUs > 0) {
+        RecordPhase(endpoint, AIPhase::FIRST_BYTE, times.preTransferUs, times.startTransferUs);
+        RecordPhase(endpoint, AIPhase::TRANSFER, times.startTransferUs, times.totalUs);
+    }
+    RecordPhase(endpoint, AIPhase::TOTAL, 0, times.totalUs);
+}
+
+size_t AITimingEndpoints() {
+    return g_aiTimingEndpoints.load(std::memory_order_acquire);
+}
+
+const std::string& AITimingEndpointName(size_t endpoint) {
+    return g_aiTimingNames[endpoint];
+}
+
+const std::string& AITimingModel() {
+    return g_aiTimingModel;
+}
+
+LatencySummary SummarizeAITiming(size_t endpoint, AIPhase phase) {
+    return SummarizeHistogram(g_aiTimings[endpoint][static_cast<size_t>(phase)]);
+}
+
+const char* AIPhaseName(AIPhase phase) {
+    switch (phase) {
+        case AIPhase::DNS:        return "dns";
+        case AIPhase::CONNECT:    return "connect";
+        case AIPhase::TLS:        return "tls";
+        case AIPhase::FIRST_BYTE: return "first_byte";
+        case AIPhase::TRANSFER:   return "transfer";
+        case AIPhase::TOTAL:      return "total";
+        default:                  return "unknown";
+    }
+}
+
+std::string RenderAITimingMetrics() {
+    size_t endpoints = AITimingEndpoints();
+    if (endpoints == 0) {
+        return "";
+    }
+    std::string out;
+    char line[1024];
+    out += "# HELP chat_ai_phase_seconds AI API attempt time by phase\n# TYPE chat_ai_phase_seconds summary\n";
+    for (size_t endpoint = 0; endpoint < endpoints; ++endpoint) {
+        const char* name = g_aiTimingNames[endpoint].c_str();
+        const char* model = g_aiTimingModel.c_str();
+        for (size_t phase = 0; phase < AI_PHASE_COUNT; ++phase) {
+            LatencySummary summary = SummarizeAITiming(endpoint, static_cast<AIPhase>(phase));
+            if (summary.count == 0) {
+                continue;
+            }
+            const char* phaseName = AIPhaseName(static_cast<AIPhase>(phase));
+            snprintf(line, sizeof(line),
+                     "chat_ai_phase_seconds{endpoint=\"%s\",model=\"%s\",phase=\"%s\",quantile=\"0.5\"} %.6f\n"
+                     "chat_ai_phase_seconds{endpoint=\"%s\",model=\"%s\",phase=\"%s\",quantile=\"0.99\"} %.6f\n"
+                     "chat_ai_phase_seconds{endpoint=\"%s\",model=\"%s\",phase=\"%s\",quantile=\"0.999\"} %.6f\n",
+                     name, model, phaseName, summary.p50Ns / 1e9, name, model, phaseName, summary.p99Ns / 1e9,
+                     name, model, phaseName, summary.p999Ns / 1e9);
+            out += line;
+            snprintf(line, sizeof(line), "chat_ai_phase_seconds_count{endpoint=\"%s\",model=\"%s\",phase=\"%s\"} %llu\n",
+                     name, model, phaseName, static_cast<unsigned long long>(summary.count));
+            out += line;
+        }
+    }
+    return out;
+}
+
+std::string RenderAITimingTable() {
+    std::string out;
+    char line[512];
+    for (size_t endpoint = 0; endpoint < AITimingEndpoints(); ++endpoint) {
+        snprintf(line, sizeof(line), "%s (%s)\n", g_aiTimingNames[endpoint].c_str(), g_aiTimingModel.c_str());
+        out += line;
+        snprintf(line, sizeof(line), "  %-12s %10s %12s %12s %12s %12s\n", "phase", "count", "p50(ms)", "p99(ms)",
+                 "p999(ms)", "max(ms)");
+        out += line;
+        for (size_t phase = 0; phase < AI_PHASE_COUNT; ++phase) {
+            LatencySummary summary = SummarizeAITiming(endpoint, static_cast<AIPhase>(phase));
+            snprintf(line, sizeof(line), "  %-12s %10llu %12.1f %12.1f %12.1f %12.1f\n",
+                     AIPhaseName(static_cast<AIPhase>(phase)), static_cast<unsigned long long>(summary.count),
+                     summary.p50Ns / 1e6, summary.p99Ns / 1e6, summary.p999Ns / 1e6, summary.maxNs / 1e6);
+            out += line;
+        }
+    }
+    if (out.empty()) {
+        out = "no samples\n";
+    }
+    return out;
+}
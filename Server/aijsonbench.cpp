@@ -0,0 +1,371 @@
+// AI服务JSON读写的压测工具：比较改为aiJson之前的写法（ostringstream拼接请求体，find查找"content"再逐个替换反转义）
+// 和现在的JsonWriter/ReadChatContent，三种场景：构造请求体、解析完整响应、解析流式事件
+// 用法：aijsonbench [--bytes 文本字节数] [--iterations 次数] [--chunk 每个流式事件的字节数]
+// 默认文本约100KB（中英文混合，带换行和引号），两种写法的结果不一致时会提示
+#include "headers/aiJson.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+// 压测参数
+struct BenchOptions {
+    size_t bytes = 100 * 1024;
+    int iterations = 200;
+    size_t chunk = 24;
+};
+
+static BenchOptions g_options;
+
+// 请求体的其他字段（与ai_config.txt的默认值相同）
+static const char* const BENCH_MODEL = "deepseek-chat";
+static const int BENCH_MAX_TOKENS = 2000;
+static const double BENCH_TEMPERATURE = 0.7;
+
+// ---- 改为aiJson之前的写法（照搬原实现） ----
+
+static std::string LegacyEscapeJSON(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size() + 8);
+    for (char c : text) {
+        switch (c) {
+            case '\"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned char>(c));
+                    escaped += buffer;
+                } else {
+                    escaped += c;
+                }
+                break;
+        }
+    }
+    return escaped;
+}
+
+static std::string LegacyBuildRequestJSON(const std::vector<std::string>& history, const std::string& userMessage) {
+    std::ostringstream json;
+    json << "{"
+         << "\"model\":\"" << BENCH_MODEL << "\","
+         << "\"messages\":[";
+    for (size_t i = 0; i + 1 < history.size(); i += 2) {
+        json << "{\"role\":\"user\",\"content\":\"" << LegacyEscapeJSON(history[i]) << "\"},"
+             << "{\"role\":\"assistant\",\"content\":\"" << LegacyEscapeJSON(history[i + 1]) << "\"},";
+    }
+    json << "{\"role\":\"user\",\"content\":\"" << LegacyEscapeJSON(userMessage) << "\"}],"
+         << "\"max_tokens\":" << BENCH_MAX_TOKENS << ","
+         << "\"temperature\":" << BENCH_TEMPERATURE;
+    json << ",\"stream\":true";
+    json << "}";
+    return json.str();
+}
+
+static std::string LegacyExtractContent(const std::string& responseJson, size_t from) {
+    size_t contentPos = responseJson.find("\"content\"", from);
+    if (contentPos == std::string::npos) {
+        return "";
+    }
+    size_t startQuote = responseJson.find("\"", contentPos + 9);
+    if (startQuote == std::string::npos) {
+        return "";
+    }
+    size_t endQuote = startQuote + 1;
+    while (endQuote < responseJson.length()) {
+        if (responseJson[endQuote] == '\"' && responseJson[endQuote - 1] != '\\') {
+            break;
+        }
+        endQuote++;
+    }
+    if (endQuote >= responseJson.length()) {
+        return "";
+    }
+    std::string content = responseJson.substr(startQuote + 1, endQuote - startQuote - 1);
+    size_t pos = 0;
+    while ((pos = content.find("\\n", pos)) != std::string::npos) {
+        content.replace(pos, 2, "\n");
+        pos += 1;
+    }
+    pos = 0;
+    while ((pos = content.find("\\\"", pos)) != std::string::npos) {
+        content.replace(pos, 2, "\"");
+        pos += 1;
+    }
+    return content;
+}
+
+static std::string LegacyParseStreamDelta(const std::string& eventJson) {
+    size_t deltaPos = eventJson.find("\"delta\"");
+    if (deltaPos == std::string::npos) {
+        return "";
+    }
+    size_t endPos = eventJson.find('}', deltaPos);
+    size_t contentPos = eventJson.find("\"content\"", deltaPos);
+    if (contentPos == std::string::npos || (endPos != std::string::npos && contentPos > endPos)) {
+        return "";
+    }
+    return LegacyExtractContent(eventJson, deltaPos);
+}
+
+// ---- 现在的写法（与AIService::BuildRequestJSON/ParseResponseJSON/ParseStreamDelta相同） ----
+
+static std::string BuildRequestJSON(const std::vector<std::string>& history, const std::string& userMessage) {
+    size_t textBytes = userMessage.size();
+    for (const std::string& text : history) {
+        textBytes += text.size();
+    }
+    JsonWriter json(textBytes + textBytes / 8 + 256);
+    json.BeginObject();
+    json.Key("model");
+    json.String(BENCH_MODEL);
+    json.Key("messages");
+    json.BeginArray();
+    auto message = [&json](const char* role, const std::string& content) {
+        json.BeginObject();
+        json.Key("role");
+        json.String(role);
+        json.Key("content");
+        json.String(content);
+        json.EndObject();
+    };
+    for (size_t i = 0; i + 1 < history.size(); i += 2) {
+        message("user", history[i]);
+        message("assistant", history[i + 1]);
+    }
+    message("user", userMessage);
+    json.EndArray();
+    json.Key("max_tokens");
+    json.Int(BENCH_MAX_TOKENS);
+    json.Key("temperature");
+    json.Double(BENCH_TEMPERATURE);
+    json.Key("stream");
+    json.Bool(true);
+    json.EndObject();
+    return json.Take();
+}
+
+// ---- 测试数据 ----
+
+// 生成约bytes字节的中英文混合文本，每行约60字节，时常带引号（旧写法只反转义\n和\"，所以不放其他转义字符）
+static std::string MakeText(size_t bytes, unsigned seed) {
+    static const char* const pieces[] = {"你好，", "这是一段测试文本", "The quick brown fox ", "jumps over ",
+                                         "\"引号\"", "数字 12345 ", "JSON", "。"};
+    std::string text;
+    text.reserve(bytes + 64);
+    size_t lineBytes = 0;
+    while (text.size() < bytes) {
+        seed = seed * 1103515245 + 12345;
+        const char* piece = pieces[(seed >> 16) % (sizeof(pieces) / sizeof(pieces[0]))];
+        text += piece;
+        lineBytes += strlen(piece);
+        if (lineBytes >= 60) {
+            text += '\n';
+            lineBytes = 0;
+        }
+    }
+    return text;
+}
+
+// 按UTF-8字符边界把text切成约chunk字节的片段
+static std::vector<std::string> SplitText(const std::string& text, size_t chunk) {
+    std::vector<std::string> parts;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = std::min(text.size(), pos + chunk);
+        while (end < text.size() && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+            end++;
+        }
+        parts.push_back(text.substr(pos, end - pos));
+        pos = end;
+    }
+    return parts;
+}
+
+static std::string MakeResponse(const std::string& content) {
+    JsonWriter json(content.size() * 2 + 256);
+    json.BeginObject();
+    json.Key("id");
+    json.String("chatcmpl-bench");
+    json.Key("object");
+    json.String("chat.completion");
+    json.Key("choices");
+    json.BeginArray();
+    json.BeginObject();
+    json.Key("index");
+    json.Int(0);
+    json.Key("message");
+    json.BeginObject();
+    json.Key("role");
+    json.String("assistant");
+    json.Key("content");
+    json.String(content);
+    json.EndObject();
+    json.Key("finish_reason");
+    json.String("stop");
+    json.EndObject();
+    json.EndArray();
+    json.Key("usage");
+    json.BeginObject();
+    json.Key("total_tokens");
+    json.Int(static_cast<long long>(content.size() / 3));
+    json.EndObject();
+    json.EndObject();
+    return json.Take();
+}
+
+// 一个流式事件（SSE的一行，包括"data: "前缀）
+static std::string MakeStreamEvent(const std::string& delta) {
+    JsonWriter json(delta.size() * 2 + 128);
+    json.BeginObject();
+    json.Key("id");
+    json.String("chatcmpl-bench");
+    json.Key("choices");
+    json.BeginArray();
+    json.BeginObject();
+    json.Key("index");
+    json.Int(0);
+    json.Key("delta");
+    json.BeginObject();
+    json.Key("content");
+    json.String(delta);
+    json.EndObject();
+    json.EndObject();
+    json.EndArray();
+    json.EndObject();
+    return "data: " + json.Take();
+}
+
+// ---- 压测 ----
+
+// 运行iterations次，返回平均每次的微秒数；sink防止结果被优化掉
+template <typename Func>
+static double TimeIt(Func func, size_t& sink) {
+    BenchClock::time_point start = BenchClock::now();
+    for (int i = 0; i < g_options.iterations; ++i) {
+        sink += func();
+    }
+    double seconds = std::chrono::duration<double>(BenchClock::now() - start).count();
+    return seconds * 1e6 / g_options.iterations;
+}
+
+static void PrintRow(const char* name, double legacyUs, double currentUs, size_t bytes, bool same) {
+    double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+    printf("%-10s 旧 %9.1fus (%7.1f MB/s)  新 %9.1fus (%7.1f MB/s)  %5.1fx%s\n", name, legacyUs,
+           megabytes / (legacyUs / 1e6), currentUs, megabytes / (currentUs / 1e6), legacyUs / currentUs,
+           same ? "" : "  结果不一致");
+}
+
+static void PrintUsage() {
+    std::cerr << "用法: aijsonbench [--bytes 文本字节数] [--iterations 次数] [--chunk 每个流式事件的字节数]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsage();
+            return 1;
+        }
+        long value = atol(argv[++i]);
+        if (arg == "--bytes") {
+            g_options.bytes = static_cast<size_t>(std::max(1L, value));
+        } else if (arg == "--iterations") {
+            g_options.iterations = static_cast<int>(std::max(1L, value));
+        } else if (arg == "--chunk") {
+            g_options.chunk = static_cast<size_t>(std::max(1L, value));
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    // 请求：8轮历史加上这次的提问，合计约bytes字节
+    std::vector<std::string> history;
+    size_t part = std::max<size_t>(1, g_options.bytes / 17);
+    for (unsigned i = 0; i < 16; ++i) {
+        history.push_back(MakeText(part, i + 1));
+    }
+    std::string userMessage = MakeText(part, 99);
+    size_t requestBytes = userMessage.size();
+    for (const std::string& text : history) {
+        requestBytes += text.size();
+    }
+
+    // 完整响应和流式事件：回复文本约bytes字节
+    std::string reply = MakeText(g_options.bytes, 7);
+    std::string response = MakeResponse(reply);
+    std::vector<std::string> events;
+    for (const std::string& delta : SplitText(reply, g_options.chunk)) {
+        events.push_back(MakeStreamEvent(delta));
+    }
+
+    printf("文本 %zu 字节, %d 次, 流式事件 %zu 个（每个约 %zu 字节）\n", g_options.bytes, g_options.iterations,
+           events.size(), g_options.chunk);
+
+    size_t sink = 0;
+
+    // 构造请求体
+    bool sameRequest = LegacyBuildRequestJSON(history, userMessage) == BuildRequestJSON(history, userMessage);
+    double legacyUs = TimeIt([&] { return LegacyBuildRequestJSON(history, userMessage).size(); }, sink);
+    double currentUs = TimeIt([&] { return BuildRequestJSON(history, userMessage).size(); }, sink);
+    PrintRow("构造请求", legacyUs, currentUs, requestBytes, sameRequest);
+
+    // 解析完整响应
+    std::string parsed;
+    ReadChatContent(response.data(), response.size(), "message", parsed);
+    bool sameResponse = LegacyExtractContent(response, 0) == reply && parsed == reply;
+    legacyUs = TimeIt([&] { return LegacyExtractContent(response, 0).size(); }, sink);
+    currentUs = TimeIt([&] {
+        std::string content;
+        ReadChatContent(response.data(), response.size(), "message", content);
+        return content.size();
+    }, sink);
+    PrintRow("解析响应", legacyUs, currentUs, response.size(), sameResponse);
+
+    // 解析流式事件：旧写法先复制出"data: "之后的部分再查找，新写法直接在行上解析
+    size_t streamBytes = 0;
+    for (const std::string& event : events) {
+        streamBytes += event.size();
+    }
+    auto legacyStream = [&] {
+        std::string text;
+        for (const std::string& event : events) {
+            std::string data = event.substr(5);
+            data.erase(0, data.find_first_not_of(' '));
+            text += LegacyParseStreamDelta(data);
+        }
+        return text;
+    };
+    auto currentStream = [&] {
+        std::string text;
+        for (const std::string& event : events) {
+            const char* data = event.data() + 5;
+            size_t dataSize = event.size() - 5;
+            while (dataSize > 0 && *data == ' ') {
+                data++;
+                dataSize--;
+            }
+            std::string delta;
+            ReadChatContent(data, dataSize, "delta", delta);
+            text += delta;
+        }
+        return text;
+    };
+    bool sameStream = legacyStream() == reply && currentStream() == reply;
+    legacyUs = TimeIt([&] { return legacyStream().size(); }, sink);
+    currentUs = TimeIt([&] { return currentStream().size(); }, sink);
+    PrintRow("流式事件", legacyUs, currentUs, streamBytes, sameStream);
+
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+// AI服务压测工具：直接使用服务器的AIService（调度、缓存、上下文、流式输出的代码与服务器相同）向模拟AI服务（aimock）
+// 或任何兼容的端点发请求，统计吞吐量、端到端延迟和首段延迟的分位数、排队等待以及失败数
+// 每个虚拟用户同一时间只有一个请求，收到回复后立即发下一个（闭环），直到发完总请求数
+// 用法：aiload [--endpoint URL]... [--users 用户数] [--requests 总请求数] [--stream 0|1] [--prompt-bytes 字节数]
+//             [--distinct 0|1] [--context-tokens N] [--max-concurrent N] [--rpm N] [--tpm N]
+// --endpoint可以给多次（测试端点选择、对冲和熔断，例如一个aimock正常、另一个加上延迟或错误率）
+#include "headers/aiService.h"
+#include "headers/latency.h"
+#include "headers/aiTiming.h"
+#include "headers/metrics.h"
+#include <curl/curl.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using LoadClock = std::chrono::steady_clock;
+
+// 压测参数
+struct LoadOptions {
+    std::vector<std::string> endpoints;  // 没有给出时使用本机8090端口的aimock
+    int users = 50;
+    int requests = 1000;
+    bool stream = true;
+    size_t promptBytes = 200;
+    bool distinct = true;       // 每个请求的提问都不同（为0时所有请求相同，用于测试缓存和合并）
+    int contextTokens = 0;      // 每次请求携带的历史对话token预算
+    int maxConcurrent = 16;
+    int rpm = 0;
+    int tpm = 0;
+};
+
+static LoadOptions g_options;
+
+// 统计
+static LatencyHistogram g_totalLatency;    // 提交到收到完整回复
+static LatencyHistogram g_firstLatency;    // 提交到收到第一段（只统计流式输出）
+static std::atomic<int> g_issued{0};
+static std::atomic<int> g_completed{0};
+static std::atomic<int> g_queuedNotices{0};
+static std::mutex g_doneMutex;
+static std::condition_variable g_doneCv;
+
+// 一个虚拟用户的当前请求
+struct LoadUser {
+    uint8_t userID = 0;
+    LoadClock::time_point submitTime;
+    std::atomic<bool> gotFirst{false};
+};
+
+static uint64_t ElapsedNs(LoadClock::time_point since) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(LoadClock::now() - since).count());
+}
+
+static std::string MakePrompt(int index) {
+    std::string prompt = g_options.distinct ? "压测请求 #" + std::to_string(index) + " " : "压测请求 ";
+    while (prompt.size() < g_options.promptBytes) {
+        prompt += "The quick brown fox jumps over the lazy dog. ";
+    }
+    prompt.resize(g_options.promptBytes);
+    return prompt;
+}
+
+// 发出用户的下一个请求（完成回调在AI服务的事件循环线程上调用，在那里接着发下一个）
+static void IssueNext(LoadUser* user) {
+    int index = g_issued.fetch_add(1);
+    if (index >= g_options.requests) {
+        return;
+    }
+    user->submitTime = LoadClock::now();
+    user->gotFirst = false;
+    g_aiService.GetAIResponseAsync(user->userID, MakePrompt(index),
+        [](size_t) {
+            g_queuedNotices++;
+        },
+        [user](const std::string&) {
+            if (!user->gotFirst.exchange(true)) {
+                g_firstLatency.Record(ElapsedNs(user->submitTime));
+            }
+        },
+        [user](const std::string&) {
+            g_totalLatency.Record(ElapsedNs(user->submitTime));
+            if (g_completed.fetch_add(1) + 1 >= g_options.requests) {
+                std::lock_guard<std::mutex> lock(g_doneMutex);
+                g_doneCv.notify_all();
+            }
+            IssueNext(user);
+        });
+}
+
+static void PrintLatency(const char* name, const LatencyHistogram& histogram) {
+    LatencySummary summary = SummarizeHistogram(histogram);
+    printf("%-10s 次数 %-8llu p50 %8.1fms  p99 %8.1fms  p999 %8.1fms  最大 %8.1fms\n", name,
+           static_cast<unsigned long long>(summary.count), summary.p50Ns / 1e6, summary.p99Ns / 1e6,
+           summary.p999Ns / 1e6, summary.maxNs / 1e6);
+}
+
+static void PrintUsage() {
+    std::cerr << "用法: aiload [--endpoint URL]... [--users 用户数] [--requests 总请求数] [--stream 0|1] "
+                 "[--prompt-bytes 字节数] [--distinct 0|1] [--context-tokens N] [--max-concurrent N] [--rpm N] [--tpm N]"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--endpoint") {
+            g_options.endpoints.push_back(value);
+        } else if (arg == "--users") {
+            g_options.users = atoi(value.c_str());
+        } else if (arg == "--requests") {
+            g_options.requests = atoi(value.c_str());
+        } else if (arg == "--stream") {
+            g_options.stream = value != "0";
+        } else if (arg == "--prompt-bytes") {
+            g_options.promptBytes = static_cast<size_t>(atoll(value.c_str()));
+        } else if (arg == "--distinct") {
+            g_options.distinct = value != "0";
+        } else if (arg == "--context-tokens") {
+            g_options.contextTokens = atoi(value.c_str());
+        } else if (arg == "--max-concurrent") {
+            g_options.maxConcurrent = atoi(value.c_str());
+        } else if (arg == "--rpm") {
+            g_options.rpm = atoi(value.c_str());
+        } else if (arg == "--tpm") {
+            g_options.tpm = atoi(value.c_str());
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    // 用户ID是一个字节，254留给AI好友
+    if (g_options.users < 1 || g_options.users > 253 || g_options.requests < 1) {
+        std::cerr << "用户数应在1到253之间，总请求数至少为1" << std::endl;
+        return 1;
+    }
+
+    if (g_options.endpoints.empty()) {
+        g_options.endpoints.push_back("http://127.0.0.1:8090/v1/chat/completions");
+    }
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    AIConfig config;
+    config.apiKey = "load-test";
+    for (const std::string& endpoint : g_options.endpoints) {
+        config.endpoints.push_back({endpoint, ""});
+    }
+    config.model = "mock";
+    config.maxTokens = 200;
+    config.temperature = 0.7f;
+    config.stream = g_options.stream;
+    config.cacheMaxBytes = 16 * 1024 * 1024;
+    config.cacheTtlSeconds = 600;
+    config.contextTokens = g_options.contextTokens;
+    config.contextMaxBytes = 8 * 1024 * 1024;
+    config.maxConcurrent = g_options.maxConcurrent;
+    config.rateLimitRpm = g_options.rpm;
+    config.rateLimitTpm = g_options.tpm;
+    config.maxQueuedPerUser = 8;
+    g_aiService.Configure(config);
+    if (!g_aiService.Start()) {
+        std::cerr << "AI服务启动失败" << std::endl;
+        return 1;
+    }
+
+    printf("压测 %s%s：%d个用户，共%d个请求，%s\n", g_options.endpoints[0].c_str(),
+           g_options.endpoints.size() > 1 ? " 等多个端点" : "", g_options.users, g_options.requests,
+           g_options.stream ? "流式输出" : "非流式");
+    fflush(stdout);
+
+    std::vector<LoadUser> users(static_cast<size_t>(g_options.users));
+    LoadClock::time_point start = LoadClock::now();
+    for (size_t i = 0; i < users.size(); ++i) {
+        users[i].userID = static_cast<uint8_t>(i + 1);
+        IssueNext(&users[i]);
+    }
+
+    // 等待全部完成，每秒输出一次进度
+    {
+        std::unique_lock<std::mutex> lock(g_doneMutex);
+        while (!g_doneCv.wait_for(lock, std::chrono::seconds(1), [] { return g_completed >= g_options.requests; })) {
+            printf("已完成 %d/%d  排队 %zu  熔断的端点 %zu\n", g_completed.load(), g_options.requests,
+                   g_aiService.Scheduler().Depth(), g_aiService.OpenEndpoints());
+            fflush(stdout);
+        }
+    }
+    double seconds = std::chrono::duration<double>(LoadClock::now() - start).count();
+
+    printf("\n用时 %.2f秒  吞吐量 %.1f请求/秒\n", seconds, g_options.requests / seconds);
+    printf("成功 %llu  失败 %llu  缓存命中 %llu  合并 %llu  收到排队通知 %d\n",
+           static_cast<unsigned long long>(g_metricAIRequests.Value(METRIC_RESULT_SUCCESS)),
+           static_cast<unsigned long long>(g_metricAIRequests.Value(METRIC_RESULT_FAILURE)),
+           static_cast<unsigned long long>(g_metricAICache.Value(METRIC_CACHE_HIT)),
+           static_cast<unsigned long long>(g_metricAICache.Value(METRIC_CACHE_COALESCED)),
+           g_queuedNotices.load());
+    printf("对冲 %llu  对冲胜出 %llu\n", static_cast<unsigned long long>(g_metricAIHedges.Value(METRIC_HEDGE_SENT)),
+           static_cast<unsigned long long>(g_metricAIHedges.Value(METRIC_HEDGE_WON)));
+    PrintLatency("端到端", g_totalLatency);
+    if (g_options.stream) {
+        PrintLatency("首段", g_firstLatency);
+    }
+    PrintLatency("排队等待", g_aiService.Scheduler().WaitHistogram());
+    printf("\n各端点分阶段耗时:\n%s", RenderAITimingTable().c_str());
+    return 0;
+}
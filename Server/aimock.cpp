@@ -0,0 +1,344 @@
+// 本地的模拟AI服务：实现chat/completions接口（包括SSE流式输出），用于在没有真实API的环境下测试和压测AI服务
+// 可以设置首字节延迟、生成速度、回复长度，以及按比例返回500、429或中途断开连接，模拟上游故障
+// 用法：aimock [--port 端口] [--latency-ms 毫秒] [--jitter-ms 毫秒] [--tokens-per-sec 速度] [--reply-tokens 数量]
+//             [--error-rate 比例] [--throttle-rate 比例] [--drop-rate 比例]
+// ai_config.txt中把API_ENDPOINT设为 http://127.0.0.1:端口/v1/chat/completions 即可让服务器使用它（API_KEY随意）
+#include "headers/aiJson.h"
+#include <winsock2.h>
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+// 模拟参数
+struct MockOptions {
+    int port = 8090;
+    int latencyMs = 300;        // 收到请求到开始回复的时间
+    int jitterMs = 100;         // 延迟的随机波动（0到jitterMs之间均匀分布）
+    double tokensPerSec = 50;   // 生成速度（0表示不限速，一次发完）
+    int replyTokens = 60;       // 每个回复的token数
+    double errorRate = 0;       // 返回500的比例
+    double throttleRate = 0;    // 返回429的比例
+    double dropRate = 0;        // 回复到一半断开连接的比例
+};
+
+static MockOptions g_options;
+
+// 统计（每10秒输出一次）
+static std::atomic<uint64_t> g_requests{0};
+static std::atomic<uint64_t> g_errors{0};
+static std::atomic<uint64_t> g_throttled{0};
+static std::atomic<uint64_t> g_dropped{0};
+static std::atomic<int> g_activeConnections{0};
+
+static const char* MOCK_WORDS[] = {"你好", "这是", "一段", "模拟的", "回复", "，", "用于", "测试", "AI", "服务", "。", "\n"};
+
+static bool SendAll(SOCKET client, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        int n = send(client, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+static bool SendChunk(SOCKET client, const std::string& data) {
+    char size[16];
+    snprintf(size, sizeof(size), "%zx\r\n", data.size());
+    return SendAll(client, size + data + "\r\n");
+}
+
+static void SleepMs(double ms) {
+    if (ms > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<long long>(ms * 1000)));
+    }
+}
+
+static std::mt19937& Random() {
+    thread_local std::mt19937 random(std::random_device{}());
+    return random;
+}
+
+// 不区分大小写地取一个请求头的值
+static std::string HeaderValue(const std::string& headers, const std::string& name) {
+    std::string lowerHeaders = headers;
+    std::string lowerName = "\r\n" + name + ":";
+    for (char& c : lowerHeaders) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    for (char& c : lowerName) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    size_t pos = lowerHeaders.find(lowerName);
+    if (pos == std::string::npos) {
+        return "";
+    }
+    size_t start = pos + lowerName.size();
+    size_t end = headers.find("\r\n", start);
+    std::string value = headers.substr(start, end - start);
+    value.erase(0, value.find_first_not_of(' '));
+    return value;
+}
+
+// 错误响应（OpenAI格式的error对象）
+static bool SendError(SOCKET client, const char* status, const char* type, const char* message, bool retryAfter) {
+    JsonWriter json;
+    json.BeginObject();
+    json.Key("error");
+    json.BeginObject();
+    json.Key("message");
+    json.String(message);
+    json.Key("type");
+    json.String(type);
+    json.EndObject();
+    json.EndObject();
+    std::string response = std::string("HTTP/1.1 ") + status + "\r\n"
+                           "Content-Type: application/json\r\n" +
+                           (retryAfter ? "Retry-After: 1\r\n" : "") +
+                           "Content-Length: " + std::to_string(json.Str().size()) + "\r\n\r\n" + json.Str();
+    return SendAll(client, response);
+}
+
+// 一个流式事件或完整响应的JSON（流式的最后一个事件delta为空）
+static std::string CompletionJSON(const std::string& model, const std::string& content, bool stream, bool last) {
+    JsonWriter json(content.size() + 192);
+    json.BeginObject();
+    json.Key("id");
+    json.String("chatcmpl-mock");
+    json.Key("object");
+    json.String(stream ? "chat.completion.chunk" : "chat.completion");
+    json.Key("model");
+    json.String(model);
+    json.Key("choices");
+    json.BeginArray();
+    json.BeginObject();
+    json.Key("index");
+    json.Int(0);
+    json.Key(stream ? "delta" : "message");
+    json.BeginObject();
+    if (!stream) {
+        json.Key("role");
+        json.String("assistant");
+    }
+    if (!stream || !last) {
+        json.Key("content");
+        json.String(content);
+    }
+    json.EndObject();
+    json.Key("finish_reason");
+    if (last || !stream) {
+        json.String("stop");
+    } else {
+        json.Null();
+    }
+    json.EndObject();
+    json.EndArray();
+    json.EndObject();
+    return json.Take();
+}
+
+// 处理一个chat/completions请求，连接应该关闭时返回false
+static bool ServeCompletion(SOCKET client, const std::string& body) {
+    g_requests++;
+
+    // 只关心model和stream，其余字段跳过
+    std::string model = "mock";
+    bool stream = false;
+    JsonReader reader(body.data(), body.size());
+    std::string key;
+    if (reader.EnterObject()) {
+        while (reader.NextKey(key)) {
+            if (key == "model") {
+                reader.ReadString(model);
+            } else if (key == "stream") {
+                reader.ReadBool(stream);
+            } else {
+                reader.Skip();
+            }
+        }
+    }
+    if (reader.Failed()) {
+        return SendError(client, "400 Bad Request", "invalid_request_error", "请求体不是有效的JSON", false);
+    }
+
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double roll = uniform(Random());
+    SleepMs(g_options.latencyMs + uniform(Random()) * g_options.jitterMs);
+    if (roll < g_options.errorRate) {
+        g_errors++;
+        return SendError(client, "500 Internal Server Error", "server_error", "模拟的服务器错误", false);
+    }
+    if (roll < g_options.errorRate + g_options.throttleRate) {
+        g_throttled++;
+        return SendError(client, "429 Too Many Requests", "rate_limit_error", "模拟的速率限制", true);
+    }
+    bool drop = uniform(Random()) < g_options.dropRate;
+    double tokenMs = g_options.tokensPerSec > 0 ? 1000.0 / g_options.tokensPerSec : 0;
+    const size_t wordCount = sizeof(MOCK_WORDS) / sizeof(MOCK_WORDS[0]);
+
+    if (!stream) {
+        std::string content;
+        for (int i = 0; i < g_options.replyTokens; ++i) {
+            content += MOCK_WORDS[i % wordCount];
+        }
+        SleepMs(tokenMs * g_options.replyTokens);
+        if (drop) {
+            g_dropped++;
+            return false;
+        }
+        std::string json = CompletionJSON(model, content, false, true);
+        return SendAll(client, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                               "Content-Length: " + std::to_string(json.size()) + "\r\n\r\n" + json);
+    }
+
+    // 流式：每个token一个SSE事件，按生成速度间隔发送
+    if (!SendAll(client, "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                         "Transfer-Encoding: chunked\r\n\r\n")) {
+        return false;
+    }
+    for (int i = 0; i < g_options.replyTokens; ++i) {
+        if (drop && i == g_options.replyTokens / 2) {
+            g_dropped++;
+            return false;
+        }
+        if (!SendChunk(client, "data: " + CompletionJSON(model, MOCK_WORDS[i % wordCount], true, false) + "\n\n")) {
+            return false;
+        }
+        SleepMs(tokenMs);
+    }
+    return SendChunk(client, "data: " + CompletionJSON(model, "", true, true) + "\n\n") &&
+           SendChunk(client, "data: [DONE]\n\n") && SendAll(client, "0\r\n\r\n");
+}
+
+// 一个连接：保持连接，依次处理请求
+static void ServeConnection(SOCKET client) {
+    g_activeConnections++;
+    std::string buffer;
+    char chunk[8192];
+    while (true) {
+        size_t headerEnd = buffer.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            int n = recv(client, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                break;
+            }
+            buffer.append(chunk, n);
+            continue;
+        }
+        std::string headers = buffer.substr(0, headerEnd + 2);
+        size_t contentLength = static_cast<size_t>(atoll(HeaderValue(headers, "Content-Length").c_str()));
+        size_t total = headerEnd + 4 + contentLength;
+        bool complete = true;
+        while (buffer.size() < total) {
+            int n = recv(client, chunk, sizeof(chunk), 0);
+            if (n <= 0) {
+                complete = false;
+                break;
+            }
+            buffer.append(chunk, n);
+        }
+        if (!complete) {
+            break;
+        }
+        std::string body = buffer.substr(headerEnd + 4, contentLength);
+        buffer.erase(0, total);
+
+        bool keepOpen = true;
+        if (headers.compare(0, 5, "POST ") == 0 && headers.find("/chat/completions") != std::string::npos) {
+            keepOpen = ServeCompletion(client, body);
+        } else if (headers.compare(0, 5, "HEAD ") == 0) {
+            // 服务器启动时的连接预热
+            keepOpen = SendAll(client, "HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\n\r\n");
+        } else {
+            keepOpen = SendAll(client, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+        }
+        if (!keepOpen) {
+            break;
+        }
+    }
+    closesocket(client);
+    g_activeConnections--;
+}
+
+static void StatsThread() {
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(10));
+        printf("请求 %llu  500错误 %llu  429限流 %llu  中途断开 %llu  当前连接 %d\n",
+               static_cast<unsigned long long>(g_requests.load()), static_cast<unsigned long long>(g_errors.load()),
+               static_cast<unsigned long long>(g_throttled.load()), static_cast<unsigned long long>(g_dropped.load()),
+               g_activeConnections.load());
+        fflush(stdout);
+    }
+}
+
+static void PrintUsage() {
+    std::cerr << "用法: aimock [--port 端口] [--latency-ms 毫秒] [--jitter-ms 毫秒] [--tokens-per-sec 速度] "
+                 "[--reply-tokens 数量] [--error-rate 比例] [--throttle-rate 比例] [--drop-rate 比例]"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--port") {
+            g_options.port = atoi(value.c_str());
+        } else if (arg == "--latency-ms") {
+            g_options.latencyMs = atoi(value.c_str());
+        } else if (arg == "--jitter-ms") {
+            g_options.jitterMs = atoi(value.c_str());
+        } else if (arg == "--tokens-per-sec") {
+            g_options.tokensPerSec = atof(value.c_str());
+        } else if (arg == "--reply-tokens") {
+            g_options.replyTokens = atoi(value.c_str());
+        } else if (arg == "--error-rate") {
+            g_options.errorRate = atof(value.c_str());
+        } else if (arg == "--throttle-rate") {
+            g_options.throttleRate = atof(value.c_str());
+        } else if (arg == "--drop-rate") {
+            g_options.dropRate = atof(value.c_str());
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        std::cerr << "WSAStartup失败" << std::endl;
+        return 1;
+    }
+    SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<u_short>(g_options.port));
+    if (listenSocket == INVALID_SOCKET ||
+        bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+        listen(listenSocket, SOMAXCONN) == SOCKET_ERROR) {
+        std::cerr << "无法监听端口 " << g_options.port << ": " << WSAGetLastError() << std::endl;
+        return 1;
+    }
+    printf("模拟AI服务已启动: http://127.0.0.1:%d/v1/chat/completions\n", g_options.port);
+    fflush(stdout);
+
+    std::thread(StatsThread).detach();
+    while (true) {
+        SOCKET client = accept(listenSocket, nullptr, nullptr);
+        if (client == INVALID_SOCKET) {
+            continue;
+        }
+        // 流式输出每个事件都很小，关闭Nagle算法，否则事件会被攒到对方确认后才发出
+        int noDelay = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+        std::thread(ServeConnection, client).detach();
+    }
+}
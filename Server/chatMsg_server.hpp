@@ -31,6 +31,10 @@ enum class MsgType : uint8_t
     ImageMsg     = 0x12, // 图片消息
     SetName      = 0x13,  // 设置用户名
     CheckUser    = 0x14, // 查询用户状态
+    HistoryReq   = 0x15, // 历史消息翻页请求
+    HistoryRe    = 0x16, // 历史消息翻页反馈
+    AIPartial    = 0x17, // AI回复的一段（流式输出，完整的回复最后仍以NormalMsg发送；field2为请求编号）
+    AIQueued     = 0x18, // AI请求正在排队（field1为前面的请求数，field2为请求编号）
 };
 
 #pragma pack(push,1)
@@ -194,6 +198,43 @@ public:
         return p;
     }
 
+    /* 方法：AI的完整回复（NormalMsg，field3为请求编号，客户端用它找到流式接收时显示的那一条） */
+    // 同一个用户可以同时有多个AI请求，排队提示、流式片段和完整回复都带上请求编号
+    static Packet makeAIReply(uint8_t Sendid, uint8_t Recvid, const std::string& textbody, uint32_t requestId)
+    {
+        Packet p(MsgType::NormalMsg);
+        p.hdr.sendid = Sendid;
+        p.hdr.recvid = Recvid;
+        p.writeField1(textbody);
+        p.writeField3(std::to_string(requestId));
+        p.finish();
+        return p;
+    }
+
+    /* 方法：AI流式回复的一段（field1为这一段新增的文本，field2为请求编号） */
+    static Packet makeAIPartial(uint8_t Sendid, uint8_t Recvid, const std::string& textbody, uint32_t requestId)
+    {
+        Packet p(MsgType::AIPartial);
+        p.hdr.sendid = Sendid;
+        p.hdr.recvid = Recvid;
+        p.writeField1(textbody);
+        p.writeField2(std::to_string(requestId));
+        p.finish();
+        return p;
+    }
+
+    /* 方法：AI请求正在排队（field1为前面大约还有多少个请求，field2为请求编号） */
+    static Packet makeAIQueued(uint8_t Sendid, uint8_t Recvid, size_t ahead, uint32_t requestId)
+    {
+        Packet p(MsgType::AIQueued);
+        p.hdr.sendid = Sendid;
+        p.hdr.recvid = Recvid;
+        p.writeField1(std::to_string(ahead));
+        p.writeField2(std::to_string(requestId));
+        p.finish();
+        return p;
+    }
+
     static Packet makeGroupMessage(uint8_t senderId, const std::string& groupId, const std::string& textbody, const std::string& timestamp)
     {
         Packet p(MsgType::GroupMsg);
@@ -236,6 +277,35 @@ public:
         finish();
     }
 
+    /* 方法：把一条保存的聊天消息改写成历史消息反馈项 */
+    // 原消息的sendid/recvid/success和field1~3保持不变，field4写入元数据：
+    // 原消息类型(1字节) + 消息序号(8字节) + 时间戳毫秒(8字节)，均为网络序
+    void HistoryItem(uint64_t seq, uint64_t timestampMs) {
+        uint8_t meta[17];
+        meta[0] = hdr.type;
+        for (int i = 0; i < 8; ++i) {
+            meta[1 + i] = static_cast<uint8_t>(seq >> (56 - 8 * i));
+            meta[9 + i] = static_cast<uint8_t>(timestampMs >> (56 - 8 * i));
+        }
+        hdr.type = static_cast<uint8_t>(MsgType::HistoryRe);
+        field4.clear();
+        writeFieldRaw(field4, meta, sizeof(meta));
+        finish();
+    }
+
+    /* 方法：历史消息一页结束的反馈包（field4为空，用来和消息项区分） */
+    // 参数：conversation - 会话（私聊为对方ID，群聊为群名），nextCursor - 下一页的游标，hasMore - 是否还有更早的消息
+    static Packet makeHistoryEnd(uint8_t userId, const std::string& conversation, uint64_t nextCursor, bool hasMore)
+    {
+        Packet p(MsgType::HistoryRe);
+        p.hdr.recvid = userId;
+        p.hdr.success = hasMore;
+        p.writeField1(conversation);
+        p.writeField2(std::to_string(nextCursor));
+        p.finish();
+        return p;
+    }
+
     void CheckUserStatusReply(const std::string& username, bool isonline) {
         field1.clear();
         field2.clear();
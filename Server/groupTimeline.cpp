@@ -0,0 +1,290 @@
+#include "headers/groupTimeline.h"
+#include "headers/historyStore.h"
+#include "headers/socket.h"
+#include "headers/logger.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+
+// 全局群聊时间线实例
+GroupTimeline g_groupTimeline;
+
+// 游标文件位置
+static const char* GROUP_CURSOR_FILE = "history/group_cursors.dat";
+static const size_t BACKLOG_PAGE = 256;  // 补发时每次从时间线读出的条数
+static const int GROUP_CURSOR_SAVE_INTERVAL_MS = 2000;  // 上下线游标的保存周期
+
+bool GroupTimeline::Open(const std::string& path) {
+    path_ = path;
+    std::ifstream file(path_, std::ios::binary);
+    if (!file.is_open()) {
+        return true;  // 第一次启动，还没有游标
+    }
+
+    // 文件格式：群聊数 + 每个群聊（群名长度、群名、成员数、每个成员的ID和游标）
+    uint32_t groupCount = 0;
+    file.read(reinterpret_cast<char*>(&groupCount), sizeof(groupCount));
+    for (uint32_t i = 0; i < groupCount && file; ++i) {
+        uint16_t nameLength = 0;
+        file.read(reinterpret_cast<char*>(&nameLength), sizeof(nameLength));
+        std::string groupName(nameLength, '\0');
+        file.read(&groupName[0], nameLength);
+        uint16_t memberCount = 0;
+        file.read(reinterpret_cast<char*>(&memberCount), sizeof(memberCount));
+        if (!file) {
+            break;
+        }
+
+        std::shared_ptr<GroupState> group = GetGroup(groupName);
+        InstrumentedLockGuard lock(group->mutex, LOCK_SITE);
+        for (uint16_t j = 0; j < memberCount && file; ++j) {
+            uint8_t memberID = 0;
+            uint64_t cursor = 0;
+            file.read(reinterpret_cast<char*>(&memberID), sizeof(memberID));
+            file.read(reinterpret_cast<char*>(&cursor), sizeof(cursor));
+            group->members[memberID].cursor = std::min(cursor, group->head);
+        }
+    }
+    if (!file && !file.eof()) {
+        WriteLog(LogLevel::WARN, "群聊游标文件不完整: " + path_);
+    }
+    return true;
+}
+
+std::shared_ptr<GroupTimeline::GroupState> GroupTimeline::GetGroup(const std::string& groupName) {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    auto it = groups_.find(groupName);
+    if (it != groups_.end()) {
+        return it->second;
+    }
+    auto group = std::make_shared<GroupState>();
+    group->head = g_historyStore.Count(HistoryStore::GroupKey(groupName));
+    groups_[groupName] = group;
+    return group;
+}
+
+// 取成员状态（调用方持有群聊的锁）；第一次出现的成员按当前是否在线初始化
+GroupTimeline::MemberState& GroupTimeline::GetMember(GroupState& group, uint8_t userID) {
+    auto it = group.members.find(userID);
+    if (it != group.members.end()) {
+        return it->second;
+    }
+    MemberState& member = group.members[userID];
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    member.live = liveUsers_.count(userID) > 0;
+    return member;
+}
+
+bool GroupTimeline::Publish(const std::string& groupName, const Packet& packet,
+                            const std::vector<uint8_t>& memberList, uint8_t senderID,
+                            std::vector<uint8_t>& liveMembers) {
+    std::shared_ptr<GroupState> group = GetGroup(groupName);
+
+    // 追加历史和判断成员是否在线放在同一把锁里，保证每条消息对每个成员要么实时转发，要么留在游标之后
+    InstrumentedLockGuard lock(group->mutex, LOCK_SITE);
+    uint64_t seq = 0;
+    if (!g_historyStore.Append(packet, &seq)) {
+        return false;
+    }
+    group->head = seq + 1;
+
+    for (uint8_t memberID : memberList) {
+        if (memberID == senderID) {
+            continue;
+        }
+        if (GetMember(*group, memberID).live) {
+            liveMembers.push_back(memberID);
+        }
+    }
+    return true;
+}
+
+std::vector<GroupTimeline::Backlog> GroupTimeline::MemberOnline(uint8_t userID, const std::vector<std::string>& groupNames) {
+    {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        liveUsers_.insert(userID);
+    }
+
+    std::vector<Backlog> backlog;
+    for (const std::string& groupName : groupNames) {
+        std::shared_ptr<GroupState> group = GetGroup(groupName);
+        InstrumentedLockGuard lock(group->mutex, LOCK_SITE);
+        MemberState& member = GetMember(*group, userID);
+        uint64_t fromSeq = member.live ? group->head : member.cursor;
+        if (fromSeq < group->head) {
+            backlog.push_back({groupName, fromSeq, group->head});
+        }
+        member.live = true;
+        member.failedSeq = UINT64_MAX;
+    }
+
+    // 崩溃时文件里的游标只会比内存旧：在线成员按上次保存时的末尾记录，重启后多补发几条而不会漏发
+    dirty_ = true;
+    return backlog;
+}
+
+void GroupTimeline::MemberOffline(uint8_t userID) {
+    std::vector<std::shared_ptr<GroupState>> groups;
+    {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        if (!liveUsers_.erase(userID)) {
+            return;  // 已经登记过下线
+        }
+        for (const auto& pair : groups_) {
+            groups.push_back(pair.second);
+        }
+    }
+
+    for (const auto& group : groups) {
+        InstrumentedLockGuard lock(group->mutex, LOCK_SITE);
+        auto it = group->members.find(userID);
+        if (it == group->members.end() || !it->second.live) {
+            continue;
+        }
+        it->second.cursor = std::min(group->head, it->second.failedSeq);
+        it->second.failedSeq = UINT64_MAX;
+        it->second.live = false;
+    }
+
+    dirty_ = true;
+}
+
+void GroupTimeline::BacklogFailed(const std::string& groupName, uint8_t userID, uint64_t failedSeq) {
+    std::shared_ptr<GroupState> group = GetGroup(groupName);
+    {
+        InstrumentedLockGuard lock(group->mutex, LOCK_SITE);
+        MemberState& member = GetMember(*group, userID);
+        if (member.live) {
+            member.failedSeq = std::min(member.failedSeq, failedSeq);
+        } else {
+            member.cursor = std::min(member.cursor, failedSeq);
+        }
+    }
+    Save();
+}
+
+void GroupTimeline::DropMember(uint8_t userID) {
+    std::vector<std::shared_ptr<GroupState>> groups;
+    {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        liveUsers_.erase(userID);
+        for (const auto& pair : groups_) {
+            groups.push_back(pair.second);
+        }
+    }
+    for (const auto& group : groups) {
+        InstrumentedLockGuard lock(group->mutex, LOCK_SITE);
+        group->members.erase(userID);
+    }
+    Save();
+}
+
+void GroupTimeline::Flush() {
+    if (dirty_) {
+        Save();
+    }
+}
+
+// 保存所有游标：在线成员记为群聊当前末尾（补发中断的记为中断位置），先写临时文件再替换
+void GroupTimeline::Save() {
+    dirty_ = false;  // 先清标记再取快照，取快照期间的变化留给下一次保存
+    std::vector<std::pair<std::string, std::shared_ptr<GroupState>>> groups;
+    {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        groups.assign(groups_.begin(), groups_.end());
+    }
+
+    std::vector<char> out;
+    auto put = [&out](const void* data, size_t size) {
+        out.insert(out.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+    };
+    uint32_t groupCount = static_cast<uint32_t>(groups.size());
+    put(&groupCount, sizeof(groupCount));
+    for (const auto& pair : groups) {
+        InstrumentedLockGuard lock(pair.second->mutex, LOCK_SITE);
+        uint16_t nameLength = static_cast<uint16_t>(pair.first.size());
+        put(&nameLength, sizeof(nameLength));
+        put(pair.first.data(), nameLength);
+        uint16_t memberCount = static_cast<uint16_t>(pair.second->members.size());
+        put(&memberCount, sizeof(memberCount));
+        for (const auto& member : pair.second->members) {
+            uint64_t cursor = member.second.live ? std::min(pair.second->head, member.second.failedSeq)
+                                                 : member.second.cursor;
+            put(&member.first, sizeof(member.first));
+            put(&cursor, sizeof(cursor));
+        }
+    }
+
+    InstrumentedLockGuard lock(saveMutex_, LOCK_SITE);
+    std::string tempPath = path_ + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            WriteLog(LogLevel::WARN, "无法保存群聊游标");
+            return;
+        }
+        file.write(out.data(), out.size());
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path_, ec);
+    if (ec) {
+        WriteLog(LogLevel::WARN, "无法保存群聊游标: " + ec.message());
+    }
+}
+
+// 定时保存游标的线程
+static void GroupCursorSaveThread() {
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(GROUP_CURSOR_SAVE_INTERVAL_MS));
+        g_groupTimeline.Flush();
+    }
+}
+
+void InitializeGroupTimeline() {
+    g_groupTimeline.Open(GROUP_CURSOR_FILE);
+    std::thread(GroupCursorSaveThread).detach();
+    WriteLog(LogLevel::INFO, "群聊时间线已加载");
+}
+
+void SendGroupBacklog(uint8_t userID, ClientSession* session, const std::vector<GroupTimeline::Backlog>& backlog) {
+    size_t sentCount = 0;
+    for (const GroupTimeline::Backlog& range : backlog) {
+        std::string key = HistoryStore::GroupKey(range.groupName);
+        uint64_t seq = range.fromSeq;
+        while (seq < range.toSeq) {
+            size_t count = static_cast<size_t>(std::min<uint64_t>(BACKLOG_PAGE, range.toSeq - seq));
+            std::vector<HistoryStore::Entry> entries;
+            if (!g_historyStore.ReadRange(key, seq, count, entries)) {
+                WriteLog(LogLevel::WARN, "群聊时间线读取失败: " + range.groupName);
+                g_groupTimeline.BacklogFailed(range.groupName, userID, seq);
+                return;
+            }
+
+            // 用户自己发的消息不用补发
+            std::vector<Packet> packets;
+            std::vector<uint64_t> seqs;
+            for (HistoryStore::Entry& entry : entries) {
+                if (entry.packet.getsendid() == userID) {
+                    continue;
+                }
+                seqs.push_back(entry.seq);
+                packets.push_back(std::move(entry.packet));
+            }
+
+            size_t sentFrames = SendPacketBatch(session->socket_fd, packets);
+            sentCount += sentFrames;
+            if (sentFrames < packets.size()) {
+                WriteLogFmt(LogLevel::PASS, LogFmt::BACKLOG_INTERRUPTED, userID, range.groupName);
+                g_groupTimeline.BacklogFailed(range.groupName, userID, seqs[sentFrames]);
+                return;
+            }
+            seq += count;
+        }
+    }
+
+    if (sentCount > 0) {
+        WriteLogFmt(LogLevel::PASS, LogFmt::BACKLOG_DONE, userID, sentCount);
+    }
+}
@@ -3,56 +3,108 @@
 #include "headers/logger.h"
 #include "headers/userControl.h"
 #include "headers/aiService.h"
+#include "headers/historyStore.h"
+#include "headers/groupTimeline.h"
+#include "headers/metrics.h"
+#include "headers/latency.h"
+#include "headers/trace.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <deque>
 #include <vector>
 
 // 全局心跳超时时间（在main中定义）
 extern const int HEARTBEAT_TIMEOUT;
-extern std::mutex g_sessionMutex;
+
+// 历史消息翻页参数
+static const size_t HISTORY_PAGE_DEFAULT = 50;  // 请求未指定页大小时的默认条数
+static const size_t HISTORY_PAGE_MAX = 200;     // 单页最多条数
 
 // 函数前置声明
-static void ReplyAIMsg(Packet& receivedPacket, ClientSession* sessionPtr);
+static void ReplyAIMsg(Packet& receivedPacket);
+
+// 在线用户的发送通道（不在线时为空，调用方持有g_sessionMutex）：只在会话锁内取得通道，发送在锁外进行，
+// 慢的或卡住的客户端只挡住给它发送的线程，不会挡住登录、转发等所有需要会话锁的操作
+static std::shared_ptr<SendChannel> FindUserChannelLocked(uint8_t userID) {
+    auto it = g_userSessions.find(userID);
+    if (it != g_userSessions.end() && it->second != nullptr) {
+        return it->second->sendChannel;
+    }
+    return nullptr;
+}
 
 // 消息转发辅助函数(判断对面是否存在，是否在线，然后转发消息)
-static void ForwardToUser(Packet& packet, uint8_t senderID, uint8_t receiverID, const std::string& msgType) {
+static void ForwardToUser(Packet& packet, uint8_t senderID, uint8_t receiverID, const char* msgType) {
+    LatencyStageTimer routingTimer(LatencyStage::ROUTING);
     int userStatus = CheckUser(receiverID);
 
     switch (userStatus) {
         case 0:
-            WriteLog(LogLevel::PASS, std::to_string(senderID) + "发送的" + msgType + ", 接收人不存在");
+            WriteLogFmt(LogLevel::PASS, LogFmt::FORWARD_NO_RECEIVER, senderID, msgType);
             break;
         case 1:
             SaveOfflineMessages(receiverID, packet);
-            WriteLog(LogLevel::PASS, std::to_string(senderID) + "发送了" + msgType);
-            WriteLog(LogLevel::PASS, std::to_string(receiverID) + "不在线, 保存至离线消息");
+            g_metricMessagesOffline.Inc(1, static_cast<uint8_t>(packet.type()));
+            WriteLogFmt(LogLevel::PASS, LogFmt::FORWARD_SAVED_OFFLINE, senderID, msgType, receiverID);
             break;
         case 2:
             {
-                bool sent = false;
+                std::shared_ptr<SendChannel> channel;
                 {
-                    // 再次检查并发送（处理TOCTOU问题）
-                    std::lock_guard<std::mutex> lock(g_sessionMutex);
-                    if (g_userSessions.count(receiverID) && g_userSessions[receiverID] != nullptr) {
-                        SendPacket(g_userSessions[receiverID]->socket_fd, packet);
-                        sent = true;
-                    } else {
+                    // 再次检查（处理TOCTOU问题）
+                    InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+                    channel = FindUserChannelLocked(receiverID);
+                    if (!channel) {
                         // 时序问题：检查时在线，但现在已离线
                         SaveOfflineMessages(receiverID, packet);
                     }
                 }
-                // 在释放锁后记录日志
-                if (sent) {
-                    WriteLog(LogLevel::PASS, "来自" + std::to_string(senderID) + "的" + msgType + "已转发给: " + std::to_string(receiverID));
+                // 在释放锁后发送和记录日志，接收方慢时不会挡住其他用户
+                if (channel) {
+                    SendPacket(channel, packet);
+                    g_metricMessagesForwarded.Inc(1, static_cast<uint8_t>(packet.type()));
+                    WriteLogFmt(LogLevel::PASS, LogFmt::FORWARD_DONE, senderID, msgType, receiverID);
                 } else {
-                    WriteLog(LogLevel::PASS, "用户" + std::to_string(receiverID) + "已离线，消息保存为离线");
+                    g_metricMessagesOffline.Inc(1, static_cast<uint8_t>(packet.type()));
+                    WriteLogFmt(LogLevel::PASS, LogFmt::FORWARD_RACE_OFFLINE, receiverID);
                 }
             }
             break;
     }
 }
 
+// 群消息转发辅助函数：消息只在群聊时间线里保存一份，只转发给在线成员
+// 离线成员什么都不存，上线时从自己的游标处补发
+static void ForwardToGroup(Packet& packet, const std::string& groupName, const std::vector<uint8_t>& memberList,
+                           uint8_t senderID, const char* msgType) {
+    LatencyStageTimer routingTimer(LatencyStage::ROUTING);
+    std::vector<uint8_t> liveMembers;
+    if (!g_groupTimeline.Publish(groupName, packet, memberList, senderID, liveMembers)) {
+        // 时间线写入失败时退回到逐个成员保存离线消息
+        WriteLog(LogLevel::WARN, "群聊时间线写入失败: " + groupName);
+        for (uint8_t memberID : memberList) {
+            if (memberID != senderID) {
+                ForwardToUser(packet, senderID, memberID, msgType);
+            }
+        }
+        return;
+    }
+
+    for (uint8_t memberID : liveMembers) {
+        ForwardToUser(packet, senderID, memberID, msgType);
+    }
+    size_t otherCount = std::count_if(memberList.begin(), memberList.end(),
+                                      [senderID](uint8_t memberID) { return memberID != senderID; });
+    size_t offlineCount = otherCount - liveMembers.size();
+    if (offlineCount > 0) {
+        WriteLogFmt(LogLevel::PASS, LogFmt::GROUP_MEMBERS_OFFLINE, groupName, offlineCount);
+    }
+}
+
 static void UpdateHeartbeat(std::chrono::steady_clock::time_point& lastHeartbeat, ClientSession* sessionPtr) {
     // 更新心跳时间
     lastHeartbeat = std::chrono::steady_clock::now();
@@ -66,7 +118,7 @@ static void HandleLogin(Packet& receivedPacket, ClientSession* sessionPtr) {
     uint8_t userID = receivedPacket.getsendid();
     std::string password = receivedPacket.getField2Str();
     
-    WriteLog(LogLevel::PROCESS, "登录请求: " + std::to_string(userID));
+    WriteLogFmt(LogLevel::PROCESS, LogFmt::LOGIN_REQUEST, userID);
     
     // 调用登录函数
     bool logSuccess = LoginConnect(userID, password, sessionPtr);
@@ -74,9 +126,11 @@ static void HandleLogin(Packet& receivedPacket, ClientSession* sessionPtr) {
     // 构造响应包
     Packet response = Packet::makeLoginRe(logSuccess);
     if (logSuccess) {
-        WriteLog(LogLevel::PROCESS, "登录成功: " + std::to_string(userID));
+        g_metricLogins.Inc(1, METRIC_RESULT_SUCCESS);
+        WriteLogFmt(LogLevel::PROCESS, LogFmt::LOGIN_SUCCESS, userID);
     } else {
-        WriteLog(LogLevel::PROCESS, "登录失败: " + std::to_string(userID));
+        g_metricLogins.Inc(1, METRIC_RESULT_FAILURE);
+        WriteLogFmt(LogLevel::PROCESS, LogFmt::LOGIN_FAILED, userID);
     }
     
     // 发送响应给客户端
@@ -84,9 +138,22 @@ static void HandleLogin(Packet& receivedPacket, ClientSession* sessionPtr) {
     
     // 如果登录成功，推送离线消息
     if (logSuccess) {
+        // 登录后立刻确定各群聊要补发的区间（之后的群消息都实时转发，不会漏也不会重复）
+        std::vector<std::string> groupNames;
+        {
+            InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+            for (const auto& group : g_groupChat) {
+                if (std::find(group.second.begin(), group.second.end(), userID) != group.second.end()) {
+                    groupNames.push_back(group.first);
+                }
+            }
+        }
+        std::vector<GroupTimeline::Backlog> groupBacklog = g_groupTimeline.MemberOnline(userID, groupNames);
+
         // 延迟3秒开始运行
         std::this_thread::sleep_for(std::chrono::seconds(3));
         SendOfflineMessages(userID, sessionPtr);
+        SendGroupBacklog(userID, sessionPtr, groupBacklog);
     }
 }
 
@@ -101,13 +168,25 @@ static void HandleCreateAccount(Packet& receivedPacket, ClientSession* sessionPt
     // 构造响应包并发送
     Packet response = Packet::makeRegiRe(success);
     SendPacket(sessionPtr->socket_fd, response);
-    WriteLog(LogLevel::PROCESS, "新账号注册: " + std::to_string(userID));
+    WriteLogFmt(LogLevel::PROCESS, LogFmt::SIGNUP_REQUEST, userID);
+}
+
+// 包头里的发送者必须是本会话登录的用户，否则客户端可以冒充他人发消息、写入他人的历史记录
+static bool CheckSender(const Packet& receivedPacket, ClientSession* sessionPtr, const char* msgType) {
+    if (receivedPacket.getsendid() == sessionPtr->userid) {
+        return true;
+    }
+    WriteLogFmt(LogLevel::WARN, LogFmt::SENDER_MISMATCH, sessionPtr->userid, msgType, receivedPacket.getsendid());
+    return false;
 }
 
 static void PassAddFriend(Packet& receivedPacket, ClientSession* sessionPtr) {
     // 检查本会话是否已在线
     if (!CheckOnline(sessionPtr->userid)) {
-        WriteLog(LogLevel::WARN, "离线用户尝试发送好友请求: " + std::to_string(sessionPtr->userid));
+        WriteLogFmt(LogLevel::WARN, LogFmt::OFFLINE_USER_REQUEST, "好友请求", sessionPtr->userid);
+        return;
+    }
+    if (!CheckSender(receivedPacket, sessionPtr, "好友请求")) {
         return;
     }
     
@@ -121,7 +200,10 @@ static void PassAddFriend(Packet& receivedPacket, ClientSession* sessionPtr) {
 static void PassAddFriendRe(Packet& receivedPacket, ClientSession* sessionPtr) {
     // 检查本会话是否是否已在线
     if (!CheckOnline(sessionPtr->userid)) {
-        WriteLog(LogLevel::WARN, "离线用户尝试发送好友响应: " + std::to_string(sessionPtr->userid));
+        WriteLogFmt(LogLevel::WARN, LogFmt::OFFLINE_USER_REQUEST, "好友响应", sessionPtr->userid);
+        return;
+    }
+    if (!CheckSender(receivedPacket, sessionPtr, "好友响应")) {
         return;
     }
     
@@ -136,7 +218,10 @@ static void PassAddFriendRe(Packet& receivedPacket, ClientSession* sessionPtr) {
 static void PassCommonMessage(Packet& receivedPacket, ClientSession* sessionPtr) {
     // 检查本会话是否已在线
     if (!CheckOnline(sessionPtr->userid)) {
-        WriteLog(LogLevel::WARN, "离线用户尝试发送私聊消息: " + std::to_string(sessionPtr->userid));
+        WriteLogFmt(LogLevel::WARN, LogFmt::OFFLINE_USER_REQUEST, "私聊消息", sessionPtr->userid);
+        return;
+    }
+    if (!CheckSender(receivedPacket, sessionPtr, "私聊消息")) {
         return;
     }
     
@@ -144,9 +229,12 @@ static void PassCommonMessage(Packet& receivedPacket, ClientSession* sessionPtr)
     uint8_t senderID = receivedPacket.getsendid();
     uint8_t receiverID = receivedPacket.getrecvid();
 
+    // 保存到会话历史
+    g_historyStore.Append(receivedPacket);
+
     // 判断是不是ai消息
     if (receiverID == 254) {
-        ReplyAIMsg(receivedPacket, sessionPtr);
+        ReplyAIMsg(receivedPacket);
     } else {
         // 转发消息给接收者
         ForwardToUser(receivedPacket, senderID, receiverID, "私聊消息");
@@ -159,8 +247,11 @@ static void HandleCreateGroup(Packet& receivedPacket, ClientSession* sessionPtr)
         WriteLog(LogLevel::WARN, "离线用户尝试创建群组");
         return;
     }
+    if (!CheckSender(receivedPacket, sessionPtr, "创建群聊")) {
+        return;
+    }
     
-    WriteLog(LogLevel::PROCESS, "收到创建群组请求来自: " + std::to_string(sessionPtr->userid));
+    WriteLogFmt(LogLevel::PROCESS, LogFmt::CREATE_GROUP_REQUEST, sessionPtr->userid);
 
     uint8_t creatorID = receivedPacket.getsendid();
     std::vector<uint8_t> memberList = receivedPacket.getField1();
@@ -185,7 +276,7 @@ static void HandleCreateGroup(Packet& receivedPacket, ClientSession* sessionPtr)
     // 向创建者返回成功
     Packet response = Packet::makeCreGroRe(success);
     SendPacket(sessionPtr->socket_fd, response);
-    WriteLog(LogLevel::PROCESS, "群聊创建成功, 名称为: " + groupName);
+    WriteLogFmt(LogLevel::PROCESS, LogFmt::CREATE_GROUP_DONE, groupName);
 }
 
 static void PassGroupMsg(Packet& receivedPacket, ClientSession* sessionPtr) {
@@ -194,35 +285,30 @@ static void PassGroupMsg(Packet& receivedPacket, ClientSession* sessionPtr) {
         WriteLog(LogLevel::WARN, "离线用户尝试发送群聊消息");
         return;
     }
+    if (!CheckSender(receivedPacket, sessionPtr, "群聊消息")) {
+        return;
+    }
 
     uint8_t senderID = receivedPacket.getsendid();
     std::string groupName = receivedPacket.getField2Str();
 
-    WriteLog(LogLevel::PASS, "收到群聊消息 - 发送者: " + std::to_string(senderID) + ", 群聊: " + groupName);
+    WriteLogFmt(LogLevel::PASS, LogFmt::GROUP_MSG_RECEIVED, senderID, groupName);
 
     // 复制群成员列表（最小化持锁时间）
     std::vector<uint8_t> memberList;
     {
-        std::lock_guard<std::mutex> lock(g_sessionMutex);
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
         // 检查群聊是否存在
         if (!g_groupChat.count(groupName)) {
-            std::string errorMsg = "群聊不存在: " + groupName + 
-                                   ", 发送者为: " + std::to_string(senderID);
-            WriteLog(LogLevel::PASS, errorMsg);
+            WriteLogFmt(LogLevel::PASS, LogFmt::GROUP_NOT_FOUND, groupName, senderID);
             return;
         }
         // 获取群成员列表
         memberList = g_groupChat[groupName];
     }
 
-
-    for (uint8_t memberID : memberList) {
-        // 跳过发送者自己
-        if (memberID == senderID) {
-            continue;
-        }
-        ForwardToUser(receivedPacket, senderID, memberID, "群聊消息");
-    }
+    // 群聊消息只保存一份到群聊时间线
+    ForwardToGroup(receivedPacket, groupName, memberList, senderID, "群聊消息");
 }
 
 static void PassImage(Packet& receivedPacket, ClientSession* sessionPtr) {
@@ -231,6 +317,9 @@ static void PassImage(Packet& receivedPacket, ClientSession* sessionPtr) {
         WriteLog(LogLevel::WARN, "离线用户尝试发送图片消息");
         return;
     }
+    if (!CheckSender(receivedPacket, sessionPtr, "图片消息")) {
+        return;
+    }
 
     bool isgroup = receivedPacket.success();
     uint8_t senderID = receivedPacket.getsendid();
@@ -239,26 +328,19 @@ static void PassImage(Packet& receivedPacket, ClientSession* sessionPtr) {
 
         std::vector<uint8_t> memberList; // 复制一份减少锁时间
         {
-            std::lock_guard<std::mutex> lock(g_sessionMutex);
+            InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
             // 检查群聊是否存在
             if (!g_groupChat.count(groupName)) {
-                std::string errorMsg = "群聊不存在: " + groupName + 
-                                    ", 发送者为: " + std::to_string(senderID);
-                WriteLog(LogLevel::PASS, errorMsg);
+                WriteLogFmt(LogLevel::PASS, LogFmt::GROUP_NOT_FOUND, groupName, senderID);
                 return;
             }
             // 获取群成员列表
             memberList = g_groupChat[groupName];
         }
-        for (uint8_t memberID : memberList) {
-        // 跳过发送者自己
-            if (memberID == senderID) {
-                continue;
-            }
-            ForwardToUser(receivedPacket, senderID, memberID, "群聊图片");
-        } 
+        ForwardToGroup(receivedPacket, groupName, memberList, senderID, "群聊图片");
     } else {
         uint8_t receiverID = receivedPacket.getrecvid();
+            g_historyStore.Append(receivedPacket);
             ForwardToUser(receivedPacket, senderID, receiverID, "私聊图片");
     }
 }
@@ -269,6 +351,9 @@ static void HandleSetUserName(Packet& receivedPacket, ClientSession* sessionPtr)
         WriteLog(LogLevel::WARN, "离线用户尝试更改用户名");
         return;
     }
+    if (!CheckSender(receivedPacket, sessionPtr, "更改用户名")) {
+        return;
+    }
 
     uint8_t userID = receivedPacket.getsendid();
     std::string userName = receivedPacket.getField1Str();
@@ -291,7 +376,7 @@ static void HandleCheckStatus(Packet& receivedPacket, ClientSession* sessionPtr)
     std::string targetName = "";
     switch (CheckUser(targetID)) {
         case 0: {
-            WriteLog(LogLevel::PROCESS, "查询的用户不存在");
+            WriteLogFmt(LogLevel::PROCESS, LogFmt::QUERY_USER_MISSING);
             return;
         }
         case 1: {
@@ -308,30 +393,223 @@ static void HandleCheckStatus(Packet& receivedPacket, ClientSession* sessionPtr)
     SendPacket(sessionPtr->socket_fd, receivedPacket);
 }
 
-static void ReplyAIMsg(Packet& receivedPacket, ClientSession* sessionPtr) {
-    uint8_t senderID = receivedPacket.getsendid();
-    std::string message = receivedPacket.getField1Str();
-    
-    WriteLog(LogLevel::PROCESS, "收到AI消息请求 - 用户: " + std::to_string(senderID));
-    
-    std::string aiReply = g_aiService.GetAIResponse(message);
-    
+static void HandleHistoryRequest(Packet& receivedPacket, ClientSession* sessionPtr) {
+    // 检测本会话是否在线
+    if (!CheckOnline(sessionPtr->userid)) {
+        WriteLog(LogLevel::WARN, "离线用户尝试查询历史消息");
+        return;
+    }
+
+    // 请求格式：success表示是否群聊，群聊时field1为群名，私聊时recvid为对方ID
+    // field2为游标（只返回序号小于它的消息，空表示从最新开始），field3为页大小
+    uint8_t userID = sessionPtr->userid;
+    bool isGroup = receivedPacket.success();
+    std::string conversation;
+    std::string key;
+    if (isGroup) {
+        conversation = receivedPacket.getField1Str();
+        // 只有群成员才能查看群聊历史
+        bool isMember = false;
+        {
+            InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+            auto it = g_groupChat.find(conversation);
+            if (it != g_groupChat.end()) {
+                isMember = std::find(it->second.begin(), it->second.end(), userID) != it->second.end();
+            }
+        }
+        if (!isMember) {
+            WriteLogFmt(LogLevel::PROCESS, LogFmt::HISTORY_NOT_MEMBER, userID, conversation);
+            SendPacket(sessionPtr->socket_fd, Packet::makeHistoryEnd(userID, conversation, 0, false));
+            return;
+        }
+        key = HistoryStore::GroupKey(conversation);
+    } else {
+        conversation = std::to_string(receivedPacket.getrecvid());
+        key = HistoryStore::PrivateKey(userID, receivedPacket.getrecvid());
+    }
+
+    uint64_t cursor = UINT64_MAX;
+    size_t pageSize = HISTORY_PAGE_DEFAULT;
+    try {
+        if (!receivedPacket.getField2().empty()) {
+            cursor = std::stoull(receivedPacket.getField2Str());
+        }
+        if (!receivedPacket.getField3().empty()) {
+            pageSize = std::min<size_t>(std::stoul(receivedPacket.getField3Str()), HISTORY_PAGE_MAX);
+        }
+    } catch (...) {
+        WriteLogFmt(LogLevel::WARN, LogFmt::HISTORY_BAD_REQUEST, userID);
+    }
+
+    // 只读游标之前的一页，与会话总消息数无关
+    uint64_t end = std::min(cursor, g_historyStore.Count(key));
+    uint64_t begin = end > pageSize ? end - pageSize : 0;
+    std::vector<HistoryStore::Entry> entries;
+    if (!g_historyStore.ReadRange(key, begin, static_cast<size_t>(end - begin), entries)) {
+        WriteLog(LogLevel::WARN, "历史消息读取失败: " + key);
+    }
+
+    // 每条消息一个反馈项，最后跟一个结束包，一次聚合写发出
+    std::vector<Packet> replies;
+    replies.reserve(entries.size() + 1);
+    for (HistoryStore::Entry& entry : entries) {
+        entry.packet.HistoryItem(entry.seq, entry.timestampMs);
+        replies.push_back(std::move(entry.packet));
+    }
+    replies.push_back(Packet::makeHistoryEnd(userID, conversation, begin, begin > 0));
+    SendPacketBatch(sessionPtr->socket_fd, replies);
+
+    WriteLogFmt(LogLevel::PROCESS, LogFmt::HISTORY_QUERY, userID, conversation, entries.size());
+}
 
-    Packet replyPacket = Packet::Message(254, senderID, aiReply);
+// 把AI回复交给用户（在AI回复的发送线程上调用）
+// 这时发起请求的会话可能已经断开，按用户ID重新查找；不在线时存为离线消息
+static void DeliverAIReply(uint8_t senderID, uint32_t requestId, const std::string& aiReply) {
+    Packet replyPacket = Packet::makeAIReply(254, senderID, aiReply, requestId);
+    g_historyStore.Append(replyPacket);
     
-    // 发送回复
-    if (!SendPacket(sessionPtr->socket_fd, replyPacket)) {
-        WriteLog(LogLevel::WARN, "发送AI回复失败 - 用户: " + std::to_string(senderID));
+    std::shared_ptr<SendChannel> channel;
+    {
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        channel = FindUserChannelLocked(senderID);
+        if (!channel) {
+            SaveOfflineMessages(senderID, replyPacket);
+        }
+    }
+    // 在释放锁后发送和记录日志
+    bool online = channel != nullptr;
+    bool sent = online && SendPacket(channel, replyPacket);
+    if (!online) {
+        g_metricMessagesOffline.Inc(1, static_cast<uint8_t>(replyPacket.type()));
+        WriteLogFmt(LogLevel::PASS, LogFmt::FORWARD_SAVED_OFFLINE, static_cast<uint8_t>(254), "AI回复", senderID);
+    } else if (!sent) {
+        WriteLogFmt(LogLevel::WARN, LogFmt::AI_REPLY_FAILED, senderID);
     } else {
-        WriteLog(LogLevel::PASS, "AI回复已发送 - 用户: " + std::to_string(senderID));
+        WriteLogFmt(LogLevel::PASS, LogFmt::AI_REPLY_SENT, senderID);
+    }
+}
+
+// 把AI流式回复的一段发给用户（在AI回复的发送线程上调用）
+// 只发给在线的用户，不保存：完整的回复最后由DeliverAIReply发送或存为离线消息
+static void DeliverAIPartial(uint8_t senderID, uint32_t requestId, const std::string& delta) {
+    std::shared_ptr<SendChannel> channel;
+    {
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        channel = FindUserChannelLocked(senderID);
+    }
+    if (channel) {
+        SendPacket(channel, Packet::makeAIPartial(254, senderID, delta, requestId));
+    }
+}
+
+// 告诉用户AI请求正在排队（在AI回复的发送线程上调用，只发给在线的用户）
+static void DeliverAIQueued(uint8_t senderID, uint32_t requestId, size_t ahead) {
+    std::shared_ptr<SendChannel> channel;
+    {
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        channel = FindUserChannelLocked(senderID);
+    }
+    if (channel) {
+        SendPacket(channel, Packet::makeAIQueued(254, senderID, ahead, requestId));
+    }
+}
+
+// AI服务的回调只把要发的内容放进队列，由单独的发送线程按顺序发出：
+// 回调在AI服务的事件循环线程上调用，不能在那里阻塞在写socket、加会话锁或写历史文件上，否则所有AI请求都会停住
+// 队列有上限：满了以后丢弃排队提示和流式片段（完整回复最后会整段发出，客户端用它替换拼出的文本），
+// 完整回复不丢弃，它的数量不超过调度器里的AI请求数
+static const size_t AI_DELIVERY_QUEUE_MAX = 4096;
+
+struct AIDelivery {
+    enum Kind { QUEUED, PARTIAL, REPLY } kind;
+    uint8_t userID;
+    uint32_t requestId; // 请求编号（客户端按它区分同一用户同时进行的多个请求）
+    size_t ahead;       // QUEUED：前面还有几个请求
+    std::string text;   // PARTIAL：新生成的一段；REPLY：完整回复
+};
+
+static std::deque<AIDelivery> g_aiDeliveries;
+static size_t g_aiDeliveriesDropped = 0;   // 队列满时丢弃的条数（g_aiDeliveryMutex保护，发送线程清空队列后报告）
+static InstrumentedMutex g_aiDeliveryMutex("aiDelivery.queue");
+static std::condition_variable_any g_aiDeliveryCv;
+
+static void EnqueueAIDelivery(AIDelivery&& delivery) {
+    {
+        InstrumentedLockGuard lock(g_aiDeliveryMutex, LOCK_SITE);
+        if (g_aiDeliveries.size() >= AI_DELIVERY_QUEUE_MAX && delivery.kind != AIDelivery::REPLY) {
+            g_aiDeliveriesDropped++;
+            return;
+        }
+        g_aiDeliveries.push_back(std::move(delivery));
+    }
+    g_aiDeliveryCv.notify_one();
+}
+
+// AI回复的发送线程：按放入的顺序发送，同一个请求的排队提示、各段流式回复和完整回复不会乱序
+static void AIDeliveryThread() {
+    SetTraceThreadName("ai delivery");
+    while (true) {
+        AIDelivery delivery;
+        size_t dropped = 0;
+        {
+            g_aiDeliveryMutex.lock(LOCK_SITE);
+            std::unique_lock<InstrumentedMutex> lock(g_aiDeliveryMutex, std::adopt_lock);
+            g_aiDeliveryCv.wait(lock, [] { return !g_aiDeliveries.empty(); });
+            delivery = std::move(g_aiDeliveries.front());
+            g_aiDeliveries.pop_front();
+            if (g_aiDeliveries.empty()) {
+                std::swap(dropped, g_aiDeliveriesDropped);
+            }
+        }
+        if (dropped > 0) {
+            WriteLog(LogLevel::WARN, "AI回复发送不及，丢弃了" + std::to_string(dropped) + "条排队提示和流式片段");
+        }
+        switch (delivery.kind) {
+            case AIDelivery::QUEUED:
+                DeliverAIQueued(delivery.userID, delivery.requestId, delivery.ahead);
+                break;
+            case AIDelivery::PARTIAL:
+                DeliverAIPartial(delivery.userID, delivery.requestId, delivery.text);
+                break;
+            case AIDelivery::REPLY:
+                DeliverAIReply(delivery.userID, delivery.requestId, delivery.text);
+                break;
+        }
     }
 }
 
+void InitializeAIDelivery() {
+    std::thread(AIDeliveryThread).detach();
+}
+
+// AI请求只提交不等待，客户端线程可以继续处理心跳和其他消息
+static void ReplyAIMsg(Packet& receivedPacket) {
+    uint8_t senderID = receivedPacket.getsendid();
+    std::string message = receivedPacket.getField1Str();
+    
+    WriteLogFmt(LogLevel::PROCESS, LogFmt::AI_REQUEST, senderID);
+    
+    static std::atomic<uint32_t> nextRequestId{0};
+    uint32_t requestId = ++nextRequestId;
+    g_aiService.GetAIResponseAsync(senderID, message,
+        [senderID, requestId](size_t ahead) {
+            EnqueueAIDelivery({AIDelivery::QUEUED, senderID, requestId, ahead, std::string()});
+        },
+        [senderID, requestId](const std::string& delta) {
+            EnqueueAIDelivery({AIDelivery::PARTIAL, senderID, requestId, 0, delta});
+        },
+        [senderID, requestId](const std::string& aiReply) {
+            EnqueueAIDelivery({AIDelivery::REPLY, senderID, requestId, 0, aiReply});
+        });
+}
+
 // 工作线程入口函数：为每个客户端分配独立线程处理消息
 void HandleClient(ClientSession* sessionPtr) { // 这个会话指针（sessionPtr)作为一个客户端在内存中的唯一代表
     SOCKET clientSocket = sessionPtr->socket_fd;
+    std::shared_ptr<SendChannel> sendChannel = sessionPtr->sendChannel;  // 会话可能先被删除，关闭时用这份
     std::string clientInfo = sessionPtr->client_ip + ":" + std::to_string(clientSocket); // 读取这个连接的ip和端口
     WriteLog(LogLevel::CONNECTION, "客户端处理线程启动: " + clientInfo);
+    SetTraceThreadName("client " + clientInfo);
 
     // 记录最后一次心跳时间
     auto lastHeartbeat = std::chrono::steady_clock::now();
@@ -372,12 +650,18 @@ void HandleClient(ClientSession* sessionPtr) { // 这个会话指针（sessionPt
         
         // 有数据可读，接收数据包
         Packet receivedPacket; // 创建数据包对象
+        auto receiveStart = std::chrono::steady_clock::now();
+        TraceSampleScope traceScope;  // 按采样率决定是否追踪这条消息
+        TraceSpan packetSpan("HandleClient");
 
         if (!RecvPacket(sessionPtr->socket_fd, receivedPacket)) {
             // 连接断开或接收失败
             WriteLog(LogLevel::CONNECTION, "客户端断开连接: " + clientInfo);
             break;
         }
+        g_metricMessagesReceived.Inc(1, static_cast<uint8_t>(receivedPacket.type()));
+        BeginPacketLatency(receivedPacket.type(), receiveStart);
+        packetSpan.SetArg("msg_type", static_cast<int64_t>(receivedPacket.type()));
 
         // // 临时调试日志 - 接收数据后再打印
         // char typeBuf[8];
@@ -450,6 +734,11 @@ void HandleClient(ClientSession* sessionPtr) { // 这个会话指针（sessionPt
                 HandleCheckStatus(receivedPacket, sessionPtr);
                 break;
             }
+
+            case MsgType::HistoryReq: {
+                HandleHistoryRequest(receivedPacket, sessionPtr);
+                break;
+            }
             
             default: {
                 WriteLog(LogLevel::WARN, 
@@ -457,10 +746,12 @@ void HandleClient(ClientSession* sessionPtr) { // 这个会话指针（sessionPt
                 break;
             }
         }
+        EndPacketLatency();
     }
     
     // 清理工作
     WriteLog(LogLevel::CONNECTION, "客户端断开连接: " + clientInfo);
+    g_metricActiveConnections.Sub();
 
     
     if (sessionPtr->userid != 0) {
@@ -470,6 +761,8 @@ void HandleClient(ClientSession* sessionPtr) { // 这个会话指针（sessionPt
     }
     sessionPtr = nullptr;
     
-    // 关闭socket
+    // 关闭socket（先关闭发送通道，其他线程拿着的通道不会再写这个句柄）
+    shutdown(clientSocket, SD_BOTH);
+    CloseSendChannel(sendChannel);
     closesocket(clientSocket);
 }
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <winsock2.h>
+#include <windows.h>
+#include "lockStats.h"
+
+// 账号与群聊的持久化存储：预写日志(WAL) + 定期二进制快照
+// 修改g_userCredentials/g_userName/g_groupChat时，在持有g_sessionMutex的同时追加一条日志记录（只进内存缓冲），
+// 释放锁后再等待后台刷盘线程把它写入磁盘。刷盘线程每次把攒下的所有记录一次写出、一次FlushFileBuffers（组提交），
+// 所以并发的注册/改名/建群共享同一次刷盘开销
+// 启动时先内存映射最近的快照，再只重放快照之后的日志尾部
+// 快照只包含已经落盘的记录：刷盘线程另外维护一份已落盘的账号数据，每写成功一批就把这一批应用上去，
+// 快照从这份数据写出，不读全局map（全局map里可能有还没落盘、之后因写盘失败而撤销的修改）
+// 写盘失败时这一批记录不算落盘，等待它们的调用返回失败；日志文件截回最后一条完整记录的位置（截不回去就换新文件），
+// 之后的记录不会接在写了一半的记录后面（重放遇到损坏的记录就停止，后面的记录都会丢失）
+class AccountStore {
+public:
+    AccountStore();
+    ~AccountStore();
+
+    // 打开存储目录：加载快照、重放日志，把数据恢复到全局map中，并启动刷盘线程
+    bool Open(const std::string& directory);
+
+    // 停止刷盘线程（会先把缓冲区中的记录全部写完）
+    void Close();
+
+    // 追加日志记录（必须在持有g_sessionMutex、且已修改全局map时调用，保证日志顺序与修改顺序一致）
+    // 返回值：记录的序号(LSN)，存储未打开时返回0
+    uint64_t LogSignup(uint8_t userID, const std::string& password);
+    uint64_t LogSetName(uint8_t userID, const std::string& userName);
+    uint64_t LogCreateGroup(const std::string& groupName, const std::vector<uint8_t>& memberList);
+    uint64_t LogDeleteUser(uint8_t userID);
+
+    // 等待指定序号的记录落盘（不要在持有g_sessionMutex时调用）
+    // 返回值：记录已经落盘（lsn为0表示没有记录要等，也返回true）；写盘失败或存储已关闭时返回false
+    bool WaitDurable(uint64_t lsn);
+
+private:
+    uint64_t AppendRecord(uint8_t op, const std::vector<char>& payload);
+    bool LoadSnapshot();
+    void ReplayLog(const std::string& path);
+    bool ApplyRecord(uint8_t op, const char* data, size_t size);
+    void ApplyBatch(const std::vector<char>& batch);
+    bool OpenLogFile(uint64_t startLsn);
+    bool RecoverLogFile(uint64_t nextLsn);
+    bool IsFailed(uint64_t lsn) const;
+    void FlushThread();
+    void WriteSnapshot(uint64_t lsn);
+
+    std::string directory_;
+    HANDLE logFile_;                   // 当前日志文件
+    uint64_t logStartLsn_;             // 当前日志文件第一条记录的序号
+    uint64_t logSize_;                 // 当前日志文件中完整写入的字节数（写盘失败时截回这里）
+    bool logHealthy_;                  // 日志文件末尾是完整的记录（截断和换文件都失败时为false，之后的写入都算失败）
+    std::vector<char> pending_;        // 还没写盘的记录
+    uint64_t nextLsn_;                 // 下一条记录的序号
+    uint64_t durableLsn_;              // 已经落盘的最大序号（不含写盘失败的记录）
+    std::vector<std::pair<uint64_t, uint64_t>> failedRanges_;  // 写盘失败的记录序号区间（相邻的合并，不丢弃）
+    uint64_t snapshotLsn_;             // 最近一次快照包含到的序号
+    bool opened_;
+    bool stopping_;
+    InstrumentedMutex mutex_{"accountStore"};  // 保护以上成员（加锁顺序：先g_sessionMutex，后mutex_）
+    std::condition_variable_any pendingCv_;  // 有新记录待写
+    std::condition_variable_any durableCv_;  // 有记录落盘
+    std::thread flushThread_;
+
+    // 已落盘的账号数据（Open时由快照和日志恢复，之后只在刷盘线程中修改和读取，不加锁）
+    std::map<uint8_t, std::string> durableCredentials_;
+    std::map<uint8_t, std::string> durableNames_;
+    std::map<std::string, std::vector<uint8_t>> durableGroups_;
+};
+
+// 全局账号存储实例
+extern AccountStore g_accountStore;
+
+// 初始化账号存储（在程序启动、开始接受连接之前调用）
+void InitializeAccountStore();
@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include "lockStats.h"
+
+// AI回复缓存：模型、温度和提问都相同的请求直接返回上次成功的回复，不再请求API
+// 按最近使用顺序淘汰（LRU）：总内存超过上限时从最久未用的条目开始淘汰；超过存活时间（TTL）的条目视为不存在
+// 条目按键的64位哈希索引，条目中保存完整的键，哈希冲突时按未命中处理
+class AIResponseCache {
+public:
+    AIResponseCache();
+    AIResponseCache(const AIResponseCache&) = delete;
+    AIResponseCache& operator=(const AIResponseCache&) = delete;
+
+    // 设置内存上限和存活时间（maxBytes为0时关闭缓存，已有条目全部丢弃）
+    void Configure(size_t maxBytes, int ttlSeconds);
+
+    // 查找回复，命中时写入reply并返回true
+    bool Lookup(const std::string& key, std::string& reply);
+
+    // 保存一条回复（只应保存成功的回复）
+    void Insert(const std::string& key, const std::string& reply);
+
+    // 当前占用的内存（估算）和条目数
+    size_t Bytes();
+    size_t Entries();
+
+private:
+    struct Entry {
+        uint64_t hash;
+        std::string key;
+        std::string reply;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    // 一个条目占用的内存（估算，包括链表和索引节点）
+    static size_t EntryBytes(const Entry& entry);
+
+    // 移除一个条目（调用者持有mutex_）
+    void EraseLocked(std::list<Entry>::iterator it);
+
+    InstrumentedMutex mutex_;
+    std::list<Entry> lru_;  // 表头是最近使用的条目
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+    size_t bytes_;
+    size_t maxBytes_;
+    std::chrono::seconds ttl_;
+};
+
+// 生成缓存键：模型 + 温度 + 规范化后的提问（去掉首尾空白，连续的空白合并为一个空格）
+std::string MakeAICacheKey(const std::string& model, float temperature, const std::string& prompt);
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+#include "lockStats.h"
+
+// 每个用户与AI好友的对话上下文：每个用户一个定长的环（最近AI_CONTEXT_MAX_TURNS轮问答），
+// 每轮问答在保存时估算好token数，组装请求时不用再扫描文本
+// 组装请求时从最新的一轮往前取，总token数不超过预算（滑动窗口）；放不下的较早几轮只保留提问的开头，
+// 合成一条简短的摘要，占预算的四分之一以内（窗口让出这部分预算，两者合计不超过预算）
+// 所有用户的上下文共用一个内存上限，超出时从最久没有对话的用户的最早一轮开始丢弃
+
+static const size_t AI_CONTEXT_MAX_TURNS = 32;   // 每个用户最多保留的轮数
+
+// 一轮问答
+struct AIContextTurn {
+    std::string user;       // 用户的提问
+    std::string assistant;  // AI的回复
+    uint32_t tokens;        // 估算的token数（包括每条消息的固定开销）
+};
+
+class AIContextStore {
+public:
+    AIContextStore();
+    AIContextStore(const AIContextStore&) = delete;
+    AIContextStore& operator=(const AIContextStore&) = delete;
+
+    // 设置每次请求携带的上下文token预算和所有用户共用的内存上限（任一为0时不保存上下文）
+    void Configure(size_t tokenBudget, size_t maxBytes);
+
+    // 取出用户的上下文：turns为窗口内的各轮（从旧到新），summary为窗口之前各轮的摘要（可能为空）
+    void Collect(uint8_t userID, std::vector<AIContextTurn>& turns, std::string& summary);
+
+    // 记录一轮问答（AI成功回复后调用）
+    void Append(uint8_t userID, const std::string& userText, const std::string& assistantText);
+
+    // 清除用户的上下文（删除账户时调用）
+    void Clear(uint8_t userID);
+
+    // 所有用户上下文占用的内存（估算）
+    size_t Bytes();
+
+private:
+    struct UserContext {
+        std::deque<AIContextTurn> turns;
+        uint64_t lastUsed = 0;  // 最近一次对话的逻辑时间（用于选择淘汰对象）
+    };
+
+    // 一轮问答占用的内存（估算）
+    static size_t TurnBytes(const AIContextTurn& turn);
+
+    // 丢弃最久没有对话的用户的最早一轮，直到不超过内存上限（调用者持有mutex_）
+    void EvictLocked();
+
+    InstrumentedMutex mutex_;
+    UserContext users_[256];
+    size_t bytes_;
+    size_t maxBytes_;
+    size_t tokenBudget_;
+    uint64_t clock_;
+};
+
+// 估算文本的token数：ASCII大约每4个字符1个token，其他字符（中文等）每个字符算1个token
+uint32_t EstimateTokens(const std::string& text);
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// AI服务的多个上游端点：按延迟选择端点、决定何时发出对冲请求、按端点熔断
+// 选择：每个端点记录首字节时间的指数平均，选（平均延迟 x (进行中的请求数 + 1)）最小的端点，慢的和忙的端点自然少分到请求
+// 对冲：请求在主端点的p95首字节时间内还没有收到数据时，向另一个端点再发一次，先收到数据的一方胜出，另一方取消
+//       对冲请求的数量受预算限制（每个请求积累AI_HEDGE_BUDGET_RATIO个，最多攒AI_HEDGE_BUDGET_MAX个），上游整体变慢时不会翻倍压垮它
+// 熔断：连续失败AI_BREAKER_FAILURES次的端点断开一段时间，期间不再选它；到时间后放一个探测请求（半开），
+//       成功则恢复，失败则断开时间加倍（最长AI_BREAKER_OPEN_MAX_MS）；所有端点都断开时请求立即失败，不再等超时
+//       每次尝试都有一个编号，只有探测请求本身的结果能结束探测、恢复或重新断开端点，
+//       断开前发出的旧请求在这之后成功、失败或被取消都不影响熔断状态
+// 只在AI服务的事件循环线程上使用（不加锁）；断开的端点数可以从其他线程读取
+
+static const size_t AI_MAX_ENDPOINTS = 32;
+static const uint32_t AI_BREAKER_FAILURES = 5;
+static const long AI_BREAKER_OPEN_MS = 5000;
+static const long AI_BREAKER_OPEN_MAX_MS = 60000;
+static const size_t AI_LATENCY_WINDOW = 128;       // 计算p95使用的最近样本数
+static const size_t AI_HEDGE_MIN_SAMPLES = 20;     // 样本少于这个数时使用默认的对冲延迟
+static const long AI_HEDGE_DEFAULT_MS = 2000;
+static const long AI_HEDGE_MIN_MS = 20;
+static const long AI_HEDGE_MAX_MS = 10000;
+static const double AI_HEDGE_BUDGET_RATIO = 0.1;
+static const double AI_HEDGE_BUDGET_MAX = 10;
+
+class AIEndpointPool {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 熔断状态
+    enum class State { CLOSED, OPEN, HALF_OPEN };
+
+    AIEndpointPool();
+    AIEndpointPool(const AIEndpointPool&) = delete;
+    AIEndpointPool& operator=(const AIEndpointPool&) = delete;
+
+    // 设置端点数（超过AI_MAX_ENDPOINTS的忽略），所有状态重置
+    void Configure(size_t count);
+
+    size_t Size() const { return endpoints_.size(); }
+
+    // 选一个可用的端点（跳过excludeMask中的端点），没有时返回-1；attempt为这次尝试的编号，报告结果时传回
+    // 选中半开的端点时这个请求就是它的探测请求，探测结束前不再选它
+    int Pick(uint32_t excludeMask, Clock::time_point now, uint64_t& attempt);
+
+    // 一次尝试的结果（firstByteMs：收到第一个数据的时间；elapsedMs：失败前等了多久）
+    // OnSuccess在端点从熔断中恢复时返回true，OnFailure在端点因此断开时返回true（用于记录日志）
+    bool OnSuccess(int index, uint64_t attempt, double firstByteMs);
+    bool OnFailure(int index, uint64_t attempt, double elapsedMs, Clock::time_point now);
+
+    // 一次尝试被对冲取消（不计入健康状况）
+    void OnCancel(int index, uint64_t attempt);
+
+    // 在这个端点上等待多久还没有数据时发出对冲请求（最近样本的p95）
+    long HedgeDelayMs(int index) const;
+
+    // 每个新请求积累对冲预算；发出对冲请求前取一个，预算不够时返回false
+    void CreditHedgeBudget();
+    bool TakeHedgeBudget();
+
+    State GetState(int index) const { return endpoints_[index].state; }
+
+    // 正处于断开状态的端点数（可以从其他线程读取）
+    size_t OpenCount() const { return openCount_.load(std::memory_order_relaxed); }
+
+private:
+    struct Endpoint {
+        State state = State::CLOSED;
+        uint32_t consecutiveFailures = 0;
+        long openMs = AI_BREAKER_OPEN_MS;   // 下一次断开的时长
+        Clock::time_point openUntil;
+        bool probing = false;               // 半开状态的探测请求正在进行
+        uint64_t probeAttempt = 0;          // 探测请求的尝试编号
+        uint32_t inFlight = 0;
+        double ewmaMs = 500;                // 首字节时间的指数平均（还没有样本时的估计值）
+        std::vector<float> samples;         // 最近的首字节时间（环形）
+        size_t nextSample = 0;
+    };
+
+    void Open(Endpoint& endpoint, Clock::time_point now);
+    bool Finish(Endpoint& endpoint, uint64_t attempt);
+
+    std::vector<Endpoint> endpoints_;
+    uint64_t nextAttempt_;
+    double hedgeBudget_;
+    std::atomic<size_t> openCount_;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// AI服务使用的JSON读写：请求体单遍写出，响应和SSE事件按需读取，不建立整棵树
+// 字符串转义和扫描每次检查16个字节（SSE2），普通文本整段复制，只在遇到需要处理的字符时逐个处理
+
+// 把text转义后追加到out（引号、反斜杠和控制字符，其他字节原样复制，不加两边的引号）
+void AppendJsonEscaped(std::string& out, const char* text, size_t size);
+
+// JSON写出器：按调用顺序写出，逗号和冒号自动加上
+class JsonWriter {
+public:
+    explicit JsonWriter(size_t reserve = 0);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    void Key(const char* key);
+    void String(const std::string& value);
+    void Int(long long value);
+    void Double(double value);
+    void Bool(bool value);
+    void Null();
+
+    // 写出的文本
+    const std::string& Str() const { return out_; }
+    std::string Take() { return std::move(out_); }
+
+private:
+    void Separator();
+
+    std::string out_;
+    bool needComma_;
+};
+
+// JSON读取器：顺序读取一段JSON文本，不关心的值直接跳过
+// 出错（格式不对、意外结束）后所有操作都返回false
+class JsonReader {
+public:
+    JsonReader(const char* data, size_t size);
+
+    // 下一个值是对象/数组时进入它
+    bool EnterObject();
+    bool EnterArray();
+
+    // 读取对象的下一个键（读到'}'时返回false并离开对象）
+    bool NextKey(std::string& key);
+
+    // 数组还有下一个元素时返回true（读到']'时返回false并离开数组）
+    bool NextElement();
+
+    // 读取字符串值（反转义，\uXXXX转为UTF-8）；值不是字符串时返回false（不消耗）
+    bool ReadString(std::string& out);
+
+    // 读取true/false；值不是布尔值时返回false（不消耗）
+    bool ReadBool(bool& value);
+
+    // 跳过下一个值（包括嵌套的对象和数组）
+    bool Skip();
+
+    bool Failed() const { return failed_; }
+
+private:
+    void SkipSpace();
+    bool Fail();
+    bool ParseString(std::string* out);  // out为空时只跳过
+
+    const char* data_;
+    size_t size_;
+    size_t pos_;
+    bool first_;       // 刚进入对象或数组，下一个元素前没有逗号
+    bool failed_;
+};
+
+// 读取聊天补全响应中choices[0].<container>.content的文本
+// container为"message"（完整响应）或"delta"（流式事件）；没有文本（content为null或缺失）时返回false
+bool ReadChatContent(const char* data, size_t size, const char* container, std::string& content);
@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include "latency.h"
+
+// AI请求的调度器：在请求交给curl之前排队，控制同时进行的API调用数和调用速率
+// 每个用户一条队列，按用户轮转取出（每轮每个用户最多一个），一个用户连发很多条也不会让其他用户一直等
+// 速率用两个令牌桶限制，分别对应服务商按分钟计的请求数配额（RPM）和token数配额（TPM）：
+// 每次调用消耗1个请求令牌和（估算的提问token数 + MAX_TOKENS）个token令牌，桶的容量为AI_RATE_BURST_SECONDS秒的配额
+// 只在AI服务的事件循环线程上使用（不加锁）；队列长度和等待时间可以从其他线程读取
+
+static const int AI_RATE_BURST_SECONDS = 10;
+
+class AIScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    AIScheduler();
+    AIScheduler(const AIScheduler&) = delete;
+    AIScheduler& operator=(const AIScheduler&) = delete;
+
+    // 设置同时进行的调用数上限、每分钟的请求数和token数配额（0表示不限制）、每个用户最多排队的请求数
+    void Configure(size_t maxConcurrent, uint32_t requestsPerMinute, uint32_t tokensPerMinute, size_t maxQueuedPerUser);
+
+    // 放进用户的队列（tokens为这次调用估算消耗的token数，submitTime用于统计等待时间），
+    // 这个用户排队的请求已满时返回false
+    bool Enqueue(uint8_t userID, void* item, uint32_t tokens, Clock::time_point submitTime);
+
+    // 取出下一个可以开始的请求（并发数和令牌都够时），没有时返回nullptr
+    // waitMs为令牌不够时到下一次可能够的毫秒数（-1表示不需要按时间醒来）
+    void* Next(Clock::time_point now, long& waitMs);
+
+    // 一个取出的请求结束（释放并发名额）
+    void Release();
+
+    // 请求还在排队时返回true，ahead为前面大约还有多少个请求（用于告诉用户排队位置）
+    // 已经取出的请求返回false（只比较指针，不访问item）
+    bool Position(uint8_t userID, const void* item, size_t& ahead) const;
+
+    // 正在排队的请求数（可以从其他线程读取）
+    size_t Depth() const { return depth_.load(std::memory_order_relaxed); }
+
+    // 排队等待时间的分布（取出时记录）
+    const LatencyHistogram& WaitHistogram() const { return wait_; }
+
+private:
+    struct Entry {
+        void* item;
+        uint32_t tokens;
+        Clock::time_point enqueueTime;
+    };
+
+    // 令牌桶（容量和补充速率由每分钟配额计算，rate为0时不限制）
+    struct Bucket {
+        double tokens = 0;
+        double capacity = 0;
+        double perMs = 0;
+        Clock::time_point lastRefill;
+    };
+
+    static void ConfigureBucket(Bucket& bucket, uint32_t perMinute, Clock::time_point now);
+    static void Refill(Bucket& bucket, Clock::time_point now);
+
+    // 桶里的令牌不够cost时返回还要等待的毫秒数，够时返回0
+    static long WaitFor(const Bucket& bucket, double cost);
+
+    std::deque<Entry> queues_[256];
+    uint16_t cursor_;          // 轮转到的下一个用户
+    size_t running_;
+    size_t maxConcurrent_;
+    size_t maxQueuedPerUser_;
+    Bucket requests_;
+    Bucket tokens_;
+    std::atomic<size_t> depth_;
+    LatencyHistogram wait_;
+};
@@ -1,16 +1,63 @@
 #pragma once
 #include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include "lockStats.h"
+#include "aiCache.h"
+#include "aiContext.h"
+#include "aiScheduler.h"
+#include "aiEndpoints.h"
+
+// 一个上游API端点
+struct AIEndpointConfig {
+    std::string url;           // API端点URL
+    std::string apiKey;        // 这个端点的密钥（为空时使用AIConfig::apiKey）
+};
 
 // AI服务配置
 struct AIConfig {
-    std::string apiKey;        // API密钥
-    std::string apiEndpoint;   // API端点URL
+    std::string apiKey;        // API密钥（端点没有单独的密钥时使用）
+    std::vector<AIEndpointConfig> endpoints;  // API端点（至少一个，同一模型的多个服务商或区域）
     std::string model;         // 使用的模型名称
     int maxTokens;             // 最大token数
     float temperature;         // 温度参数(0.0-1.0)
+    bool stream;               // 是否使用流式输出（SSE），边生成边转给用户
+    size_t cacheMaxBytes;      // 回复缓存的内存上限（0表示不缓存）
+    int cacheTtlSeconds;       // 缓存的回复保留多久
+    int contextTokens;         // 每次请求携带的历史对话token预算（0表示不带历史）
+    size_t contextMaxBytes;    // 所有用户的历史对话共用的内存上限
+    int maxConcurrent;         // 同时进行的API调用数上限
+    int rateLimitRpm;          // 服务商的每分钟请求数配额（0表示不限制）
+    int rateLimitTpm;          // 服务商的每分钟token数配额（0表示不限制）
+    int maxQueuedPerUser;      // 每个用户最多排队的请求数（超过时直接回复提示）
 };
 
+// AI回复完成回调：参数是AI的回复，失败时是给用户看的提示
+// 在AI服务的事件循环线程上调用，只应做很快的事（例如把回复包交给发送或离线队列）
+using AICompletion = std::function<void(const std::string& reply)>;
+
+// AI流式回复的一段：参数是自上一段以来新增的文本（同样在事件循环线程上调用）
+// 第一段收到后立即交出，之后每AI_STREAM_FLUSH_MS毫秒合并交出一次；完整的回复仍由AICompletion交回
+using AIPartialCallback = std::function<void(const std::string& delta)>;
+
+static const int AI_STREAM_FLUSH_MS = 50;
+
+// AI请求需要排队：参数是前面大约还有多少个请求（同样在事件循环线程上调用，每个请求最多一次）
+using AIQueuedCallback = std::function<void(size_t ahead)>;
+
 // AI服务类
+// 所有HTTP请求都在一个事件循环线程上用curl multi接口并发执行，提交请求的线程立即返回，
+// 同时进行的对话再多也不需要额外的线程
+// curl句柄用完放回池中复用；连接保持并优先走HTTP/2多路复用，DNS和TLS会话在所有句柄间共享，
+// 启动时先预热一条到API服务器的连接，之后的请求不再付握手的开销
+// 成功的回复按（模型、温度、规范化后的提问）缓存；同样的请求正在进行时，后来的请求合并到同一次API调用上，
+// 不再另外请求（后来者先收到已经生成的部分，之后和第一个请求者一起收到后续的段和完整回复）
+// 每个用户与AI的最近几轮对话作为上下文随请求发送（见aiContext.h），缓存键包含上下文，不同的对话不会互相命中
+// 真正的API调用先经过调度器（见aiScheduler.h）：限制并发数和速率，各用户轮流取出，排队的用户先收到排队通知
+// 配置了多个端点时按延迟选择端点，慢的请求向另一个端点对冲，连续失败的端点熔断（见aiEndpoints.h）；
+// 还没有收到数据就失败的请求换一个端点重试一次
 class AIService {
 public:
     // 构造函数
@@ -20,26 +67,118 @@ public:
     // 配置AI服务
     void Configure(const AIConfig& config);
     
-    // 发送消息给AI并获取回复
-    // 参数：userMessage - 用户发送的消息
-    // 返回：AI的回复字符串，如果失败返回空字符串
-    std::string GetAIResponse(const std::string& userMessage);
+    // 启动事件循环线程并预热到API服务器的连接（配置完成后调用一次）
+    bool Start();
+    
+    // 发送消息给AI，不等待回复
+    // 参数：userID - 发送消息的用户（用于取出和记录对话上下文）
+    //       userMessage - 用户发送的消息
+    //       onQueued - 请求需要排队时调用（可以为空）
+    //       onPartial - 流式输出时每收到一段调用（可以为空；未开启流式输出时不会调用）
+    //       onComplete - 收到回复（或失败）时调用；未配置、消息为空、命中缓存等情况会在当前线程直接调用
+    void GetAIResponseAsync(uint8_t userID, const std::string& userMessage, AIQueuedCallback onQueued,
+                            AIPartialCallback onPartial, AICompletion onComplete);
+    
+    // 清除用户的对话上下文（删除账户时调用）
+    void ClearContext(uint8_t userID);
     
     // 检查服务是否已配置
     bool IsConfigured() const;
     
+    // 回复缓存（用于导出占用的内存和条目数）
+    AIResponseCache& Cache() { return cache_; }
+    
+    // 所有用户的对话上下文占用的内存（估算）
+    size_t ContextBytes() { return context_.Bytes(); }
+    
+    // 调度器（用于导出排队长度和等待时间）
+    const AIScheduler& Scheduler() const { return scheduler_; }
+    
+    // 被熔断、暂停使用的端点数
+    size_t OpenEndpoints() const { return endpoints_.OpenCount(); }
+    
 private:
+    struct Request;   // 一次API调用（定义在aiService.cpp）
+    struct Transfer;  // 一次HTTP尝试（定义在aiService.cpp）
+    struct Flight;    // 一次正在进行的API调用及等待它的所有请求（定义在aiService.cpp）
+    
+    // API调用结束的内部回调：success为false时reply是给用户看的错误提示（不缓存）
+    using ResultCallback = std::function<void(const std::string& reply, bool success)>;
+    
     AIConfig config_;
     bool configured_;
+    void* multi_;                       // CURLM*，只由事件循环线程使用（唤醒除外）
+    void* share_;                       // CURLSH*，DNS缓存和TLS会话缓存（只在事件循环线程上使用，不需要加锁）
+    std::vector<void*> endpointHeaders_;  // curl_slist*，每个端点的HTTP头（认证头不同）
+    std::vector<void*> idleHandles_;    // 空闲的CURL*句柄（只由事件循环线程访问）
+    std::vector<Request*> running_;     // 已经开始的调用（只由事件循环线程访问，用于定时交出流式回复和对冲）
+    InstrumentedMutex pendingMutex_;    // 保护pending_
+    std::vector<Request*> pending_;     // 已提交、还没有交给调度器的请求
+    AIScheduler scheduler_;             // 只由事件循环线程使用（排队长度和等待时间除外）
+    AIEndpointPool endpoints_;          // 只由事件循环线程使用（断开的端点数除外）
+    AIResponseCache cache_;
+    AIContextStore context_;
+    // 正在进行的API调用（键为缓存键）；锁顺序：flightMutex_在g_sessionMutex之前（持有它时会把段发给用户）
+    InstrumentedMutex flightMutex_;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;
+    
+    // 把HTTP请求交给事件循环线程（经过调度器排队）
+    // 参数：userID - 按这个用户排队，tokens - 估算这次调用消耗的token数（用于token速率限制）
+    void SubmitHttpRequest(uint8_t userID, uint32_t tokens, const std::string& postData, AIQueuedCallback onQueued, AIPartialCallback onPartial, ResultCallback onComplete);
     
-    // 发送HTTP请求的辅助函数
-    std::string SendHttpRequest(const std::string& url, const std::string& postData);
+    // API调用结束：缓存成功的回复，把结果交给等待这次调用的所有请求
+    void CompleteFlight(const std::string& key, const std::shared_ptr<Flight>& flight,
+                        const std::string& reply, bool success);
     
-    // 构造AI API请求的JSON
-    std::string BuildRequestJSON(const std::string& userMessage);
+    // 事件循环：把新请求交给调度器、推进所有传输、处理完成的传输、从调度器取出可以开始的请求
+    void EventLoop();
     
-    // 解析AI API响应的JSON
+    // 开始调度器允许开始的请求，返回到令牌够用还要等待的毫秒数（-1表示不需要按时间醒来）
+    long AdmitRequests();
+    
+    // 为调用选一个端点并发出第一次尝试（没有可用的端点时立即失败）
+    void StartRequest(Request* request);
+    
+    // 向指定端点发出一次尝试（attempt为Pick分配的尝试编号，hedge表示对冲请求），失败时返回false
+    bool StartAttempt(Request* request, int endpoint, uint64_t attempt, bool hedge);
+    
+    // 取消一次尝试（对冲中落败，或调用已经结束）
+    void CancelAttempt(Transfer* transfer);
+    
+    // 对到了对冲时间还没有数据的调用发出对冲请求，返回到下一个对冲时间的毫秒数（-1表示没有）
+    long CheckHedges();
+    
+    // 从池中取一个句柄（没有空闲的就新建），设置这次请求的选项并加入multi句柄
+    bool StartTransfer(Transfer* transfer);
+    
+    // 把句柄放回池中（连接留在multi句柄的连接缓存里）
+    void ReleaseHandle(void* curl);
+    
+    // 把流式传输中攒下的文本交出（force为false时距上次交出不足AI_STREAM_FLUSH_MS则跳过）
+    void FlushPartial(Request* request, bool force);
+    
+    // curl接收数据的回调（userdata为Transfer*）
+    static size_t WriteCallback(char* ptr, size_t size, size_t nmemb, void* userdata);
+    
+    // 一次尝试结束：检查结果、记录端点的健康状况，成功或无法重试时结束调用
+    void FinishTransfer(Transfer* transfer, int result);
+    
+    // 调用结束：取消剩下的尝试，空出并发名额，调用完成回调并释放
+    void CompleteRequest(Request* request, const std::string& reply, bool success);
+    
+    // 把配置中的并发数和速率配额交给调度器
+    void ConfigureScheduler();
+    
+    // 构造AI API请求的JSON（单遍写出，见aiJson.h）
+    // 参数：summary - 较早对话的摘要（可以为空），turns - 窗口内的历史对话（从旧到新）
+    std::string BuildRequestJSON(const std::string& summary, const std::vector<AIContextTurn>& turns,
+                                 const std::string& userMessage);
+    
+    // 解析AI API响应的JSON（choices[0].message.content），没有文本时返回空字符串
     std::string ParseResponseJSON(const std::string& responseJson);
+    
+    // 解析流式响应中一个事件的JSON（choices[0].delta.content），没有文本时返回空字符串
+    static std::string ParseStreamDelta(const char* eventJson, size_t size);
 };
 
 // 全局AI服务实例
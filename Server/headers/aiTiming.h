@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "latency.h"
+#include "aiEndpoints.h"
+
+// AI请求的分阶段耗时：每次HTTP尝试结束时从curl读出各阶段的时间点，按端点（和模型）记入直方图
+// 用于区分慢在哪里：DNS、建立TCP连接、TLS握手属于我们到服务商的网络，首字节等待主要是服务商在排队和生成，
+// 传输是流式输出的生成速度（调度器排队时间见aiScheduler.h）
+// 复用连接的请求没有DNS、连接和TLS阶段，这三个阶段只在新建连接时记录
+
+// 阶段（各阶段首尾相接，不重叠）
+enum class AIPhase : uint8_t {
+    DNS = 0,       // 域名解析
+    CONNECT,       // TCP连接
+    TLS,           // TLS握手（HTTP端点没有）
+    FIRST_BYTE,    // 请求发出到收到响应的第一个字节（包括上传请求体）
+    TRANSFER,      // 第一个字节到传输结束
+    TOTAL,         // 整次尝试
+    COUNT
+};
+
+static const size_t AI_PHASE_COUNT = static_cast<size_t>(AIPhase::COUNT);
+
+// curl报告的一次尝试的时间点（从尝试开始算起的微秒数，没有经过的阶段为0）
+struct AITransferTimes {
+    int64_t nameLookupUs = 0;
+    int64_t connectUs = 0;
+    int64_t appConnectUs = 0;
+    int64_t preTransferUs = 0;
+    int64_t startTransferUs = 0;
+    int64_t totalUs = 0;
+    bool newConnection = false;   // 这次尝试新建了连接
+    bool warmup = false;          // 预热请求（只记录建立连接的阶段）
+};
+
+// 设置端点名（AI服务启动时调用一次，之后不再改变）
+void ConfigureAITimings(const std::vector<std::string>& endpointNames, const std::string& model);
+
+// 记录一次尝试的各阶段耗时
+void RecordAITransferTimes(size_t endpoint, const AITransferTimes& times);
+
+// 已配置的端点数、端点名和模型名
+size_t AITimingEndpoints();
+const std::string& AITimingEndpointName(size_t endpoint);
+const std::string& AITimingModel();
+
+// 汇总一个端点、一个阶段的直方图
+LatencySummary SummarizeAITiming(size_t endpoint, AIPhase phase);
+
+// 阶段名（用于显示和导出）
+const char* AIPhaseName(AIPhase phase);
+
+// Prometheus文本格式的分阶段耗时（summary类型，按端点、模型和阶段分标签）
+std::string RenderAITimingMetrics();
+
+// 文本格式的分阶段耗时表（每个端点一段，每段各阶段一行）
+std::string RenderAITimingTable();
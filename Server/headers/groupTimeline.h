@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include "userControl.h"
+#include "../chatMsg_server.hpp"
+
+// 群聊时间线：群消息只在群聊历史（historyStore）里保存一份，每个成员只记一个读游标
+// 成员在线时消息实时转发；离线时什么都不存，上线时从游标处把错过的消息从时间线里读出来补发
+// 这样群聊的离线存储只随消息数增长，而不是消息数×成员数
+class GroupTimeline {
+public:
+    // 上线时需要补发的一段消息（群聊历史中[fromSeq, toSeq)）
+    struct Backlog {
+        std::string groupName;
+        uint64_t fromSeq;
+        uint64_t toSeq;
+    };
+
+    // 打开游标文件（需要在历史消息存储打开之后调用）
+    bool Open(const std::string& path);
+
+    // 发布一条群消息：追加到群聊历史，并返回需要实时转发的在线成员（离线成员的游标保持不动）
+    bool Publish(const std::string& groupName, const Packet& packet, const std::vector<uint8_t>& memberList,
+                 uint8_t senderID, std::vector<uint8_t>& liveMembers);
+
+    // 成员上线：返回各群聊需要补发的区间，之后的新消息都走实时转发
+    std::vector<Backlog> MemberOnline(uint8_t userID, const std::vector<std::string>& groupNames);
+
+    // 成员下线：游标移到各群聊当前末尾（在线期间的消息已经实时转发过）
+    void MemberOffline(uint8_t userID);
+
+    // 补发中断：下次上线从failedSeq开始重新补发
+    void BacklogFailed(const std::string& groupName, uint8_t userID, uint64_t failedSeq);
+
+    // 删除成员的全部游标（删除用户时调用）
+    void DropMember(uint8_t userID);
+
+    // 游标有变化时写入文件（定时保存线程和关闭服务器时调用）
+    void Flush();
+
+private:
+    // 单个成员在某个群聊中的状态
+    struct MemberState {
+        uint64_t cursor = 0;                 // 离线时：下次上线从这里开始补发
+        uint64_t failedSeq = UINT64_MAX;     // 在线时补发中断的位置
+        bool live = false;                   // 是否正在实时接收
+    };
+
+    // 单个群聊的状态
+    struct GroupState {
+        uint64_t head = 0;                   // 群聊历史的消息总数
+        std::map<uint8_t, MemberState> members;
+        InstrumentedMutex mutex{"groupTimeline.group"};  // 保护本群聊状态，并保证追加历史与判断在线是原子的
+    };
+
+    std::shared_ptr<GroupState> GetGroup(const std::string& groupName);
+    MemberState& GetMember(GroupState& group, uint8_t userID);
+    void Save();
+
+    std::string path_;
+    std::atomic<bool> dirty_{false};    // 上下线只改内存并标记，由Flush定时写入
+    std::map<std::string, std::shared_ptr<GroupState>> groups_;
+    std::set<uint8_t> liveUsers_;   // 当前在线（已完成上线登记）的用户
+    InstrumentedMutex mutex_{"groupTimeline"};       // 保护groups_和liveUsers_（加锁顺序：先群聊的锁，后这把锁）
+    InstrumentedMutex saveMutex_{"groupTimeline.save"};  // 串行化游标文件的写入
+};
+
+// 全局群聊时间线实例
+extern GroupTimeline g_groupTimeline;
+
+// 初始化群聊时间线（在历史消息存储初始化之后调用）
+void InitializeGroupTimeline();
+
+// 把补发区间中的群消息推送给刚上线的用户（跳过用户自己发的消息）
+void SendGroupBacklog(uint8_t userID, ClientSession* session, const std::vector<GroupTimeline::Backlog>& backlog);
@@ -7,3 +7,6 @@
 // 客户端处理线程入口函数
 void HandleClient(ClientSession* sessionPtr);
 
+// 启动AI回复的发送线程（在AI服务初始化之前调用）
+void InitializeAIDelivery();
+
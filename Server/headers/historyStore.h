@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <winsock2.h>
+#include <windows.h>
+#include "../chatMsg_server.hpp"
+#include "lockStats.h"
+
+// 会话历史消息存储：每个会话（私聊双方或一个群聊）对应一个追加写的数据文件和一个定长索引文件
+// 索引文件的第n项就是序号为n的消息（数据位置、长度、时间戳），按游标翻页时只需要
+// 读page个索引项和一段连续的数据，耗时只与页大小有关，与会话的总消息数无关
+class HistoryStore {
+public:
+    // 读出的一条历史消息
+    struct Entry {
+        uint64_t seq;          // 会话内的消息序号（从0开始）
+        uint64_t timestampMs;  // 服务器收到消息的时间（Unix毫秒）
+        Packet packet;         // 原始消息
+    };
+
+    HistoryStore();
+    ~HistoryStore();
+
+    // 打开存储目录（会话文件在第一次访问时才打开）
+    bool Open(const std::string& directory);
+
+    // 记录一条聊天消息（私聊、群聊、图片），seqOut返回分配到的序号
+    bool Append(const Packet& packet, uint64_t* seqOut = nullptr);
+
+    // 会话当前的消息总数（也就是下一条消息的序号）
+    uint64_t Count(const std::string& key);
+
+    // 读取序号在[firstSeq, firstSeq + count)之间的消息，按序号从小到大追加到out
+    bool ReadRange(const std::string& key, uint64_t firstSeq, size_t count, std::vector<Entry>& out);
+
+    // 会话键：私聊按两个ID从小到大拼接，群聊按群名的十六进制编码（群名可能含有文件名不允许的字符）
+    static std::string PrivateKey(uint8_t userA, uint8_t userB);
+    static std::string GroupKey(const std::string& groupName);
+    static std::string KeyOf(const Packet& packet);  // 根据消息类型判断所属会话，不需要记录的消息返回空串
+
+private:
+    // 单个会话打开的文件
+    struct Conversation {
+        HANDLE dataFile = INVALID_HANDLE_VALUE;
+        HANDLE indexFile = INVALID_HANDLE_VALUE;
+        uint64_t count = 0;     // 已有消息数
+        uint64_t dataSize = 0;  // 数据文件有效长度
+        InstrumentedMutex mutex{"historyStore.conversation"};  // 保护本会话的文件读写
+        ~Conversation();
+    };
+
+    std::shared_ptr<Conversation> GetConversation(const std::string& key, bool create);
+
+    std::string directory_;
+    std::map<std::string, std::shared_ptr<Conversation>> conversations_;
+    bool opened_;
+    InstrumentedMutex mutex_{"historyStore"};  // 只保护conversations_，文件读写用各会话自己的锁
+};
+
+// 全局历史消息存储实例
+extern HistoryStore g_historyStore;
+
+// 初始化历史消息存储（在程序启动时调用）
+void InitializeHistoryStore();
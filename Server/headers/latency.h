@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../chatMsg_server.hpp"
+
+// 消息处理延迟直方图：按MsgType和处理阶段分别统计，用于查看每类消息从收到到发完花了多久、时间花在哪一段
+// 桶按对数划分（每个2的幂区间再均分16份，相对误差约6%），记录一次只是一次原子加法，可以在生产环境常开
+
+// 处理阶段（各阶段互不重叠，嵌套的阶段会暂停外层阶段的计时）
+enum class LatencyStage : uint8_t {
+    INGRESS = 0,   // 接收：select返回后读包头、包体并解析
+    DISPATCH,      // 分发：HandleClient中switch到各处理函数的逻辑（不含路由和写socket）
+    ROUTING,       // 路由：查在线状态、加会话锁、存离线消息、写群聊时间线
+    SOCKET_WRITE,  // 写socket：序列化并发送
+    TOTAL,         // 总计：从开始接收到处理完毕
+    COUNT
+};
+
+static const size_t LATENCY_SUB_BUCKETS = 16;                   // 每个2的幂区间的子桶数
+static const size_t LATENCY_MAX_EXPONENT = 36;                  // 最大记录约2^36纳秒（约69秒），更大的值记在最后一个桶
+static const size_t LATENCY_BUCKETS = (LATENCY_MAX_EXPONENT - 2) * LATENCY_SUB_BUCKETS;
+static const size_t LATENCY_TYPE_SLOTS = 32;                    // MsgType数值小于32的单独统计，其余记在0号
+
+// 对数分桶直方图（纳秒）
+class LatencyHistogram {
+public:
+    void Record(uint64_t ns);
+
+    // 读出所有桶的计数（并发写入时是近似快照）
+    void Snapshot(std::vector<uint64_t>& counts, uint64_t& total, uint64_t& maxNs) const;
+
+    static size_t BucketIndex(uint64_t ns);
+    static uint64_t BucketUpperBound(size_t index);  // 桶内最大值（报告分位数时使用）
+
+private:
+    std::atomic<uint64_t> buckets_[LATENCY_BUCKETS] = {};
+    std::atomic<uint64_t> max_{0};
+};
+
+// 一个直方图的汇总结果
+struct LatencySummary {
+    uint64_t count = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p99Ns = 0;
+    uint64_t p999Ns = 0;
+    uint64_t maxNs = 0;
+};
+
+// 记录一次延迟
+void RecordLatency(MsgType type, LatencyStage stage, uint64_t ns);
+
+// 汇总一个直方图（p50/p99/p999/最大值）
+LatencySummary SummarizeHistogram(const LatencyHistogram& histogram);
+
+// 汇总一个消息类型、一个阶段的直方图
+LatencySummary SummarizeLatency(uint8_t typeSlot, LatencyStage stage);
+
+// 阶段名（用于显示和导出）
+const char* LatencyStageName(LatencyStage stage);
+
+// 文本格式的延迟表（每个有记录的MsgType一段，每段各阶段一行）
+std::string RenderLatencyTable();
+
+// 当前线程正在处理的消息：HandleClient收到并解析完消息时开始（receiveStart到现在记为接收阶段），
+// 处理完毕时结束并记录各阶段耗时
+// 没有正在处理的消息时（例如AI回复线程）阶段计时器什么都不做
+void BeginPacketLatency(MsgType type, std::chrono::steady_clock::time_point receiveStart);
+void EndPacketLatency();
+
+// 阶段计时器：构造时开始计时并暂停外层阶段，析构时把耗时累加到当前消息，恢复外层阶段
+class LatencyStageTimer {
+public:
+    explicit LatencyStageTimer(LatencyStage stage);
+    ~LatencyStageTimer();
+    LatencyStageTimer(const LatencyStageTimer&) = delete;
+    LatencyStageTimer& operator=(const LatencyStageTimer&) = delete;
+
+private:
+    bool active_;
+    LatencyStage parent_;
+};
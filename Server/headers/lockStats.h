@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "latency.h"
+
+// 带统计的互斥锁：可以直接替换std::mutex（满足Lockable，可以配合lock_guard/unique_lock/condition_variable_any使用）
+// 统计每把锁的加锁次数、发生等待的次数、等待时间和持有时间直方图，以及等待最多的调用位置
+// 同名的锁（例如每个群聊各有一把的锁）共用一份统计
+// 没有竞争时只多两次取时间（用于持有时间）；发生竞争时才记录等待时间和调用位置
+// 调用位置由调用方显式传入（LOCK_SITE）：lock()被std::lock_guard等包装调用时，返回地址落在包装里而不是加锁的那一行
+
+static const size_t LOCK_CALL_SITES = 64;  // 每把锁最多记录的调用位置数（超出的单独计入<overflow>）
+
+// 加锁的源代码位置
+struct LockSite {
+    const char* file;
+    int line;
+};
+
+// 当前源代码位置：每处展开各有一个静态对象，调用位置表用它的地址区分不同的位置
+#define LOCK_SITE ([]() -> const LockSite* { static const LockSite site = {__FILE__, __LINE__}; return &site; }())
+
+// 没有传入调用位置的加锁（例如condition_variable_any等待结束后重新加锁）
+extern const LockSite UNSPECIFIED_LOCK_SITE;
+
+// 一个调用位置的等待统计
+struct LockCallSite {
+    std::atomic<const LockSite*> site{nullptr};
+    std::atomic<uint64_t> waits{0};
+    std::atomic<uint64_t> waitNs{0};
+};
+
+// 一把锁（或同名的一组锁）的统计
+struct LockStats {
+    std::string name;
+    std::string waitSpanName;  // 请求追踪中等锁区段的名字
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    LatencyHistogram waitHistogram;  // 只记录发生等待的加锁
+    LatencyHistogram holdHistogram;
+    LockCallSite callSites[LOCK_CALL_SITES];
+    LockCallSite overflowSite;  // 调用位置表满之后的等待（site始终为空）
+};
+
+class InstrumentedMutex {
+public:
+    explicit InstrumentedMutex(const char* name);
+    InstrumentedMutex(const InstrumentedMutex&) = delete;
+    InstrumentedMutex& operator=(const InstrumentedMutex&) = delete;
+
+    void lock() { lock(&UNSPECIFIED_LOCK_SITE); }
+    void lock(const LockSite* site);
+    bool try_lock();
+    void unlock();
+
+private:
+    void RecordWait(const LockSite* site, uint64_t waitNs);
+
+    std::mutex mutex_;
+    LockStats* stats_;
+    std::chrono::steady_clock::time_point acquiredAt_;  // 只由持有者读写
+};
+
+// 作用域锁（相当于std::lock_guard），加锁时记下调用位置：InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+// 需要配合条件变量时先mutex_.lock(LOCK_SITE)，再用std::unique_lock的adopt_lock接管
+class InstrumentedLockGuard {
+public:
+    InstrumentedLockGuard(InstrumentedMutex& mutex, const LockSite* site) : mutex_(mutex) { mutex_.lock(site); }
+    ~InstrumentedLockGuard() { mutex_.unlock(); }
+    InstrumentedLockGuard(const InstrumentedLockGuard&) = delete;
+    InstrumentedLockGuard& operator=(const InstrumentedLockGuard&) = delete;
+
+private:
+    InstrumentedMutex& mutex_;
+};
+
+// 一把锁统计的汇总结果
+struct LockSummary {
+    std::string name;
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0;
+    LatencySummary wait;
+    LatencySummary hold;
+    std::vector<std::pair<std::string, uint64_t>> topCallSites;  // 调用位置（文件名:行号）-> 等待总时间（纳秒）
+};
+
+// 汇总所有锁的统计（按等待总次数排序）
+std::vector<LockSummary> SummarizeLocks(size_t topCallSites);
+
+// Prometheus格式的锁指标（附加在/metrics后面）
+std::string RenderLockMetrics();
+
+// 文本格式的锁统计表（包括等待最多的调用位置）
+std::string RenderLockTable();
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "logFormat.h"
+
+// 日志归档：关闭的日志段（log/YYYYMMDD_NNN.blog）在后台压缩为<段名>.blog.zst，并生成稀疏索引<段名>.blog.idx
+// 压缩时按记录边界把日志切成约1MB的块，每块单独压缩为一个zstd帧（整个文件仍然是合法的zstd流，可以直接用zstd命令解压）
+// 索引中每个帧一项：时间范围、压缩位置、以及帧中出现过的用户ID位图
+// 查询时先读索引，只解压时间范围和用户都可能匹配的帧
+// 第0帧只包含文件头和格式定义，查询任何帧之前先解压它取得格式表
+
+static const char BLOG_INDEX_MAGIC[4] = {'B', 'L', 'G', 'I'};
+static const uint32_t BLOG_INDEX_VERSION = 1;
+static const size_t BLOG_FRAME_SIZE = 1024 * 1024;  // 每个压缩帧的目标原始大小
+
+#pragma pack(push,1)
+// 索引文件头
+struct BlogIndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t frameCount;
+    uint32_t reserved;
+};
+
+// 每个压缩帧的索引项
+struct BlogFrameIndex {
+    uint64_t firstTimeUs;       // 帧中最早的记录时间
+    uint64_t lastTimeUs;        // 帧中最晚的记录时间
+    uint64_t compressedOffset;  // 帧在.zst文件中的位置
+    uint32_t compressedSize;
+    uint32_t rawSize;           // 解压后的大小
+    uint8_t users[32];          // 帧中出现过的用户ID（256位位图）
+};
+#pragma pack(pop)
+
+inline bool FrameHasUser(const BlogFrameIndex& frame, uint8_t userID) {
+    return (frame.users[userID >> 3] >> (userID & 7)) & 1;
+}
+
+// 压缩一个已关闭的日志段：生成.blog.zst和.blog.idx后删除原文件
+bool CompressLogSegment(const std::string& path, std::string& error);
+
+// 读取索引文件
+bool ReadLogIndex(const std::string& indexPath, std::vector<BlogFrameIndex>& frames, std::string& error);
+
+// 从.zst文件中解压一个帧
+bool ReadLogFrame(const std::string& archivePath, const BlogFrameIndex& frame, std::vector<char>& out, std::string& error);
@@ -0,0 +1,226 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <algorithm>
+
+// 二进制日志（.blog）格式：服务器只记录格式ID和原始参数，文本只在Monitor显示或用logdecode转换时才生成
+//
+// 文件 = 文件头 + 记录序列
+// 记录 = BlogRecordHeader + 参数区；参数区依次存放每个参数：1字节类型 + 内容
+//   LOG_ARG_INT/LOG_ARG_UINT：8字节整数
+//   LOG_ARG_STR：2字节长度 + 字节内容
+//   LOG_ARG_STR_CUT：同LOG_ARG_STR，表示字符串被截断过（显示时末尾加“…”）
+// 参数区放不下的参数连同其后的所有参数都不写入，显示时对应的{}替换为“<缺失>”
+// 每次打开日志文件时先写入一组格式定义记录（格式ID为LOG_FORMAT_DEFINE，参数为ID、格式串和用户ID参数掩码），
+// 所以旧的日志文件在格式表变化之后仍然能被正确解码
+
+// 日志格式ID（只能在末尾追加，不能修改已有项的含义）
+// 格式串中的{}按顺序替换为参数
+enum class LogFmt : uint16_t {
+    TEXT = 0,                   // 预先拼好的文本（普通WriteLog调用）
+    FORWARD_NO_RECEIVER,        // 发送者, 消息类型
+    FORWARD_SAVED_OFFLINE,      // 发送者, 消息类型, 接收者
+    FORWARD_DONE,               // 发送者, 消息类型, 接收者
+    FORWARD_RACE_OFFLINE,       // 接收者
+    GROUP_MEMBERS_OFFLINE,      // 群名, 离线人数
+    LOGIN_REQUEST,              // 用户
+    LOGIN_SUCCESS,              // 用户
+    LOGIN_FAILED,               // 用户
+    SIGNUP_REQUEST,             // 用户
+    CREATE_GROUP_REQUEST,       // 用户
+    CREATE_GROUP_DONE,          // 群名
+    GROUP_MSG_RECEIVED,         // 发送者, 群名
+    GROUP_NOT_FOUND,            // 群名, 发送者
+    QUERY_USER_MISSING,
+    HISTORY_NOT_MEMBER,         // 用户, 群名
+    HISTORY_QUERY,              // 用户, 会话, 条数
+    AI_REQUEST,                 // 用户
+    AI_REPLY_SENT,              // 用户
+    SIGNUP_DONE,                // 用户
+    SIGNUP_EXISTS,              // 用户
+    GROUP_EXISTS,
+    OFFLINE_PUSH_BEGIN,         // 用户, 条数
+    OFFLINE_PUSH_INTERRUPTED,   // 已发送, 剩余
+    OFFLINE_PUSH_DONE,          // 条数
+    SET_NAME_DONE,              // 用户, 新用户名
+    SET_NAME_MISSING,
+    BACKLOG_INTERRUPTED,        // 用户, 群名
+    BACKLOG_DONE,               // 用户, 条数
+    SENDER_MISMATCH,            // 会话用户, 消息类型, 包头发送者
+    OFFLINE_USER_REQUEST,       // 消息类型, 用户
+    HISTORY_BAD_REQUEST,        // 用户
+    AI_REPLY_FAILED,            // 用户
+    AI_USER_QUEUE_FULL,         // 用户
+    MONITOR_FORCE_DISCONNECT,   // 用户
+    MONITOR_DELETE_USER,        // 用户
+    FORCE_DISCONNECT,           // 用户
+    USER_DELETED,               // 用户
+    USER_DELETE_NOT_DURABLE,    // 用户
+    SIGNUP_NOT_DURABLE,         // 用户
+    SET_NAME_NOT_DURABLE,       // 用户
+    OFFLINE_SAVE_FAILED,        // 接收者
+    CREATE_GROUP_NOT_DURABLE,   // 群名
+    COUNT
+};
+
+static const uint16_t LOG_FORMAT_DEFINE = 0xFFFF;  // 格式定义记录
+static const char BLOG_MAGIC[4] = {'B', 'L', 'O', 'G'};
+static const uint32_t BLOG_VERSION = 1;
+
+// 参数类型
+static const uint8_t LOG_ARG_INT = 1;
+static const uint8_t LOG_ARG_UINT = 2;
+static const uint8_t LOG_ARG_STR = 3;
+static const uint8_t LOG_ARG_STR_CUT = 4;
+
+// 结构化日志中单个字符串参数的上限：超出的截断，保证一个长字符串不会挤掉后面的整数参数
+static const size_t LOG_ARG_STRING_MAX = 48;
+
+#pragma pack(push,1)
+// 文件头（只在新文件开头写一次）
+struct BlogFileHeader {
+    char magic[4];
+    uint32_t version;
+};
+
+// 记录头
+struct BlogRecordHeader {
+    uint16_t length;    // 整条记录长度（含记录头）
+    uint16_t format;    // 格式ID
+    uint8_t level;      // LogLevel
+    uint8_t reserved;
+    uint64_t timeUs;    // Unix微秒
+};
+#pragma pack(pop)
+
+// 解析出的一条记录（参数区指向原数据，不复制）
+struct BlogRecordView {
+    uint16_t format;
+    uint8_t level;
+    uint64_t timeUs;
+    const char* args;
+    size_t argsSize;
+};
+
+// 解析出的一个参数
+struct LogArgValue {
+    uint8_t tag;
+    uint64_t integer = 0;        // LOG_ARG_INT/LOG_ARG_UINT
+    const char* str = nullptr;   // LOG_ARG_STR
+    uint16_t length = 0;
+};
+
+// 参数编码器：写入调用方提供的定长缓冲区
+// 字符串超过maxLength或剩余空间时截断（按UTF-8字符边界）并标记为LOG_ARG_STR_CUT；
+// 连类型和长度都放不下的参数不写入，之后的参数也都不再写入，解码时显示为缺失，而不是让后面的参数错位
+class LogArgWriter {
+public:
+    LogArgWriter(char* buffer, size_t capacity) : buffer_(buffer), capacity_(capacity), size_(0), full_(false) {}
+
+    void PutInt(int64_t value) { PutInteger(LOG_ARG_INT, static_cast<uint64_t>(value)); }
+    void PutUInt(uint64_t value) { PutInteger(LOG_ARG_UINT, value); }
+
+    void PutString(const char* data, size_t length, size_t maxLength = UINT16_MAX) {
+        if (full_ || size_ + 3 > capacity_) {
+            full_ = true;
+            return;
+        }
+        size_t room = std::min<size_t>({capacity_ - size_ - 3, maxLength, UINT16_MAX});
+        bool cut = length > room;
+        if (cut) {
+            length = room;
+            while (length > 0 && (static_cast<uint8_t>(data[length]) & 0xC0) == 0x80) {
+                --length;  // 不把多字节字符截成两半
+            }
+        }
+        uint16_t length16 = static_cast<uint16_t>(length);
+        buffer_[size_++] = static_cast<char>(cut ? LOG_ARG_STR_CUT : LOG_ARG_STR);
+        memcpy(buffer_ + size_, &length16, sizeof(length16));
+        size_ += sizeof(length16);
+        memcpy(buffer_ + size_, data, length16);
+        size_ += length16;
+    }
+
+    size_t Size() const { return size_; }
+
+private:
+    void PutInteger(uint8_t tag, uint64_t value) {
+        if (full_ || size_ + 1 + sizeof(value) > capacity_) {
+            full_ = true;
+            return;
+        }
+        buffer_[size_++] = static_cast<char>(tag);
+        memcpy(buffer_ + size_, &value, sizeof(value));
+        size_ += sizeof(value);
+    }
+
+    char* buffer_;
+    size_t capacity_;
+    size_t size_;
+    bool full_;     // 已有参数放不下
+};
+
+// 各种参数类型的编码
+template <typename T>
+inline typename std::enable_if<std::is_integral<T>::value>::type EncodeLogArg(LogArgWriter& writer, T value) {
+    if (std::is_signed<T>::value) {
+        writer.PutInt(static_cast<int64_t>(value));
+    } else {
+        writer.PutUInt(static_cast<uint64_t>(value));
+    }
+}
+template <typename T>
+inline typename std::enable_if<std::is_enum<T>::value>::type EncodeLogArg(LogArgWriter& writer, T value) {
+    writer.PutUInt(static_cast<uint64_t>(value));
+}
+inline void EncodeLogArg(LogArgWriter& writer, const std::string& value) {
+    writer.PutString(value.data(), value.size(), LOG_ARG_STRING_MAX);
+}
+inline void EncodeLogArg(LogArgWriter& writer, const char* value) {
+    writer.PutString(value, strlen(value), LOG_ARG_STRING_MAX);
+}
+
+inline void EncodeLogArgs(LogArgWriter&) {
+}
+template <typename First, typename... Rest>
+inline void EncodeLogArgs(LogArgWriter& writer, const First& first, const Rest&... rest) {
+    EncodeLogArg(writer, first);
+    EncodeLogArgs(writer, rest...);
+}
+
+// 格式ID对应的格式串（未知ID返回nullptr）
+const char* LogFormatString(uint16_t format);
+
+// 格式ID的用户ID参数掩码（第n位为1表示第n个参数是用户ID）
+uint8_t LogFormatUserArgs(uint16_t format);
+
+// 日志级别名称（LogLevel的数值）
+const char* LogLevelName(uint8_t level);
+
+// 从data中解析一条记录，size是data剩余的字节数；成功时recordSize返回这条记录的长度
+bool ParseBlogRecord(const char* data, size_t size, BlogRecordView& record, size_t& recordSize);
+
+// 读取下一个参数，参数区结束或损坏时返回false
+bool NextLogArg(const char*& args, const char* end, LogArgValue& value);
+
+// 按掩码取出记录中的用户ID，返回个数
+size_t ExtractLogUsers(const BlogRecordView& record, uint8_t userArgs, uint8_t* users, size_t maxUsers);
+
+// 解析格式定义记录（格式ID、格式串、用户ID参数掩码）
+bool ParseLogDefinition(const BlogRecordView& record, uint16_t& format, std::string& text, uint8_t& userArgs);
+
+// 按格式串把参数区格式化为文本
+std::string FormatLogArgs(const char* format, const char* args, size_t argsSize);
+
+// 格式化整条记录："[时间][级别]内容"，withLevel为false时为"[时间] 内容"
+// format为nullptr时使用本程序编译时的格式表
+std::string FormatBlogRecord(const BlogRecordView& record, bool withLevel, const char* format = nullptr);
+
+// 追加一条记录的编码（参数区已经编码好）
+void AppendBlogRecord(std::string& out, uint16_t format, uint8_t level, uint64_t timeUs,
+                      const char* args, size_t argsSize);
+
+// 追加全部格式定义记录（每次打开日志文件时写入）
+void AppendBlogDefinitions(std::string& out, uint64_t timeUs);
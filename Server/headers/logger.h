@@ -1,8 +1,10 @@
 #pragma once
 #include <string>
-#include <fstream>
 #include <vector>
-#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include "logFormat.h"
 
 // 日志级别枚举
 
@@ -15,24 +17,76 @@ enum class LogLevel {
     CONNECTION, // 客户端连接有关
 };
 
-// 全局日志文件句柄
-extern std::ofstream logFile;
+// 日志刷盘策略（后台写线程每批写完之后）
+enum class LogFsyncPolicy {
+    NONE,       // 只写入系统缓存，由系统决定何时落盘
+    INTERVAL,   // 距上次刷盘超过指定间隔才刷盘（默认，间隔1秒）
+    EVERY_BATCH // 每批都刷盘
+};
+
+// 异步日志：WriteLog只把记录放进当前线程自己的无锁环形队列（单生产者单消费者），
+// 由后台写线程统一取出、按时间排序，编码为二进制日志（.blog，见logFormat.h）后整批写入日志文件，
+// 并在写线程里更新供Monitor显示的UI缓冲区。转发路径上不再有格式化、文件写入和刷盘
+// 日志按天和大小分段（log/YYYYMMDD_NNN.blog），关闭的段由后台线程压缩归档（见logArchive.h），可用logquery按时间和用户查询
+// 转发路径上的日志用WriteLogFmt，只记录格式ID和原始参数，连字符串拼接也省掉；文本由Monitor或logdecode生成
+
+// 供Monitor显示的定长环形日志缓冲区：只有后台写线程写入，Monitor无锁读取
+// 槽位中保存的是编码后的.blog记录，Monitor用FormatBlogRecord格式化
+// 每条记录带递增的序号，Monitor记住上一帧读到的序号，每帧只复制新增的记录；写满后直接覆盖最旧的槽位，不移动内存
+// 每个槽位有自己的版本号（seqlock）：读之前和读之后版本号一致才说明读到的内容没有被覆盖
+class UILogRing {
+public:
+    static const size_t RECORD_CAPACITY = 512;  // 单条记录的最大长度，文本日志超出部分截断
+
+    explicit UILogRing(size_t capacity);
+
+    // 追加一条记录（只在后台写线程中调用）
+    void Push(const char* data, size_t size);
 
+    // 读出序号不小于fromSeq的所有记录，返回下一次应该传入的序号
+    // 已被覆盖的记录会被跳过（读取太慢时只能看到最近capacity条）
+    uint64_t ReadSince(uint64_t fromSeq, std::vector<std::string>& out) const;
 
+    size_t Capacity() const { return capacity_; }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> version{0};  // 2*seq+1：正在写入序号为seq的记录；2*seq+2：写入完成
+        uint16_t length = 0;
+        char data[RECORD_CAPACITY];
+    };
+
+    size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t> head_{0};  // 下一条记录的序号
+};
 
 // UI日志缓冲区（供Monitor显示）
-extern std::vector<std::string> g_forwardMsgBuffer;
-extern std::vector<std::string> g_requestMsgBuffer;
-extern std::vector<std::string> g_uiLogBuffer;
-extern std::mutex g_forwardMsgMutex;
-extern std::mutex g_requestMsgMutex;
-extern std::mutex g_uiLogMutex;
+extern UILogRing g_forwardMsgRing;   // 转发消息
+extern UILogRing g_requestMsgRing;   // 请求消息
+extern UILogRing g_uiLogRing;        // 其他日志
 
 // 函数声明
 std::string TimeStamp();                          // 获取时间戳
-std::string FileNameGen();                        // 生成日志文件名
 std::string LevelToString(LogLevel level);        // 日志级别转字符串
-void InitializeLogFile();                         // 初始化日志文件
+void InitializeLogFile();                         // 打开新的日志段并启动后台写线程和压缩线程
+void SetLogFsyncPolicy(LogFsyncPolicy policy, int intervalMs = 1000);  // 设置刷盘策略
+bool ParseLogFsyncPolicy(const std::string& text, LogFsyncPolicy& policy, int& intervalMs);  // 解析命令行的刷盘策略（none、batch或间隔毫秒数）
 void WriteLog(LogLevel level, const std::string& message);  // 写入日志
+void WriteLog(LogLevel level, std::string&& message);       // 写入日志（直接接管临时字符串，省去一次拷贝）
+void WriteLogEncoded(LogLevel level, LogFmt format, const char* args, size_t argsSize);  // 写入已编码参数的结构化日志
 void DebugWriteLog(LogLevel level, const std::string& message); // 调试模式日志
-void CloseLogFile();                              // 关闭日志文件
+void CloseLogFile();                              // 写完队列中剩余的日志并关闭日志文件
+uint64_t GetDroppedLogCount();                    // 队列满而丢弃的日志记录数（累计）
+
+// 结构化日志的参数区上限（字符串参数另有LOG_ARG_STRING_MAX的上限，放不下的参数解码时显示为缺失）
+static const size_t LOG_INLINE_ARGS = 128;
+
+// 写入结构化日志：只在栈上编码格式ID和参数（整数、字符串），不做任何格式化和内存分配
+template <typename... Args>
+inline void WriteLogFmt(LogLevel level, LogFmt format, const Args&... args) {
+    char buffer[LOG_INLINE_ARGS];
+    LogArgWriter writer(buffer, sizeof(buffer));
+    EncodeLogArgs(writer, args...);
+    WriteLogEncoded(level, format, buffer, writer.Size());
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <functional>
+
+// 指标注册表：计数器和仪表的值按线程分片保存，每个线程只写自己的分片（不加锁、不抢缓存行），
+// 抓取时把所有分片加起来；线程退出时把分片中的值并入公共的退役分片，不会丢失
+// 指标以Prometheus文本格式通过内置的HTTP端点（GET /metrics）输出，服务器不需要图形界面也能被监控
+// 同一个端点的GET /latency输出消息处理延迟表（见latency.h），GET /locks输出锁统计（见lockStats.h），
+// GET /ai输出AI请求的分阶段耗时（见aiTiming.h），
+// GET /trace导出请求追踪（见trace.h）
+
+// 计数器（只增不减），可以带一个标签维度，标签值在注册时固定，按下标累加
+class Counter {
+public:
+    Counter(const char* name, const char* help, const char* labelName = nullptr,
+            std::vector<std::string> labelValues = {});
+    void Inc(uint64_t value = 1, size_t label = 0);
+    uint64_t Value(size_t label = 0) const;  // 当前值（汇总所有分片）
+    uint64_t Total() const;                  // 所有标签值之和
+
+private:
+    size_t base_;     // 在分片中的第一个槽位
+    size_t labels_;   // 标签值个数（无标签时为1）
+};
+
+// 仪表（可增可减），同样按线程分片：连接在一个线程建立、在另一个线程断开也能正确加减
+class Gauge {
+public:
+    Gauge(const char* name, const char* help);
+    void Add(int64_t value = 1);
+    void Sub(int64_t value = 1) { Add(-value); }
+    int64_t Value() const;
+
+private:
+    size_t slot_;
+};
+
+// 注册一个抓取时才计算的仪表（例如队列长度这类已经由其他模块维护的数值）
+void RegisterGaugeCallback(const char* name, const char* help, std::function<double()> read);
+// 同上，输出为计数器（值由调用方保证只增不减）
+void RegisterCounterCallback(const char* name, const char* help, std::function<double()> read);
+
+// 以MsgType的数值为下标的标签值（未定义的类型为空串，只在计数不为0时输出）
+std::vector<std::string> MsgTypeLabelValues();
+
+// 生成Prometheus文本格式的全部指标
+std::string RenderMetrics();
+
+// 在指定端口启动指标HTTP端点（后台线程）
+// 默认只监听127.0.0.1，publicBind为true时监听所有网卡；
+// allowTraceControl为true时允许本机的请求通过/trace?sample=N修改采样率（其他地址的请求始终只能读取）
+bool StartMetricsServer(int port, bool publicBind = false, bool allowTraceControl = false);
+
+// 服务器各模块使用的指标
+extern Counter g_metricConnections;        // 接受的连接数
+extern Gauge g_metricActiveConnections;    // 当前连接数
+extern Counter g_metricLogins;             // 登录次数（按结果）
+extern Counter g_metricMessagesReceived;   // 收到的消息（按MsgType）
+extern Counter g_metricMessagesForwarded;  // 实时转发的消息（按MsgType）
+extern Counter g_metricMessagesOffline;    // 存为离线的消息（按MsgType）
+extern Counter g_metricBytesReceived;      // 接收字节数
+extern Counter g_metricBytesSent;          // 发送字节数
+extern Counter g_metricAIRequests;         // AI请求（按结果）
+extern Gauge g_metricAIInFlight;           // 正在进行的AI请求
+extern Counter g_metricAICache;            // AI请求的缓存结果（命中、未命中、合并到正在进行的请求）
+extern Counter g_metricAIScheduled;        // 交给调度器的AI调用（直接开始、排队、排队已满被拒绝）
+extern Counter g_metricAIHedges;           // 发往另一个端点的对冲请求（发出、胜出）
+
+// 登录和AI请求的结果标签下标
+static const size_t METRIC_RESULT_SUCCESS = 0;
+static const size_t METRIC_RESULT_FAILURE = 1;
+
+// AI缓存结果的标签下标（命中率 = hit / (hit + miss + coalesced)）
+static const size_t METRIC_CACHE_HIT = 0;
+static const size_t METRIC_CACHE_MISS = 1;
+static const size_t METRIC_CACHE_COALESCED = 2;
+
+// AI调度结果的标签下标
+static const size_t METRIC_SCHEDULE_IMMEDIATE = 0;
+static const size_t METRIC_SCHEDULE_QUEUED = 1;
+static const size_t METRIC_SCHEDULE_REJECTED = 2;
+
+// AI对冲请求的标签下标（won / sent 是对冲的命中率）
+static const size_t METRIC_HEDGE_SENT = 0;
+static const size_t METRIC_HEDGE_WON = 1;
@@ -2,5 +2,6 @@
 
 #include <string>
 
-// UI监视窗口入口函数（在独立线程中调用）
+// UI监视窗口入口函数（在服务器的独立线程中调用，或者由独立的monitor进程调用）
+// 显示的数据全部来自服务器发布的状态共享内存（见statsSegment.h）
 void RunMonitorUI();
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+struct StatsSnapshot;
+
+static const size_t LOCAL_LOG_LINES = 100000;  // 每个日志面板本地最多保留的行数（绘制时只提交可见的行）
+
+// 监视窗口的各个面板（与窗口和图形后端无关），只能在UI线程调用
+// monitor.cpp在每帧的ImGui::NewFrame和ImGui::Render之间调用DrawMonitorWindow；monitorbench不创建窗口，直接调用
+
+// 每SNAPSHOT_REFRESH_MS读取一次服务器发布的快照，并转换为各面板使用的数据
+void RefreshMonitorSnapshot();
+
+// 把一份快照转换为各面板使用的数据：用户和群聊列表只在变化计数改变时重建，日志只追加新增的行
+void ApplyMonitorSnapshot(const StatsSnapshot& snapshot, std::chrono::steady_clock::time_point now);
+
+// 在当前ImGui帧中绘制整个监视窗口（铺满io.DisplaySize）
+void DrawMonitorWindow();
+
+// 最近一帧构建界面的耗时（显示在统计面板中）
+void SetMonitorBuildTime(double ms);
@@ -0,0 +1,120 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <winsock2.h>
+#include <windows.h>
+#include "../chatMsg_server.hpp"
+#include "lockStats.h"
+
+// 离线消息落盘存储：分段的追加写日志文件 + 每个用户一份紧凑的偏移索引
+// 消息本体按网络格式保存在磁盘上，推送时通过内存映射直接交给WSASend，内存里只保留索引
+// 每个用户的投递游标单独保存在cursors.dat中，所以服务器重启后未推送的消息不会丢失
+// 旧段中还没推送的消息占比很低时（例如某个用户一直不上线），把这些消息复制到活动段后删除旧段，
+// 一个不上线的用户不会让整串段文件一直留在磁盘上
+// 压缩、删除旧段和保存游标都在后台维护线程中进行，推送路径上只更新内存中的索引和计数；
+// 游标每OFFLINE_CHECKPOINT_MS保存一次，崩溃时最后这段时间推送过的消息下次上线会再推送一遍（不会丢）
+class OfflineStore {
+public:
+    OfflineStore();
+    ~OfflineStore();
+
+    // 打开存储目录并扫描已有的日志段，恢复每个用户的索引，启动后台维护线程
+    bool Open(const std::string& directory);
+
+    // 停止后台维护线程（退出前保存一次游标）
+    void Close();
+
+    // 追加一条离线消息（写入当前活动段并登记索引）
+    bool Append(uint8_t userID, const Packet& packet);
+
+    // 查询用户还有多少条待推送的离线消息
+    size_t PendingCount(uint8_t userID);
+
+    // 所有用户待推送的离线消息总数
+    size_t TotalPending();
+
+    // 把用户的离线消息批量推送到socket
+    // 返回值：本次成功推送的条数；complete为false表示中途发送失败，剩余消息留到下次上线
+    size_t Deliver(uint8_t userID, SOCKET sock, bool& complete);
+
+    // 丢弃用户的全部离线消息（删除用户时调用）
+    void DropUser(uint8_t userID);
+
+private:
+    // 索引项：一条消息在哪个段的什么位置（只记录帧本身，不含记录头）
+    struct IndexEntry {
+        uint32_t segment;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // 单个用户的索引和游标
+    struct UserIndex {
+        std::deque<IndexEntry> entries;  // 待推送消息，按序号递增
+        uint64_t cursor = 0;             // 投递游标：序号小于它的消息都已推送
+        uint64_t nextSeq = 0;            // 下一条消息的序号
+    };
+
+    // 段文件的只读内存映射（推送时可能还在被WSASend使用，用shared_ptr管理生命周期）
+    struct SegmentView {
+        HANDLE mapping = nullptr;
+        const char* data = nullptr;
+        uint64_t size = 0;
+        ~SegmentView();
+    };
+
+    // 段文件信息
+    struct Segment {
+        HANDLE file = INVALID_HANDLE_VALUE;
+        uint64_t size = 0;               // 已写入的字节数
+        uint32_t liveCount = 0;          // 还未推送的消息条数，降到0就可以压缩（删除）
+        uint64_t liveBytes = 0;          // 还未推送的消息占用的字节数（含记录头），占比很低时复制出来后删除
+        bool deletePending = false;      // 文件删除失败：留在索引里，后台线程稍后重试
+        std::shared_ptr<SegmentView> view;
+    };
+
+    std::string SegmentPath(uint32_t segmentID) const;
+    bool OpenActiveSegment(uint32_t segmentID);
+    // 扫描时收集到的一条消息（各段扫描完后按序号排序，压缩搬过的消息可能出现在更新的段里）
+    struct ScannedEntry {
+        uint64_t seq;
+        IndexEntry entry;
+    };
+
+    void ScanSegment(uint32_t segmentID, Segment& segment, const uint64_t* cursors,
+                     std::map<uint8_t, std::vector<ScannedEntry>>& scanned);
+    bool WriteRecord(std::vector<char>& record, uint32_t& segmentID, uint64_t& offset);
+    void MaybeCompactSegment(uint32_t segmentID);
+    bool CompactSegmentStep(uint32_t segmentID, uint8_t& nextUser, size_t& moved);
+    std::shared_ptr<SegmentView> MapSegment(uint32_t segmentID, uint64_t requiredSize);
+    void ReleaseEntry(const IndexEntry& entry);
+    void RemoveSegment(uint32_t segmentID);
+    void MaintenanceThread();
+    bool WriteCursors(const uint64_t* cursors);
+
+    std::string directory_;
+    std::map<uint32_t, Segment> segments_;  // 段编号 -> 段信息
+    std::map<uint8_t, UserIndex> users_;    // 用户ID -> 索引
+    uint32_t activeSegment_;                // 当前追加写入的段编号
+    std::set<uint32_t> compactQueue_;       // 等待后台线程压缩或删除的旧段
+    bool cursorsDirty_;                     // 游标有变化还没保存
+    bool opened_;
+    bool stopping_;
+    InstrumentedMutex mutex_{"offlineStore"};  // 保护以上所有成员（与g_sessionMutex无关）
+    std::condition_variable_any maintenanceCv_;  // 有段等待压缩或需要停止
+    std::thread maintenanceThread_;
+};
+
+// 全局离线消息存储实例
+extern OfflineStore g_offlineStore;
+
+// 初始化离线消息存储（在程序启动时调用）
+void InitializeOfflineStore();
@@ -1,5 +1,7 @@
 #pragma once
+#include <memory>
 #include <string>
+#include <vector>
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include "../chatMsg_server.hpp"
@@ -12,6 +14,19 @@ void CleanupWinSock();       // 清理WinSock
 std::string GetServerIP();   // 获取本机IP地址
 int SetupServerAddress(const int port, sockaddr_in& address_info); // 配置服务器地址
 
-// 数据包收发函数
+// 数据包序列化（按网络格式追加到缓冲区末尾，发送和落盘共用同一种格式）
+void SerializePacket(const Packet& packet, std::vector<char>& out);
+
+// 连接的发送通道：同一个socket上的发送互斥，多个线程写同一个连接时帧不会交错
+// 其他线程可以在g_sessionMutex内取得会话的通道、解锁后再发送，不必持有会话锁等待慢的客户端；
+// 连接关闭后通道标记为关闭，之后的发送直接失败，不会写到复用了同一句柄的新连接
+struct SendChannel;
+std::shared_ptr<SendChannel> OpenSendChannel(SOCKET sock);           // 接受连接后调用
+void CloseSendChannel(const std::shared_ptr<SendChannel>& channel); // 关闭socket前调用（先shutdown）
+
+// 数据包收发函数（按socket发送时使用它打开着的通道）
 bool RecvPacket(SOCKET sock, Packet& packet);       // 接收数据包
 bool SendPacket(SOCKET sock, const Packet& packet); // 发送数据包
+bool SendPacket(const std::shared_ptr<SendChannel>& channel, const Packet& packet); // 通过通道发送（已关闭时返回false）
+size_t SendBuffers(SOCKET sock, std::vector<WSABUF>& buffers); // 聚合写出多段缓冲区（返回实际发送字节数）
+size_t SendPacketBatch(SOCKET sock, const std::vector<Packet>& packets); // 批量发送数据包（返回完整发出的帧数）
@@ -0,0 +1,5 @@
+#pragma once
+
+// 状态发布线程：每100毫秒把服务器状态写入共享内存段（见statsSegment.h），并执行监视窗口提交的命令
+// 只在发布时短暂持有一次g_sessionMutex，监视窗口刷新多快都不会再和消息转发抢锁
+void InitializeStatsPublisher();
@@ -0,0 +1,182 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <winsock2.h>
+#include <windows.h>
+
+// 状态共享内存段：服务器定时把用户、会话、群聊、计数器、延迟和锁统计、AI请求的分阶段耗时以及最近的日志写成一份快照，
+// 放在命名共享内存里，监视窗口（同进程或独立的monitor进程）只读这块内存，不接触服务器的任何锁
+// 快照用seqlock保护：写入前后各把序号加1，序号为奇数表示正在写；读者复制整份快照，前后序号一致才算读到
+// 监视窗口的操作（强制下线、删除账户）通过同一块内存中的命令环交给服务器执行，所以段只对运行服务器的用户开放
+
+static const char STATS_SEGMENT_NAME[] = "Local\\ChatServerStats";
+static const uint32_t STATS_SEGMENT_MAGIC = 0x53545343;  // "CSTS"
+static const uint32_t STATS_SEGMENT_VERSION = 4;          // 布局变化时加1，版本不一致的监视进程拒绝读取
+
+static const size_t STATS_MAX_USERS = 256;
+static const size_t STATS_MAX_GROUPS = 128;
+static const size_t STATS_LOG_LINES = 2048;       // 每类日志保留的最近行数（每100毫秒发布一次，每秒超过约1万行才会丢行）
+static const size_t STATS_LOG_LINE_SIZE = 256;    // 每行最大长度（含结尾0）
+static const size_t STATS_LATENCY_TYPES = 32;
+static const size_t STATS_LATENCY_STAGES = 5;
+static const size_t STATS_MAX_LOCKS = 16;
+static const size_t STATS_LOCK_CALL_SITES = 3;
+static const size_t STATS_MAX_AI_ENDPOINTS = 32;
+static const size_t STATS_AI_PHASES = 6;
+static const size_t STATS_COMMAND_SLOTS = 16;
+
+// 日志类别
+enum StatsLogKind : uint32_t {
+    STATS_LOG_SERVER = 0,   // 服务器日志（带级别）
+    STATS_LOG_FORWARD,      // 转发消息
+    STATS_LOG_REQUEST,      // 请求消息
+    STATS_LOG_KINDS
+};
+
+// 计数器（与/metrics中的同名指标一致）
+enum StatsCounter : uint32_t {
+    STATS_CONNECTIONS = 0,
+    STATS_ACTIVE_CONNECTIONS,
+    STATS_ONLINE_USERS,
+    STATS_LOGINS_SUCCESS,
+    STATS_LOGINS_FAILURE,
+    STATS_MESSAGES_RECEIVED,
+    STATS_MESSAGES_FORWARDED,
+    STATS_MESSAGES_OFFLINE,
+    STATS_BYTES_RECEIVED,
+    STATS_BYTES_SENT,
+    STATS_AI_SUCCESS,
+    STATS_AI_FAILURE,
+    STATS_OFFLINE_PENDING,
+    STATS_COUNTERS
+};
+
+// 监视窗口发给服务器的命令
+enum StatsCommandType : uint32_t {
+    STATS_COMMAND_FORCE_DISCONNECT = 1,
+    STATS_COMMAND_DELETE_USER = 2,
+};
+
+// 用户和群聊表只在内容变化时才增加对应的变化计数，心跳时间单独存放，不影响变化计数
+struct StatsUser {
+    uint8_t userID;
+    uint8_t online;
+    uint16_t port;
+    char name[32];
+    char ip[46];
+};
+
+struct StatsGroup {
+    char name[64];
+    uint16_t memberCount;
+    uint8_t members[32];      // 成员ID位图
+};
+
+struct StatsLatency {
+    uint64_t count;
+    uint64_t p50Ns;
+    uint64_t p99Ns;
+    uint64_t p999Ns;
+    uint64_t maxNs;
+};
+
+struct StatsLockSite {
+    char text[48];            // 模块+偏移
+    uint64_t waitNs;
+};
+
+struct StatsLock {
+    char name[32];
+    uint64_t acquisitions;
+    uint64_t contended;
+    StatsLatency wait;
+    StatsLatency hold;
+    StatsLockSite sites[STATS_LOCK_CALL_SITES];
+    uint32_t siteCount;
+};
+
+// 一个AI端点各阶段的耗时
+struct StatsAIEndpoint {
+    char name[96];            // 端点URL（过长时截断）
+    StatsLatency phases[STATS_AI_PHASES];
+};
+
+// 一类日志的最近若干行：第seq行（从0开始）存放在lines[seq % STATS_LOG_LINES]
+// 监视窗口两次读取之间新增超过STATS_LOG_LINES行时，更早的行已被覆盖，由监视窗口自己按序号差计算丢了多少
+struct StatsLogTail {
+    uint64_t nextSeq;         // 已发布的总行数
+    uint64_t droppedLines;    // 发布前就已丢失的总行数（服务器的UI日志缓冲区在两次发布之间被写满覆盖）
+    char lines[STATS_LOG_LINES][STATS_LOG_LINE_SIZE];
+};
+
+// 快照内容（普通数据，可以整块复制）
+struct StatsSnapshot {
+    uint64_t version;                 // 发布次数
+    uint64_t publishTimeMs;           // 发布时的服务器运行时间
+    uint64_t counters[STATS_COUNTERS];
+
+    uint64_t usersChangeSeq;          // 用户表内容每变化一次加1（监视窗口据此决定是否重建列表）
+    uint64_t groupsChangeSeq;         // 群聊表内容每变化一次加1
+    uint32_t userCount;
+    uint32_t groupCount;
+    uint32_t groupsTruncated;         // 群聊超过STATS_MAX_GROUPS时为1
+    StatsUser users[STATS_MAX_USERS];
+    uint32_t heartbeatAgeMs[STATS_MAX_USERS];   // 与users对应：发布快照时距离上次心跳的毫秒数
+    StatsGroup groups[STATS_MAX_GROUPS];
+
+    char typeNames[STATS_LATENCY_TYPES][16];    // 空串表示这个类型没有记录
+    char stageNames[STATS_LATENCY_STAGES][16];
+    StatsLatency latency[STATS_LATENCY_TYPES][STATS_LATENCY_STAGES];
+
+    uint32_t lockCount;
+    StatsLock locks[STATS_MAX_LOCKS];
+
+    char aiModel[64];
+    char aiPhaseNames[STATS_AI_PHASES][16];
+    uint32_t aiEndpointCount;
+    StatsAIEndpoint aiEndpoints[STATS_MAX_AI_ENDPOINTS];
+
+    StatsLogTail logs[STATS_LOG_KINDS];
+};
+
+// 命令环的一个槽：ready为槽位序号+1时表示命令已写好
+struct StatsCommandSlot {
+    std::atomic<uint64_t> ready;
+    uint32_t type;
+    uint32_t userID;
+};
+
+// 共享内存段的完整布局
+struct StatsSegment {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    std::atomic<uint64_t> sequence;       // seqlock序号
+    std::atomic<uint64_t> commandHead;    // 下一个可写的命令序号（监视进程递增）
+    std::atomic<uint64_t> commandTail;    // 下一个要执行的命令序号（服务器递增）
+    StatsCommandSlot commands[STATS_COMMAND_SLOTS];
+    StatsSnapshot snapshot;
+};
+
+// 服务器端：创建共享内存段
+StatsSegment* CreateStatsSegment();
+
+// 服务器端：发布一份快照（只能有一个发布线程）
+void PublishStatsSnapshot(StatsSegment* segment, const StatsSnapshot& snapshot);
+
+// 服务器端：取出下一条命令，没有时返回false
+bool TakeStatsCommand(StatsSegment* segment, uint32_t& type, uint32_t& userID);
+
+// 监视端：打开服务器创建的共享内存段，服务器没有运行或版本不一致时返回nullptr
+// 监视端只写命令环，快照部分只读
+StatsSegment* OpenStatsSegment();
+
+// 监视端：关闭共享内存段（服务器重启后需要重新打开）
+void CloseStatsSegment(StatsSegment* segment);
+
+// 监视端：读取一份完整的快照（写入频繁时会重试），读取失败返回false
+bool ReadStatsSnapshot(const StatsSegment* segment, StatsSnapshot& out);
+
+// 监视端：提交一条命令，命令环满时返回false
+bool SendStatsCommand(StatsSegment* segment, uint32_t type, uint32_t userID);
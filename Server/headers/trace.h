@@ -0,0 +1,60 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// 请求追踪：按采样率选中一部分消息，把处理它时经过的各个区段（接收、解析、查询用户状态、等会话锁、发送、AI请求）
+// 记录到每个线程自己的环形缓冲区，导出为Chrome trace-event JSON（可以直接拖进Perfetto或chrome://tracing查看时间线）
+// 默认关闭；开启后每条消息多一次全局计数器的原子加，被采样的消息每个区段多两次取时间
+
+static const size_t TRACE_BUFFER_CAPACITY = 512;  // 每个缓冲区保留的最近区段数（约20KB）
+static const size_t TRACE_MAX_BUFFERS = 64;       // 缓冲区总数上限（正在运行和已退出的线程合计，约1.3MB）
+
+// 设置采样率：每N条消息追踪1条，0表示关闭
+void SetTraceSampleRate(uint32_t everyN);
+uint32_t GetTraceSampleRate();
+
+// 给当前线程命名（显示在时间线的线程名上）
+void SetTraceThreadName(const std::string& name);
+
+// 一条消息的采样范围：构造时按采样率决定这条消息是否追踪，析构时恢复
+class TraceSampleScope {
+public:
+    TraceSampleScope();
+    ~TraceSampleScope();
+    TraceSampleScope(const TraceSampleScope&) = delete;
+    TraceSampleScope& operator=(const TraceSampleScope&) = delete;
+
+private:
+    bool previous_;
+};
+
+// 当前线程正在处理的消息是否被采样
+bool IsTraceSampled();
+
+// 区段：构造时开始，析构或调用End()时结束；当前消息没有被采样时什么都不做
+// name必须是字符串常量（缓冲区里只保存指针）
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* argName = nullptr, int64_t argValue = 0);
+    ~TraceSpan() { End(); }
+    void End();
+    void SetArg(const char* argName, int64_t argValue);
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    const char* argName_;
+    int64_t argValue_;
+    uint64_t startUs_;
+    bool active_;
+};
+
+// 在当前线程记录一个已经结束的区段：开始和结束不在同一个作用域时使用（例如事件循环线程上的HTTP请求），
+// 调用方自己判断这个区段所属的消息是否被采样；name必须是字符串常量
+void RecordTraceSpan(const char* name, std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point end, const char* argName = nullptr, int64_t argValue = 0);
+
+// 导出所有线程缓冲区中的区段（Chrome trace-event JSON）
+std::string ExportTraceJSON();
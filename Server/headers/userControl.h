@@ -5,8 +5,12 @@
 #include <vector>
 #include <mutex>
 #include <chrono>
+#include <memory>
 #include <winsock2.h>
 #include "../chatMsg_server.hpp"
+#include "lockStats.h"
+
+struct SendChannel;
 
 // 用户会话类
 class ClientSession {
@@ -16,6 +20,7 @@ public:
     unsigned short client_port; // 客户端端口
     uint8_t userid;            // 用户ID
     std::chrono::steady_clock::time_point lastHeartbeatTime;  // 最后一次心跳时间
+    std::shared_ptr<SendChannel> sendChannel;  // 发送通道（其他线程在g_sessionMutex内取得，解锁后发送）
 
     // 构造函数
     ClientSession(SOCKET fd, const std::string& ip, unsigned short port);
@@ -27,10 +32,9 @@ public:
 // 全局变量声明
 extern std::map<uint8_t, std::string> g_userCredentials;       // 用户凭证(ID->密码)
 extern std::map<uint8_t, ClientSession*> g_userSessions;       // 用户会话(ID->会话指针)
-extern std::map<uint8_t, std::vector<Packet>> g_offlineMessages; // 离线消息队列
 extern std::map<std::string, std::vector<uint8_t>> g_groupChat;  // 群聊(群名->成员列表)
 extern std::map<uint8_t, std::string> g_userName;              // 用户名(ID->用户名)
-extern std::mutex g_sessionMutex;  // 保护用户会话数据的互斥锁
+extern InstrumentedMutex g_sessionMutex;  // 保护用户会话数据的互斥锁
 
 // 用户检查函数
 bool CheckExist(uint8_t userID);   // 检查用户是否存在
@@ -0,0 +1,249 @@
+#include "headers/historyStore.h"
+#include "headers/socket.h"
+#include "headers/logger.h"
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+
+// 全局历史消息存储实例
+HistoryStore g_historyStore;
+
+// 存储参数
+static const char* HISTORY_FOLDER = "history";
+
+#pragma pack(push,1)
+// 索引文件中的定长索引项
+struct HistoryIndexEntry {
+    uint64_t offset;       // 消息在数据文件中的位置
+    uint32_t length;       // 消息长度（网络格式数据帧）
+    uint32_t reserved;
+    uint64_t timestampMs;  // 服务器收到消息的时间
+};
+#pragma pack(pop)
+
+// 在指定位置读取（调用方持有会话锁）
+static bool ReadAt(HANDLE file, uint64_t offset, void* buffer, size_t size) {
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(offset);
+    if (!SetFilePointerEx(file, position, nullptr, FILE_BEGIN)) {
+        return false;
+    }
+    DWORD read = 0;
+    return ReadFile(file, buffer, static_cast<DWORD>(size), &read, nullptr) && read == size;
+}
+
+// 在指定位置写入（调用方持有会话锁）
+static bool WriteAt(HANDLE file, uint64_t offset, const void* buffer, size_t size) {
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(offset);
+    if (!SetFilePointerEx(file, position, nullptr, FILE_BEGIN)) {
+        return false;
+    }
+    DWORD written = 0;
+    return WriteFile(file, buffer, static_cast<DWORD>(size), &written, nullptr) && written == size;
+}
+
+static uint64_t FileSize(HANDLE file) {
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        return 0;
+    }
+    return static_cast<uint64_t>(size.QuadPart);
+}
+
+HistoryStore::Conversation::~Conversation() {
+    if (dataFile != INVALID_HANDLE_VALUE) CloseHandle(dataFile);
+    if (indexFile != INVALID_HANDLE_VALUE) CloseHandle(indexFile);
+}
+
+HistoryStore::HistoryStore() : opened_(false) {
+}
+
+HistoryStore::~HistoryStore() {
+}
+
+bool HistoryStore::Open(const std::string& directory) {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    directory_ = directory;
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        return false;
+    }
+    opened_ = true;
+    return true;
+}
+
+std::string HistoryStore::PrivateKey(uint8_t userA, uint8_t userB) {
+    if (userA > userB) {
+        std::swap(userA, userB);
+    }
+    char key[16];
+    snprintf(key, sizeof(key), "p_%03u_%03u", userA, userB);
+    return key;
+}
+
+std::string HistoryStore::GroupKey(const std::string& groupName) {
+    static const char* HEX = "0123456789abcdef";
+    std::string key = "g_";
+    for (unsigned char c : groupName) {
+        key += HEX[c >> 4];
+        key += HEX[c & 0x0F];
+    }
+    return key;
+}
+
+std::string HistoryStore::KeyOf(const Packet& packet) {
+    switch (packet.type()) {
+        case MsgType::NormalMsg:
+            return PrivateKey(packet.getsendid(), packet.getrecvid());
+        case MsgType::GroupMsg:
+            return GroupKey(packet.getField2Str());
+        case MsgType::ImageMsg:
+            // success标志表示是否为群聊图片，群名在field3
+            if (packet.success()) {
+                return GroupKey(packet.getField3Str());
+            }
+            return PrivateKey(packet.getsendid(), packet.getrecvid());
+        default:
+            return "";
+    }
+}
+
+std::shared_ptr<HistoryStore::Conversation> HistoryStore::GetConversation(const std::string& key, bool create) {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    if (!opened_ || key.empty()) {
+        return nullptr;
+    }
+    auto it = conversations_.find(key);
+    if (it != conversations_.end()) {
+        return it->second;
+    }
+
+    std::string dataPath = directory_ + "/" + key + ".dat";
+    std::string indexPath = directory_ + "/" + key + ".idx";
+    if (!create && !std::filesystem::exists(indexPath)) {
+        return nullptr;
+    }
+
+    auto conversation = std::make_shared<Conversation>();
+    conversation->dataFile = CreateFileA(dataPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                                         nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    conversation->indexFile = CreateFileA(indexPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                                          nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (conversation->dataFile == INVALID_HANDLE_VALUE || conversation->indexFile == INVALID_HANDLE_VALUE) {
+        WriteLog(LogLevel::WARN, "无法打开历史消息文件: " + key);
+        return nullptr;
+    }
+
+    // 数据先于索引写入，所以索引指向的数据一定完整；崩溃留下的半条索引项和多余数据直接截掉
+    conversation->count = FileSize(conversation->indexFile) / sizeof(HistoryIndexEntry);
+    conversation->dataSize = 0;
+    if (conversation->count > 0) {
+        HistoryIndexEntry last;
+        if (ReadAt(conversation->indexFile, (conversation->count - 1) * sizeof(HistoryIndexEntry), &last, sizeof(last))) {
+            conversation->dataSize = last.offset + last.length;
+        } else {
+            conversation->count = 0;
+        }
+    }
+
+    conversations_[key] = conversation;
+    return conversation;
+}
+
+bool HistoryStore::Append(const Packet& packet, uint64_t* seqOut) {
+    std::string key = KeyOf(packet);
+    std::shared_ptr<Conversation> conversation = GetConversation(key, true);
+    if (!conversation) {
+        return false;
+    }
+
+    // 在锁外序列化
+    std::vector<char> frame;
+    SerializePacket(packet, frame);
+    HistoryIndexEntry entry = {};
+    entry.length = static_cast<uint32_t>(frame.size());
+    entry.timestampMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+
+    InstrumentedLockGuard lock(conversation->mutex, LOCK_SITE);
+    entry.offset = conversation->dataSize;
+    if (!WriteAt(conversation->dataFile, entry.offset, frame.data(), frame.size()) ||
+        !WriteAt(conversation->indexFile, conversation->count * sizeof(HistoryIndexEntry), &entry, sizeof(entry))) {
+        WriteLog(LogLevel::WARN, "历史消息写入失败: " + key);
+        return false;
+    }
+    if (seqOut) {
+        *seqOut = conversation->count;
+    }
+    conversation->dataSize += frame.size();
+    conversation->count++;
+    return true;
+}
+
+uint64_t HistoryStore::Count(const std::string& key) {
+    std::shared_ptr<Conversation> conversation = GetConversation(key, false);
+    if (!conversation) {
+        return 0;
+    }
+    InstrumentedLockGuard lock(conversation->mutex, LOCK_SITE);
+    return conversation->count;
+}
+
+bool HistoryStore::ReadRange(const std::string& key, uint64_t firstSeq, size_t count, std::vector<Entry>& out) {
+    std::shared_ptr<Conversation> conversation = GetConversation(key, false);
+    if (!conversation) {
+        return true;  // 会话还没有任何消息
+    }
+
+    std::vector<HistoryIndexEntry> entries;
+    std::vector<char> data;
+    {
+        InstrumentedLockGuard lock(conversation->mutex, LOCK_SITE);
+        if (firstSeq >= conversation->count) {
+            return true;
+        }
+        count = static_cast<size_t>(std::min<uint64_t>(count, conversation->count - firstSeq));
+        if (count == 0) {
+            return true;
+        }
+
+        // 一次读出这一页的索引项
+        entries.resize(count);
+        if (!ReadAt(conversation->indexFile, firstSeq * sizeof(HistoryIndexEntry),
+                    entries.data(), count * sizeof(HistoryIndexEntry))) {
+            return false;
+        }
+
+        // 同一会话的消息在数据文件中是连续的，一次读出整段
+        uint64_t begin = entries.front().offset;
+        uint64_t end = entries.back().offset + entries.back().length;
+        data.resize(static_cast<size_t>(end - begin));
+        if (!ReadAt(conversation->dataFile, begin, data.data(), data.size())) {
+            return false;
+        }
+    }
+
+    // 在锁外解析
+    uint64_t base = entries.front().offset;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        Entry entry;
+        entry.seq = firstSeq + i;
+        entry.timestampMs = entries[i].timestampMs;
+        if (!entry.packet.parseFrom(data.data() + (entries[i].offset - base), entries[i].length)) {
+            WriteLog(LogLevel::WARN, "历史消息解析失败: " + key + ", 序号: " + std::to_string(entry.seq));
+            continue;
+        }
+        out.push_back(std::move(entry));
+    }
+    return true;
+}
+
+void InitializeHistoryStore() {
+    if (!g_historyStore.Open(HISTORY_FOLDER)) {
+        WriteLog(LogLevel::FATAL, "历史消息存储初始化失败，聊天记录将不会被保存");
+        return;
+    }
+    WriteLog(LogLevel::INFO, "历史消息存储已打开");
+}
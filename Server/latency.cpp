@@ -0,0 +1,203 @@
+#include "headers/latency.h"
+#include "headers/metrics.h"
+#include <algorithm>
+#include <cstdio>
+
+static LatencyHistogram g_latencyHistograms[LATENCY_TYPE_SLOTS][static_cast<size_t>(LatencyStage::COUNT)];
+
+size_t LatencyHistogram::BucketIndex(uint64_t ns) {
+    if (ns < LATENCY_SUB_BUCKETS) {
+        return static_cast<size_t>(ns);  // 小于16纳秒的值每个值一个桶
+    }
+    size_t exponent = 63 - __builtin_clzll(ns);  // ns所在的2的幂区间[2^e, 2^(e+1))
+    if (exponent > LATENCY_MAX_EXPONENT) {
+        return LATENCY_BUCKETS - 1;
+    }
+    size_t sub = static_cast<size_t>(ns >> (exponent - 4)) & (LATENCY_SUB_BUCKETS - 1);
+    return (exponent - 3) * LATENCY_SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::BucketUpperBound(size_t index) {
+    if (index < LATENCY_SUB_BUCKETS) {
+        return index;
+    }
+    size_t exponent = index / LATENCY_SUB_BUCKETS + 3;
+    uint64_t sub = index % LATENCY_SUB_BUCKETS;
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << (exponent - 4)) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t ns) {
+    buckets_[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t currentMax = max_.load(std::memory_order_relaxed);
+    while (ns > currentMax && !max_.compare_exchange_weak(currentMax, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::Snapshot(std::vector<uint64_t>& counts, uint64_t& total, uint64_t& maxNs) const {
+    counts.resize(LATENCY_BUCKETS);
+    total = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    maxNs = max_.load(std::memory_order_relaxed);
+}
+
+static size_t TypeSlot(MsgType type) {
+    size_t slot = static_cast<uint8_t>(type);
+    return slot < LATENCY_TYPE_SLOTS ? slot : 0;
+}
+
+void RecordLatency(MsgType type, LatencyStage stage, uint64_t ns) {
+    g_latencyHistograms[TypeSlot(type)][static_cast<size_t>(stage)].Record(ns);
+}
+
+// 按HDR的习惯，分位数报告为所在桶的上界
+static uint64_t Percentile(const std::vector<uint64_t>& counts, uint64_t total, double quantile) {
+    uint64_t rank = static_cast<uint64_t>(quantile * total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return LatencyHistogram::BucketUpperBound(i);
+        }
+    }
+    return 0;
+}
+
+LatencySummary SummarizeHistogram(const LatencyHistogram& histogram) {
+    LatencySummary summary;
+    std::vector<uint64_t> counts;
+    histogram.Snapshot(counts, summary.count, summary.maxNs);
+    if (summary.count == 0) {
+        return summary;
+    }
+    summary.p50Ns = Percentile(counts, summary.count, 0.50);
+    summary.p99Ns = Percentile(counts, summary.count, 0.99);
+    summary.p999Ns = Percentile(counts, summary.count, 0.999);
+    // 桶上界可能超过真实最大值，按最大值截断
+    summary.p50Ns = std::min(summary.p50Ns, summary.maxNs);
+    summary.p99Ns = std::min(summary.p99Ns, summary.maxNs);
+    summary.p999Ns = std::min(summary.p999Ns, summary.maxNs);
+    return summary;
+}
+
+LatencySummary SummarizeLatency(uint8_t typeSlot, LatencyStage stage) {
+    if (typeSlot >= LATENCY_TYPE_SLOTS || stage >= LatencyStage::COUNT) {
+        return LatencySummary();
+    }
+    return SummarizeHistogram(g_latencyHistograms[typeSlot][static_cast<size_t>(stage)]);
+}
+
+const char* LatencyStageName(LatencyStage stage) {
+    switch (stage) {
+        case LatencyStage::INGRESS:      return "ingress";
+        case LatencyStage::DISPATCH:     return "dispatch";
+        case LatencyStage::ROUTING:      return "routing";
+        case LatencyStage::SOCKET_WRITE: return "socket_write";
+        case LatencyStage::TOTAL:        return "total";
+        default:                         return "unknown";
+    }
+}
+
+std::string RenderLatencyTable() {
+    std::vector<std::string> typeNames = MsgTypeLabelValues();
+    std::string out;
+    char line[256];
+    for (size_t slot = 0; slot < LATENCY_TYPE_SLOTS; ++slot) {
+        LatencySummary total = SummarizeLatency(static_cast<uint8_t>(slot), LatencyStage::TOTAL);
+        if (total.count == 0) {
+            continue;
+        }
+        std::string typeName = typeNames[slot].empty() ? "other" : typeNames[slot];
+        snprintf(line, sizeof(line), "%s (%llu)\n", typeName.c_str(), static_cast<unsigned long long>(total.count));
+        out += line;
+        snprintf(line, sizeof(line), "  %-14s %10s %12s %12s %12s %12s\n", "stage", "count", "p50(us)", "p99(us)",
+                 "p999(us)", "max(us)");
+        out += line;
+        for (size_t stage = 0; stage < static_cast<size_t>(LatencyStage::COUNT); ++stage) {
+            LatencySummary summary = SummarizeLatency(static_cast<uint8_t>(slot), static_cast<LatencyStage>(stage));
+            snprintf(line, sizeof(line), "  %-14s %10llu %12.1f %12.1f %12.1f %12.1f\n",
+                     LatencyStageName(static_cast<LatencyStage>(stage)), static_cast<unsigned long long>(summary.count),
+                     summary.p50Ns / 1000.0, summary.p99Ns / 1000.0, summary.p999Ns / 1000.0, summary.maxNs / 1000.0);
+            out += line;
+        }
+    }
+    if (out.empty()) {
+        out = "no samples\n";
+    }
+    return out;
+}
+
+// 当前线程正在处理的消息
+struct PacketLatencyContext {
+    bool active = false;
+    MsgType type = MsgType::Heartbeat;
+    std::chrono::steady_clock::time_point receiveStart;
+    std::chrono::steady_clock::time_point stageStart;   // 当前阶段（本段）开始的时间
+    LatencyStage stage = LatencyStage::INGRESS;          // 当前阶段
+    uint64_t stageNs[static_cast<size_t>(LatencyStage::COUNT)] = {};
+    bool stageSeen[static_cast<size_t>(LatencyStage::COUNT)] = {};
+};
+
+static thread_local PacketLatencyContext t_packetLatency;
+
+static inline uint64_t ElapsedNs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+}
+
+// 把当前阶段到now为止的耗时记上，并切换到下一个阶段
+static inline void SwitchStage(PacketLatencyContext& context, LatencyStage next, std::chrono::steady_clock::time_point now) {
+    size_t current = static_cast<size_t>(context.stage);
+    context.stageNs[current] += ElapsedNs(context.stageStart, now);
+    context.stageSeen[current] = true;
+    context.stage = next;
+    context.stageStart = now;
+}
+
+void BeginPacketLatency(MsgType type, std::chrono::steady_clock::time_point receiveStart) {
+    PacketLatencyContext& context = t_packetLatency;
+    context = PacketLatencyContext();
+    context.active = true;
+    context.type = type;
+    context.receiveStart = receiveStart;
+    context.stageStart = receiveStart;
+    context.stage = LatencyStage::INGRESS;
+    SwitchStage(context, LatencyStage::DISPATCH, std::chrono::steady_clock::now());
+}
+
+void EndPacketLatency() {
+    PacketLatencyContext& context = t_packetLatency;
+    if (!context.active) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    SwitchStage(context, LatencyStage::DISPATCH, now);
+    context.active = false;
+
+    for (size_t stage = 0; stage < static_cast<size_t>(LatencyStage::TOTAL); ++stage) {
+        if (context.stageSeen[stage]) {
+            RecordLatency(context.type, static_cast<LatencyStage>(stage), context.stageNs[stage]);
+        }
+    }
+    RecordLatency(context.type, LatencyStage::TOTAL, ElapsedNs(context.receiveStart, now));
+}
+
+LatencyStageTimer::LatencyStageTimer(LatencyStage stage) : active_(t_packetLatency.active), parent_(stage) {
+    if (!active_) {
+        return;
+    }
+    PacketLatencyContext& context = t_packetLatency;
+    parent_ = context.stage;
+    SwitchStage(context, stage, std::chrono::steady_clock::now());
+}
+
+LatencyStageTimer::~LatencyStageTimer() {
+    if (!active_ || !t_packetLatency.active) {
+        return;
+    }
+    SwitchStage(t_packetLatency, parent_, std::chrono::steady_clock::now());
+}
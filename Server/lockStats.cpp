@@ -0,0 +1,208 @@
+#include "headers/lockStats.h"
+#include "headers/trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+
+const LockSite UNSPECIFIED_LOCK_SITE = {"<unspecified>", 0};
+
+// 所有锁的统计（按名字），锁对象析构后统计仍然保留
+struct LockRegistry {
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<LockStats>> stats;
+};
+
+static LockRegistry& Registry() {
+    static LockRegistry registry;
+    return registry;
+}
+
+static LockStats* GetLockStats(const char* name) {
+    LockRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::unique_ptr<LockStats>& stats = registry.stats[name];
+    if (!stats) {
+        stats.reset(new LockStats());
+        stats->name = name;
+        stats->waitSpanName = std::string(name) + " wait";
+    }
+    return stats.get();
+}
+
+static inline uint64_t ElapsedNs(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count());
+}
+
+InstrumentedMutex::InstrumentedMutex(const char* name) : stats_(GetLockStats(name)) {
+}
+
+void InstrumentedMutex::lock(const LockSite* site) {
+    if (!mutex_.try_lock()) {
+        // 发生竞争：记录等待时间，被追踪的消息同时记一个等锁区段
+        TraceSpan waitSpan(stats_->waitSpanName.c_str());
+        auto waitStart = std::chrono::steady_clock::now();
+        mutex_.lock();
+        waitSpan.End();
+        acquiredAt_ = std::chrono::steady_clock::now();
+        RecordWait(site, ElapsedNs(waitStart, acquiredAt_));
+    } else {
+        acquiredAt_ = std::chrono::steady_clock::now();
+    }
+    stats_->acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool InstrumentedMutex::try_lock() {
+    if (!mutex_.try_lock()) {
+        return false;
+    }
+    acquiredAt_ = std::chrono::steady_clock::now();
+    stats_->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void InstrumentedMutex::unlock() {
+    uint64_t holdNs = ElapsedNs(acquiredAt_, std::chrono::steady_clock::now());
+    mutex_.unlock();
+    stats_->holdHistogram.Record(holdNs);
+}
+
+void InstrumentedMutex::RecordWait(const LockSite* site, uint64_t waitNs) {
+    stats_->contended.fetch_add(1, std::memory_order_relaxed);
+    stats_->waitHistogram.Record(waitNs);
+
+    // 开放寻址找到（或占用）这个调用位置的槽，表满时计入单独的溢出项，不混进某个真实的调用位置
+    size_t start = (reinterpret_cast<uintptr_t>(site) >> 4) % LOCK_CALL_SITES;
+    for (size_t i = 0; i < LOCK_CALL_SITES; ++i) {
+        LockCallSite& slot = stats_->callSites[(start + i) % LOCK_CALL_SITES];
+        const LockSite* current = slot.site.load(std::memory_order_relaxed);
+        if (current == nullptr && slot.site.compare_exchange_strong(current, site, std::memory_order_relaxed)) {
+            current = site;
+        }
+        if (current == site) {
+            slot.waits.fetch_add(1, std::memory_order_relaxed);
+            slot.waitNs.fetch_add(waitNs, std::memory_order_relaxed);
+            return;
+        }
+    }
+    LockCallSite& overflow = stats_->overflowSite;
+    overflow.waits.fetch_add(1, std::memory_order_relaxed);
+    overflow.waitNs.fetch_add(waitNs, std::memory_order_relaxed);
+}
+
+// 调用位置的文字说明："文件名:行号"（去掉目录）
+static std::string DescribeCallSite(const LockSite* site) {
+    if (site->line == 0) {
+        return site->file;
+    }
+    const char* fileName = site->file;
+    for (const char* p = site->file; *p; ++p) {
+        if (*p == '/' || *p == '\\') {
+            fileName = p + 1;
+        }
+    }
+    return std::string(fileName) + ":" + std::to_string(site->line);
+}
+
+std::vector<LockSummary> SummarizeLocks(size_t topCallSites) {
+    std::vector<LockStats*> all;
+    {
+        LockRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto& pair : registry.stats) {
+            all.push_back(pair.second.get());
+        }
+    }
+
+    std::vector<LockSummary> summaries;
+    for (LockStats* stats : all) {
+        LockSummary summary;
+        summary.name = stats->name;
+        summary.acquisitions = stats->acquisitions.load(std::memory_order_relaxed);
+        summary.contended = stats->contended.load(std::memory_order_relaxed);
+        summary.wait = SummarizeHistogram(stats->waitHistogram);
+        summary.hold = SummarizeHistogram(stats->holdHistogram);
+
+        std::vector<std::pair<uint64_t, const LockSite*>> sites;  // 等待总时间 -> 调用位置
+        for (const LockCallSite& slot : stats->callSites) {
+            uint64_t waitNs = slot.waitNs.load(std::memory_order_relaxed);
+            if (waitNs > 0) {
+                sites.emplace_back(waitNs, slot.site.load(std::memory_order_relaxed));
+            }
+        }
+        uint64_t overflowNs = stats->overflowSite.waitNs.load(std::memory_order_relaxed);
+        if (overflowNs > 0) {
+            sites.emplace_back(overflowNs, nullptr);
+        }
+        std::sort(sites.rbegin(), sites.rend());
+        for (size_t i = 0; i < sites.size() && i < topCallSites; ++i) {
+            std::string site = sites[i].second != nullptr ? DescribeCallSite(sites[i].second) : "<overflow>";
+            summary.topCallSites.emplace_back(site, sites[i].first);
+        }
+        summaries.push_back(std::move(summary));
+    }
+    std::sort(summaries.begin(), summaries.end(),
+              [](const LockSummary& a, const LockSummary& b) { return a.contended > b.contended; });
+    return summaries;
+}
+
+std::string RenderLockMetrics() {
+    std::vector<LockSummary> summaries = SummarizeLocks(0);
+    std::string out;
+    char line[512];
+    out += "# HELP chat_lock_acquisitions_total Lock acquisitions\n# TYPE chat_lock_acquisitions_total counter\n";
+    for (const LockSummary& summary : summaries) {
+        snprintf(line, sizeof(line), "chat_lock_acquisitions_total{lock=\"%s\"} %llu\n", summary.name.c_str(),
+                 static_cast<unsigned long long>(summary.acquisitions));
+        out += line;
+    }
+    out += "# HELP chat_lock_contended_total Lock acquisitions that had to wait\n# TYPE chat_lock_contended_total counter\n";
+    for (const LockSummary& summary : summaries) {
+        snprintf(line, sizeof(line), "chat_lock_contended_total{lock=\"%s\"} %llu\n", summary.name.c_str(),
+                 static_cast<unsigned long long>(summary.contended));
+        out += line;
+    }
+    // 等待和持有时间以summary类型输出分位数（秒）
+    const char* kinds[] = {"wait", "hold"};
+    for (const char* kind : kinds) {
+        snprintf(line, sizeof(line), "# HELP chat_lock_%s_seconds Lock %s time\n# TYPE chat_lock_%s_seconds summary\n",
+                 kind, kind, kind);
+        out += line;
+        for (const LockSummary& summary : summaries) {
+            const LatencySummary& latency = kind[0] == 'w' ? summary.wait : summary.hold;
+            snprintf(line, sizeof(line),
+                     "chat_lock_%s_seconds{lock=\"%s\",quantile=\"0.5\"} %.9f\n"
+                     "chat_lock_%s_seconds{lock=\"%s\",quantile=\"0.99\"} %.9f\n"
+                     "chat_lock_%s_seconds{lock=\"%s\",quantile=\"0.999\"} %.9f\n",
+                     kind, summary.name.c_str(), latency.p50Ns / 1e9, kind, summary.name.c_str(), latency.p99Ns / 1e9,
+                     kind, summary.name.c_str(), latency.p999Ns / 1e9);
+            out += line;
+            snprintf(line, sizeof(line), "chat_lock_%s_seconds_count{lock=\"%s\"} %llu\n", kind, summary.name.c_str(),
+                     static_cast<unsigned long long>(latency.count));
+            out += line;
+        }
+    }
+    return out;
+}
+
+std::string RenderLockTable() {
+    std::vector<LockSummary> summaries = SummarizeLocks(5);
+    std::string out;
+    char line[320];
+    snprintf(line, sizeof(line), "%-24s %12s %10s %12s %12s %12s %12s %12s\n", "lock", "acquired", "contended",
+             "wait p50", "wait p99", "wait p999", "hold p50", "hold p99");
+    out += line;
+    for (const LockSummary& summary : summaries) {
+        snprintf(line, sizeof(line), "%-24s %12llu %10llu %10.1fus %10.1fus %10.1fus %10.1fus %10.1fus\n",
+                 summary.name.c_str(), static_cast<unsigned long long>(summary.acquisitions),
+                 static_cast<unsigned long long>(summary.contended), summary.wait.p50Ns / 1000.0,
+                 summary.wait.p99Ns / 1000.0, summary.wait.p999Ns / 1000.0, summary.hold.p50Ns / 1000.0,
+                 summary.hold.p99Ns / 1000.0);
+        out += line;
+        for (const auto& site : summary.topCallSites) {
+            snprintf(line, sizeof(line), "    waited %.1fus at %s\n", site.second / 1000.0, site.first.c_str());
+            out += line;
+        }
+    }
+    return out;
+}
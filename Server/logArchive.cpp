@@ -0,0 +1,200 @@
+#include "headers/logArchive.h"
+#include <zstd.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+static const int LOG_COMPRESSION_LEVEL = 3;
+
+// 读取整个文件
+static bool ReadWholeFile(const std::string& path, std::vector<char>& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// 先写临时文件再替换，保证不会留下写了一半的归档
+static bool WriteFileReplace(const std::string& path, const std::vector<char>& data) {
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write(data.data(), data.size());
+        if (!file) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    return !ec;
+}
+
+bool CompressLogSegment(const std::string& path, std::string& error) {
+    std::vector<char> raw;
+    if (!ReadWholeFile(path, raw)) {
+        error = "无法读取日志段";
+        return false;
+    }
+    BlogFileHeader fileHeader;
+    if (raw.size() < sizeof(fileHeader)) {
+        error = "日志段为空";
+        return false;
+    }
+    memcpy(&fileHeader, raw.data(), sizeof(fileHeader));
+    if (memcmp(fileHeader.magic, BLOG_MAGIC, sizeof(BLOG_MAGIC)) != 0) {
+        error = "不是二进制日志文件";
+        return false;
+    }
+
+    std::vector<char> archive;
+    std::vector<BlogFrameIndex> frames;
+    std::map<uint16_t, uint8_t> userArgs;  // 以文件中的格式定义为准
+
+    // 把[frameBegin, frameEnd)压缩为一个帧
+    BlogFrameIndex frame = {};
+    size_t frameBegin = 0;
+    bool frameHasRecord = false;
+    auto finishFrame = [&](size_t frameEnd) -> bool {
+        if (frameEnd <= frameBegin) {
+            return true;
+        }
+        size_t bound = ZSTD_compressBound(frameEnd - frameBegin);
+        size_t offset = archive.size();
+        archive.resize(offset + bound);
+        size_t compressed = ZSTD_compress(archive.data() + offset, bound, raw.data() + frameBegin,
+                                          frameEnd - frameBegin, LOG_COMPRESSION_LEVEL);
+        if (ZSTD_isError(compressed)) {
+            error = std::string("压缩失败: ") + ZSTD_getErrorName(compressed);
+            return false;
+        }
+        archive.resize(offset + compressed);
+        frame.compressedOffset = offset;
+        frame.compressedSize = static_cast<uint32_t>(compressed);
+        frame.rawSize = static_cast<uint32_t>(frameEnd - frameBegin);
+        frames.push_back(frame);
+
+        frame = BlogFrameIndex();
+        frameBegin = frameEnd;
+        frameHasRecord = false;
+        return true;
+    };
+
+    // 第0帧：文件头和开头的格式定义
+    size_t offset = sizeof(fileHeader);
+    bool inDefinitions = true;
+    while (offset < raw.size()) {
+        BlogRecordView record;
+        size_t recordSize = 0;
+        if (!ParseBlogRecord(raw.data() + offset, raw.size() - offset, record, recordSize)) {
+            break;  // 崩溃留下的半条记录，丢弃
+        }
+
+        if (record.format == LOG_FORMAT_DEFINE) {
+            uint16_t format = 0;
+            uint8_t mask = 0;
+            std::string text;
+            if (ParseLogDefinition(record, format, text, mask)) {
+                userArgs[format] = mask;
+            }
+        } else if (inDefinitions) {
+            inDefinitions = false;
+            if (!finishFrame(offset)) {
+                return false;
+            }
+        }
+
+        // 更新当前帧的时间范围和用户位图
+        if (!frameHasRecord) {
+            frame.firstTimeUs = record.timeUs;
+            frameHasRecord = true;
+        }
+        frame.firstTimeUs = std::min(frame.firstTimeUs, record.timeUs);
+        frame.lastTimeUs = std::max(frame.lastTimeUs, record.timeUs);
+        auto it = userArgs.find(record.format);
+        uint8_t mask = it != userArgs.end() ? it->second : LogFormatUserArgs(record.format);
+        uint8_t users[8];
+        size_t userCount = ExtractLogUsers(record, mask, users, sizeof(users));
+        for (size_t i = 0; i < userCount; ++i) {
+            frame.users[users[i] >> 3] |= static_cast<uint8_t>(1 << (users[i] & 7));
+        }
+
+        offset += recordSize;
+        if (!inDefinitions && offset - frameBegin >= BLOG_FRAME_SIZE) {
+            if (!finishFrame(offset)) {
+                return false;
+            }
+        }
+    }
+    if (!finishFrame(offset)) {
+        return false;
+    }
+
+    std::vector<char> index(sizeof(BlogIndexHeader));
+    BlogIndexHeader indexHeader;
+    memcpy(indexHeader.magic, BLOG_INDEX_MAGIC, sizeof(indexHeader.magic));
+    indexHeader.version = BLOG_INDEX_VERSION;
+    indexHeader.frameCount = static_cast<uint32_t>(frames.size());
+    indexHeader.reserved = 0;
+    memcpy(index.data(), &indexHeader, sizeof(indexHeader));
+    index.insert(index.end(), reinterpret_cast<const char*>(frames.data()),
+                 reinterpret_cast<const char*>(frames.data() + frames.size()));
+
+    // 先写归档再写索引，最后删除原文件；中途失败时原文件还在，下次启动会重新压缩
+    if (!WriteFileReplace(path + ".zst", archive) || !WriteFileReplace(path + ".idx", index)) {
+        error = "无法写入归档文件";
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    return true;
+}
+
+bool ReadLogIndex(const std::string& indexPath, std::vector<BlogFrameIndex>& frames, std::string& error) {
+    std::vector<char> data;
+    if (!ReadWholeFile(indexPath, data)) {
+        error = "无法读取索引文件";
+        return false;
+    }
+    BlogIndexHeader header;
+    if (data.size() < sizeof(header)) {
+        error = "索引文件不完整";
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, BLOG_INDEX_MAGIC, sizeof(BLOG_INDEX_MAGIC)) != 0 || header.version != BLOG_INDEX_VERSION ||
+        data.size() < sizeof(header) + header.frameCount * sizeof(BlogFrameIndex)) {
+        error = "索引文件已损坏";
+        return false;
+    }
+    frames.resize(header.frameCount);
+    memcpy(frames.data(), data.data() + sizeof(header), header.frameCount * sizeof(BlogFrameIndex));
+    return true;
+}
+
+bool ReadLogFrame(const std::string& archivePath, const BlogFrameIndex& frame, std::vector<char>& out, std::string& error) {
+    std::ifstream file(archivePath, std::ios::binary);
+    if (!file.is_open()) {
+        error = "无法打开归档文件";
+        return false;
+    }
+    std::vector<char> compressed(frame.compressedSize);
+    file.seekg(static_cast<std::streamoff>(frame.compressedOffset));
+    file.read(compressed.data(), compressed.size());
+    if (!file) {
+        error = "归档文件不完整";
+        return false;
+    }
+    out.resize(frame.rawSize);
+    size_t size = ZSTD_decompress(out.data(), out.size(), compressed.data(), compressed.size());
+    if (ZSTD_isError(size) || size != frame.rawSize) {
+        error = "解压失败";
+        return false;
+    }
+    return true;
+}
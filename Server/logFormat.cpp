@@ -0,0 +1,244 @@
+#include "headers/logFormat.h"
+#include "headers/logger.h"
+#include <ctime>
+#include <algorithm>
+
+// 格式表（下标就是LogFmt的数值）
+// userArgs按位标记哪几个参数是用户ID（第0位对应第一个参数），logquery按用户筛选、归档索引记录用户时使用
+struct LogFormatInfo {
+    const char* format;
+    uint8_t userArgs;
+};
+static const LogFormatInfo LOG_FORMATS[] = {
+    {"{}", 0},
+    {"{}发送的{}, 接收人不存在", 0x01},
+    {"{}发送了{}, {}不在线, 保存至离线消息", 0x05},
+    {"来自{}的{}已转发给: {}", 0x05},
+    {"用户{}已离线，消息保存为离线", 0x01},
+    {"{}中{}名成员不在线, 消息保留在群聊时间线", 0},
+    {"登录请求: {}", 0x01},
+    {"登录成功: {}", 0x01},
+    {"登录失败: {}", 0x01},
+    {"新账号注册: {}", 0x01},
+    {"收到创建群组请求来自: {}", 0x01},
+    {"群聊创建成功, 名称为: {}", 0},
+    {"收到群聊消息 - 发送者: {}, 群聊: {}", 0x01},
+    {"群聊不存在: {}, 发送者为: {}", 0x02},
+    {"查询的用户不存在", 0},
+    {"非群成员查询群聊历史, 用户: {}, 群聊: {}", 0x01},
+    {"用户{}查询历史消息: {}, 返回 {} 条", 0x01},
+    {"收到AI消息请求 - 用户: {}", 0x01},
+    {"AI回复已发送 - 用户: {}", 0x01},
+    {"账号创建成功: {}", 0x01},
+    {"账号创建失败 - ID已存在: {}", 0x01},
+    {"群聊已经存在", 0},
+    {"推送离线消息给: {}, 消息数量: {}", 0x01},
+    {"离线消息发送中断, 已发送: {} 条，剩余: {} 条", 0},
+    {"离线消息推送完成, 共计: {} 条", 0},
+    {"用户{}修改用户名为{}", 0x01},
+    {"用户不存在，无法更改用户名", 0},
+    {"群聊消息补发中断, 用户: {}, 群聊: {}", 0x01},
+    {"群聊消息补发完成, 用户: {}, 共计: {} 条", 0x01},
+    {"用户{}发送的{}冒用发送者{}, 已丢弃", 0x05},
+    {"离线用户尝试发送{}: {}", 0x02},
+    {"历史消息请求参数无效, 用户: {}", 0x01},
+    {"发送AI回复失败 - 用户: {}", 0x01},
+    {"用户排队的AI请求过多，拒绝新请求 - 用户: {}", 0x01},
+    {"监视窗口请求强制下线: {}", 0x01},
+    {"监视窗口请求删除账户: {}", 0x01},
+    {"强制下线用户: {}", 0x01},
+    {"已彻底删除用户: {}", 0x01},
+    {"删除用户未能写入磁盘: {}", 0x01},
+    {"注册未能写入磁盘, 已撤销: {}", 0x01},
+    {"修改用户名未能写入磁盘, 已撤销: {}", 0x01},
+    {"离线消息保存失败, 接收者: {}", 0x01},
+    {"创建群聊未能写入磁盘, 已撤销: {}", 0},
+};
+static_assert(sizeof(LOG_FORMATS) / sizeof(LOG_FORMATS[0]) == static_cast<size_t>(LogFmt::COUNT),
+              "LOG_FORMATS必须与LogFmt一一对应");
+
+const char* LogFormatString(uint16_t format) {
+    if (format >= static_cast<uint16_t>(LogFmt::COUNT)) {
+        return nullptr;
+    }
+    return LOG_FORMATS[format].format;
+}
+
+uint8_t LogFormatUserArgs(uint16_t format) {
+    if (format >= static_cast<uint16_t>(LogFmt::COUNT)) {
+        return 0;
+    }
+    return LOG_FORMATS[format].userArgs;
+}
+
+const char* LogLevelName(uint8_t level) {
+    switch (static_cast<LogLevel>(level)) {
+        case LogLevel::INFO: return "INFO";
+        case LogLevel::WARN: return "WARN";
+        case LogLevel::FATAL: return "FATAL";
+        case LogLevel::PASS: return "PASS";
+        case LogLevel::PROCESS: return "PROCESS";
+        case LogLevel::CONNECTION: return "CONNECTION";
+        default: return "UNKNOWN";
+    }
+}
+
+// 日志级别转字符串
+std::string LevelToString(LogLevel level) {
+    return LogLevelName(static_cast<uint8_t>(level));
+}
+
+bool ParseBlogRecord(const char* data, size_t size, BlogRecordView& record, size_t& recordSize) {
+    BlogRecordHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.length < sizeof(header) || header.length > size) {
+        return false;
+    }
+    record.format = header.format;
+    record.level = header.level;
+    record.timeUs = header.timeUs;
+    record.args = data + sizeof(header);
+    record.argsSize = header.length - sizeof(header);
+    recordSize = header.length;
+    return true;
+}
+
+bool NextLogArg(const char*& args, const char* end, LogArgValue& value) {
+    if (args >= end) {
+        return false;
+    }
+    value.tag = static_cast<uint8_t>(*args++);
+    if (value.tag == LOG_ARG_INT || value.tag == LOG_ARG_UINT) {
+        if (end - args < static_cast<ptrdiff_t>(sizeof(value.integer))) {
+            return false;
+        }
+        memcpy(&value.integer, args, sizeof(value.integer));
+        args += sizeof(value.integer);
+        return true;
+    }
+    if (value.tag == LOG_ARG_STR || value.tag == LOG_ARG_STR_CUT) {
+        if (end - args < static_cast<ptrdiff_t>(sizeof(value.length))) {
+            return false;
+        }
+        memcpy(&value.length, args, sizeof(value.length));
+        args += sizeof(value.length);
+        value.length = static_cast<uint16_t>(std::min<ptrdiff_t>(value.length, end - args));
+        value.str = args;
+        args += value.length;
+        return true;
+    }
+    return false;
+}
+
+size_t ExtractLogUsers(const BlogRecordView& record, uint8_t userArgs, uint8_t* users, size_t maxUsers) {
+    size_t count = 0;
+    const char* args = record.args;
+    const char* end = record.args + record.argsSize;
+    LogArgValue value;
+    for (unsigned index = 0; userArgs >> index && count < maxUsers && NextLogArg(args, end, value); ++index) {
+        if ((userArgs >> index) & 1 && (value.tag == LOG_ARG_INT || value.tag == LOG_ARG_UINT) &&
+            value.integer <= UINT8_MAX) {
+            users[count++] = static_cast<uint8_t>(value.integer);
+        }
+    }
+    return count;
+}
+
+bool ParseLogDefinition(const BlogRecordView& record, uint16_t& format, std::string& text, uint8_t& userArgs) {
+    if (record.format != LOG_FORMAT_DEFINE) {
+        return false;
+    }
+    const char* args = record.args;
+    const char* end = record.args + record.argsSize;
+    LogArgValue id, str, mask;
+    if (!NextLogArg(args, end, id) || id.tag != LOG_ARG_UINT ||
+        !NextLogArg(args, end, str) || str.tag != LOG_ARG_STR) {
+        return false;
+    }
+    format = static_cast<uint16_t>(id.integer);
+    text.assign(str.str, str.length);
+    // 早期的定义记录没有用户ID掩码，使用本程序的格式表
+    userArgs = NextLogArg(args, end, mask) && mask.tag == LOG_ARG_UINT ? static_cast<uint8_t>(mask.integer)
+                                                                        : LogFormatUserArgs(format);
+    return true;
+}
+
+std::string FormatLogArgs(const char* format, const char* args, size_t argsSize) {
+    std::string out;
+    const char* end = args + argsSize;
+    for (const char* p = format; *p; ++p) {
+        if (p[0] == '{' && p[1] == '}') {
+            LogArgValue value;
+            if (!NextLogArg(args, end, value)) {
+                out += "<缺失>";  // 参数区放不下而没有写入的参数
+            } else if (value.tag == LOG_ARG_STR || value.tag == LOG_ARG_STR_CUT) {
+                out.append(value.str, value.length);
+                if (value.tag == LOG_ARG_STR_CUT) {
+                    out += "…";
+                }
+            } else if (value.tag == LOG_ARG_INT) {
+                out += std::to_string(static_cast<int64_t>(value.integer));
+            } else {
+                out += std::to_string(value.integer);
+            }
+            ++p;
+        } else {
+            out += *p;
+        }
+    }
+    return out;
+}
+
+std::string FormatBlogRecord(const BlogRecordView& record, bool withLevel, const char* format) {
+    time_t seconds = static_cast<time_t>(record.timeUs / 1000000);
+    tm localTime;
+    localtime_s(&localTime, &seconds);
+    char timeStamp[32];
+    strftime(timeStamp, sizeof(timeStamp), "[%Y-%m-%d %H:%M:%S]", &localTime);
+
+    std::string line = timeStamp;
+    if (withLevel) {
+        line += '[';
+        line += LogLevelName(record.level);
+        line += ']';
+    } else {
+        line += ' ';
+    }
+
+    if (!format) {
+        format = LogFormatString(record.format);
+    }
+    if (format) {
+        line += FormatLogArgs(format, record.args, record.argsSize);
+    } else {
+        line += "<未知日志格式 " + std::to_string(record.format) + ">";
+    }
+    return line;
+}
+
+void AppendBlogRecord(std::string& out, uint16_t format, uint8_t level, uint64_t timeUs,
+                      const char* args, size_t argsSize) {
+    argsSize = std::min<size_t>(argsSize, UINT16_MAX - sizeof(BlogRecordHeader));
+    BlogRecordHeader header;
+    header.length = static_cast<uint16_t>(sizeof(header) + argsSize);
+    header.format = format;
+    header.level = level;
+    header.reserved = 0;
+    header.timeUs = timeUs;
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(args, argsSize);
+}
+
+void AppendBlogDefinitions(std::string& out, uint64_t timeUs) {
+    char args[512];
+    for (uint16_t format = 0; format < static_cast<uint16_t>(LogFmt::COUNT); ++format) {
+        LogArgWriter writer(args, sizeof(args));
+        writer.PutUInt(format);
+        writer.PutString(LOG_FORMATS[format].format, strlen(LOG_FORMATS[format].format));
+        writer.PutUInt(LOG_FORMATS[format].userArgs);
+        AppendBlogRecord(out, LOG_FORMAT_DEFINE, static_cast<uint8_t>(LogLevel::INFO), timeUs, args, writer.Size());
+    }
+}
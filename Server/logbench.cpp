@@ -0,0 +1,174 @@
+// 日志压测工具：多个线程同时写日志，比较改为异步之前的同步WriteLog（legacy）、现在的WriteLog（text）
+// 和结构化的WriteLogFmt（fmt）三种写法的调用方延迟和吞吐量
+// legacy在调用线程里格式化时间戳、写文件并立即刷新；text和fmt只把记录放进本线程的队列，由后台写线程写入
+// 用法：logbench [--mode legacy|text|fmt] [--threads 线程数] [--records 每线程条数] [--log-fsync none|batch|毫秒数]
+// 每次只测一种写法（各自独立的进程，互不影响），在空目录中运行，日志写到当前目录的log/下
+#include "headers/logger.h"
+#include "headers/latency.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+// 压测参数
+struct BenchOptions {
+    std::string mode = "text";
+    int threads = 4;
+    int records = 100000;
+};
+
+static BenchOptions g_options;
+static LatencyHistogram g_callLatency;  // 单次调用在调用线程上花的时间
+
+// ---- 改为异步之前的同步WriteLog（照搬原实现，只是给文件加了锁：原来多个线程同时写同一个ofstream） ----
+
+static std::ofstream g_legacyFile;
+static std::mutex g_legacyFileMutex;
+static std::vector<std::string> g_legacyForwardBuffer;
+static std::vector<std::string> g_legacyRequestBuffer;
+static std::vector<std::string> g_legacyUIBuffer;
+static std::mutex g_legacyForwardMutex;
+static std::mutex g_legacyRequestMutex;
+static std::mutex g_legacyUIMutex;
+
+static std::string LegacyTimeStamp() {
+    time_t currentTime = time(nullptr);
+    tm* localTime = localtime(&currentTime);
+    std::stringstream ss;
+    ss << "[" << std::put_time(localTime, "%Y-%m-%d %H:%M:%S") << "]";
+    return ss.str();
+}
+
+static void LegacyWriteLog(LogLevel level, const std::string& message) {
+    std::string fullLog = LegacyTimeStamp() + "[" + LevelToString(level) + "]" + message;
+    {
+        std::lock_guard<std::mutex> lock(g_legacyFileMutex);
+        g_legacyFile << fullLog << std::endl;
+        g_legacyFile.flush();
+    }
+    if (level == LogLevel::PASS) {
+        std::lock_guard<std::mutex> lock(g_legacyForwardMutex);
+        g_legacyForwardBuffer.push_back(LegacyTimeStamp() + " " + message);
+        if (g_legacyForwardBuffer.size() > 500) {
+            g_legacyForwardBuffer.erase(g_legacyForwardBuffer.begin());
+        }
+    } else if (level == LogLevel::PROCESS) {
+        std::lock_guard<std::mutex> lock(g_legacyRequestMutex);
+        g_legacyRequestBuffer.push_back(LegacyTimeStamp() + " " + message);
+        if (g_legacyRequestBuffer.size() > 500) {
+            g_legacyRequestBuffer.erase(g_legacyRequestBuffer.begin());
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(g_legacyUIMutex);
+        g_legacyUIBuffer.push_back(fullLog);
+        if (g_legacyUIBuffer.size() > 1000) {
+            g_legacyUIBuffer.erase(g_legacyUIBuffer.begin());
+        }
+    }
+}
+
+// ---- 压测 ----
+
+// 写一条转发日志（与ForwardToUser的“已转发”日志相同的内容）
+static void WriteOne(int index) {
+    uint8_t sender = static_cast<uint8_t>(index % 200 + 1);
+    uint8_t receiver = static_cast<uint8_t>(index % 199 + 2);
+    if (g_options.mode == "legacy") {
+        LegacyWriteLog(LogLevel::PASS, "来自" + std::to_string(sender) + "的私聊消息已转发给: " + std::to_string(receiver));
+    } else if (g_options.mode == "text") {
+        WriteLog(LogLevel::PASS, "来自" + std::to_string(sender) + "的私聊消息已转发给: " + std::to_string(receiver));
+    } else {
+        WriteLogFmt(LogLevel::PASS, LogFmt::FORWARD_DONE, sender, "私聊消息", receiver);
+    }
+}
+
+static void BenchThread(int threadIndex) {
+    for (int i = 0; i < g_options.records; ++i) {
+        BenchClock::time_point start = BenchClock::now();
+        WriteOne(threadIndex * g_options.records + i);
+        g_callLatency.Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(BenchClock::now() - start).count()));
+    }
+}
+
+static double SecondsSince(BenchClock::time_point since) {
+    return std::chrono::duration<double>(BenchClock::now() - since).count();
+}
+
+static void PrintUsage() {
+    std::cerr << "用法: logbench [--mode legacy|text|fmt] [--threads 线程数] [--records 每线程条数] "
+                 "[--log-fsync none|batch|毫秒数]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--mode" && (value == "legacy" || value == "text" || value == "fmt")) {
+            g_options.mode = value;
+        } else if (arg == "--threads") {
+            g_options.threads = std::max(1, atoi(value.c_str()));
+        } else if (arg == "--records") {
+            g_options.records = std::max(1, atoi(value.c_str()));
+        } else if (arg == "--log-fsync") {
+            LogFsyncPolicy policy;
+            int intervalMs = 1000;
+            if (!ParseLogFsyncPolicy(value, policy, intervalMs)) {
+                PrintUsage();
+                return 1;
+            }
+            SetLogFsyncPolicy(policy, intervalMs);
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (g_options.mode == "legacy") {
+        g_legacyFile.open("logbench_legacy.log", std::ios::out | std::ios::trunc);
+    } else {
+        InitializeLogFile();
+    }
+
+    BenchClock::time_point start = BenchClock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < g_options.threads; ++i) {
+        threads.emplace_back(BenchThread, i);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double callSeconds = SecondsSince(start);
+
+    // 异步写法要等后台写线程把队列写完才算真正写入
+    if (g_options.mode == "legacy") {
+        g_legacyFile.close();
+    } else {
+        CloseLogFile();
+    }
+    double totalSeconds = SecondsSince(start);
+
+    double records = static_cast<double>(g_options.threads) * g_options.records;
+    LatencySummary summary = SummarizeHistogram(g_callLatency);
+    printf("模式 %s, %d 线程 x %d 条\n", g_options.mode.c_str(), g_options.threads, g_options.records);
+    printf("调用方   %8.0f 条/秒  p50 %8.0fns  p99 %8.0fns  p999 %8.0fns  最大 %10.0fns\n", records / callSeconds,
+           static_cast<double>(summary.p50Ns), static_cast<double>(summary.p99Ns),
+           static_cast<double>(summary.p999Ns), static_cast<double>(summary.maxNs));
+    printf("写入完成 %8.0f 条/秒  共 %.3f 秒\n", records / totalSeconds, totalSeconds);
+    return 0;
+}
@@ -0,0 +1,77 @@
+// 二进制日志解码工具：把服务器写出的.blog文件转换为文本
+// 用法：logdecode <日志文件.blog> [输出文件]，不指定输出文件时输出到标准输出
+#include "headers/logFormat.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "用法: logdecode <日志文件.blog> [输出文件]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input.is_open()) {
+        std::cerr << "无法打开日志文件: " << argv[1] << std::endl;
+        return 1;
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+    std::ofstream outputFile;
+    if (argc >= 3) {
+        outputFile.open(argv[2], std::ios::out | std::ios::trunc);
+        if (!outputFile.is_open()) {
+            std::cerr << "无法创建输出文件: " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& output = argc >= 3 ? static_cast<std::ostream&>(outputFile) : std::cout;
+
+    BlogFileHeader fileHeader;
+    if (data.size() < sizeof(fileHeader)) {
+        std::cerr << "不是有效的二进制日志文件: " << argv[1] << std::endl;
+        return 1;
+    }
+    memcpy(&fileHeader, data.data(), sizeof(fileHeader));
+    if (memcmp(fileHeader.magic, BLOG_MAGIC, sizeof(BLOG_MAGIC)) != 0 || fileHeader.version != BLOG_VERSION) {
+        std::cerr << "不是有效的二进制日志文件: " << argv[1] << std::endl;
+        return 1;
+    }
+
+    // 文件中的格式定义优先于本程序编译时的格式表
+    std::map<uint16_t, std::string> formats;
+    size_t offset = sizeof(fileHeader);
+    size_t recordCount = 0;
+    while (offset < data.size()) {
+        BlogRecordView record;
+        size_t recordSize = 0;
+        if (!ParseBlogRecord(data.data() + offset, data.size() - offset, record, recordSize)) {
+            std::cerr << "日志文件在偏移 " << offset << " 处损坏或不完整，已停止解码" << std::endl;
+            break;
+        }
+        offset += recordSize;
+
+        if (record.format == LOG_FORMAT_DEFINE) {
+            uint16_t format = 0;
+            uint8_t userArgs = 0;
+            std::string text;
+            if (ParseLogDefinition(record, format, text, userArgs)) {
+                formats[format] = text;
+            }
+            continue;
+        }
+
+        auto it = formats.find(record.format);
+        output << FormatBlogRecord(record, true, it != formats.end() ? it->second.c_str() : nullptr) << "\n";
+        recordCount++;
+    }
+
+    output.flush();
+    std::cerr << "共解码 " << recordCount << " 条日志" << std::endl;
+    return 0;
+}
@@ -1,101 +1,573 @@
 
 #include "headers/logger.h"
+#include "headers/logFormat.h"
+#include "headers/logArchive.h"
+#include "headers/statsSegment.h"
 #include <ctime>
 #include <sstream>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
 #include <vector>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <winsock2.h>
+#include <windows.h>
 
 // 全局变量定义
-std::ofstream logFile;
+static HANDLE logFile = INVALID_HANDLE_VALUE;
 
 
-// UI日志缓冲区
-std::vector<std::string> g_forwardMsgBuffer;
-std::vector<std::string> g_requestMsgBuffer;
-std::vector<std::string> g_uiLogBuffer;
-std::mutex g_forwardMsgMutex;  // 转发消息专用锁
-std::mutex g_requestMsgMutex;  // 请求消息专用锁
-std::mutex g_uiLogMutex;       // 日志缓冲区专用锁
+// UI日志缓冲区（状态发布线程每100毫秒取一次，容量要能放下两次之间的日志，与共享内存中的日志尾部一致）
+UILogRing g_forwardMsgRing(STATS_LOG_LINES);
+UILogRing g_requestMsgRing(STATS_LOG_LINES);
+UILogRing g_uiLogRing(STATS_LOG_LINES);
+
+UILogRing::UILogRing(size_t capacity) : capacity_(capacity), slots_(new Slot[capacity]) {
+}
+
+void UILogRing::Push(const char* data, size_t size) {
+    uint64_t seq = head_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[seq % capacity_];
+    slot.version.store(2 * seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    size_t length = std::min(size, RECORD_CAPACITY);
+    memcpy(slot.data, data, length);
+    slot.length = static_cast<uint16_t>(length);
+    slot.version.store(2 * seq + 2, std::memory_order_release);
+    head_.store(seq + 1, std::memory_order_release);
+}
+
+uint64_t UILogRing::ReadSince(uint64_t fromSeq, std::vector<std::string>& out) const {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (head > capacity_ && fromSeq < head - capacity_) {
+        fromSeq = head - capacity_;  // 更早的已经被覆盖
+    }
+    char data[RECORD_CAPACITY];
+    for (uint64_t seq = fromSeq; seq < head; ++seq) {
+        const Slot& slot = slots_[seq % capacity_];
+        uint64_t before = slot.version.load(std::memory_order_acquire);
+        if (before != 2 * seq + 2) {
+            continue;  // 读的过程中已经被新记录覆盖
+        }
+        size_t length = std::min<size_t>(slot.length, RECORD_CAPACITY);
+        memcpy(data, slot.data, length);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.version.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+        out.emplace_back(data, length);
+    }
+    return head;
+}
+
+// 一条待写的日志记录：文本日志保存整段文本，结构化日志保存格式ID和编码后的参数
+struct LogRecord {
+    LogLevel level;
+    LogFmt format;
+    uint16_t argsSize;
+    std::chrono::system_clock::time_point time;
+    std::string text;              // LogFmt::TEXT的文本
+    char args[LOG_INLINE_ARGS];    // 其他格式的参数区
+};
+
+// 每个线程一个的单生产者单消费者环形队列：生产者是写日志的线程，消费者是后台写线程
+// head_和tail_只增不减，分别放在不同的缓存行里，避免两边互相抢缓存行
+class LogRing {
+public:
+    static const size_t CAPACITY = 512;  // 必须是2的幂
+
+    // 直接在槽位里填写记录，省去一次拷贝
+    template <typename Fill>
+    bool TryPush(Fill&& fill) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= CAPACITY) {
+            return false;
+        }
+        fill(slots_[head & (CAPACITY - 1)]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 取出当前所有记录（只在写线程中调用）
+    size_t Drain(std::vector<LogRecord>& out) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        for (size_t i = tail; i != head; ++i) {
+            out.push_back(std::move(slots_[i & (CAPACITY - 1)]));
+        }
+        tail_.store(head, std::memory_order_release);
+        return head - tail;
+    }
+
+    bool Empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    std::atomic<bool> closed{false};  // 所属线程已退出，队列取空后即可回收
+
+private:
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+    LogRecord slots_[CAPACITY];
+};
+
+// 所有线程的日志队列（写线程遍历它们取记录）
+static std::mutex& RingRegistryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+static std::vector<std::shared_ptr<LogRing>>& RingRegistry() {
+    static std::vector<std::shared_ptr<LogRing>> rings;
+    return rings;
+}
+
+// 线程第一次写日志时创建并登记自己的队列，线程退出时标记为关闭
+struct ThreadLogRing {
+    std::shared_ptr<LogRing> ring;
+    ThreadLogRing() : ring(std::make_shared<LogRing>()) {
+        std::lock_guard<std::mutex> lock(RingRegistryMutex());
+        RingRegistry().push_back(ring);
+    }
+    ~ThreadLogRing() {
+        ring->closed.store(true, std::memory_order_release);
+    }
+};
+
+static LogRing& LocalRing() {
+    thread_local ThreadLogRing local;
+    return *local.ring;
+}
+
+// 后台写线程状态
+static std::thread g_logWriterThread;
+static std::atomic<bool> g_logWriterRunning{false};
+static std::atomic<bool> g_logStopping{false};
+static std::atomic<bool> g_logUrgent{false};
+static std::mutex g_logWakeMutex;
+static std::condition_variable g_logWakeCv;
+static std::atomic<uint64_t> g_droppedLogs{0};      // 写线程未启动时队列满而丢弃的记录数（累计，指标端点输出）
+static std::atomic<int> g_fsyncPolicy{static_cast<int>(LogFsyncPolicy::INTERVAL)};
+static std::atomic<int> g_fsyncIntervalMs{1000};
+
+static const std::chrono::milliseconds LOG_WRITER_PERIOD(10);  // 写线程的最长等待时间
+static const size_t LOG_WRITE_BUFFER = 256 * 1024;            // 单次写文件的缓冲区大小
+
+// 日志分段：每天至少一个新段，单个段超过上限也换新段；关闭的段交给后台压缩线程归档
+static const char* LOG_FOLDER = "log";
+static const uint64_t LOG_SEGMENT_MAX = 64ull * 1024 * 1024;  // 单个日志段的大小上限
+static std::string g_segmentPath;    // 当前日志段（只在写线程和初始化/关闭时访问）
+static uint64_t g_segmentSize = 0;
+static int g_segmentDay = 0;         // 当前日志段的日期（YYYYMMDD）
+
+// 后台压缩线程状态
+static std::thread g_compressThread;
+static std::deque<std::string> g_compressQueue;
+static std::mutex g_compressMutex;
+static std::condition_variable g_compressCv;
+static bool g_compressStopping = false;
+
+// 线程安全地转换为本地时间
+static void LocalTime(time_t currentTime, tm& localTime) {
+    localtime_s(&localTime, &currentTime);
+}
 
 // 获取时间戳
 std::string TimeStamp() {
     time_t currentTime = time(nullptr); //不是可直接阅读的日历时间
-    tm* localTime = localtime(&currentTime); //转换为服务器本地时间
+    tm localTime;
+    LocalTime(currentTime, localTime); //转换为服务器本地时间
     std::stringstream ss; // 开始生成时间戳
-    ss << "[" << std::put_time(localTime, "%Y-%m-%d %H:%M:%S") << "]";
+    ss << "[" << std::put_time(&localTime, "%Y-%m-%d %H:%M:%S") << "]";
     return ss.str();
 }
 
-std::string FileNameGen() { // 将日志以当前日期命名，但是不包含具体时间，逻辑与获取时间戳函数一致
-    time_t currentTime = time(nullptr);
-    tm* localTime = localtime(&currentTime);
-    std::stringstream fname;
-    fname << std::put_time(localTime, "%Y%m%d");
-    fname << ".log";
-    return fname.str();
+// 本地日期（YYYYMMDD）
+static int LocalDay(time_t seconds) {
+    tm localTime;
+    LocalTime(seconds, localTime);
+    return (localTime.tm_year + 1900) * 10000 + (localTime.tm_mon + 1) * 100 + localTime.tm_mday;
 }
 
-// 日志级别转字符串
-std::string LevelToString(LogLevel level) {
-    switch (level) {
-        case LogLevel::INFO: return "INFO";
-        case LogLevel::WARN: return "WARN";
-        case LogLevel::FATAL: return "FATAL";
-        case LogLevel::PASS: return "PASS";
-        case LogLevel::PROCESS: return "PROCESS";
-        case LogLevel::CONNECTION: return "CONNECTION";
-        default: return "UNKNOWN";
+// 记录所属的日期，同一秒内复用上次的结果（只在写线程中使用）
+class DayCache {
+public:
+    int Get(std::chrono::system_clock::time_point time) {
+        time_t seconds = std::chrono::system_clock::to_time_t(time);
+        if (seconds != cachedSecond_) {
+            cachedDay_ = LocalDay(seconds);
+            cachedSecond_ = seconds;
+        }
+        return cachedDay_;
     }
+
+private:
+    time_t cachedSecond_ = -1;
+    int cachedDay_ = 0;
+};
+
+static uint64_t ToUnixMicros(std::chrono::system_clock::time_point time) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        time.time_since_epoch()).count());
 }
-// 日志写入函数
-void WriteLog(LogLevel level, const std::string& message) { //包含两个参数：重要级，消息内容
-    std::string fullLog = TimeStamp() + "[" + LevelToString(level) + "]" + message;
-    
-    if (logFile.is_open()) {
-        logFile << fullLog << std::endl;
-        logFile.flush(); //立即刷新缓冲区
-    }
-    
-    // 添加到UI日志缓冲区
-    if (level == LogLevel::PASS) {
-        std::lock_guard<std::mutex> lock(g_forwardMsgMutex);
-        g_forwardMsgBuffer.push_back(TimeStamp() + " " + message);
-        if (g_forwardMsgBuffer.size() > 500) {
-        g_forwardMsgBuffer.erase(g_forwardMsgBuffer.begin());
-        }
-    } else if (level == LogLevel::PROCESS) {
-        std::lock_guard<std::mutex> lock(g_requestMsgMutex);
-        g_requestMsgBuffer.push_back(TimeStamp() + " " + message);
-        if (g_requestMsgBuffer.size() > 500) {
-        g_requestMsgBuffer.erase(g_requestMsgBuffer.begin());
-        }
+
+// 把一条记录编码为.blog格式追加到out；文本日志超过maxText字节时截断
+static void EncodeRecord(std::string& out, const LogRecord& record, size_t maxText) {
+    if (record.format == LogFmt::TEXT) {
+        std::vector<char> args(std::min(record.text.size(), maxText) + 3);
+        LogArgWriter writer(args.data(), args.size());
+        writer.PutString(record.text.data(), record.text.size());
+        AppendBlogRecord(out, static_cast<uint16_t>(record.format), static_cast<uint8_t>(record.level),
+                         ToUnixMicros(record.time), args.data(), writer.Size());
     } else {
-        std::lock_guard<std::mutex> lock(g_uiLogMutex);
-        g_uiLogBuffer.push_back(fullLog);
-        if (g_uiLogBuffer.size() > 1000) {
-        g_uiLogBuffer.erase(g_uiLogBuffer.begin());
+        AppendBlogRecord(out, static_cast<uint16_t>(record.format), static_cast<uint8_t>(record.level),
+                         ToUnixMicros(record.time), record.args, record.argsSize);
+    }
+}
+
+static void WriteToFile(const std::string& data) {
+    if (logFile == INVALID_HANDLE_VALUE || data.empty()) {
+        return;
+    }
+    DWORD written = 0;
+    WriteFile(logFile, data.data(), static_cast<DWORD>(data.size()), &written, nullptr);
+    g_segmentSize += written;
+}
+
+// 日志段文件名：log/YYYYMMDD_NNN.blog
+static std::string SegmentFileName(int day, int index) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s/%08d_%03d.blog", LOG_FOLDER, day, index);
+    return name;
+}
+
+// 打开指定日期的新日志段（编号取当天第一个未使用的），写入文件头和格式定义
+static bool OpenSegment(int day) {
+    std::string path;
+    for (int index = 0; ; ++index) {
+        path = SegmentFileName(day, index);
+        if (!std::filesystem::exists(path) && !std::filesystem::exists(path + ".zst")) {
+            break;
+        }
+    }
+    logFile = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                          CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (logFile == INVALID_HANDLE_VALUE) {
+        std::cerr << "无法打开日志文件：" << path << std::endl; // 此时无法写入日志（当然）
+        return false;
+    }
+    g_segmentPath = path;
+    g_segmentSize = 0;
+    g_segmentDay = day;
+
+    // 每个段都自带文件头和格式定义，可以单独解码
+    std::string header;
+    BlogFileHeader fileHeader;
+    memcpy(fileHeader.magic, BLOG_MAGIC, sizeof(fileHeader.magic));
+    fileHeader.version = BLOG_VERSION;
+    header.append(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+    AppendBlogDefinitions(header, ToUnixMicros(std::chrono::system_clock::now()));
+    WriteToFile(header);
+    return true;
+}
+
+// 关闭当前日志段，compress为true时交给后台压缩线程
+static void CloseSegment(bool compress) {
+    if (logFile == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    FlushFileBuffers(logFile);
+    CloseHandle(logFile);
+    logFile = INVALID_HANDLE_VALUE;
+    if (compress) {
+        std::lock_guard<std::mutex> lock(g_compressMutex);
+        g_compressQueue.push_back(g_segmentPath);
+        g_compressCv.notify_one();
+    }
+}
+
+// 后台压缩线程：依次把关闭的日志段压缩归档
+static void LogCompressThread() {
+    while (true) {
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lock(g_compressMutex);
+            g_compressCv.wait(lock, [] { return g_compressStopping || !g_compressQueue.empty(); });
+            if (g_compressStopping) {
+                return;  // 没压缩完的段下次启动时继续
+            }
+            path = g_compressQueue.front();
+            g_compressQueue.pop_front();
+        }
+
+        std::string error;
+        if (CompressLogSegment(path, error)) {
+            WriteLog(LogLevel::INFO, "日志段已压缩归档: " + path);
+        } else {
+            WriteLog(LogLevel::WARN, "日志段压缩失败: " + path + ", " + error);
+        }
+    }
+}
+
+// 添加到UI日志缓冲区（放入编码后的记录，由Monitor自己格式化）
+static void AppendToUIBuffers(const std::vector<LogRecord>& batch) {
+    std::string encoded;
+    for (const LogRecord& record : batch) {
+        encoded.clear();
+        EncodeRecord(encoded, record, UILogRing::RECORD_CAPACITY - sizeof(BlogRecordHeader) - 3);
+        if (record.level == LogLevel::PASS) {
+            g_forwardMsgRing.Push(encoded.data(), encoded.size());
+        } else if (record.level == LogLevel::PROCESS) {
+            g_requestMsgRing.Push(encoded.data(), encoded.size());
+        } else {
+            g_uiLogRing.Push(encoded.data(), encoded.size());
+        }
+    }
+}
+
+// 写线程自己的通知（换段、丢弃计数）直接编码进待写的缓冲区：
+// 写线程调用WriteLog会放进它自己的队列，要等下一轮才写出，队列满时还会等待自己腾出空间
+static void AppendWriterNotice(std::string& out, LogLevel level, std::chrono::system_clock::time_point time,
+                               const std::string& text) {
+    LogRecord notice;
+    notice.level = level;
+    notice.format = LogFmt::TEXT;
+    notice.argsSize = 0;
+    notice.time = time;
+    notice.text = text;
+    EncodeRecord(out, notice, UINT16_MAX);
+}
+
+// 后台写线程：取出所有队列中的记录，编码后整批写入
+static void LogWriterThread() {
+    std::vector<LogRecord> batch;
+    std::vector<std::shared_ptr<LogRing>> rings;
+    std::string out;
+    out.reserve(LOG_WRITE_BUFFER);
+    auto lastFsync = std::chrono::steady_clock::now();
+    DayCache dayCache;
+    uint64_t reportedDrops = 0;  // 已经写进文件的丢弃计数
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(g_logWakeMutex);
+            g_logWakeCv.wait_for(lock, LOG_WRITER_PERIOD, [] {
+                return g_logUrgent.load() || g_logStopping.load();
+            });
+            g_logUrgent.store(false);
+        }
+        bool stopping = g_logStopping.load();
+
+        // 取出所有队列的记录，顺便回收线程已退出且已取空的队列
+        {
+            std::lock_guard<std::mutex> lock(RingRegistryMutex());
+            std::vector<std::shared_ptr<LogRing>>& registry = RingRegistry();
+            registry.erase(std::remove_if(registry.begin(), registry.end(), [](const std::shared_ptr<LogRing>& ring) {
+                return ring->closed.load(std::memory_order_acquire) && ring->Empty();
+            }), registry.end());
+            rings = registry;
+        }
+        batch.clear();
+        for (const auto& ring : rings) {
+            ring->Drain(batch);
+        }
+        rings.clear();
+
+        if (!batch.empty()) {
+            // 每个队列内部有序，合并后按时间排序，保证文件中的顺序与发生顺序一致
+            std::stable_sort(batch.begin(), batch.end(), [](const LogRecord& a, const LogRecord& b) {
+                return a.time < b.time;
+            });
+
+            out.clear();
+            uint64_t dropped = g_droppedLogs.load(std::memory_order_relaxed);
+            if (dropped > reportedDrops) {
+                AppendWriterNotice(out, LogLevel::WARN, batch.front().time,
+                                   "日志队列溢出，累计丢弃 " + std::to_string(dropped) + " 条日志");
+                reportedDrops = dropped;
+            }
+            for (const LogRecord& record : batch) {
+                // 跨天或当前段写满时换新段
+                int day = dayCache.Get(record.time);
+                if (logFile != INVALID_HANDLE_VALUE &&
+                    (day != g_segmentDay || g_segmentSize + out.size() >= LOG_SEGMENT_MAX)) {
+                    WriteToFile(out);
+                    out.clear();
+                    std::string oldPath = g_segmentPath;
+                    CloseSegment(true);
+                    if (OpenSegment(day)) {
+                        AppendWriterNotice(out, LogLevel::INFO, record.time,
+                                           "日志文件已切换: " + oldPath + " -> " + g_segmentPath);
+                    }
+                }
+                EncodeRecord(out, record, UINT16_MAX);
+                if (out.size() >= LOG_WRITE_BUFFER) {
+                    WriteToFile(out);
+                    out.clear();
+                }
+            }
+            WriteToFile(out);
+            AppendToUIBuffers(batch);
+
+            LogFsyncPolicy policy = static_cast<LogFsyncPolicy>(g_fsyncPolicy.load());
+            auto now = std::chrono::steady_clock::now();
+            bool fsync = policy == LogFsyncPolicy::EVERY_BATCH ||
+                         (policy == LogFsyncPolicy::INTERVAL &&
+                          now - lastFsync >= std::chrono::milliseconds(g_fsyncIntervalMs.load()));
+            if (fsync && logFile != INVALID_HANDLE_VALUE) {
+                FlushFileBuffers(logFile);
+                lastFsync = now;
+            }
+        }
+
+        if (stopping) {
+            break;
         }
     }
 }
 
+template <typename Fill>
+static void PushRecord(LogLevel level, Fill&& fill) {
+    LogRing& ring = LocalRing();
+    while (!ring.TryPush(fill)) {
+        // 队列满：写线程在运行就叫醒它并等待腾出空间，否则（启动前/关闭后）只能丢弃
+        if (!g_logWriterRunning.load(std::memory_order_acquire)) {
+            g_droppedLogs.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        g_logUrgent.store(true);
+        g_logWakeCv.notify_one();
+        std::this_thread::yield();
+    }
+    if (level == LogLevel::FATAL) {
+        g_logUrgent.store(true);
+        g_logWakeCv.notify_one();
+    }
+}
+
+uint64_t GetDroppedLogCount() {
+    return g_droppedLogs.load(std::memory_order_relaxed);
+}
+
+// 日志写入函数
+void WriteLog(LogLevel level, const std::string& message) { //包含两个参数：重要级，消息内容
+    auto now = std::chrono::system_clock::now();
+    PushRecord(level, [&](LogRecord& record) {
+        record.level = level;
+        record.format = LogFmt::TEXT;
+        record.argsSize = 0;
+        record.time = now;
+        record.text = message;
+    });
+}
+
+void WriteLog(LogLevel level, std::string&& message) {
+    auto now = std::chrono::system_clock::now();
+    PushRecord(level, [&](LogRecord& record) {
+        record.level = level;
+        record.format = LogFmt::TEXT;
+        record.argsSize = 0;
+        record.time = now;
+        record.text = std::move(message);
+    });
+}
+
+void WriteLogEncoded(LogLevel level, LogFmt format, const char* args, size_t argsSize) {
+    auto now = std::chrono::system_clock::now();
+    argsSize = std::min(argsSize, LOG_INLINE_ARGS);
+    PushRecord(level, [&](LogRecord& record) {
+        record.level = level;
+        record.format = format;
+        record.argsSize = static_cast<uint16_t>(argsSize);
+        record.time = now;
+        memcpy(record.args, args, argsSize);
+    });
+}
+
+void SetLogFsyncPolicy(LogFsyncPolicy policy, int intervalMs) {
+    g_fsyncPolicy.store(static_cast<int>(policy));
+    g_fsyncIntervalMs.store(intervalMs);
+}
+
+bool ParseLogFsyncPolicy(const std::string& text, LogFsyncPolicy& policy, int& intervalMs) {
+    if (text == "none") {
+        policy = LogFsyncPolicy::NONE;
+        return true;
+    }
+    if (text == "batch") {
+        policy = LogFsyncPolicy::EVERY_BATCH;
+        return true;
+    }
+    char* end = nullptr;
+    long value = strtol(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || value <= 0 || value > 3600 * 1000) {
+        return false;
+    }
+    policy = LogFsyncPolicy::INTERVAL;
+    intervalMs = static_cast<int>(value);
+    return true;
+}
+
 
 void InitializeLogFile() {
-    const std::string LOG_FOLDER = "log/";
-    std::string logfilename = LOG_FOLDER + FileNameGen();
-    logFile.open(logfilename, std::ios::out | std::ios::app);
-    if (!logFile.is_open()) {
-        std::cerr << "无法打开日志文件：" << logfilename << std::endl; // 此时无法写入日志（当然）
-    } else {
-        std::string message = "日志文件初始化成功：" + logfilename;
-        WriteLog(LogLevel::INFO, message);
+    std::error_code ec;
+    std::filesystem::create_directories(LOG_FOLDER, ec);
+    bool opened = OpenSegment(LocalDay(time(nullptr)));
+
+    // 即使文件打不开也启动写线程，UI缓冲区仍然需要它
+    if (!g_logWriterRunning.exchange(true)) {
+        g_logStopping.store(false);
+        g_logWriterThread = std::thread(LogWriterThread);
+    }
+
+    // 上次运行留下的未压缩日志段（除了刚打开的）交给压缩线程
+    {
+        std::lock_guard<std::mutex> lock(g_compressMutex);
+        g_compressStopping = false;
+        for (const auto& entry : std::filesystem::directory_iterator(LOG_FOLDER, ec)) {
+            std::string path = std::string(LOG_FOLDER) + "/" + entry.path().filename().string();
+            if (entry.path().extension() == ".blog" && path != g_segmentPath) {
+                g_compressQueue.push_back(path);
+            }
+        }
+    }
+    if (!g_compressThread.joinable()) {
+        g_compressThread = std::thread(LogCompressThread);
+    }
+
+    if (opened) {
+        WriteLog(LogLevel::INFO, "日志文件初始化成功：" + g_segmentPath);
     }
 }
 
 void CloseLogFile() {
-    if (logFile.is_open()) {
+    if (logFile != INVALID_HANDLE_VALUE) {
         WriteLog(LogLevel::INFO, "关闭日志文件");
-        logFile.close();
+    }
+    if (g_logWriterRunning.load()) {
+        g_logStopping.store(true);
+        g_logWakeCv.notify_one();
+        if (g_logWriterThread.joinable()) {
+            g_logWriterThread.join();
+        }
+        g_logWriterRunning.store(false);
+    }
+    CloseSegment(false);
+
+    {
+        std::lock_guard<std::mutex> lock(g_compressMutex);
+        g_compressStopping = true;
+        g_compressCv.notify_one();
+    }
+    if (g_compressThread.joinable()) {
+        g_compressThread.join();
     }
 }
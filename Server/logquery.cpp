@@ -0,0 +1,224 @@
+// 日志查询工具：从日志目录中按时间范围和/或用户ID取出日志，输出为文本
+// 已归档的日志段先查稀疏索引，只解压可能匹配的帧；还没压缩的日志段直接扫描
+// 用法：logquery [--dir 日志目录] [--from "YYYY-MM-DD HH:MM:SS"] [--to "YYYY-MM-DD HH:MM:SS"] [--user 用户ID]
+#include "headers/logArchive.h"
+#include <cstdio>
+#include <ctime>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+// 查询条件
+struct LogQuery {
+    uint64_t fromUs = 0;
+    uint64_t toUs = UINT64_MAX;
+    bool filterUser = false;
+    uint8_t userID = 0;
+};
+
+// 一个日志段的格式表（以文件中的定义为准）
+struct SegmentFormats {
+    std::map<uint16_t, std::string> text;
+    std::map<uint16_t, uint8_t> userArgs;
+};
+
+// 解析"YYYY-MM-DD HH:MM:SS"或"YYYY-MM-DD"（本地时间）
+static bool ParseLocalTime(const std::string& text, uint64_t& timeUs) {
+    tm localTime = {};
+    int fields = sscanf(text.c_str(), "%d-%d-%d %d:%d:%d", &localTime.tm_year, &localTime.tm_mon, &localTime.tm_mday,
+                        &localTime.tm_hour, &localTime.tm_min, &localTime.tm_sec);
+    if (fields != 3 && fields != 6) {
+        return false;
+    }
+    localTime.tm_year -= 1900;
+    localTime.tm_mon -= 1;
+    localTime.tm_isdst = -1;
+    time_t seconds = mktime(&localTime);
+    if (seconds < 0) {
+        return false;
+    }
+    timeUs = static_cast<uint64_t>(seconds) * 1000000;
+    return true;
+}
+
+// 处理一段连续的记录：格式定义更新格式表，其余记录按条件筛选后输出
+static size_t ScanRecords(const char* data, size_t size, const LogQuery& query, SegmentFormats& formats) {
+    size_t matched = 0;
+    size_t offset = 0;
+    while (offset < size) {
+        BlogRecordView record;
+        size_t recordSize = 0;
+        if (!ParseBlogRecord(data + offset, size - offset, record, recordSize)) {
+            break;
+        }
+        offset += recordSize;
+
+        if (record.format == LOG_FORMAT_DEFINE) {
+            uint16_t format = 0;
+            uint8_t userArgs = 0;
+            std::string text;
+            if (ParseLogDefinition(record, format, text, userArgs)) {
+                formats.text[format] = text;
+                formats.userArgs[format] = userArgs;
+            }
+            continue;
+        }
+        if (record.timeUs < query.fromUs || record.timeUs > query.toUs) {
+            continue;
+        }
+        if (query.filterUser) {
+            auto it = formats.userArgs.find(record.format);
+            uint8_t mask = it != formats.userArgs.end() ? it->second : LogFormatUserArgs(record.format);
+            uint8_t users[8];
+            size_t userCount = ExtractLogUsers(record, mask, users, sizeof(users));
+            if (std::find(users, users + userCount, query.userID) == users + userCount) {
+                continue;
+            }
+        }
+
+        auto it = formats.text.find(record.format);
+        std::cout << FormatBlogRecord(record, true, it != formats.text.end() ? it->second.c_str() : nullptr) << "\n";
+        matched++;
+    }
+    return matched;
+}
+
+// 查询已归档的日志段：只解压时间范围和用户位图可能匹配的帧
+static size_t QueryArchive(const std::string& segmentPath, const LogQuery& query, size_t& framesRead) {
+    std::string error;
+    std::vector<BlogFrameIndex> frames;
+    if (!ReadLogIndex(segmentPath + ".idx", frames, error)) {
+        std::cerr << segmentPath << ": " << error << std::endl;
+        return 0;
+    }
+
+    std::vector<size_t> selected;
+    for (size_t i = 1; i < frames.size(); ++i) {
+        const BlogFrameIndex& frame = frames[i];
+        if (frame.lastTimeUs < query.fromUs || frame.firstTimeUs > query.toUs) {
+            continue;
+        }
+        if (query.filterUser && !FrameHasUser(frame, query.userID)) {
+            continue;
+        }
+        selected.push_back(i);
+    }
+    if (selected.empty()) {
+        return 0;
+    }
+
+    // 第0帧是文件头和格式定义
+    SegmentFormats formats;
+    std::vector<char> data;
+    std::string archivePath = segmentPath + ".zst";
+    if (!frames.empty() && ReadLogFrame(archivePath, frames[0], data, error) && data.size() >= sizeof(BlogFileHeader)) {
+        ScanRecords(data.data() + sizeof(BlogFileHeader), data.size() - sizeof(BlogFileHeader), query, formats);
+        framesRead++;
+    }
+
+    size_t matched = 0;
+    for (size_t i : selected) {
+        if (!ReadLogFrame(archivePath, frames[i], data, error)) {
+            std::cerr << archivePath << ": " << error << std::endl;
+            continue;
+        }
+        matched += ScanRecords(data.data(), data.size(), query, formats);
+        framesRead++;
+    }
+    return matched;
+}
+
+// 查询还没压缩的日志段（当前正在写的段，或者等待压缩的段）
+static size_t QueryRawSegment(const std::string& path, const LogQuery& query) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    BlogFileHeader fileHeader;
+    if (data.size() < sizeof(fileHeader)) {
+        return 0;
+    }
+    memcpy(&fileHeader, data.data(), sizeof(fileHeader));
+    if (memcmp(fileHeader.magic, BLOG_MAGIC, sizeof(BLOG_MAGIC)) != 0) {
+        return 0;
+    }
+    SegmentFormats formats;
+    return ScanRecords(data.data() + sizeof(fileHeader), data.size() - sizeof(fileHeader), query, formats);
+}
+
+static void PrintUsage() {
+    std::cerr << "用法: logquery [--dir 日志目录] [--from \"YYYY-MM-DD HH:MM:SS\"] [--to \"YYYY-MM-DD HH:MM:SS\"] [--user 用户ID]"
+              << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string directory = "log";
+    LogQuery query;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--dir") {
+            directory = value;
+        } else if (arg == "--from") {
+            if (!ParseLocalTime(value, query.fromUs)) {
+                std::cerr << "无效的时间: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--to") {
+            if (!ParseLocalTime(value, query.toUs)) {
+                std::cerr << "无效的时间: " << value << std::endl;
+                return 1;
+            }
+            if (value.find(':') == std::string::npos) {
+                query.toUs += 24ull * 3600 * 1000000 - 1;  // 只给日期时包含当天全天
+            }
+        } else if (arg == "--user") {
+            int userID = atoi(value.c_str());
+            if (userID < 0 || userID > 255) {
+                std::cerr << "无效的用户ID: " << value << std::endl;
+                return 1;
+            }
+            query.filterUser = true;
+            query.userID = static_cast<uint8_t>(userID);
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    // 日志段名为YYYYMMDD_NNN，按名字排序就是时间顺序；同一段可能同时有原文件和归档（压缩中途），以归档为准
+    std::map<std::string, bool> segments;  // 段路径 -> 是否已归档
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        std::string path = entry.path().string();
+        if (path.size() > 9 && path.compare(path.size() - 9, 9, ".blog.idx") == 0) {
+            segments[path.substr(0, path.size() - 4)] = true;
+        } else if (path.size() > 5 && path.compare(path.size() - 5, 5, ".blog") == 0) {
+            segments.emplace(path, false);
+        }
+    }
+    if (ec) {
+        std::cerr << "无法读取日志目录: " << directory << std::endl;
+        return 1;
+    }
+
+    size_t matched = 0;
+    size_t framesRead = 0;
+    for (const auto& segment : segments) {
+        matched += segment.second ? QueryArchive(segment.first, query, framesRead)
+                                  : QueryRawSegment(segment.first, query);
+    }
+    std::cout.flush();
+    std::cerr << "共找到 " << matched << " 条日志（解压 " << framesRead << " 个帧）" << std::endl;
+    return 0;
+}
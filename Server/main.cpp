@@ -1,6 +1,8 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 #include <thread>
 // 网络连接部分
 #include <winsock2.h>
@@ -14,6 +16,13 @@
 #include "headers/handleClient.h"
 #include "headers/Monitor.h"
 #include "headers/aiService.h"
+#include "headers/offlineStore.h"
+#include "headers/accountStore.h"
+#include "headers/historyStore.h"
+#include "headers/groupTimeline.h"
+#include "headers/metrics.h"
+#include "headers/trace.h"
+#include "headers/statsPublisher.h"
 
 // TODO: 添加监视窗口，包含用户列表，群聊列表，在线客户端列表，usersession跟踪，手动控制map绑定
 
@@ -21,19 +30,69 @@
 extern const int PORT = 8888;
 extern const int BACKLOG = 5;
 extern const int HEARTBEAT_TIMEOUT = 30;
+extern const int METRICS_PORT = 9100;  // 指标端点默认端口（可用--metrics-port修改），默认只监听127.0.0.1
+
+
+int main(int argc, char* argv[]) {
+    // 命令行参数：--headless 不启动监视窗口（没有图形界面的机器上运行），--metrics-port 指标端点端口，
+    // --metrics-public 指标端点监听所有网卡（默认只监听127.0.0.1），
+    // --trace-sample N 开启请求追踪，每N条消息追踪1条，
+    // --metrics-trace-control 允许本机通过指标端点的/trace?sample=N在运行中修改采样率，
+    // --log-fsync none|batch|毫秒数 日志刷盘策略（默认每1000毫秒刷盘一次）
+    bool headless = false;
+    int metricsPort = METRICS_PORT;
+    bool metricsPublic = false;
+    bool metricsTraceControl = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            metricsPort = atoi(argv[++i]);
+        } else if (arg == "--metrics-public") {
+            metricsPublic = true;
+        } else if (arg == "--metrics-trace-control") {
+            metricsTraceControl = true;
+        } else if (arg == "--trace-sample" && i + 1 < argc) {
+            SetTraceSampleRate(static_cast<uint32_t>(std::max(0, atoi(argv[++i]))));
+        } else if (arg == "--log-fsync" && i + 1 < argc) {
+            // none：不主动刷盘；batch：每批都刷盘；数字：按间隔（毫秒）刷盘
+            LogFsyncPolicy policy;
+            int intervalMs = 1000;
+            if (ParseLogFsyncPolicy(argv[++i], policy, intervalMs)) {
+                SetLogFsyncPolicy(policy, intervalMs);
+            } else {
+                WriteLog(LogLevel::WARN, "无效的--log-fsync参数: " + std::string(argv[i]) + "（应为none、batch或毫秒数）");
+            }
+        }
+    }
 
-
-int main() {
     // 启动UI监视窗口线程
-    std::thread uiThread(RunMonitorUI);
-    uiThread.detach();  // 独立运行
+    if (!headless) {
+        std::thread uiThread(RunMonitorUI);
+        uiThread.detach();  // 独立运行
+    }
 
     // 初始化日志文件
     InitializeLogFile();
 
-    WriteLog(LogLevel::INFO, "监视窗口已启动");
+    WriteLog(LogLevel::INFO, headless ? "以无界面模式运行" : "监视窗口已启动");
     
-    // 初始化AI服务
+    // 加载账号和群聊数据（快照 + 预写日志）
+    InitializeAccountStore();
+
+    // 打开离线消息存储（从磁盘恢复未推送的离线消息）
+    InitializeOfflineStore();
+
+    // 打开会话历史存储
+    InitializeHistoryStore();
+    InitializeGroupTimeline();
+
+    // 发布监视窗口使用的状态快照（共享内存）
+    InitializeStatsPublisher();
+
+    // 初始化AI服务（先启动AI回复的发送线程）
+    InitializeAIDelivery();
     InitializeAIService();
 
     // 初始化WinSock
@@ -42,6 +101,24 @@ int main() {
         return 1;
     }
 
+    // 启动指标端点（Prometheus格式）
+    RegisterGaugeCallback("chat_online_users", "Users currently logged in", [] {
+        // 用户下线后表项可能留着（值为nullptr），只数真正有会话的
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        size_t online = 0;
+        for (const auto& pair : g_userSessions) {
+            if (pair.second != nullptr) {
+                ++online;
+            }
+        }
+        return static_cast<double>(online);
+    });
+    RegisterCounterCallback("chat_log_records_dropped_total", "Log records dropped because the log queue was full",
+                            [] { return static_cast<double>(GetDroppedLogCount()); });
+    if (metricsPort > 0) {
+        StartMetricsServer(metricsPort, metricsPublic, metricsTraceControl);
+    }
+
     // 创建Socket
     SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (listenSocket == INVALID_SOCKET) {
@@ -117,6 +194,8 @@ int main() {
         unsigned short clientPort = ntohs(clientAddress.sin_port);
         
         std::string clientIP = std::string(clientIPAddress);
+        g_metricConnections.Inc();
+        g_metricActiveConnections.Add();
         WriteLog(LogLevel::CONNECTION, 
                  "接受新连接来自IP: " + clientIP + ", 端口: " + std::to_string(clientPort));
         
@@ -135,6 +214,9 @@ int main() {
     
     // 程序正常情况下不会执行到这里（除非手动break跳出循环）
     closesocket(listenSocket);
+    g_groupTimeline.Flush();
+    g_accountStore.Close();
+    g_offlineStore.Close();
     CleanupWinSock();
     CloseLogFile();
     
@@ -0,0 +1,431 @@
+#include "headers/metrics.h"
+#include "headers/logger.h"
+#include "headers/latency.h"
+#include "headers/trace.h"
+#include "headers/lockStats.h"
+#include "headers/aiTiming.h"
+#include "chatMsg_server.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+static const size_t METRIC_SLOT_MAX = 2048;  // 每个分片的槽位数（所有指标共用）
+
+// 一个线程的分片：只有所属线程写，抓取线程读
+struct MetricShard {
+    std::atomic<uint64_t> slots[METRIC_SLOT_MAX];
+    MetricShard() {
+        for (auto& slot : slots) {
+            slot.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+// 指标族（一个指标名）
+struct MetricFamily {
+    std::string name;
+    std::string help;
+    std::string type;                       // counter / gauge
+    std::string labelName;
+    std::vector<std::string> labelValues;
+    size_t base = 0;
+    size_t labels = 1;
+    bool isSigned = false;
+    std::function<double()> callback;       // 抓取时计算的仪表
+};
+
+// 注册表（函数内静态变量，避免不同编译单元的初始化顺序问题）
+struct MetricRegistry {
+    std::mutex mutex;                       // 保护families、shards和retired
+    std::vector<MetricFamily> families;
+    std::vector<MetricShard*> shards;       // 所有活着的线程的分片
+    MetricShard retired;                    // 已退出线程的累计值
+    size_t nextSlot = 0;
+};
+
+static MetricRegistry& Registry() {
+    static MetricRegistry registry;
+    return registry;
+}
+
+static size_t RegisterFamily(MetricFamily family) {
+    MetricRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    family.base = registry.nextSlot;
+    if (family.base + family.labels > METRIC_SLOT_MAX) {
+        family.base = METRIC_SLOT_MAX - family.labels;  // 槽位不够时只能共用（注册时就能发现，不会发生在运行中）
+    }
+    registry.nextSlot = family.base + family.labels;
+    size_t base = family.base;
+    registry.families.push_back(std::move(family));
+    return base;
+}
+
+// 线程第一次更新指标时登记分片，退出时把值并入退役分片
+struct ThreadMetricShard {
+    std::unique_ptr<MetricShard> shard;
+    ThreadMetricShard() : shard(new MetricShard()) {
+        MetricRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.shards.push_back(shard.get());
+    }
+    ~ThreadMetricShard() {
+        MetricRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (size_t i = 0; i < METRIC_SLOT_MAX; ++i) {
+            uint64_t value = shard->slots[i].load(std::memory_order_relaxed);
+            if (value) {
+                registry.retired.slots[i].fetch_add(value, std::memory_order_relaxed);
+            }
+        }
+        registry.shards.erase(std::remove(registry.shards.begin(), registry.shards.end(), shard.get()),
+                              registry.shards.end());
+    }
+};
+
+static MetricShard& LocalShard() {
+    thread_local ThreadMetricShard local;
+    return *local.shard;
+}
+
+// 只有本线程写自己的分片，所以不需要原子加法，读出再写回即可
+static inline void AddToSlot(size_t slot, uint64_t value) {
+    std::atomic<uint64_t>& cell = LocalShard().slots[slot];
+    cell.store(cell.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// 汇总一个槽位在所有分片中的值
+static uint64_t ReadSlot(size_t slot) {
+    MetricRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    uint64_t sum = registry.retired.slots[slot].load(std::memory_order_relaxed);
+    for (MetricShard* shard : registry.shards) {
+        sum += shard->slots[slot].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+Counter::Counter(const char* name, const char* help, const char* labelName, std::vector<std::string> labelValues) {
+    MetricFamily family;
+    family.name = name;
+    family.help = help;
+    family.type = "counter";
+    if (labelName) {
+        family.labelName = labelName;
+        family.labels = std::max<size_t>(labelValues.size(), 1);
+        family.labelValues = std::move(labelValues);
+    }
+    labels_ = family.labels;
+    base_ = RegisterFamily(std::move(family));
+}
+
+void Counter::Inc(uint64_t value, size_t label) {
+    if (label < labels_) {
+        AddToSlot(base_ + label, value);
+    }
+}
+
+uint64_t Counter::Value(size_t label) const {
+    return label < labels_ ? ReadSlot(base_ + label) : 0;
+}
+
+uint64_t Counter::Total() const {
+    uint64_t total = 0;
+    for (size_t label = 0; label < labels_; ++label) {
+        total += ReadSlot(base_ + label);
+    }
+    return total;
+}
+
+Gauge::Gauge(const char* name, const char* help) {
+    MetricFamily family;
+    family.name = name;
+    family.help = help;
+    family.type = "gauge";
+    family.isSigned = true;
+    slot_ = RegisterFamily(std::move(family));
+}
+
+void Gauge::Add(int64_t value) {
+    AddToSlot(slot_, static_cast<uint64_t>(value));  // 按补码相加，汇总后再转回有符号数
+}
+
+int64_t Gauge::Value() const {
+    return static_cast<int64_t>(ReadSlot(slot_));
+}
+
+static void RegisterCallback(const char* name, const char* help, const char* type, std::function<double()> read) {
+    MetricFamily family;
+    family.name = name;
+    family.help = help;
+    family.type = type;
+    family.labels = 0;
+    family.callback = std::move(read);
+    MetricRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.families.push_back(std::move(family));
+}
+
+void RegisterGaugeCallback(const char* name, const char* help, std::function<double()> read) {
+    RegisterCallback(name, help, "gauge", std::move(read));
+}
+
+void RegisterCounterCallback(const char* name, const char* help, std::function<double()> read) {
+    RegisterCallback(name, help, "counter", std::move(read));
+}
+
+std::vector<std::string> MsgTypeLabelValues() {
+    std::vector<std::string> labels(256);
+    labels[static_cast<uint8_t>(MsgType::LoginReq)] = "LoginReq";
+    labels[static_cast<uint8_t>(MsgType::CreateAcc)] = "CreateAcc";
+    labels[static_cast<uint8_t>(MsgType::CreateGrope)] = "CreateGrope";
+    labels[static_cast<uint8_t>(MsgType::Loginreturn)] = "Loginreturn";
+    labels[static_cast<uint8_t>(MsgType::regireturn)] = "regireturn";
+    labels[static_cast<uint8_t>(MsgType::CreateGroRe)] = "CreateGroRe";
+    labels[static_cast<uint8_t>(MsgType::AddFriendReq)] = "AddFriendReq";
+    labels[static_cast<uint8_t>(MsgType::AddFriendRe)] = "AddFriendRe";
+    labels[static_cast<uint8_t>(MsgType::Heartbeat)] = "Heartbeat";
+    labels[static_cast<uint8_t>(MsgType::NormalMsg)] = "NormalMsg";
+    labels[static_cast<uint8_t>(MsgType::GroupMsg)] = "GroupMsg";
+    labels[static_cast<uint8_t>(MsgType::ImageMsg)] = "ImageMsg";
+    labels[static_cast<uint8_t>(MsgType::SetName)] = "SetName";
+    labels[static_cast<uint8_t>(MsgType::CheckUser)] = "CheckUser";
+    labels[static_cast<uint8_t>(MsgType::HistoryReq)] = "HistoryReq";
+    labels[static_cast<uint8_t>(MsgType::HistoryRe)] = "HistoryRe";
+    labels[static_cast<uint8_t>(MsgType::AIPartial)] = "AIPartial";
+    labels[static_cast<uint8_t>(MsgType::AIQueued)] = "AIQueued";
+    return labels;
+}
+
+std::string RenderMetrics() {
+    MetricRegistry& registry = Registry();
+    std::vector<MetricFamily> families;
+    std::vector<uint64_t> totals;
+    {
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        families = registry.families;
+        totals.resize(registry.nextSlot);
+        for (size_t i = 0; i < totals.size(); ++i) {
+            uint64_t sum = registry.retired.slots[i].load(std::memory_order_relaxed);
+            for (MetricShard* shard : registry.shards) {
+                sum += shard->slots[i].load(std::memory_order_relaxed);
+            }
+            totals[i] = sum;
+        }
+    }
+
+    std::string out;
+    char line[256];
+    for (const MetricFamily& family : families) {
+        out += "# HELP " + family.name + " " + family.help + "\n";
+        out += "# TYPE " + family.name + " " + family.type + "\n";
+        if (family.callback) {
+            snprintf(line, sizeof(line), "%s %.17g\n", family.name.c_str(), family.callback());
+            out += line;
+            continue;
+        }
+        if (family.labelName.empty()) {
+            uint64_t value = totals[family.base];
+            if (family.isSigned) {
+                snprintf(line, sizeof(line), "%s %lld\n", family.name.c_str(), static_cast<long long>(value));
+            } else {
+                snprintf(line, sizeof(line), "%s %llu\n", family.name.c_str(), static_cast<unsigned long long>(value));
+            }
+            out += line;
+            continue;
+        }
+        for (size_t i = 0; i < family.labels; ++i) {
+            uint64_t value = totals[family.base + i];
+            std::string label = i < family.labelValues.size() ? family.labelValues[i] : "";
+            if (label.empty()) {
+                if (value == 0) {
+                    continue;  // 未命名且没有计数的标签值不输出
+                }
+                snprintf(line, sizeof(line), "0x%02zX", i);
+                label = line;
+            }
+            snprintf(line, sizeof(line), "%s{%s=\"%s\"} %llu\n", family.name.c_str(), family.labelName.c_str(),
+                     label.c_str(), static_cast<unsigned long long>(value));
+            out += line;
+        }
+    }
+    out += RenderLockMetrics();  // 锁统计的锁名在运行中才注册，单独生成
+    out += RenderAITimingMetrics();  // AI端点在AI服务启动时才确定，同样单独生成
+    return out;
+}
+
+// 请求行是否为GET path（后面跟空格或查询串）
+static bool IsGetRequest(const std::string& request, const std::string& path) {
+    std::string prefix = "GET " + path;
+    return request.compare(0, prefix.size(), prefix) == 0 && request.size() > prefix.size() &&
+           (request[prefix.size()] == ' ' || request[prefix.size()] == '?');
+}
+
+// 取查询串中的一个整数参数（例如/trace?sample=100），没有时返回false
+static bool QueryIntParam(const std::string& request, const std::string& name, int& value) {
+    size_t lineEnd = request.find("\r\n");
+    size_t query = request.find('?');
+    if (query == std::string::npos || query > lineEnd) {
+        return false;
+    }
+    size_t pos = request.find(name + "=", query);
+    if (pos == std::string::npos || pos > lineEnd) {
+        return false;
+    }
+    value = atoi(request.c_str() + pos + name.size() + 1);
+    return true;
+}
+
+static const int METRICS_REQUEST_DEADLINE_MS = 500;  // 每个连接读完请求头的期限（发送同样限时）
+static const int METRICS_MAX_CONNECTIONS = 4;        // 同时处理的连接数上限（超出的直接关闭）
+
+static std::atomic<int> g_metricsConnections{0};
+static bool g_metricsTraceControl = false;  // 启动时设置，之后只读
+
+// 处理一个HTTP请求：GET /metrics输出Prometheus指标，GET /latency输出各消息类型的延迟分位数表，
+// GET /locks输出锁统计和等待最多的调用位置，GET /ai输出每个AI端点各阶段的耗时表，
+// GET /trace导出追踪的区段（Chrome trace JSON），/trace?sample=N修改采样率（每N条消息追踪1条，0关闭），
+// 修改采样率需要启动时允许，并且只接受本机的请求
+static void ServeMetricsRequest(SOCKET client, bool fromLoopback) {
+    // 整个请求头必须在期限内读完：每次recv的超时是剩余的时间，慢慢发送的客户端也占不住连接
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(METRICS_REQUEST_DEADLINE_MS);
+    DWORD sendTimeoutMs = METRICS_REQUEST_DEADLINE_MS;
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&sendTimeoutMs), sizeof(sendTimeoutMs));
+
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        auto remainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remainingMs <= 0) {
+            return;
+        }
+        DWORD timeoutMs = static_cast<DWORD>(remainingMs);
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeoutMs), sizeof(timeoutMs));
+        int n = recv(client, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            return;
+        }
+        request.append(buffer, n);
+    }
+
+    std::string status = "200 OK";
+    std::string contentType = "text/plain; version=0.0.4; charset=utf-8";
+    std::string body;
+    if (IsGetRequest(request, "/metrics")) {
+        body = RenderMetrics();
+    } else if (IsGetRequest(request, "/latency")) {
+        body = RenderLatencyTable();
+    } else if (IsGetRequest(request, "/locks")) {
+        body = RenderLockTable();
+    } else if (IsGetRequest(request, "/ai")) {
+        body = RenderAITimingTable();
+    } else if (IsGetRequest(request, "/trace")) {
+        int sampleRate = 0;
+        if (QueryIntParam(request, "sample", sampleRate)) {
+            if (!g_metricsTraceControl || !fromLoopback) {
+                status = "403 Forbidden";
+                body = "trace sample rate can only be changed from localhost with --metrics-trace-control\n";
+            } else if (sampleRate < 0) {
+                status = "400 Bad Request";
+                body = "invalid sample rate\n";
+            } else {
+                SetTraceSampleRate(static_cast<uint32_t>(sampleRate));
+                WriteLog(LogLevel::INFO, "指标端点修改了追踪采样率: " + std::to_string(sampleRate));
+                body = "trace sample rate: " + std::to_string(sampleRate) + "\n";
+            }
+        } else {
+            contentType = "application/json";
+            body = ExportTraceJSON();
+        }
+    } else {
+        status = "404 Not Found";
+        body = "not found\n";
+    }
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+                           "Content-Type: " + contentType + "\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                           "Connection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        int n = send(client, response.data() + sent, static_cast<int>(response.size() - sent), 0);
+        if (n <= 0) {
+            break;
+        }
+        sent += n;
+    }
+}
+
+// 指标端点线程：每个连接交给单独的线程处理（一个不发请求的连接不会挡住其他抓取），同时处理的连接数有上限
+static void MetricsServerThread(SOCKET listenSocket) {
+    while (true) {
+        sockaddr_in peer = {};
+        int peerLength = sizeof(peer);
+        SOCKET client = accept(listenSocket, reinterpret_cast<sockaddr*>(&peer), &peerLength);
+        if (client == INVALID_SOCKET) {
+            continue;
+        }
+        if (g_metricsConnections.fetch_add(1) >= METRICS_MAX_CONNECTIONS) {
+            g_metricsConnections.fetch_sub(1);
+            closesocket(client);
+            continue;
+        }
+        bool fromLoopback = peer.sin_family == AF_INET && ntohl(peer.sin_addr.s_addr) == INADDR_LOOPBACK;
+        std::thread([client, fromLoopback] {
+            ServeMetricsRequest(client, fromLoopback);
+            closesocket(client);
+            g_metricsConnections.fetch_sub(1);
+        }).detach();
+    }
+}
+
+bool StartMetricsServer(int port, bool publicBind, bool allowTraceControl) {
+    g_metricsTraceControl = allowTraceControl;
+    SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket == INVALID_SOCKET) {
+        WriteLog(LogLevel::WARN, "指标端点Socket创建失败: " + std::to_string(WSAGetLastError()));
+        return false;
+    }
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(publicBind ? INADDR_ANY : INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<u_short>(port));
+    if (bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR ||
+        listen(listenSocket, 8) == SOCKET_ERROR) {
+        WriteLog(LogLevel::WARN, "指标端点无法监听端口 " + std::to_string(port) + ": " + std::to_string(WSAGetLastError()));
+        closesocket(listenSocket);
+        return false;
+    }
+    std::thread(MetricsServerThread, listenSocket).detach();
+    WriteLog(LogLevel::INFO, std::string("指标端点已启动: http://") + (publicBind ? "0.0.0.0" : "127.0.0.1") + ":" +
+                             std::to_string(port) + "/metrics");
+    return true;
+}
+
+// 服务器各模块使用的指标
+Counter g_metricConnections("chat_connections_total", "Accepted client connections");
+Gauge g_metricActiveConnections("chat_active_connections", "Currently open client connections");
+Counter g_metricLogins("chat_logins_total", "Login attempts by result", "result", {"success", "failure"});
+Counter g_metricMessagesReceived("chat_messages_received_total", "Packets received from clients by message type",
+                                 "msg_type", MsgTypeLabelValues());
+Counter g_metricMessagesForwarded("chat_messages_forwarded_total", "Packets forwarded to online users by message type",
+                                  "msg_type", MsgTypeLabelValues());
+Counter g_metricMessagesOffline("chat_messages_offline_total", "Packets stored for offline users by message type",
+                                "msg_type", MsgTypeLabelValues());
+Counter g_metricBytesReceived("chat_bytes_received_total", "Bytes received from client sockets");
+Counter g_metricBytesSent("chat_bytes_sent_total", "Bytes sent to client sockets");
+Counter g_metricAIRequests("chat_ai_requests_total", "AI reply requests by result", "result", {"success", "failure"});
+Gauge g_metricAIInFlight("chat_ai_requests_in_flight", "AI reply requests waiting for the API");
+Counter g_metricAICache("chat_ai_cache_requests_total", "AI reply requests by cache result", "result",
+                        {"hit", "miss", "coalesced"});
+Counter g_metricAIScheduled("chat_ai_scheduled_requests_total", "AI API calls by scheduling result", "result",
+                            {"immediate", "queued", "rejected"});
+Counter g_metricAIHedges("chat_ai_hedged_requests_total", "AI API attempts hedged to another endpoint", "result",
+                         {"sent", "won"});
@@ -1,45 +1,18 @@
 #include "headers/Monitor.h"
-#include "headers/logger.h"
-#include "headers/userControl.h"
-#include "headers/handleClient.h"
+#include "headers/monitorPanels.h"
 #include <imgui.h>
 #include <imgui_impl_win32.h>
 #include <imgui_impl_dx11.h>
 #include <d3d11.h>
 #include <tchar.h>
-#include <string>
-#include <vector>
-#include <map>
-#include <mutex>
 #include <chrono>
 
-// 外部声明（来自其他模块）
-extern std::mutex g_sessionMutex;
-extern std::mutex g_forwardMsgMutex;
-extern std::mutex g_requestMsgMutex;
-extern std::mutex g_uiLogMutex;
-extern std::map<uint8_t, std::string> g_userName;
-
 // DirectX 11设备
 static ID3D11Device* g_pd3dDevice = nullptr;
 static ID3D11DeviceContext* g_pd3dDeviceContext = nullptr;
 static IDXGISwapChain* g_pSwapChain = nullptr;
 static ID3D11RenderTargetView* g_mainRenderTargetView = nullptr;
 
-// 用户UI状态结构（与g_userSessions解耦）
-struct UserUIState {
-    uint8_t userID;
-    bool isOnline;
-    std::string userName;  // 用户名
-    std::string clientIP;
-    unsigned short clientPort;
-    std::chrono::steady_clock::time_point lastHeartbeat;
-};
-
-// UI专用数据（不需要锁保护，仅UI线程访问）
-static std::vector<UserUIState> g_uiUserStates;
-static std::map<std::string, std::vector<uint8_t>> g_uiGroupStates;
-
 // 窗口过程函数声明
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
@@ -50,21 +23,6 @@ void CleanupDeviceD3D();
 void CreateRenderTarget();
 void CleanupRenderTarget();
 
-// UI状态变量
-static int g_selectedUserId = -1;  // 被选中的用户ID（用于显示详细信息）
-static auto g_lastHeartbeatTime = std::chrono::steady_clock::now();
-static bool g_showDeleteConfirm = false;  // 是否显示删除确认对话框
-static uint8_t g_deleteTargetID = 0;  // 待删除的用户ID
-static std::string g_deleteTargetName = "";  // 待删除的用户名
-
-// 绘制各个监视框
-void DrawUserListPanel();
-void DrawGroupListPanel();
-void DrawServerLogPanel();
-void DrawForwardMessagesPanel();
-void DrawRequestMessagesPanel();
-void DrawDeleteConfirmDialog();
-
 // UI主函数
 void RunMonitorUI()
 {
@@ -134,79 +92,16 @@ void RunMonitorUI()
         if (!running)
             break;
 
+        // 读取服务器发布的最新快照
+        RefreshMonitorSnapshot();
+
         // 开始ImGui帧
+        auto frameStart = std::chrono::steady_clock::now();
         ImGui_ImplDX11_NewFrame();
         ImGui_ImplWin32_NewFrame();
         ImGui::NewFrame();
 
-        // 创建全屏主窗口（固定大小，不可调整）
-        ImGui::SetNextWindowPos(ImVec2(0, 0));
-        ImGui::SetNextWindowSize(io.DisplaySize);
-        ImGui::Begin("MainMonitor", nullptr, 
-                     ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | 
-                     ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | 
-                     ImGuiWindowFlags_NoBringToFrontOnFocus);
-
-        // 获取可用区域
-        ImVec2 windowSize = ImGui::GetContentRegionAvail();
-        float leftWidth = windowSize.x * 0.3f;   // 左侧30%
-        float rightWidth = windowSize.x * 0.7f;  // 右侧70%
-        float spacing = 10.0f;
-
-        // 左侧区域（用户列表 + 群聊列表）
-        ImGui::BeginGroup();
-        {
-            float leftUpperHeight = windowSize.y * 0.7f;  // 上70% - 用户列表
-            float leftLowerHeight = windowSize.y * 0.3f - spacing;  // 下30% - 群聊列表
-
-            // 用户列表框
-            ImGui::BeginChild("UserListPanel", ImVec2(leftWidth, leftUpperHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
-            DrawUserListPanel();
-            ImGui::EndChild();
-
-            ImGui::Spacing();
-
-            // 群聊列表框
-            ImGui::BeginChild("GroupListPanel", ImVec2(leftWidth, leftLowerHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
-            DrawGroupListPanel();
-            ImGui::EndChild();
-        }
-        ImGui::EndGroup();
-
-        ImGui::SameLine();
-
-        // 右侧区域（日志 + 转发消息 + 请求消息）- 去掉外围大框
-        ImGui::BeginGroup();
-        {
-            float rightUpperHeight = windowSize.y * 0.4f;  // 上40%
-            float rightLowerHeight = windowSize.y * 0.6f - spacing;  // 下60%
-            float rightLowerHalfWidth = (rightWidth - spacing) * 0.5f;
-
-            // 服务器日志框
-            ImGui::BeginChild("ServerLogPanel", ImVec2(rightWidth, rightUpperHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
-            DrawServerLogPanel();
-            ImGui::EndChild();
-
-            ImGui::Spacing();
-
-            // 转发消息框
-            ImGui::BeginChild("ForwardMessagesPanel", ImVec2(rightLowerHalfWidth, rightLowerHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
-            DrawForwardMessagesPanel();
-            ImGui::EndChild();
-
-            ImGui::SameLine();
-
-            // 请求消息框
-            ImGui::BeginChild("RequestMessagesPanel", ImVec2(rightLowerHalfWidth, rightLowerHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
-            DrawRequestMessagesPanel();
-            ImGui::EndChild();
-        }
-        ImGui::EndGroup();
-
-        ImGui::End();
-
-        // 绘制确认对话框（在主窗口之后）
-        DrawDeleteConfirmDialog();
+        DrawMonitorWindow();
 
         // 渲染
         ImGui::Render();
@@ -214,6 +109,7 @@ void RunMonitorUI()
         g_pd3dDeviceContext->OMSetRenderTargets(1, &g_mainRenderTargetView, nullptr);
         g_pd3dDeviceContext->ClearRenderTargetView(g_mainRenderTargetView, clear_color);
         ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+        SetMonitorBuildTime(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
 
         g_pSwapChain->Present(1, 0);  // 垂直同步
     }
@@ -228,308 +124,6 @@ void RunMonitorUI()
     ::UnregisterClassW(wc.lpszClassName, wc.hInstance);
 }
 
-// 绘制用户列表面板
-void DrawUserListPanel()
-{
-    ImGui::Text("用户");
-    ImGui::Separator();
-
-    // 从全局数据同步到UI状态（最小化持锁时间）
-    {
-        std::lock_guard<std::mutex> lock(g_sessionMutex);
-        
-        // 更新UI状态列表
-        g_uiUserStates.clear();
-        for (const auto& pair : g_userSessions) {
-            UserUIState state;
-            state.userID = pair.first;
-            state.isOnline = (pair.second != nullptr);
-            
-            // 读取用户名（带锁保护）
-            if (g_userName.count(pair.first)) {
-                state.userName = g_userName[pair.first];
-            } else {
-                state.userName = "Unknown";
-            }
-            
-            if (state.isOnline) {
-                state.clientIP = pair.second->client_ip;
-                state.clientPort = pair.second->client_port;
-                state.lastHeartbeat = pair.second->lastHeartbeatTime;
-            } else {
-                state.clientIP = "";
-                state.clientPort = 0;
-                state.lastHeartbeat = std::chrono::steady_clock::now();
-            }
-            g_uiUserStates.push_back(state);
-        }
-    }
-
-    auto now = std::chrono::steady_clock::now();
-
-    // 使用UI本地数据绘制（不持有任何锁）
-    for (const auto& user : g_uiUserStates)
-    {
-        uint8_t userID = user.userID;
-        bool isOnline = user.isOnline;
-        
-        // 计算心跳闪烁效果（收到心跳后300ms内亮起）
-        bool shouldBlink = false;
-        if (isOnline) {
-            auto timeSinceHeartbeat = std::chrono::duration_cast<std::chrono::milliseconds>(
-                now - user.lastHeartbeat).count();
-            shouldBlink = (timeSinceHeartbeat < 300);  // 心跳后300ms内闪烁
-        }
-        
-        // 添加上下间距
-        ImGui::Spacing();
-        
-        // 添加左侧缩进实现对齐
-        ImGui::Indent(5.0f);
-        
-        // 根据在线状态设置颜色
-        ImVec4 textColor = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);  // 默认白色
-        if (isOnline) {
-            if (shouldBlink) {
-                // 心跳闪烁时使用高亮颜色
-                ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.3f, 1.0f, 0.3f, 1.0f));  // 鲜绿色高亮
-            } else {
-                ImGui::PushStyleColor(ImGuiCol_Text, textColor);
-            }
-        } else {
-            // 离线用户灰色
-            ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.5f, 0.5f, 0.5f, 1.0f));
-        }
-        
-        // 显示用户名和状态
-        ImGui::Text("%s [%s]", user.userName.c_str(), isOnline ? "在线" : "离线");
-        
-        ImGui::PopStyleColor();
-        ImGui::Unindent(5.0f);
-
-        // 鼠标悬停显示详细信息
-        if (ImGui::IsItemHovered())
-        {
-            ImGui::BeginTooltip();
-            ImGui::Text("用户名: %s", user.userName.c_str());
-            ImGui::Text("用户ID: %d", userID);
-            if (isOnline) {
-                ImGui::Text("IP地址: %s", user.clientIP.c_str());
-                ImGui::Text("端口: %d", user.clientPort);
-                ImGui::Text("状态: 在线");
-            } else {
-                ImGui::Text("状态: 离线");
-            }
-            ImGui::EndTooltip();
-        }
-
-        if (ImGui::IsItemClicked())
-        {
-            g_selectedUserId = userID;
-        }
-        
-        // 右键菜单
-        if (ImGui::BeginPopupContextItem(("UserMenu_" + std::to_string(userID)).c_str()))
-        {
-            ImGui::Text("用户 %s (ID: %d)", user.userName.c_str(), userID);
-            ImGui::Separator();
-            
-            if (isOnline && ImGui::MenuItem("强制下线"))
-            {
-                ForceDisconnect(userID);
-                ImGui::CloseCurrentPopup();
-            }
-            
-            if (ImGui::MenuItem("删除账户"))
-            {
-                g_showDeleteConfirm = true;
-                g_deleteTargetID = userID;
-                g_deleteTargetName = user.userName;
-                ImGui::CloseCurrentPopup();
-            }
-            
-            ImGui::EndPopup();
-        }
-    }
-}
-
-// 删除确认对话框渲染（需要在主UI循环中调用）
-void DrawDeleteConfirmDialog()
-{
-    if (g_showDeleteConfirm)
-    {
-        ImGui::OpenPopup("删除确认");
-        g_showDeleteConfirm = false;  // 只打开一次
-    }
-    
-    if (ImGui::BeginPopupModal("删除确认", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
-    {
-        ImGui::Text("确定要删除用户 '%s' (ID: %d) 吗？", g_deleteTargetName.c_str(), g_deleteTargetID);
-        ImGui::Text("此操作将:");
-        ImGui::BulletText("强制用户下线");
-        ImGui::BulletText("删除用户账户和密码");
-        ImGui::BulletText("删除所有离线消息");
-        ImGui::BulletText("从所有群聊中移除");
-        ImGui::Separator();
-        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "此操作不可恢复！");
-        ImGui::Separator();
-        
-        if (ImGui::Button("确定删除", ImVec2(120, 0)))
-        {
-            DeleteUser(g_deleteTargetID);
-            ImGui::CloseCurrentPopup();
-        }
-        ImGui::SameLine();
-        if (ImGui::Button("取消", ImVec2(120, 0)))
-        {
-            ImGui::CloseCurrentPopup();
-        }
-        
-        ImGui::EndPopup();
-    }
-}
-
-// 绘制群聊列表面板
-void DrawGroupListPanel()
-{
-    ImGui::Text("群聊");
-    ImGui::Separator();
-
-    // 从全局数据同步到UI状态（最小化持锁时间）
-    {
-        std::lock_guard<std::mutex> lock(g_sessionMutex);
-        g_uiGroupStates = g_groupChat;
-    }
-
-    if (g_uiGroupStates.empty())
-    {
-        ImGui::TextDisabled("");
-    }
-    else
-    {
-        for (const auto& pair : g_uiGroupStates)
-        {
-            const std::string& groupName = pair.first;
-            const auto& members = pair.second;
-
-            ImGui::BulletText("%s (%zu人)", groupName.c_str(), members.size());
-            
-            // 鼠标悬停显示成员列表
-            if (ImGui::IsItemHovered())
-            {
-                ImGui::BeginTooltip();
-                ImGui::Text("群聊名称: %s", groupName.c_str());
-                ImGui::Text("成员数量: %zu", members.size());
-                ImGui::Separator();
-                for (int memberId : members)
-                {
-                    ImGui::Text("  - 用户ID: %d", memberId);
-                }
-                ImGui::EndTooltip();
-            }
-        }
-    }
-}
-
-// 绘制服务器日志面板
-void DrawServerLogPanel()
-{
-    ImGui::Text("日志");
-    ImGui::Separator();
-
-    // 创建可滚动的子窗口
-    ImGui::BeginChild("ServerLogScrollArea", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
-    
-    // 复制日志数据到本地（最小化持锁时间）
-    std::vector<std::string> localLogBuffer;
-    {
-        std::lock_guard<std::mutex> lock(g_uiLogMutex);
-        localLogBuffer = g_uiLogBuffer;
-    }
-    
-    // 显示日志（自动滚动）
-    
-    for (const std::string& logLine : localLogBuffer)
-    {
-        // 根据日志类型着色
-        ImVec4 color = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);  // 默认白色
-        if (logLine.find("[FATAL]") != std::string::npos)
-            color = ImVec4(1.0f, 0.0f, 0.0f, 1.0f);  // 红色
-        else if (logLine.find("[WARN]") != std::string::npos)
-            color = ImVec4(1.0f, 1.0f, 0.0f, 1.0f);  // 黄色
-
-        ImGui::TextColored(color, "%s", logLine.c_str());
-    }
-
-    // 自动滚动到底部
-    if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
-        ImGui::SetScrollHereY(1.0f);
-    
-    ImGui::EndChild();
-}
-
-// 绘制转发消息面板
-void DrawForwardMessagesPanel()
-{
-    ImGui::Text("转发");
-    ImGui::Separator();
-    
-    // 创建可滚动的子窗口
-    ImGui::BeginChild("ForwardMsgScrollArea", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
-    
-    // 复制数据到本地（最小化持锁时间）
-    std::vector<std::string> localForwardBuffer;
-    {
-        std::lock_guard<std::mutex> lock(g_forwardMsgMutex);
-        localForwardBuffer = g_forwardMsgBuffer;
-    }
-    
-    if (localForwardBuffer.empty()) {
-        ImGui::TextDisabled("");
-    } else {
-        for (const auto& msg : localForwardBuffer) {
-            ImGui::TextWrapped("%s", msg.c_str());
-        }
-        
-        // 自动滚动到底部
-        if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
-            ImGui::SetScrollHereY(1.0f);
-    }
-    
-    ImGui::EndChild();
-}
-
-// 绘制请求消息面板
-void DrawRequestMessagesPanel()
-{
-    ImGui::Text("请求");
-    ImGui::Separator();
-    
-    // 创建可滚动的子窗口
-    ImGui::BeginChild("RequestMsgScrollArea", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
-    
-    // 复制数据到本地（最小化持锁时间）
-    std::vector<std::string> localRequestBuffer;
-    {
-        std::lock_guard<std::mutex> lock(g_requestMsgMutex);
-        localRequestBuffer = g_requestMsgBuffer;
-    }
-    
-    if (localRequestBuffer.empty()) {
-        ImGui::TextDisabled("");
-    } else {
-        for (const auto& msg : localRequestBuffer) {
-            ImGui::TextWrapped("%s", msg.c_str());
-        }
-        
-        // 自动滚动到底部
-        if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
-            ImGui::SetScrollHereY(1.0f);
-    }
-    
-    ImGui::EndChild();
-}
-
 // DirectX 11设备创建
 bool CreateDeviceD3D(HWND hWnd)
 {
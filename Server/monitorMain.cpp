@@ -0,0 +1,7 @@
+// 独立的监视进程：读取服务器发布的状态共享内存并显示，服务器可以用--headless启动，监视窗口随时开关
+#include "headers/Monitor.h"
+
+int main() {
+    RunMonitorUI();
+    return 0;
+}
@@ -0,0 +1,766 @@
+// 监视窗口的各个面板：把服务器发布的快照转换为界面数据并绘制，不依赖窗口和图形后端
+// monitor.cpp负责窗口、DirectX和主循环，monitorbench不创建窗口直接调用这里的函数
+#include "headers/monitorPanels.h"
+#include "headers/statsSegment.h"
+#include <imgui.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstring>
+#include <chrono>
+#include <cstdint>
+
+// 用户UI状态结构（与g_userSessions解耦）
+struct UserUIState {
+    uint8_t userID;
+    bool isOnline;
+    std::string userName;  // 用户名
+    std::string clientIP;
+    unsigned short clientPort;
+    std::chrono::steady_clock::time_point lastHeartbeat;
+};
+
+// 群聊UI状态结构
+struct GroupUIState {
+    std::string groupName;
+    std::vector<uint8_t> members;
+};
+
+// UI专用数据（不需要锁保护，仅UI线程访问）
+// 列表只在快照中对应的变化计数改变时才重建；绘制时用ImGuiListClipper只提交可见的行
+static std::vector<UserUIState> g_uiUserStates;
+static std::vector<GroupUIState> g_uiGroupStates;
+static uint64_t g_uiUsersChangeSeq = UINT64_MAX;   // 当前列表对应的变化计数
+static uint64_t g_uiGroupsChangeSeq = UINT64_MAX;
+static double g_uiBuildTimeMs = 0.0;                // 最近一帧构建界面的耗时（不含等待垂直同步）
+
+// 服务器发布的状态快照（监视窗口的全部数据都来自这里，不接触服务器的任何锁）
+static const int SNAPSHOT_REFRESH_MS = 100;     // 读取快照的间隔
+static const int SNAPSHOT_STALE_MS = 2000;      // 快照超过这么久没有更新就认为服务器没有运行
+static StatsSegment* g_statsSegment = nullptr;
+static std::unique_ptr<StatsSnapshot> g_snapshot(new StatsSnapshot());
+static bool g_snapshotValid = false;
+static uint64_t g_snapshotVersion = 0;
+static auto g_snapshotReadTime = std::chrono::steady_clock::time_point();    // 上次读取快照的时间
+static auto g_snapshotChangeTime = std::chrono::steady_clock::time_point();  // 上次读到新版本的时间
+
+// UI状态变量
+static int g_selectedUserId = -1;  // 被选中的用户ID（用于显示详细信息）
+static auto g_lastHeartbeatTime = std::chrono::steady_clock::now();
+static bool g_showDeleteConfirm = false;  // 是否显示删除确认对话框
+static uint8_t g_deleteTargetID = 0;  // 待删除的用户ID
+static std::string g_deleteTargetName = "";  // 待删除的用户名
+
+// 绘制各个监视框
+void DrawUserListPanel();
+void DrawGroupListPanel();
+void DrawServerLogPanel();
+void DrawLatencyPanel();
+void DrawLockPanel();
+void DrawAITimingPanel();
+void DrawCounterPanel();
+void DrawForwardMessagesPanel();
+void DrawRequestMessagesPanel();
+void DrawDeleteConfirmDialog();
+
+// 在当前ImGui帧中绘制整个监视窗口
+void DrawMonitorWindow()
+{
+    ImGuiIO& io = ImGui::GetIO();
+
+    // 创建全屏主窗口（固定大小，不可调整）
+    ImGui::SetNextWindowPos(ImVec2(0, 0));
+    ImGui::SetNextWindowSize(io.DisplaySize);
+    ImGui::Begin("MainMonitor", nullptr, 
+                 ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | 
+                 ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse | 
+                 ImGuiWindowFlags_NoBringToFrontOnFocus);
+
+    // 获取可用区域
+    ImVec2 windowSize = ImGui::GetContentRegionAvail();
+    float leftWidth = windowSize.x * 0.3f;   // 左侧30%
+    float rightWidth = windowSize.x * 0.7f;  // 右侧70%
+    float spacing = 10.0f;
+
+    // 左侧区域（用户列表 + 群聊列表）
+    ImGui::BeginGroup();
+    {
+        float leftUpperHeight = windowSize.y * 0.7f;  // 上70% - 用户列表
+        float leftLowerHeight = windowSize.y * 0.3f - spacing;  // 下30% - 群聊列表
+
+        // 用户列表框
+        ImGui::BeginChild("UserListPanel", ImVec2(leftWidth, leftUpperHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
+        DrawUserListPanel();
+        ImGui::EndChild();
+
+        ImGui::Spacing();
+
+        // 群聊列表框
+        ImGui::BeginChild("GroupListPanel", ImVec2(leftWidth, leftLowerHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
+        DrawGroupListPanel();
+        ImGui::EndChild();
+    }
+    ImGui::EndGroup();
+
+    ImGui::SameLine();
+
+    // 右侧区域（日志 + 转发消息 + 请求消息）- 去掉外围大框
+    ImGui::BeginGroup();
+    {
+        float rightUpperHeight = windowSize.y * 0.4f;  // 上40%
+        float rightLowerHeight = windowSize.y * 0.6f - spacing;  // 下60%
+        float rightLowerHalfWidth = (rightWidth - spacing) * 0.5f;
+
+        // 服务器日志框（日志和延迟统计分两个标签页）
+        ImGui::BeginChild("ServerLogPanel", ImVec2(rightWidth, rightUpperHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
+        if (ImGui::BeginTabBar("ServerLogTabs")) {
+            if (ImGui::BeginTabItem("日志")) {
+                DrawServerLogPanel();
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("延迟")) {
+                DrawLatencyPanel();
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("锁")) {
+                DrawLockPanel();
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("AI")) {
+                DrawAITimingPanel();
+                ImGui::EndTabItem();
+            }
+            if (ImGui::BeginTabItem("统计")) {
+                DrawCounterPanel();
+                ImGui::EndTabItem();
+            }
+            ImGui::EndTabBar();
+        }
+        ImGui::EndChild();
+
+        ImGui::Spacing();
+
+        // 转发消息框
+        ImGui::BeginChild("ForwardMessagesPanel", ImVec2(rightLowerHalfWidth, rightLowerHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
+        DrawForwardMessagesPanel();
+        ImGui::EndChild();
+
+        ImGui::SameLine();
+
+        // 请求消息框
+        ImGui::BeginChild("RequestMessagesPanel", ImVec2(rightLowerHalfWidth, rightLowerHeight), true, ImGuiWindowFlags_HorizontalScrollbar);
+        DrawRequestMessagesPanel();
+        ImGui::EndChild();
+    }
+    ImGui::EndGroup();
+
+    ImGui::End();
+
+    // 绘制确认对话框（在主窗口之后）
+    DrawDeleteConfirmDialog();
+}
+
+void SetMonitorBuildTime(double ms)
+{
+    g_uiBuildTimeMs = ms;
+}
+
+// 绘制用户列表面板
+void DrawUserListPanel()
+{
+    ImGui::Text("用户");
+    ImGui::Separator();
+
+    if (!g_snapshotValid) {
+        ImGui::TextDisabled("等待服务器...");
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    // 使用UI本地数据绘制（不持有任何锁），只提交可见的行
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(g_uiUserStates.size()));
+    while (clipper.Step())
+    {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+        {
+            const UserUIState& user = g_uiUserStates[row];
+            uint8_t userID = user.userID;
+            bool isOnline = user.isOnline;
+            
+            // 计算心跳闪烁效果（收到心跳后300ms内亮起）
+            bool shouldBlink = false;
+            if (isOnline) {
+                auto timeSinceHeartbeat = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    now - user.lastHeartbeat).count();
+                shouldBlink = (timeSinceHeartbeat < 300);  // 心跳后300ms内闪烁
+            }
+            
+            // 添加上下间距
+            ImGui::Spacing();
+            
+            // 添加左侧缩进实现对齐
+            ImGui::Indent(5.0f);
+            
+            // 根据在线状态设置颜色
+            ImVec4 textColor = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);  // 默认白色
+            if (isOnline) {
+                if (shouldBlink) {
+                    // 心跳闪烁时使用高亮颜色
+                    ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.3f, 1.0f, 0.3f, 1.0f));  // 鲜绿色高亮
+                } else {
+                    ImGui::PushStyleColor(ImGuiCol_Text, textColor);
+                }
+            } else {
+                // 离线用户灰色
+                ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.5f, 0.5f, 0.5f, 1.0f));
+            }
+            
+            // 显示用户名和状态
+            ImGui::Text("%s [%s]", user.userName.c_str(), isOnline ? "在线" : "离线");
+            
+            ImGui::PopStyleColor();
+            ImGui::Unindent(5.0f);
+
+            // 鼠标悬停显示详细信息
+            if (ImGui::IsItemHovered())
+            {
+                ImGui::BeginTooltip();
+                ImGui::Text("用户名: %s", user.userName.c_str());
+                ImGui::Text("用户ID: %d", userID);
+                if (isOnline) {
+                    ImGui::Text("IP地址: %s", user.clientIP.c_str());
+                    ImGui::Text("端口: %d", user.clientPort);
+                    ImGui::Text("状态: 在线");
+                } else {
+                    ImGui::Text("状态: 离线");
+                }
+                ImGui::EndTooltip();
+            }
+
+            if (ImGui::IsItemClicked())
+            {
+                g_selectedUserId = userID;
+            }
+            
+            // 右键菜单
+            ImGui::PushID(userID);
+            if (ImGui::BeginPopupContextItem("UserMenu"))
+            {
+                ImGui::Text("用户 %s (ID: %d)", user.userName.c_str(), userID);
+                ImGui::Separator();
+                
+                if (isOnline && ImGui::MenuItem("强制下线"))
+                {
+                    SendStatsCommand(g_statsSegment, STATS_COMMAND_FORCE_DISCONNECT, userID);
+                    ImGui::CloseCurrentPopup();
+                }
+                
+                if (ImGui::MenuItem("删除账户"))
+                {
+                    g_showDeleteConfirm = true;
+                    g_deleteTargetID = userID;
+                    g_deleteTargetName = user.userName;
+                    ImGui::CloseCurrentPopup();
+                }
+                
+                ImGui::EndPopup();
+            }
+            ImGui::PopID();
+        }
+    }
+}
+
+// 删除确认对话框渲染（需要在主UI循环中调用）
+void DrawDeleteConfirmDialog()
+{
+    if (g_showDeleteConfirm)
+    {
+        ImGui::OpenPopup("删除确认");
+        g_showDeleteConfirm = false;  // 只打开一次
+    }
+    
+    if (ImGui::BeginPopupModal("删除确认", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+    {
+        ImGui::Text("确定要删除用户 '%s' (ID: %d) 吗？", g_deleteTargetName.c_str(), g_deleteTargetID);
+        ImGui::Text("此操作将:");
+        ImGui::BulletText("强制用户下线");
+        ImGui::BulletText("删除用户账户和密码");
+        ImGui::BulletText("删除所有离线消息");
+        ImGui::BulletText("从所有群聊中移除");
+        ImGui::Separator();
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "此操作不可恢复！");
+        ImGui::Separator();
+        
+        if (ImGui::Button("确定删除", ImVec2(120, 0)))
+        {
+            SendStatsCommand(g_statsSegment, STATS_COMMAND_DELETE_USER, g_deleteTargetID);
+            ImGui::CloseCurrentPopup();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("取消", ImVec2(120, 0)))
+        {
+            ImGui::CloseCurrentPopup();
+        }
+        
+        ImGui::EndPopup();
+    }
+}
+
+// 绘制群聊列表面板
+void DrawGroupListPanel()
+{
+    ImGui::Text("群聊");
+    ImGui::Separator();
+
+    if (g_uiGroupStates.empty())
+    {
+        ImGui::TextDisabled("");
+    }
+    else
+    {
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(g_uiGroupStates.size()));
+        while (clipper.Step())
+        {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+            {
+                const std::string& groupName = g_uiGroupStates[row].groupName;
+                const auto& members = g_uiGroupStates[row].members;
+
+                ImGui::BulletText("%s (%zu人)", groupName.c_str(), members.size());
+                
+                // 鼠标悬停显示成员列表
+                if (ImGui::IsItemHovered())
+                {
+                    ImGui::BeginTooltip();
+                    ImGui::Text("群聊名称: %s", groupName.c_str());
+                    ImGui::Text("成员数量: %zu", members.size());
+                    ImGui::Separator();
+                    for (int memberId : members)
+                    {
+                        ImGui::Text("  - 用户ID: %d", memberId);
+                    }
+                    ImGui::EndTooltip();
+                }
+            }
+        }
+    }
+}
+
+// 一行本地日志（颜色在收到时确定一次，绘制时不再查找级别）
+struct LocalLogLine {
+    std::string text;
+    ImVec4 color;
+};
+
+// 各日志面板本地保存的记录（仅UI线程访问，每个面板最多LOCAL_LOG_LINES行）
+static std::deque<LocalLogLine> g_localLogLines;
+static std::deque<LocalLogLine> g_localForwardLines;
+static std::deque<LocalLogLine> g_localRequestLines;
+static uint64_t g_logNextSeq = 0;
+static uint64_t g_forwardNextSeq = 0;
+static uint64_t g_requestNextSeq = 0;
+static uint64_t g_logDroppedSeen = 0;      // 已经标记过的服务器端丢失行数
+static uint64_t g_forwardDroppedSeen = 0;
+static uint64_t g_requestDroppedSeen = 0;
+
+// 把快照日志尾部中上次之后新增的行追加到本地（快照只保留最近STATS_LOG_LINES行，读得太慢时更早的行会被跳过）
+// 跳过的行和服务器发布前就丢失的行都用一行标记注明数量，不会悄悄缺一段
+static void PullNewLogLines(const StatsLogTail& tail, uint64_t& nextSeq, uint64_t& droppedSeen,
+                            std::deque<LocalLogLine>& lines)
+{
+    if (tail.nextSeq < nextSeq || tail.droppedLines < droppedSeen) {
+        nextSeq = 0;  // 服务器重启，序号重新开始
+        droppedSeen = 0;
+        lines.clear();
+    }
+    bool firstRead = nextSeq == 0 && lines.empty();  // 刚连上服务器：之前的行不算丢失
+    uint64_t dropped = tail.droppedLines - droppedSeen;
+    droppedSeen = tail.droppedLines;
+    if (tail.nextSeq - nextSeq > STATS_LOG_LINES) {
+        dropped += tail.nextSeq - STATS_LOG_LINES - nextSeq;
+        nextSeq = tail.nextSeq - STATS_LOG_LINES;
+    }
+    if (dropped > 0 && !firstRead) {
+        LocalLogLine marker;
+        marker.text = "...... 日志过快，" + std::to_string(dropped) + " 行未能显示 ......";
+        marker.color = ImVec4(0.6f, 0.6f, 0.6f, 1.0f);  // 灰色
+        lines.push_back(std::move(marker));
+    }
+    for (; nextSeq < tail.nextSeq; ++nextSeq) {
+        const char* line = tail.lines[nextSeq % STATS_LOG_LINES];
+        LocalLogLine local;
+        local.text.assign(line, strnlen(line, STATS_LOG_LINE_SIZE));
+        // 根据日志类型着色
+        local.color = ImVec4(1.0f, 1.0f, 1.0f, 1.0f);  // 默认白色
+        if (local.text.find("[FATAL]") != std::string::npos)
+            local.color = ImVec4(1.0f, 0.0f, 0.0f, 1.0f);  // 红色
+        else if (local.text.find("[WARN]") != std::string::npos)
+            local.color = ImVec4(1.0f, 1.0f, 0.0f, 1.0f);  // 黄色
+        lines.push_back(std::move(local));
+    }
+    while (lines.size() > LOCAL_LOG_LINES) {
+        lines.pop_front();
+    }
+}
+
+// 读取服务器发布的快照，并转换为各面板使用的数据
+void RefreshMonitorSnapshot()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - g_snapshotReadTime < std::chrono::milliseconds(SNAPSHOT_REFRESH_MS)) {
+        return;
+    }
+    g_snapshotReadTime = now;
+
+    if (g_statsSegment == nullptr) {
+        g_statsSegment = OpenStatsSegment();  // 服务器还没启动时每次刷新都重试
+        if (g_statsSegment == nullptr) {
+            g_snapshotValid = false;
+            return;
+        }
+        g_snapshotChangeTime = now;
+    }
+    if (!ReadStatsSnapshot(g_statsSegment, *g_snapshot)) {
+        return;  // 服务器正在频繁写入，下次再读
+    }
+    ApplyMonitorSnapshot(*g_snapshot, now);
+}
+
+// 把一份快照转换为各面板使用的数据
+void ApplyMonitorSnapshot(const StatsSnapshot& snapshot, std::chrono::steady_clock::time_point now)
+{
+    if (&snapshot != g_snapshot.get()) {
+        *g_snapshot = snapshot;  // 各面板绘制时读g_snapshot
+    }
+    if (snapshot.version < g_snapshotVersion) {
+        // 服务器重启，变化计数重新开始，强制重建列表
+        g_uiUsersChangeSeq = UINT64_MAX;
+        g_uiGroupsChangeSeq = UINT64_MAX;
+    }
+    if (snapshot.version != g_snapshotVersion) {
+        g_snapshotVersion = snapshot.version;
+        g_snapshotChangeTime = now;
+    }
+    g_snapshotValid = now - g_snapshotChangeTime < std::chrono::milliseconds(SNAPSHOT_STALE_MS);
+
+    uint32_t userCount = snapshot.userCount < STATS_MAX_USERS ? snapshot.userCount : static_cast<uint32_t>(STATS_MAX_USERS);
+    if (snapshot.usersChangeSeq != g_uiUsersChangeSeq) {
+        g_uiUsersChangeSeq = snapshot.usersChangeSeq;
+        g_uiUserStates.clear();
+        for (uint32_t i = 0; i < userCount; ++i) {
+            const StatsUser& user = snapshot.users[i];
+            UserUIState state;
+            state.userID = user.userID;
+            state.isOnline = user.online != 0;
+            state.userName = std::string(user.name, strnlen(user.name, sizeof(user.name)));
+            state.clientIP = std::string(user.ip, strnlen(user.ip, sizeof(user.ip)));
+            state.clientPort = user.port;
+            g_uiUserStates.push_back(state);
+        }
+    }
+    // 心跳时间每次都会变，只更新这一项
+    for (uint32_t i = 0; i < userCount && i < g_uiUserStates.size(); ++i) {
+        UserUIState& state = g_uiUserStates[i];
+        state.lastHeartbeat = state.isOnline ? now - std::chrono::milliseconds(snapshot.heartbeatAgeMs[i]) : now;
+    }
+
+    if (snapshot.groupsChangeSeq != g_uiGroupsChangeSeq) {
+        g_uiGroupsChangeSeq = snapshot.groupsChangeSeq;
+        g_uiGroupStates.clear();
+        for (uint32_t i = 0; i < snapshot.groupCount && i < STATS_MAX_GROUPS; ++i) {
+            const StatsGroup& group = snapshot.groups[i];
+            GroupUIState state;
+            state.groupName = std::string(group.name, strnlen(group.name, sizeof(group.name)));
+            for (int memberID = 0; memberID < 256; ++memberID) {
+                if ((group.members[memberID >> 3] >> (memberID & 7)) & 1) {
+                    state.members.push_back(static_cast<uint8_t>(memberID));
+                }
+            }
+            g_uiGroupStates.push_back(std::move(state));
+        }
+    }
+
+    PullNewLogLines(snapshot.logs[STATS_LOG_SERVER], g_logNextSeq, g_logDroppedSeen, g_localLogLines);
+    PullNewLogLines(snapshot.logs[STATS_LOG_FORWARD], g_forwardNextSeq, g_forwardDroppedSeen, g_localForwardLines);
+    PullNewLogLines(snapshot.logs[STATS_LOG_REQUEST], g_requestNextSeq, g_requestDroppedSeen, g_localRequestLines);
+}
+
+// 绘制服务器日志面板
+void DrawServerLogPanel()
+{
+    // 创建可滚动的子窗口
+    ImGui::BeginChild("ServerLogScrollArea", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
+    
+    // 显示日志（自动滚动），只提交可见的行
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<int>(g_localLogLines.size()));
+    while (clipper.Step())
+    {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+        {
+            const LocalLogLine& logLine = g_localLogLines[row];
+            ImGui::PushStyleColor(ImGuiCol_Text, logLine.color);
+            ImGui::TextUnformatted(logLine.text.c_str(), logLine.text.c_str() + logLine.text.size());
+            ImGui::PopStyleColor();
+        }
+    }
+
+    // 自动滚动到底部
+    if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
+        ImGui::SetScrollHereY(1.0f);
+    
+    ImGui::EndChild();
+}
+
+// 绘制延迟统计面板：每个MsgType各阶段的p50/p99/p999（微秒）
+void DrawLatencyPanel()
+{
+    if (!g_snapshotValid) {
+        ImGui::TextDisabled("等待服务器...");
+        return;
+    }
+    const StatsSnapshot& snapshot = *g_snapshot;
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+    if (ImGui::BeginTable("LatencyTable", 7, flags)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("消息类型");
+        ImGui::TableSetupColumn("阶段");
+        ImGui::TableSetupColumn("次数");
+        ImGui::TableSetupColumn("p50(us)");
+        ImGui::TableSetupColumn("p99(us)");
+        ImGui::TableSetupColumn("p999(us)");
+        ImGui::TableSetupColumn("max(us)");
+        ImGui::TableHeadersRow();
+        for (size_t slot = 0; slot < STATS_LATENCY_TYPES; ++slot) {
+            if (snapshot.typeNames[slot][0] == '\0') {
+                continue;  // 没有记录的类型
+            }
+            for (size_t stage = 0; stage < STATS_LATENCY_STAGES; ++stage) {
+                const StatsLatency& latency = snapshot.latency[slot][stage];
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                if (stage == 0) {
+                    ImGui::TextUnformatted(snapshot.typeNames[slot]);  // 同一类型只在第一行显示名字
+                }
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(snapshot.stageNames[stage]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(latency.count));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", latency.p50Ns / 1000.0);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", latency.p99Ns / 1000.0);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", latency.p999Ns / 1000.0);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", latency.maxNs / 1000.0);
+            }
+        }
+        ImGui::EndTable();
+    }
+}
+
+// 绘制锁统计面板：每把锁的加锁次数、等待和持有时间，展开显示等待最多的调用位置
+void DrawLockPanel()
+{
+    if (!g_snapshotValid) {
+        ImGui::TextDisabled("等待服务器...");
+        return;
+    }
+    const StatsSnapshot& snapshot = *g_snapshot;
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+    if (ImGui::BeginTable("LockTable", 8, flags)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("锁");
+        ImGui::TableSetupColumn("加锁次数");
+        ImGui::TableSetupColumn("等待次数");
+        ImGui::TableSetupColumn("等待p50(us)");
+        ImGui::TableSetupColumn("等待p99(us)");
+        ImGui::TableSetupColumn("等待p999(us)");
+        ImGui::TableSetupColumn("持有p50(us)");
+        ImGui::TableSetupColumn("持有p99(us)");
+        ImGui::TableHeadersRow();
+        for (uint32_t i = 0; i < snapshot.lockCount && i < STATS_MAX_LOCKS; ++i) {
+            const StatsLock& row = snapshot.locks[i];
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            bool open = false;
+            if (row.siteCount == 0) {
+                ImGui::TextUnformatted(row.name);
+            } else {
+                open = ImGui::TreeNode(row.name);
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(row.acquisitions));
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(row.contended));
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", row.wait.p50Ns / 1000.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", row.wait.p99Ns / 1000.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", row.wait.p999Ns / 1000.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", row.hold.p50Ns / 1000.0);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", row.hold.p99Ns / 1000.0);
+            if (open) {
+                // 等待最多的调用位置（模块+偏移，可用addr2line查看对应的源码行）
+                for (uint32_t site = 0; site < row.siteCount && site < STATS_LOCK_CALL_SITES; ++site) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextDisabled("%s", row.sites[site].text);
+                    ImGui::TableNextColumn();
+                    ImGui::TableNextColumn();
+                    ImGui::TextDisabled("共等待 %.1f us", row.sites[site].waitNs / 1000.0);
+                }
+                ImGui::TreePop();
+            }
+        }
+        ImGui::EndTable();
+    }
+}
+
+// 绘制AI耗时面板：每个AI端点各阶段的p50/p99/p999（毫秒），用于区分网络、服务商和传输哪一段慢
+void DrawAITimingPanel()
+{
+    if (!g_snapshotValid) {
+        ImGui::TextDisabled("等待服务器...");
+        return;
+    }
+    const StatsSnapshot& snapshot = *g_snapshot;
+    if (snapshot.aiEndpointCount == 0) {
+        ImGui::TextDisabled("AI服务未启动");
+        return;
+    }
+    ImGui::Text("模型: %s", snapshot.aiModel);
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY;
+    if (ImGui::BeginTable("AITimingTable", 7, flags)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("端点");
+        ImGui::TableSetupColumn("阶段");
+        ImGui::TableSetupColumn("次数");
+        ImGui::TableSetupColumn("p50(ms)");
+        ImGui::TableSetupColumn("p99(ms)");
+        ImGui::TableSetupColumn("p999(ms)");
+        ImGui::TableSetupColumn("max(ms)");
+        ImGui::TableHeadersRow();
+        for (uint32_t i = 0; i < snapshot.aiEndpointCount && i < STATS_MAX_AI_ENDPOINTS; ++i) {
+            const StatsAIEndpoint& endpoint = snapshot.aiEndpoints[i];
+            for (size_t phase = 0; phase < STATS_AI_PHASES; ++phase) {
+                const StatsLatency& latency = endpoint.phases[phase];
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                if (phase == 0) {
+                    ImGui::TextUnformatted(endpoint.name);  // 同一端点只在第一行显示名字
+                }
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(snapshot.aiPhaseNames[phase]);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(latency.count));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", latency.p50Ns / 1e6);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", latency.p99Ns / 1e6);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", latency.p999Ns / 1e6);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", latency.maxNs / 1e6);
+            }
+        }
+        ImGui::EndTable();
+    }
+}
+
+// 绘制计数器面板
+void DrawCounterPanel()
+{
+    if (!g_snapshotValid) {
+        ImGui::TextDisabled("等待服务器...");
+        return;
+    }
+    static const char* const names[STATS_COUNTERS] = {
+        "累计连接数", "当前连接数", "在线用户", "登录成功", "登录失败", "收到消息",
+        "实时转发", "存为离线", "接收字节", "发送字节", "AI请求成功", "AI请求失败", "待推送离线消息",
+    };
+    const StatsSnapshot& snapshot = *g_snapshot;
+    ImGui::Text("运行时间: %llu 秒", static_cast<unsigned long long>(snapshot.publishTimeMs / 1000));
+    ImGui::Text("界面耗时: %.2f ms", g_uiBuildTimeMs);
+    if (ImGui::BeginTable("CounterTable", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        for (size_t i = 0; i < STATS_COUNTERS; ++i) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(names[i]);
+            ImGui::TableNextColumn();
+            ImGui::Text("%llu", static_cast<unsigned long long>(snapshot.counters[i]));
+        }
+        ImGui::EndTable();
+    }
+}
+
+// 绘制转发消息面板
+void DrawForwardMessagesPanel()
+{
+    ImGui::Text("转发");
+    ImGui::Separator();
+    
+    // 创建可滚动的子窗口
+    ImGui::BeginChild("ForwardMsgScrollArea", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
+    
+    if (g_localForwardLines.empty()) {
+        ImGui::TextDisabled("");
+    } else {
+        // 不自动换行（行高一致才能只提交可见的行），长消息用水平滚动条查看
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(g_localForwardLines.size()));
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                const std::string& msg = g_localForwardLines[row].text;
+                ImGui::TextUnformatted(msg.c_str(), msg.c_str() + msg.size());
+            }
+        }
+        
+        // 自动滚动到底部
+        if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
+            ImGui::SetScrollHereY(1.0f);
+    }
+    
+    ImGui::EndChild();
+}
+
+// 绘制请求消息面板
+void DrawRequestMessagesPanel()
+{
+    ImGui::Text("请求");
+    ImGui::Separator();
+    
+    // 创建可滚动的子窗口
+    ImGui::BeginChild("RequestMsgScrollArea", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
+    
+    if (g_localRequestLines.empty()) {
+        ImGui::TextDisabled("");
+    } else {
+        // 不自动换行（行高一致才能只提交可见的行），长消息用水平滚动条查看
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(g_localRequestLines.size()));
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                const std::string& msg = g_localRequestLines[row].text;
+                ImGui::TextUnformatted(msg.c_str(), msg.c_str() + msg.size());
+            }
+        }
+        
+        // 自动滚动到底部
+        if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
+            ImGui::SetScrollHereY(1.0f);
+    }
+    
+    ImGui::EndChild();
+}
@@ -0,0 +1,197 @@
+// 监视窗口压测工具：不创建窗口和图形设备，只用ImGui核心构建界面（NewFrame到Render，不提交给显卡）
+// 先用快照把三个日志面板各填满LOCAL_LOG_LINES行、用户和群聊表填满，然后连续构建若干帧，报告每帧耗时
+// idle：快照不变，只有各面板的绘制（ImGuiListClipper只提交可见的行）
+// churn：每帧一份新快照，用户和群聊表的变化计数都加1（整表重建），每类日志新增若干行（本地保持满行数，从头部淘汰）
+// 用法：monitorbench [--mode idle|churn] [--frames 帧数] [--lines churn每帧每类新增行数] [--width 宽] [--height 高]
+// 每次只测一种模式；churn的耗时包括把快照复制一份（对应监视窗口从共享内存读快照）
+#include "headers/monitorPanels.h"
+#include "headers/statsSegment.h"
+#include <imgui.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+// 压测参数
+struct BenchOptions {
+    std::string mode = "idle";
+    int frames = 600;
+    int lines = 200;
+    float width = 1280.0f;   // 与监视窗口的默认大小相同
+    float height = 720.0f;
+};
+
+static BenchOptions g_options;
+static std::unique_ptr<StatsSnapshot> g_benchSnapshot(new StatsSnapshot());
+
+// 填满用户表和群聊表（各一半用户在线，每个群都有全部用户）
+static void FillTables(StatsSnapshot& snapshot) {
+    snapshot.userCount = static_cast<uint32_t>(STATS_MAX_USERS);
+    for (size_t i = 0; i < STATS_MAX_USERS; ++i) {
+        StatsUser& user = snapshot.users[i];
+        user.userID = static_cast<uint8_t>(i);
+        user.online = i % 2;
+        user.port = static_cast<uint16_t>(50000 + i);
+        snprintf(user.name, sizeof(user.name), "用户%zu", i);
+        snprintf(user.ip, sizeof(user.ip), "192.168.1.%zu", i);
+        snapshot.heartbeatAgeMs[i] = static_cast<uint32_t>(i * 37 % 5000);
+    }
+    snapshot.groupCount = static_cast<uint32_t>(STATS_MAX_GROUPS);
+    for (size_t i = 0; i < STATS_MAX_GROUPS; ++i) {
+        StatsGroup& group = snapshot.groups[i];
+        snprintf(group.name, sizeof(group.name), "群聊%zu", i);
+        group.memberCount = 256;
+        memset(group.members, 0xff, sizeof(group.members));
+    }
+}
+
+// 每类日志追加count行（与服务器的转发日志内容相近，每50行一条WARN用于着色）
+static void AppendLogLines(StatsSnapshot& snapshot, size_t count) {
+    for (size_t kind = 0; kind < STATS_LOG_KINDS; ++kind) {
+        StatsLogTail& tail = snapshot.logs[kind];
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t seq = tail.nextSeq++;
+            snprintf(tail.lines[seq % STATS_LOG_LINES], STATS_LOG_LINE_SIZE,
+                     "[2026-01-01 12:00:00][%s]来自%llu的私聊消息已转发给: %llu",
+                     seq % 50 == 0 ? "WARN" : "PASS",
+                     static_cast<unsigned long long>(seq % 200 + 1),
+                     static_cast<unsigned long long>(seq % 199 + 2));
+        }
+    }
+}
+
+// 发布下一份快照：版本和两个变化计数都加1
+static void ApplyNextSnapshot(size_t newLines) {
+    StatsSnapshot& snapshot = *g_benchSnapshot;
+    ++snapshot.version;
+    ++snapshot.usersChangeSeq;
+    ++snapshot.groupsChangeSeq;
+    AppendLogLines(snapshot, newLines);
+    ApplyMonitorSnapshot(snapshot, BenchClock::now());
+}
+
+// 构建一帧，返回这一帧的顶点数
+static int BuildFrame() {
+    ImGui::NewFrame();
+    DrawMonitorWindow();
+    ImGui::Render();
+    return ImGui::GetDrawData()->TotalVtxCount;
+}
+
+static double MsSince(BenchClock::time_point since) {
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - since).count();
+}
+
+// 按毫秒排序后的耗时打印p50/p99/最大值
+static void PrintTimes(const char* name, std::vector<double>& times) {
+    if (times.empty()) {
+        return;
+    }
+    std::sort(times.begin(), times.end());
+    double total = 0.0;
+    for (double t : times) {
+        total += t;
+    }
+    printf("%-8s 平均 %7.3fms  p50 %7.3fms  p99 %7.3fms  最大 %7.3fms\n", name, total / times.size(),
+           times[times.size() / 2], times[std::min(times.size() - 1, times.size() * 99 / 100)], times.back());
+}
+
+static void PrintUsage() {
+    std::cerr << "用法: monitorbench [--mode idle|churn] [--frames 帧数] [--lines churn每帧每类新增行数] "
+                 "[--width 宽] [--height 高]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            PrintUsage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--mode" && (value == "idle" || value == "churn")) {
+            g_options.mode = value;
+        } else if (arg == "--frames") {
+            g_options.frames = std::max(1, atoi(value.c_str()));
+        } else if (arg == "--lines") {
+            g_options.lines = std::max(0, atoi(value.c_str()));
+        } else if (arg == "--width") {
+            g_options.width = static_cast<float>(std::max(320, atoi(value.c_str())));
+        } else if (arg == "--height") {
+            g_options.height = static_cast<float>(std::max(240, atoi(value.c_str())));
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    // 没有渲染后端：声明支持动态纹理，字形按需光栅化到纹理数据里，只是没有人上传给显卡
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures;
+    io.DisplaySize = ImVec2(g_options.width, g_options.height);
+    io.DeltaTime = 1.0f / 60.0f;
+    io.IniFilename = nullptr;
+    // 与监视窗口相同的中文字体，找不到时用内置字体（中文显示为问号）
+    // 先检查文件是否存在：调试版的ImGui在字体文件打不开时会断言
+    static const char* const fontPath = "c:/windows/fonts/msyh.ttc";
+    if (FILE* fontFile = fopen(fontPath, "rb")) {
+        fclose(fontFile);
+        io.Fonts->AddFontFromFileTTF(fontPath, 18.0f);
+    } else {
+        io.Fonts->AddFontDefault();
+    }
+    ImGui::StyleColorsDark();
+
+    // 填满各表：日志每次最多追加STATS_LOG_LINES行，超过就会被当作丢行
+    BenchClock::time_point fillStart = BenchClock::now();
+    FillTables(*g_benchSnapshot);
+    for (size_t filled = 0; filled < LOCAL_LOG_LINES; filled += STATS_LOG_LINES) {
+        ApplyNextSnapshot(STATS_LOG_LINES);
+    }
+    double fillMs = MsSince(fillStart);
+
+    // 预热：第一次绘制时光栅化字形、创建窗口和表格的状态
+    for (int i = 0; i < 10; ++i) {
+        BuildFrame();
+    }
+
+    bool churn = g_options.mode == "churn";
+    std::vector<double> applyTimes;
+    std::vector<double> buildTimes;
+    std::vector<double> frameTimes;
+    long long vertices = 0;
+    for (int i = 0; i < g_options.frames; ++i) {
+        BenchClock::time_point frameStart = BenchClock::now();
+        if (churn) {
+            ApplyNextSnapshot(static_cast<size_t>(g_options.lines));
+            applyTimes.push_back(MsSince(frameStart));
+        }
+        BenchClock::time_point buildStart = BenchClock::now();
+        vertices += BuildFrame();
+        buildTimes.push_back(MsSince(buildStart));
+        frameTimes.push_back(MsSince(frameStart));
+    }
+
+    printf("模式 %s, %d 帧, 窗口 %.0fx%.0f, 每个日志面板 %zu 行, 用户 %zu, 群聊 %zu\n", g_options.mode.c_str(),
+           g_options.frames, g_options.width, g_options.height, LOCAL_LOG_LINES, STATS_MAX_USERS, STATS_MAX_GROUPS);
+    printf("填充     %.1fms\n", fillMs);
+    if (churn) {
+        printf("每帧每类新增 %d 行日志，用户和群聊表整表重建\n", g_options.lines);
+        PrintTimes("快照", applyTimes);
+    }
+    PrintTimes("构建界面", buildTimes);
+    PrintTimes("每帧", frameTimes);
+    printf("每帧顶点 %lld\n", vertices / g_options.frames);
+
+    ImGui::DestroyContext();
+    return 0;
+}
@@ -0,0 +1,640 @@
+#include "headers/offlineStore.h"
+#include "headers/socket.h"
+#include "headers/logger.h"
+#include "headers/metrics.h"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// 全局离线消息存储实例
+OfflineStore g_offlineStore;
+
+// 存储参数
+static const char* OFFLINE_FOLDER = "offline";
+static const uint32_t OFFLINE_RECORD_MAGIC = 0x4E4C464F;        // "OFLN"
+static const uint64_t SEGMENT_MAX_BYTES = 64ull * 1024 * 1024;  // 单个段文件超过64MB就换新段
+static const size_t DELIVER_BATCH_FRAMES = 256;                 // 每批推送最多的帧数
+static const size_t DELIVER_BATCH_BYTES = 1024 * 1024;          // 每批推送最多的字节数
+static const uint64_t COMPACT_LIVE_DIVISOR = 8;                 // 旧段中待推送的字节不到1/8时压缩（最多复制8MB）
+static const size_t COMPACT_BATCH_RECORDS = 256;                // 压缩时每次持锁最多复制的消息数
+static const int OFFLINE_CHECKPOINT_MS = 1000;                  // 保存投递游标（以及重试删除段文件）的间隔
+
+#pragma pack(push,1)
+// 段文件中每条记录的头部，后面紧跟length字节的网络格式数据帧
+struct OfflineRecordHeader {
+    uint32_t magic;     // 固定魔数，用来识别写了一半的尾部
+    uint32_t length;    // 数据帧长度
+    uint64_t seq;       // 该用户的消息序号
+    uint8_t  userID;    // 接收者ID
+    uint8_t  reserved[3];
+    uint32_t checksum;  // 数据帧的FNV-1a校验值
+};
+#pragma pack(pop)
+
+// FNV-1a校验（只用来发现崩溃时写坏的记录，不需要很强）
+static uint32_t Checksum(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+OfflineStore::SegmentView::~SegmentView() {
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+}
+
+OfflineStore::OfflineStore() : activeSegment_(0), cursorsDirty_(false), opened_(false), stopping_(false) {
+}
+
+OfflineStore::~OfflineStore() {
+    Close();
+    for (auto& pair : segments_) {
+        pair.second.view.reset();
+        if (pair.second.file != INVALID_HANDLE_VALUE) {
+            CloseHandle(pair.second.file);
+        }
+    }
+}
+
+std::string OfflineStore::SegmentPath(uint32_t segmentID) const {
+    char name[32];
+    snprintf(name, sizeof(name), "segment_%06u.log", segmentID);
+    return directory_ + "/" + name;
+}
+
+bool OfflineStore::Open(const std::string& directory) {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    directory_ = directory;
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+
+    // 读取投递游标（用户ID最多256个，直接存一个定长数组）
+    uint64_t cursors[256] = {};
+    std::ifstream cursorFile(directory_ + "/cursors.dat", std::ios::binary);
+    if (cursorFile.is_open()) {
+        cursorFile.read(reinterpret_cast<char*>(cursors), sizeof(cursors));
+        cursorFile.close();
+    }
+    for (int id = 0; id < 256; ++id) {
+        if (cursors[id] != 0) {
+            users_[static_cast<uint8_t>(id)].cursor = cursors[id];
+            users_[static_cast<uint8_t>(id)].nextSeq = cursors[id];
+        }
+    }
+
+    // 找出所有段文件并按编号排序
+    std::vector<uint32_t> segmentIDs;
+    for (const auto& item : std::filesystem::directory_iterator(directory_, ec)) {
+        std::string name = item.path().filename().string();
+        unsigned int segmentID = 0;
+        if (sscanf(name.c_str(), "segment_%u.log", &segmentID) == 1) {
+            segmentIDs.push_back(segmentID);
+        }
+    }
+    std::sort(segmentIDs.begin(), segmentIDs.end());
+
+    // 按顺序扫描所有段，再按序号重建每个用户的索引
+    // 压缩时搬到新段的消息序号比新段里其他消息小；压缩到一半崩溃时同一条消息会在新旧两个段里各有一份，保留新段的那份
+    std::map<uint8_t, std::vector<ScannedEntry>> scanned;
+    for (uint32_t segmentID : segmentIDs) {
+        ScanSegment(segmentID, segments_[segmentID], cursors, scanned);
+    }
+    size_t recovered = 0;
+    for (auto& pair : scanned) {
+        std::vector<ScannedEntry>& entries = pair.second;
+        std::sort(entries.begin(), entries.end(), [](const ScannedEntry& a, const ScannedEntry& b) {
+            return a.seq != b.seq ? a.seq < b.seq : a.entry.segment > b.entry.segment;
+        });
+        UserIndex& user = users_[pair.first];
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (i > 0 && entries[i].seq == entries[i - 1].seq) {
+                continue;
+            }
+            const IndexEntry& entry = entries[i].entry;
+            user.entries.push_back(entry);
+            Segment& segment = segments_[entry.segment];
+            segment.liveCount++;
+            segment.liveBytes += sizeof(OfflineRecordHeader) + entry.length;
+            recovered++;
+        }
+    }
+
+    // 已经全部推送完的旧段直接删掉
+    for (uint32_t segmentID : segmentIDs) {
+        if (segments_[segmentID].liveCount == 0) {
+            RemoveSegment(segmentID);
+        }
+    }
+
+    // 每次启动都新开一个段写入，不去续写可能被截断的旧段
+    uint32_t nextSegment = segmentIDs.empty() ? 1 : segmentIDs.back() + 1;
+    if (!OpenActiveSegment(nextSegment)) {
+        WriteLog(LogLevel::FATAL, "无法创建离线消息段文件: " + SegmentPath(nextSegment));
+        return false;
+    }
+
+    // 待推送消息很少的旧段交给后台线程复制到活动段
+    for (uint32_t segmentID : segmentIDs) {
+        MaybeCompactSegment(segmentID);
+    }
+
+    opened_ = true;
+    stopping_ = false;
+    maintenanceThread_ = std::thread(&OfflineStore::MaintenanceThread, this);
+    WriteLog(LogLevel::INFO, "离线消息存储已打开, 恢复待推送消息: " + std::to_string(recovered) + " 条");
+    return true;
+}
+
+void OfflineStore::Close() {
+    {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        if (!opened_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    maintenanceCv_.notify_all();
+    if (maintenanceThread_.joinable()) {
+        maintenanceThread_.join();
+    }
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    opened_ = false;
+}
+
+bool OfflineStore::OpenActiveSegment(uint32_t segmentID) {
+    // 允许共享删除：段被压缩删除时，仍在推送中的映射可以继续读到最后
+    HANDLE file = CreateFileA(SegmentPath(segmentID).c_str(), GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    Segment& segment = segments_[segmentID];
+    segment.file = file;
+    segment.size = 0;
+    segment.liveCount = 0;
+    segment.liveBytes = 0;
+    activeSegment_ = segmentID;
+    return true;
+}
+
+void OfflineStore::ScanSegment(uint32_t segmentID, Segment& segment, const uint64_t* cursors,
+                               std::map<uint8_t, std::vector<ScannedEntry>>& scanned) {
+    segment.file = CreateFileA(SegmentPath(segmentID).c_str(), GENERIC_READ,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                               nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (segment.file == INVALID_HANDLE_VALUE) {
+        WriteLog(LogLevel::WARN, "无法打开离线消息段文件: " + SegmentPath(segmentID));
+        return;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(segment.file, &fileSize) || fileSize.QuadPart == 0) {
+        return;
+    }
+    segment.size = static_cast<uint64_t>(fileSize.QuadPart);
+
+    std::shared_ptr<SegmentView> view = MapSegment(segmentID, segment.size);
+    if (!view) {
+        WriteLog(LogLevel::WARN, "无法映射离线消息段文件: " + SegmentPath(segmentID));
+        return;
+    }
+
+    uint64_t offset = 0;
+    while (offset + sizeof(OfflineRecordHeader) <= view->size) {
+        OfflineRecordHeader record;
+        memcpy(&record, view->data + offset, sizeof(record));
+        uint64_t frameOffset = offset + sizeof(record);
+        if (record.magic != OFFLINE_RECORD_MAGIC || frameOffset + record.length > view->size ||
+            Checksum(view->data + frameOffset, record.length) != record.checksum) {
+            // 崩溃时写了一半的尾部，后面的内容不可信
+            WriteLog(LogLevel::WARN, "离线消息段文件尾部损坏, 已忽略: " + SegmentPath(segmentID));
+            break;
+        }
+
+        UserIndex& user = users_[record.userID];
+        if (record.seq >= cursors[record.userID]) {
+            scanned[record.userID].push_back({record.seq, {segmentID, static_cast<uint32_t>(frameOffset), record.length}});
+        }
+        user.nextSeq = std::max(user.nextSeq, record.seq + 1);
+        offset = frameOffset + record.length;
+    }
+}
+
+std::shared_ptr<OfflineStore::SegmentView> OfflineStore::MapSegment(uint32_t segmentID, uint64_t requiredSize) {
+    Segment& segment = segments_[segmentID];
+    if (segment.view && segment.view->size >= requiredSize) {
+        return segment.view;
+    }
+
+    // 活动段一直在变长，旧的映射不够用时按当前大小重新映射（旧映射由持有者自行释放）
+    auto view = std::make_shared<SegmentView>();
+    view->size = segment.size;
+    view->mapping = CreateFileMappingA(segment.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!view->mapping) {
+        return nullptr;
+    }
+    view->data = static_cast<const char*>(MapViewOfFile(view->mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!view->data) {
+        return nullptr;
+    }
+    segment.view = view;
+    return view;
+}
+
+bool OfflineStore::Append(uint8_t userID, const Packet& packet) {
+    // 先在锁外拼好整条记录
+    std::vector<char> record(sizeof(OfflineRecordHeader));
+    SerializePacket(packet, record);
+    uint32_t frameLength = static_cast<uint32_t>(record.size() - sizeof(OfflineRecordHeader));
+
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    if (!opened_) {
+        return false;
+    }
+
+    UserIndex& user = users_[userID];
+    OfflineRecordHeader header = {};
+    header.magic = OFFLINE_RECORD_MAGIC;
+    header.length = frameLength;
+    header.seq = user.nextSeq;
+    header.userID = userID;
+    header.checksum = Checksum(record.data() + sizeof(header), frameLength);
+    memcpy(record.data(), &header, sizeof(header));
+
+    uint32_t segmentID = 0;
+    uint64_t offset = 0;
+    if (!WriteRecord(record, segmentID, offset)) {
+        return false;
+    }
+
+    Segment& segment = segments_[segmentID];
+    user.entries.push_back({segmentID, static_cast<uint32_t>(offset + sizeof(header)), frameLength});
+    user.nextSeq++;
+    segment.liveCount++;
+    segment.liveBytes += record.size();
+    return true;
+}
+
+// 把一条完整的记录追加到活动段，返回写在哪个段的什么位置（不登记存活计数）
+bool OfflineStore::WriteRecord(std::vector<char>& record, uint32_t& segmentID, uint64_t& offset) {
+    // 活动段写满了就换新段（旧段如果已经没有待推送消息，交给后台线程删除）
+    if (segments_[activeSegment_].size + record.size() > SEGMENT_MAX_BYTES) {
+        uint32_t oldSegment = activeSegment_;
+        if (!OpenActiveSegment(oldSegment + 1)) {
+            WriteLog(LogLevel::WARN, "无法创建离线消息段文件: " + SegmentPath(oldSegment + 1));
+            return false;
+        }
+        MaybeCompactSegment(oldSegment);
+    }
+
+    Segment& segment = segments_[activeSegment_];
+    DWORD written = 0;
+    if (!WriteFile(segment.file, record.data(), static_cast<DWORD>(record.size()), &written, nullptr) ||
+        written != record.size()) {
+        // 只写了一部分：截回原来的长度，否则之后所有记录的偏移都不对；截不回去就换新段，不再往这个段里写
+        LARGE_INTEGER position;
+        position.QuadPart = static_cast<LONGLONG>(segment.size);
+        if (!SetFilePointerEx(segment.file, position, nullptr, FILE_BEGIN) || !SetEndOfFile(segment.file)) {
+            uint32_t oldSegment = activeSegment_;
+            WriteLog(LogLevel::WARN, "离线消息段文件写入失败且无法截断, 改用新段: " + SegmentPath(oldSegment));
+            if (OpenActiveSegment(oldSegment + 1)) {
+                MaybeCompactSegment(oldSegment);
+            }
+        }
+        return false;
+    }
+
+    segmentID = activeSegment_;
+    offset = segment.size;
+    segment.size += record.size();
+    return true;
+}
+
+size_t OfflineStore::PendingCount(uint8_t userID) {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    auto it = users_.find(userID);
+    if (it == users_.end()) {
+        return 0;
+    }
+    return it->second.entries.size();
+}
+
+size_t OfflineStore::TotalPending() {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    size_t total = 0;
+    for (const auto& user : users_) {
+        total += user.second.entries.size();
+    }
+    return total;
+}
+
+size_t OfflineStore::Deliver(uint8_t userID, SOCKET sock, bool& complete) {
+    complete = true;
+    size_t totalSent = 0;
+
+    while (true) {
+        // 持锁只登记这一批要发哪些帧，数据本身直接指向映射内存
+        std::vector<std::shared_ptr<SegmentView>> views;
+        std::vector<WSABUF> buffers;
+        {
+            InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+            auto it = users_.find(userID);
+            if (it == users_.end()) {
+                break;
+            }
+            size_t batchBytes = 0;
+            for (const IndexEntry& entry : it->second.entries) {
+                if (buffers.size() >= DELIVER_BATCH_FRAMES ||
+                    (!buffers.empty() && batchBytes + entry.length > DELIVER_BATCH_BYTES)) {
+                    break;
+                }
+                std::shared_ptr<SegmentView> view = MapSegment(entry.segment, entry.offset + entry.length);
+                if (!view) {
+                    WriteLog(LogLevel::WARN, "无法映射离线消息段文件: " + SegmentPath(entry.segment));
+                    break;
+                }
+                WSABUF buf;
+                buf.buf = const_cast<char*>(view->data + entry.offset);
+                buf.len = entry.length;
+                buffers.push_back(buf);
+                views.push_back(view);
+                batchBytes += entry.length;
+            }
+        }
+        if (buffers.empty()) {
+            break;
+        }
+
+        // 记下每帧的长度，SendBuffers会修改buffers
+        std::vector<ULONG> frameLengths;
+        frameLengths.reserve(buffers.size());
+        for (const WSABUF& buf : buffers) {
+            frameLengths.push_back(buf.len);
+        }
+
+        size_t sentBytes = SendBuffers(sock, buffers);
+        size_t sentFrames = 0;
+        for (ULONG length : frameLengths) {
+            if (sentBytes < length) {
+                break;
+            }
+            sentBytes -= length;
+            sentFrames++;
+        }
+
+        // 推进游标，释放已推送的消息
+        {
+            InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+            UserIndex& user = users_[userID];
+            size_t count = std::min(sentFrames, user.entries.size());
+            for (size_t i = 0; i < count; ++i) {
+                IndexEntry entry = user.entries.front();
+                user.entries.pop_front();
+                user.cursor++;
+                ReleaseEntry(entry);
+            }
+        }
+        totalSent += sentFrames;
+
+        if (sentFrames < frameLengths.size()) {
+            complete = false;
+            break;
+        }
+    }
+
+    if (totalSent > 0) {
+        InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+        cursorsDirty_ = true;  // 由后台线程定期保存
+    }
+    return totalSent;
+}
+
+void OfflineStore::DropUser(uint8_t userID) {
+    InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+    auto it = users_.find(userID);
+    if (it == users_.end()) {
+        return;
+    }
+    UserIndex& user = it->second;
+    while (!user.entries.empty()) {
+        IndexEntry entry = user.entries.front();
+        user.entries.pop_front();
+        ReleaseEntry(entry);
+    }
+    user.cursor = user.nextSeq;
+    cursorsDirty_ = true;
+}
+
+// 一条消息推送完毕：所在段的存活计数减一，不是活动段且归零或剩得很少时交给后台线程删除或压缩
+void OfflineStore::ReleaseEntry(const IndexEntry& entry) {
+    auto it = segments_.find(entry.segment);
+    if (it == segments_.end()) {
+        return;
+    }
+    if (it->second.liveCount > 0) {
+        it->second.liveCount--;
+    }
+    uint64_t bytes = sizeof(OfflineRecordHeader) + entry.length;
+    it->second.liveBytes = it->second.liveBytes > bytes ? it->second.liveBytes - bytes : 0;
+    MaybeCompactSegment(entry.segment);
+}
+
+// 登记需要后台线程处理的旧段（持有mutex_调用，只做判断，不碰文件）
+void OfflineStore::MaybeCompactSegment(uint32_t segmentID) {
+    auto it = segments_.find(segmentID);
+    if (it == segments_.end() || segmentID == activeSegment_) {
+        return;
+    }
+    if (it->second.liveCount == 0 || it->second.liveBytes * COMPACT_LIVE_DIVISOR < it->second.size) {
+        if (compactQueue_.insert(segmentID).second) {
+            maintenanceCv_.notify_one();
+        }
+    }
+}
+
+// 压缩的一步：从nextUser开始，把旧段中还没推送的消息连同记录头（序号、校验值不变）复制到活动段并改写索引，
+// 最多复制COMPACT_BATCH_RECORDS条（持有mutex_调用，每步之间释放锁，推送和追加不用等整个段复制完）
+// 返回true表示这个段已经处理完（或者无法继续，剩下的消息留在旧段，下次释放消息时再登记），false表示还有剩余
+bool OfflineStore::CompactSegmentStep(uint32_t segmentID, uint8_t& nextUser, size_t& moved) {
+    auto segmentIt = segments_.find(segmentID);
+    if (segmentIt == segments_.end() || segmentIt->second.liveCount == 0) {
+        return true;
+    }
+    std::shared_ptr<SegmentView> view = MapSegment(segmentID, segmentIt->second.size);
+    if (!view) {
+        WriteLog(LogLevel::WARN, "无法映射离线消息段文件: " + SegmentPath(segmentID));
+        return true;
+    }
+
+    size_t copied = 0;
+    for (auto userIt = users_.lower_bound(nextUser); userIt != users_.end(); ++userIt) {
+        nextUser = userIt->first;
+        for (IndexEntry& entry : userIt->second.entries) {
+            if (entry.segment != segmentID) {
+                continue;
+            }
+            if (copied == COMPACT_BATCH_RECORDS) {
+                return false;  // 下一步从这个用户继续（已经搬走的消息不再属于旧段，会被跳过）
+            }
+            const char* recordStart = view->data + entry.offset - sizeof(OfflineRecordHeader);
+            std::vector<char> record(recordStart, recordStart + sizeof(OfflineRecordHeader) + entry.length);
+            uint32_t newSegment = 0;
+            uint64_t newOffset = 0;
+            if (!WriteRecord(record, newSegment, newOffset)) {
+                WriteLog(LogLevel::WARN, "离线消息段压缩失败: " + SegmentPath(segmentID));
+                return true;
+            }
+            Segment& source = segments_[segmentID];
+            source.liveCount--;
+            source.liveBytes -= record.size();
+            Segment& target = segments_[newSegment];
+            target.liveCount++;
+            target.liveBytes += record.size();
+            entry = {newSegment, static_cast<uint32_t>(newOffset + sizeof(OfflineRecordHeader)), entry.length};
+            moved++;
+            copied++;
+        }
+    }
+    return true;
+}
+
+// 关闭并删除段文件，从索引中移除（持有mutex_调用）
+// 删除失败时段留在索引里并标记deletePending，后台线程下次保存游标时重试，不会把文件遗留在磁盘上却忘掉它
+void OfflineStore::RemoveSegment(uint32_t segmentID) {
+    auto it = segments_.find(segmentID);
+    if (it == segments_.end()) {
+        return;
+    }
+    Segment& segment = it->second;
+    segment.view.reset();
+    if (segment.file != INVALID_HANDLE_VALUE) {
+        CloseHandle(segment.file);
+        segment.file = INVALID_HANDLE_VALUE;
+    }
+    std::string path = SegmentPath(segmentID);
+    if (!DeleteFileA(path.c_str())) {
+        DWORD error = GetLastError();
+        if (error != ERROR_FILE_NOT_FOUND) {
+            if (!segment.deletePending) {
+                WriteLog(LogLevel::WARN, "无法删除离线消息段文件, 稍后重试: " + path + ", 错误码: " + std::to_string(error));
+            }
+            segment.deletePending = true;
+            return;
+        }
+    }
+    if (segment.deletePending) {
+        WriteLog(LogLevel::INFO, "离线消息段文件重试删除成功: " + path);
+    }
+    segments_.erase(it);
+}
+
+// 后台维护线程：逐步压缩登记的旧段，定期保存投递游标、重试删除失败的段文件
+void OfflineStore::MaintenanceThread() {
+    auto lastCheckpoint = std::chrono::steady_clock::now();
+    bool compacting = false;  // 正在分步压缩compactingSegment
+    uint32_t compactingSegment = 0;
+    uint8_t nextUser = 0;      // 下一步从这个用户开始
+    size_t moved = 0;
+    while (true) {
+        uint64_t cursors[256] = {};
+        bool saveCursors = false;
+        bool stopping = false;
+        {
+            mutex_.lock(LOCK_SITE);
+            std::unique_lock<InstrumentedMutex> lock(mutex_, std::adopt_lock);
+            if (!compacting) {
+                maintenanceCv_.wait_for(lock, std::chrono::milliseconds(OFFLINE_CHECKPOINT_MS),
+                                        [this] { return stopping_ || !compactQueue_.empty(); });
+            }
+            stopping = stopping_;
+
+            if (!stopping && !compacting && !compactQueue_.empty()) {
+                compactingSegment = *compactQueue_.begin();
+                compactQueue_.erase(compactQueue_.begin());
+                compacting = true;
+                nextUser = 0;
+                moved = 0;
+            }
+            if (!stopping && compacting && CompactSegmentStep(compactingSegment, nextUser, moved)) {
+                compacting = false;
+                auto it = segments_.find(compactingSegment);
+                if (it != segments_.end() && it->second.liveCount == 0 && compactingSegment != activeSegment_) {
+                    if (moved > 0) {
+                        WriteLog(LogLevel::INFO, "离线消息段已压缩: " + SegmentPath(compactingSegment) + ", 搬移 " +
+                                                 std::to_string(moved) + " 条");
+                    }
+                    RemoveSegment(compactingSegment);
+                }
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (stopping || now - lastCheckpoint >= std::chrono::milliseconds(OFFLINE_CHECKPOINT_MS)) {
+                lastCheckpoint = now;
+                std::vector<uint32_t> retry;
+                for (const auto& pair : segments_) {
+                    if (pair.second.deletePending) {
+                        retry.push_back(pair.first);
+                    }
+                }
+                for (uint32_t segmentID : retry) {
+                    RemoveSegment(segmentID);
+                }
+                if (cursorsDirty_) {
+                    for (const auto& pair : users_) {
+                        cursors[pair.first] = pair.second.cursor;
+                    }
+                    cursorsDirty_ = false;
+                    saveCursors = true;
+                }
+            }
+        }
+
+        // 写文件和刷盘在锁外进行（只有这个线程写游标文件）
+        if (saveCursors && !WriteCursors(cursors)) {
+            InstrumentedLockGuard lock(mutex_, LOCK_SITE);
+            cursorsDirty_ = true;  // 下次再试
+        }
+        if (stopping) {
+            break;
+        }
+    }
+}
+
+// 保存投递游标：先写临时文件并刷盘，再原子替换，避免写到一半崩溃导致游标丢失（只在后台维护线程中调用）
+bool OfflineStore::WriteCursors(const uint64_t* cursors) {
+    std::string path = directory_ + "/cursors.dat";
+    std::string tempPath = path + ".tmp";
+    HANDLE file = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        WriteLog(LogLevel::WARN, "无法保存离线消息投递游标, 错误码: " + std::to_string(GetLastError()));
+        return false;
+    }
+    DWORD size = static_cast<DWORD>(256 * sizeof(uint64_t));
+    DWORD written = 0;
+    bool ok = WriteFile(file, cursors, size, &written, nullptr) && written == size && FlushFileBuffers(file);
+    CloseHandle(file);
+    if (!ok || !MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        WriteLog(LogLevel::WARN, "无法保存离线消息投递游标, 错误码: " + std::to_string(GetLastError()));
+        return false;
+    }
+    return true;
+}
+
+void InitializeOfflineStore() {
+    if (!g_offlineStore.Open(OFFLINE_FOLDER)) {
+        WriteLog(LogLevel::FATAL, "离线消息存储初始化失败，离线消息将无法保存");
+    }
+    RegisterGaugeCallback("chat_offline_pending_messages", "Private offline messages waiting for delivery",
+                          [] { return static_cast<double>(g_offlineStore.TotalPending()); });
+}
@@ -1,8 +1,64 @@
 #include "headers/socket.h"
 #include "headers/logger.h"
+#include "headers/metrics.h"
+#include "headers/latency.h"
+#include "headers/trace.h"
+#include "headers/lockStats.h"
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
+// 同一个socket的发送互斥：客户端线程（转发、补发离线消息和群聊消息、历史消息）和AI回复的发送线程会写同一个socket，
+// 一次发送必须整段写完另一次才能开始，否则阻塞或部分发送（SendBuffers续发剩余部分）时两边的帧会交错
+struct SendChannel {
+    SOCKET sock;
+    InstrumentedMutex mutex;
+    bool closed;   // mutex保护
+
+    explicit SendChannel(SOCKET s) : sock(s), mutex("socket.send"), closed(false) {}
+};
+
+// 打开着的连接的发送通道（连接关闭时移除）
+static std::mutex g_sendChannelsMutex;
+static std::unordered_map<SOCKET, std::shared_ptr<SendChannel>> g_sendChannels;
+
+std::shared_ptr<SendChannel> OpenSendChannel(SOCKET sock) {
+    std::shared_ptr<SendChannel> channel = std::make_shared<SendChannel>(sock);
+    std::lock_guard<std::mutex> lock(g_sendChannelsMutex);
+    g_sendChannels[sock] = channel;
+    return channel;
+}
+
+void CloseSendChannel(const std::shared_ptr<SendChannel>& channel) {
+    if (!channel) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_sendChannelsMutex);
+        auto it = g_sendChannels.find(channel->sock);
+        if (it != g_sendChannels.end() && it->second == channel) {
+            g_sendChannels.erase(it);
+        }
+    }
+    // 等正在进行的发送结束（调用方先shutdown，阻塞的发送会立即失败）
+    InstrumentedLockGuard lock(channel->mutex, LOCK_SITE);
+    channel->closed = true;
+}
+
+// 按socket查找发送通道（没有经过OpenSendChannel的socket临时建一个，只用于这一次发送）
+static std::shared_ptr<SendChannel> FindSendChannel(SOCKET sock) {
+    {
+        std::lock_guard<std::mutex> lock(g_sendChannelsMutex);
+        auto it = g_sendChannels.find(sock);
+        if (it != g_sendChannels.end()) {
+            return it->second;
+        }
+    }
+    return std::make_shared<SendChannel>(sock);
+}
+
 // 获取本机ip地址函数(要在创建了socket之后才调用)
 std::string GetServerIP() {
     char hostname[256];
@@ -56,6 +112,7 @@ int SetupServerAddress(const int port, sockaddr_in& address_info) {
 // 接收数据包函数
 bool RecvPacket(SOCKET sock, Packet& packet) {
     // 先接收Header（Header的定义在chatmsg.hpp中）
+    TraceSpan recvSpan("recv");
     char headerBuf[sizeof(Header)]; // 取得包头长度
     int totalReceived = 0; 
     while (totalReceived < sizeof(Header)) { // 循环接收包头
@@ -81,15 +138,19 @@ bool RecvPacket(SOCKET sock, Packet& packet) {
         totalReceived += n;
     }
     
+    g_metricBytesReceived.Inc(fullPacket.size());
+    recvSpan.SetArg("bytes", static_cast<int64_t>(fullPacket.size()));
+    recvSpan.End();
+
     // 使用parseFrom解析
+    TraceSpan parseSpan("parse");
     return packet.parseFrom(fullPacket.data(), fullPacket.size());
 }
 
-// 发送数据包函数
-bool SendPacket(SOCKET sock, const Packet& packet) {
-    // 准备完整数据包（header + field1 + field2 + field3 + field4）
-    size_t totalSize = packet.size();
-    std::vector<char> fullPacket(totalSize);
+// 数据包序列化函数：header转为网络字节序，后面依次接上各个field
+void SerializePacket(const Packet& packet, std::vector<char>& out) {
+    size_t offset = out.size();
+    out.resize(offset + packet.size());
     
     // 1. 拷贝并转换header为网络字节序
     Header networkHeader;
@@ -98,43 +159,163 @@ bool SendPacket(SOCKET sock, const Packet& packet) {
     networkHeader.field2Len = h2n16(networkHeader.field2Len);
     networkHeader.field3Len = h2n16(networkHeader.field3Len);
     networkHeader.field4Len = h2n16(networkHeader.field4Len);
-    memcpy(fullPacket.data(), &networkHeader, sizeof(Header));
+    memcpy(out.data() + offset, &networkHeader, sizeof(Header));
+    offset += sizeof(Header);
     
     // 2. 依次拷贝各个field到header后面
-    size_t offset = sizeof(Header);
-    
     const auto& field1 = packet.getField1();
     if (!field1.empty()) {
-        memcpy(fullPacket.data() + offset, field1.data(), field1.size());
+        memcpy(out.data() + offset, field1.data(), field1.size());
         offset += field1.size();
     }
     
     const auto& field2 = packet.getField2();
     if (!field2.empty()) {
-        memcpy(fullPacket.data() + offset, field2.data(), field2.size());
+        memcpy(out.data() + offset, field2.data(), field2.size());
         offset += field2.size();
     }
     
     const auto& field3 = packet.getField3();
     if (!field3.empty()) {
-        memcpy(fullPacket.data() + offset, field3.data(), field3.size());
+        memcpy(out.data() + offset, field3.data(), field3.size());
         offset += field3.size();
     }
     
     const auto& field4 = packet.getField4();
     if (!field4.empty()) {
-        memcpy(fullPacket.data() + offset, field4.data(), field4.size());
+        memcpy(out.data() + offset, field4.data(), field4.size());
     }
+}
+
+// 发送数据包函数
+bool SendPacket(SOCKET sock, const Packet& packet) {
+    return SendPacket(FindSendChannel(sock), packet);
+}
+
+bool SendPacket(const std::shared_ptr<SendChannel>& channel, const Packet& packet) {
+    LatencyStageTimer writeTimer(LatencyStage::SOCKET_WRITE);
+    TraceSpan traceSpan("SendPacket", "bytes", static_cast<int64_t>(packet.size()));
+    // 准备完整数据包（header + field1 + field2 + field3 + field4）
+    std::vector<char> fullPacket;
+    SerializePacket(packet, fullPacket);
+    size_t totalSize = fullPacket.size();
     
-    // 3. 一次性发送完整数据包
+    // 一次性发送完整数据包（连接已经关闭时不发送，句柄可能已经分给了新连接）
+    InstrumentedLockGuard sendLock(channel->mutex, LOCK_SITE);
+    if (channel->closed) {
+        return false;
+    }
     int totalSent = 0;
     while (totalSent < totalSize) {
-        int n = send(sock, fullPacket.data() + totalSent, totalSize - totalSent, 0);
+        int n = send(channel->sock, fullPacket.data() + totalSent, totalSize - totalSent, 0);
         if (n <= 0) {
+            g_metricBytesSent.Inc(totalSent);
             return false;
         }
         totalSent += n;
     }
     
+    g_metricBytesSent.Inc(totalSent);
     return true;
 }
+
+// 聚合发送函数：一次WSASend写出多段缓冲区，遇到部分发送时跳过已写出的部分继续发（调用方持有发送锁）
+// 返回值：实际发送的总字节数（与缓冲区总长度不等说明连接出错）
+static size_t SendBuffersLocked(SOCKET sock, std::vector<WSABUF>& buffers) {
+    LatencyStageTimer writeTimer(LatencyStage::SOCKET_WRITE);
+    size_t totalSent = 0;
+    size_t first = 0; // 第一个还没发完的缓冲区
+    while (first < buffers.size()) {
+        DWORD sent = 0;
+        int ret = WSASend(sock, buffers.data() + first, static_cast<DWORD>(buffers.size() - first),
+                          &sent, 0, nullptr, nullptr);
+        if (ret == SOCKET_ERROR || sent == 0) {
+            break;
+        }
+        totalSent += sent;
+
+        // 跳过已经完整发出的缓冲区，并调整发了一半的那个
+        while (first < buffers.size() && sent >= buffers[first].len) {
+            sent -= buffers[first].len;
+            first++;
+        }
+        if (first < buffers.size() && sent > 0) {
+            buffers[first].buf += sent;
+            buffers[first].len -= sent;
+        }
+    }
+    g_metricBytesSent.Inc(totalSent);
+    return totalSent;
+}
+
+size_t SendBuffers(SOCKET sock, std::vector<WSABUF>& buffers) {
+    std::shared_ptr<SendChannel> channel = FindSendChannel(sock);
+    InstrumentedLockGuard sendLock(channel->mutex, LOCK_SITE);
+    if (channel->closed) {
+        return 0;
+    }
+    return SendBuffersLocked(sock, buffers);
+}
+
+// 批量发送数据包：把多帧的包头和变长区直接拼成WSABUF数组，不再逐帧拷贝和逐帧send
+// 返回值：完整发出的帧数（全部成功时等于packets.size()）
+size_t SendPacketBatch(SOCKET sock, const std::vector<Packet>& packets) {
+    TraceSpan traceSpan("SendPacketBatch", "packets", static_cast<int64_t>(packets.size()));
+    if (packets.empty()) {
+        return 0;
+    }
+
+    std::vector<Header> networkHeaders(packets.size()); // 网络字节序的包头（WSABUF指向这里，发送完前不能释放）
+    std::vector<size_t> frameEnds(packets.size());      // 每帧结束时的累计字节数，用来换算发送了几帧
+    std::vector<WSABUF> buffers;
+    buffers.reserve(packets.size() * 5);
+
+    // 把一段数据挂到缓冲区数组上（空段跳过）
+    auto appendBuffer = [&buffers](const void* data, size_t len) {
+        if (len == 0) {
+            return;
+        }
+        WSABUF buf;
+        buf.buf = const_cast<char*>(static_cast<const char*>(data));
+        buf.len = static_cast<ULONG>(len);
+        buffers.push_back(buf);
+    };
+
+    size_t totalSize = 0;
+    for (size_t i = 0; i < packets.size(); ++i) {
+        const Packet& packet = packets[i];
+
+        // 拷贝并转换header为网络字节序
+        Header& networkHeader = networkHeaders[i];
+        memcpy(&networkHeader, packet.data(), sizeof(Header));
+        networkHeader.field1Len = h2n16(networkHeader.field1Len);
+        networkHeader.field2Len = h2n16(networkHeader.field2Len);
+        networkHeader.field3Len = h2n16(networkHeader.field3Len);
+        networkHeader.field4Len = h2n16(networkHeader.field4Len);
+
+        appendBuffer(&networkHeader, sizeof(Header));
+        appendBuffer(packet.getField1().data(), packet.getField1().size());
+        appendBuffer(packet.getField2().data(), packet.getField2().size());
+        appendBuffer(packet.getField3().data(), packet.getField3().size());
+        appendBuffer(packet.getField4().data(), packet.getField4().size());
+
+        totalSize += packet.size();
+        frameEnds[i] = totalSize;
+    }
+
+    size_t sentBytes = 0;
+    {
+        std::shared_ptr<SendChannel> channel = FindSendChannel(sock);
+        InstrumentedLockGuard sendLock(channel->mutex, LOCK_SITE);
+        if (!channel->closed) {
+            sentBytes = SendBuffersLocked(sock, buffers);
+        }
+    }
+
+    // 统计完整发出的帧数（最后一帧发了一半的不算）
+    size_t sentFrames = 0;
+    while (sentFrames < frameEnds.size() && frameEnds[sentFrames] <= sentBytes) {
+        sentFrames++;
+    }
+    return sentFrames;
+}
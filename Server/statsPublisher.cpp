@@ -0,0 +1,249 @@
+#include "headers/statsPublisher.h"
+#include "headers/statsSegment.h"
+#include "headers/userControl.h"
+#include "headers/offlineStore.h"
+#include "headers/logger.h"
+#include "headers/metrics.h"
+#include "headers/latency.h"
+#include "headers/lockStats.h"
+#include "headers/aiTiming.h"
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static const int STATS_PUBLISH_INTERVAL_MS = 100;
+
+static_assert(STATS_LATENCY_TYPES == LATENCY_TYPE_SLOTS, "共享内存中的延迟表大小与latency.h不一致");
+static_assert(STATS_LATENCY_STAGES == static_cast<size_t>(LatencyStage::COUNT), "共享内存中的阶段数与latency.h不一致");
+static_assert(STATS_MAX_AI_ENDPOINTS == AI_MAX_ENDPOINTS, "共享内存中的AI端点数与aiEndpoints.h不一致");
+static_assert(STATS_AI_PHASES == AI_PHASE_COUNT, "共享内存中的AI阶段数与aiTiming.h不一致");
+
+// 复制字符串到定长数组（截断并保证以0结尾）
+template <size_t N>
+static void CopyText(char (&dest)[N], const std::string& text) {
+    size_t length = text.size() < N - 1 ? text.size() : N - 1;
+    memcpy(dest, text.data(), length);
+    dest[length] = '\0';
+}
+
+// 上一次发布的用户表和群聊表，用于判断内容是否变化
+struct SessionTables {
+    uint32_t userCount;
+    uint32_t groupCount;
+    StatsUser users[STATS_MAX_USERS];
+    StatsGroup groups[STATS_MAX_GROUPS];
+};
+
+// 用户、会话和群聊（唯一一处持有g_sessionMutex的地方）
+static void CollectSessions(StatsSnapshot& snapshot) {
+    auto now = std::chrono::steady_clock::now();
+    InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+
+    snapshot.userCount = 0;
+    uint64_t online = 0;
+    for (const auto& pair : g_userSessions) {
+        if (snapshot.userCount >= STATS_MAX_USERS) {
+            break;
+        }
+        uint32_t index = snapshot.userCount++;
+        StatsUser& user = snapshot.users[index];
+        memset(&user, 0, sizeof(user));
+        snapshot.heartbeatAgeMs[index] = 0;
+        user.userID = pair.first;
+        auto name = g_userName.find(pair.first);
+        CopyText(user.name, name != g_userName.end() ? name->second : "Unknown");
+        if (pair.second != nullptr) {
+            user.online = 1;
+            user.port = pair.second->client_port;
+            CopyText(user.ip, pair.second->client_ip);
+            snapshot.heartbeatAgeMs[index] = static_cast<uint32_t>(
+                std::chrono::duration_cast<std::chrono::milliseconds>(now - pair.second->lastHeartbeatTime).count());
+            online++;
+        }
+    }
+    snapshot.counters[STATS_ONLINE_USERS] = online;
+
+    snapshot.groupCount = 0;
+    snapshot.groupsTruncated = g_groupChat.size() > STATS_MAX_GROUPS ? 1 : 0;
+    for (const auto& pair : g_groupChat) {
+        if (snapshot.groupCount >= STATS_MAX_GROUPS) {
+            break;
+        }
+        StatsGroup& group = snapshot.groups[snapshot.groupCount++];
+        memset(&group, 0, sizeof(group));
+        CopyText(group.name, pair.first);
+        group.memberCount = static_cast<uint16_t>(pair.second.size());
+        for (uint8_t memberID : pair.second) {
+            group.members[memberID >> 3] |= static_cast<uint8_t>(1 << (memberID & 7));
+        }
+    }
+}
+
+// 和上一次发布的内容比较，变化时增加对应的变化计数
+static void UpdateChangeSeq(StatsSnapshot& snapshot, SessionTables& previous) {
+    if (snapshot.userCount != previous.userCount ||
+        memcmp(snapshot.users, previous.users, snapshot.userCount * sizeof(StatsUser)) != 0) {
+        snapshot.usersChangeSeq++;
+        previous.userCount = snapshot.userCount;
+        memcpy(previous.users, snapshot.users, snapshot.userCount * sizeof(StatsUser));
+    }
+    if (snapshot.groupCount != previous.groupCount ||
+        memcmp(snapshot.groups, previous.groups, snapshot.groupCount * sizeof(StatsGroup)) != 0) {
+        snapshot.groupsChangeSeq++;
+        previous.groupCount = snapshot.groupCount;
+        memcpy(previous.groups, snapshot.groups, snapshot.groupCount * sizeof(StatsGroup));
+    }
+}
+
+static void CollectCounters(StatsSnapshot& snapshot) {
+    snapshot.counters[STATS_CONNECTIONS] = g_metricConnections.Value();
+    snapshot.counters[STATS_ACTIVE_CONNECTIONS] = static_cast<uint64_t>(g_metricActiveConnections.Value());
+    snapshot.counters[STATS_LOGINS_SUCCESS] = g_metricLogins.Value(METRIC_RESULT_SUCCESS);
+    snapshot.counters[STATS_LOGINS_FAILURE] = g_metricLogins.Value(METRIC_RESULT_FAILURE);
+    snapshot.counters[STATS_MESSAGES_RECEIVED] = g_metricMessagesReceived.Total();
+    snapshot.counters[STATS_MESSAGES_FORWARDED] = g_metricMessagesForwarded.Total();
+    snapshot.counters[STATS_MESSAGES_OFFLINE] = g_metricMessagesOffline.Total();
+    snapshot.counters[STATS_BYTES_RECEIVED] = g_metricBytesReceived.Value();
+    snapshot.counters[STATS_BYTES_SENT] = g_metricBytesSent.Value();
+    snapshot.counters[STATS_AI_SUCCESS] = g_metricAIRequests.Value(METRIC_RESULT_SUCCESS);
+    snapshot.counters[STATS_AI_FAILURE] = g_metricAIRequests.Value(METRIC_RESULT_FAILURE);
+    snapshot.counters[STATS_OFFLINE_PENDING] = g_offlineStore.TotalPending();
+}
+
+static void CollectLatency(StatsSnapshot& snapshot, const std::vector<std::string>& typeNames) {
+    for (size_t stage = 0; stage < STATS_LATENCY_STAGES; ++stage) {
+        CopyText(snapshot.stageNames[stage], LatencyStageName(static_cast<LatencyStage>(stage)));
+    }
+    for (size_t slot = 0; slot < STATS_LATENCY_TYPES; ++slot) {
+        snapshot.typeNames[slot][0] = '\0';
+        for (size_t stage = 0; stage < STATS_LATENCY_STAGES; ++stage) {
+            LatencySummary summary = SummarizeLatency(static_cast<uint8_t>(slot), static_cast<LatencyStage>(stage));
+            snapshot.latency[slot][stage] = {summary.count, summary.p50Ns, summary.p99Ns, summary.p999Ns, summary.maxNs};
+        }
+        if (snapshot.latency[slot][static_cast<size_t>(LatencyStage::TOTAL)].count > 0) {
+            CopyText(snapshot.typeNames[slot], typeNames[slot].empty() ? "other" : typeNames[slot]);
+        }
+    }
+}
+
+static void CollectLocks(StatsSnapshot& snapshot) {
+    std::vector<LockSummary> locks = SummarizeLocks(STATS_LOCK_CALL_SITES);
+    snapshot.lockCount = 0;
+    for (const LockSummary& summary : locks) {
+        if (snapshot.lockCount >= STATS_MAX_LOCKS) {
+            break;
+        }
+        StatsLock& lock = snapshot.locks[snapshot.lockCount++];
+        memset(&lock, 0, sizeof(lock));
+        CopyText(lock.name, summary.name);
+        lock.acquisitions = summary.acquisitions;
+        lock.contended = summary.contended;
+        lock.wait = {summary.wait.count, summary.wait.p50Ns, summary.wait.p99Ns, summary.wait.p999Ns, summary.wait.maxNs};
+        lock.hold = {summary.hold.count, summary.hold.p50Ns, summary.hold.p99Ns, summary.hold.p999Ns, summary.hold.maxNs};
+        for (const auto& site : summary.topCallSites) {
+            StatsLockSite& target = lock.sites[lock.siteCount++];
+            CopyText(target.text, site.first);
+            target.waitNs = site.second;
+        }
+    }
+}
+
+static void CollectAITimings(StatsSnapshot& snapshot) {
+    for (size_t phase = 0; phase < STATS_AI_PHASES; ++phase) {
+        CopyText(snapshot.aiPhaseNames[phase], AIPhaseName(static_cast<AIPhase>(phase)));
+    }
+    snapshot.aiEndpointCount = static_cast<uint32_t>(AITimingEndpoints());
+    CopyText(snapshot.aiModel, snapshot.aiEndpointCount > 0 ? AITimingModel() : std::string());
+    for (uint32_t i = 0; i < snapshot.aiEndpointCount; ++i) {
+        StatsAIEndpoint& endpoint = snapshot.aiEndpoints[i];
+        CopyText(endpoint.name, AITimingEndpointName(i));
+        for (size_t phase = 0; phase < STATS_AI_PHASES; ++phase) {
+            LatencySummary summary = SummarizeAITiming(i, static_cast<AIPhase>(phase));
+            endpoint.phases[phase] = {summary.count, summary.p50Ns, summary.p99Ns, summary.p999Ns, summary.maxNs};
+        }
+    }
+}
+
+// 把日志环形缓冲区中新增的记录格式化后追加到快照的日志尾部
+static void CollectLogs(const UILogRing& ring, uint64_t& nextSeq, StatsLogTail& tail, bool withLevel) {
+    std::vector<std::string> records;
+    uint64_t fromSeq = nextSeq;
+    nextSeq = ring.ReadSince(nextSeq, records);
+    tail.droppedLines += nextSeq - fromSeq - records.size();  // 读之前或读的过程中已被覆盖的记录
+    for (const std::string& encoded : records) {
+        BlogRecordView record;
+        size_t recordSize = 0;
+        if (!ParseBlogRecord(encoded.data(), encoded.size(), record, recordSize)) {
+            continue;
+        }
+        char(&line)[STATS_LOG_LINE_SIZE] = tail.lines[tail.nextSeq % STATS_LOG_LINES];
+        CopyText(line, FormatBlogRecord(record, withLevel));
+        tail.nextSeq++;
+    }
+}
+
+// 执行监视窗口提交的命令
+static void ExecuteCommands(StatsSegment* segment) {
+    uint32_t type = 0;
+    uint32_t userID = 0;
+    while (TakeStatsCommand(segment, type, userID)) {
+        if (userID > 255) {
+            continue;
+        }
+        switch (type) {
+            case STATS_COMMAND_FORCE_DISCONNECT:
+                WriteLogFmt(LogLevel::INFO, LogFmt::MONITOR_FORCE_DISCONNECT, userID);
+                ForceDisconnect(static_cast<uint8_t>(userID));
+                break;
+            case STATS_COMMAND_DELETE_USER:
+                WriteLogFmt(LogLevel::INFO, LogFmt::MONITOR_DELETE_USER, userID);
+                DeleteUser(static_cast<uint8_t>(userID));
+                break;
+            default:
+                WriteLog(LogLevel::WARN, "未知的监视窗口命令: " + std::to_string(type));
+                break;
+        }
+    }
+}
+
+static void StatsPublisherThread(StatsSegment* segment) {
+    std::unique_ptr<StatsSnapshot> snapshot(new StatsSnapshot());
+    memset(snapshot.get(), 0, sizeof(StatsSnapshot));
+    std::unique_ptr<SessionTables> previous(new SessionTables());
+    memset(previous.get(), 0, sizeof(SessionTables));
+    std::vector<std::string> typeNames = MsgTypeLabelValues();
+    uint64_t logNextSeq[STATS_LOG_KINDS] = {};
+    auto startTime = std::chrono::steady_clock::now();
+
+    while (true) {
+        ExecuteCommands(segment);
+
+        snapshot->version++;
+        snapshot->publishTimeMs = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+        CollectSessions(*snapshot);
+        UpdateChangeSeq(*snapshot, *previous);
+        CollectCounters(*snapshot);
+        CollectLatency(*snapshot, typeNames);
+        CollectLocks(*snapshot);
+        CollectAITimings(*snapshot);
+        CollectLogs(g_uiLogRing, logNextSeq[STATS_LOG_SERVER], snapshot->logs[STATS_LOG_SERVER], true);
+        CollectLogs(g_forwardMsgRing, logNextSeq[STATS_LOG_FORWARD], snapshot->logs[STATS_LOG_FORWARD], false);
+        CollectLogs(g_requestMsgRing, logNextSeq[STATS_LOG_REQUEST], snapshot->logs[STATS_LOG_REQUEST], false);
+        PublishStatsSnapshot(segment, *snapshot);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(STATS_PUBLISH_INTERVAL_MS));
+    }
+}
+
+void InitializeStatsPublisher() {
+    StatsSegment* segment = CreateStatsSegment();
+    if (segment == nullptr) {
+        WriteLog(LogLevel::WARN, "状态共享内存创建失败，监视窗口将无法显示数据: " + std::to_string(GetLastError()));
+        return;
+    }
+    std::thread(StatsPublisherThread, segment).detach();
+    WriteLog(LogLevel::INFO, "状态共享内存已创建: " + std::string(STATS_SEGMENT_NAME));
+}
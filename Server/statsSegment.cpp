@@ -0,0 +1,168 @@
+#include "headers/statsSegment.h"
+#include <aclapi.h>
+#include <cstring>
+#include <vector>
+
+// 运行服务器的用户（TOKEN_USER，SID指向缓冲区内部）
+static PSID CurrentUserSid(std::vector<char>& buffer) {
+    HANDLE token = nullptr;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) {
+        return nullptr;
+    }
+    DWORD size = 0;
+    GetTokenInformation(token, TokenUser, nullptr, 0, &size);
+    buffer.resize(size);
+    bool ok = size > 0 && GetTokenInformation(token, TokenUser, buffer.data(), size, &size);
+    CloseHandle(token);
+    return ok ? reinterpret_cast<TOKEN_USER*>(buffer.data())->User.Sid : nullptr;
+}
+
+// 只允许sid访问、所有者为sid的安全描述符
+static bool BuildOwnerOnlySecurity(PSID sid, SECURITY_DESCRIPTOR& descriptor, std::vector<char>& aclBuffer) {
+    DWORD aclSize = static_cast<DWORD>(sizeof(ACL) + sizeof(ACCESS_ALLOWED_ACE) - sizeof(DWORD) + GetLengthSid(sid));
+    aclBuffer.resize(aclSize);
+    PACL acl = reinterpret_cast<PACL>(aclBuffer.data());
+    return InitializeAcl(acl, aclSize, ACL_REVISION) && AddAccessAllowedAce(acl, ACL_REVISION, GENERIC_ALL, sid) &&
+           InitializeSecurityDescriptor(&descriptor, SECURITY_DESCRIPTOR_REVISION) &&
+           SetSecurityDescriptorDacl(&descriptor, TRUE, acl, FALSE) && SetSecurityDescriptorOwner(&descriptor, sid, FALSE);
+}
+
+// 已存在的段是否由sid创建（防止其他用户抢先创建同名段，再借命令环操作服务器）
+static bool IsOwnedBy(HANDLE mapping, PSID sid) {
+    PSID owner = nullptr;
+    PSECURITY_DESCRIPTOR descriptor = nullptr;
+    if (GetSecurityInfo(mapping, SE_KERNEL_OBJECT, OWNER_SECURITY_INFORMATION, &owner, nullptr, nullptr, nullptr,
+                        &descriptor) != ERROR_SUCCESS) {
+        return false;
+    }
+    bool owned = owner != nullptr && EqualSid(owner, sid);
+    LocalFree(descriptor);
+    return owned;
+}
+
+StatsSegment* CreateStatsSegment() {
+    // 段只对运行服务器的用户开放：默认安全属性下同一会话中的任何进程都能打开它，向命令环写入强制下线、删除账户的命令
+    std::vector<char> userBuffer;
+    std::vector<char> aclBuffer;
+    SECURITY_DESCRIPTOR descriptor;
+    PSID sid = CurrentUserSid(userBuffer);
+    if (sid == nullptr || !BuildOwnerOnlySecurity(sid, descriptor, aclBuffer)) {
+        return nullptr;
+    }
+    SECURITY_ATTRIBUTES attributes = {};
+    attributes.nLength = sizeof(attributes);
+    attributes.lpSecurityDescriptor = &descriptor;
+    attributes.bInheritHandle = FALSE;
+
+    // 监视进程还开着时同名段已经存在，确认是自己创建的之后直接复用（重新初始化头部）
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, &attributes, PAGE_READWRITE, 0,
+                                        static_cast<DWORD>(sizeof(StatsSegment)), STATS_SEGMENT_NAME);
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS && !IsOwnedBy(mapping, sid)) {
+        CloseHandle(mapping);
+        SetLastError(ERROR_ACCESS_DENIED);
+        return nullptr;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(StatsSegment));
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        return nullptr;
+    }
+    // 映射句柄不关闭，段在服务器运行期间一直存在
+
+    StatsSegment* segment = static_cast<StatsSegment*>(view);
+    segment->sequence.store(segment->sequence.load() | 1);  // 初始化期间让读者等待
+    segment->magic = STATS_SEGMENT_MAGIC;
+    segment->version = STATS_SEGMENT_VERSION;
+    segment->size = sizeof(StatsSegment);
+    segment->commandHead.store(0);
+    segment->commandTail.store(0);
+    for (StatsCommandSlot& slot : segment->commands) {
+        slot.ready.store(0);
+    }
+    memset(&segment->snapshot, 0, sizeof(segment->snapshot));
+    segment->sequence.fetch_add(1, std::memory_order_release);
+    return segment;
+}
+
+void PublishStatsSnapshot(StatsSegment* segment, const StatsSnapshot& snapshot) {
+    uint64_t sequence = segment->sequence.load(std::memory_order_relaxed);
+    segment->sequence.store(sequence + 1, std::memory_order_relaxed);  // 变为奇数：正在写
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&segment->snapshot, &snapshot, sizeof(snapshot));
+    segment->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool TakeStatsCommand(StatsSegment* segment, uint32_t& type, uint32_t& userID) {
+    uint64_t tail = segment->commandTail.load(std::memory_order_relaxed);
+    StatsCommandSlot& slot = segment->commands[tail % STATS_COMMAND_SLOTS];
+    if (slot.ready.load(std::memory_order_acquire) != tail + 1) {
+        return false;
+    }
+    type = slot.type;
+    userID = slot.userID;
+    segment->commandTail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+StatsSegment* OpenStatsSegment() {
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, STATS_SEGMENT_NAME);
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(StatsSegment));
+    CloseHandle(mapping);  // 视图会保持段存在
+    if (view == nullptr) {
+        return nullptr;
+    }
+    StatsSegment* segment = static_cast<StatsSegment*>(view);
+    if (segment->magic != STATS_SEGMENT_MAGIC || segment->version != STATS_SEGMENT_VERSION ||
+        segment->size != sizeof(StatsSegment)) {
+        UnmapViewOfFile(view);
+        return nullptr;
+    }
+    return segment;
+}
+
+void CloseStatsSegment(StatsSegment* segment) {
+    if (segment) {
+        UnmapViewOfFile(segment);
+    }
+}
+
+bool ReadStatsSnapshot(const StatsSegment* segment, StatsSnapshot& out) {
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        uint64_t before = segment->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            Sleep(0);  // 服务器正在写
+            continue;
+        }
+        memcpy(&out, &segment->snapshot, sizeof(out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment->sequence.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool SendStatsCommand(StatsSegment* segment, uint32_t type, uint32_t userID) {
+    if (segment == nullptr) {
+        return false;
+    }
+    // 先占一个序号（可能有多个监视进程），再写槽位，最后标记写好
+    uint64_t head = segment->commandHead.load(std::memory_order_relaxed);
+    do {
+        if (head - segment->commandTail.load(std::memory_order_acquire) >= STATS_COMMAND_SLOTS) {
+            return false;
+        }
+    } while (!segment->commandHead.compare_exchange_weak(head, head + 1, std::memory_order_relaxed));
+
+    StatsCommandSlot& slot = segment->commands[head % STATS_COMMAND_SLOTS];
+    slot.type = type;
+    slot.userID = userID;
+    slot.ready.store(head + 1, std::memory_order_release);
+    return true;
+}
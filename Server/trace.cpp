@@ -0,0 +1,252 @@
+#include "headers/trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+// 一个区段（Chrome trace的完整事件，ph = "X"）
+struct TraceEvent {
+    const char* name;
+    const char* argName;
+    int64_t argValue;
+    uint64_t startUs;
+    uint64_t durationUs;
+};
+
+// 每个线程的环形缓冲区：只有所属线程写入，导出时加锁读取（锁只在被采样的区段结束时使用，基本没有竞争）
+struct TraceBuffer {
+    std::mutex mutex;
+    uint32_t tid = 0;
+    std::string threadName;
+    std::vector<TraceEvent> events;
+    size_t next = 0;  // 下一个写入位置
+    bool wrapped = false;
+};
+
+// 缓冲区池：正在运行和已退出的线程合计最多TRACE_MAX_BUFFERS个；
+// 已退出线程的缓冲区保留到需要新缓冲区时（客户端断开后仍能查看），满了以后复用最早退出的那个，
+// 全部属于正在运行的线程时新线程不再分配，它的区段计入丢弃数
+struct TraceRegistry {
+    std::mutex mutex;
+    uint32_t nextTid = 1;
+    std::vector<std::shared_ptr<TraceBuffer>> live;
+    std::deque<std::shared_ptr<TraceBuffer>> retired;
+};
+
+static std::atomic<uint64_t> g_traceDroppedSpans{0};  // 没有分到缓冲区而丢弃的区段数
+
+static TraceRegistry& Registry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+static std::atomic<uint32_t> g_traceSampleRate{0};
+static std::atomic<uint64_t> g_traceSampleCounter{0};  // 所有线程共用的消息计数（每个线程各自计数时每个客户端的第一条消息都会被采样）
+static const auto g_traceEpoch = std::chrono::steady_clock::now();
+
+static inline uint64_t TraceTimeUs(std::chrono::steady_clock::time_point time) {
+    if (time < g_traceEpoch) {
+        return 0;
+    }
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(time - g_traceEpoch).count());
+}
+
+static inline uint64_t TraceNowUs() {
+    return TraceTimeUs(std::chrono::steady_clock::now());
+}
+
+// 线程局部状态：缓冲区在第一次记录区段时才从池中取得，没被采样过的线程不占内存
+struct ThreadTraceState {
+    std::shared_ptr<TraceBuffer> buffer;
+    std::string pendingName;  // 取得缓冲区之前设置的线程名
+    bool sampled = false;
+
+    // 取得这个线程的缓冲区，池已经全部被正在运行的线程占用时返回nullptr（下次记录时再试）
+    TraceBuffer* Buffer() {
+        if (buffer) {
+            return buffer.get();
+        }
+        TraceRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        std::shared_ptr<TraceBuffer> acquired;
+        if (registry.live.size() + registry.retired.size() < TRACE_MAX_BUFFERS) {
+            acquired = std::make_shared<TraceBuffer>();
+            acquired->events.resize(TRACE_BUFFER_CAPACITY);
+        } else if (!registry.retired.empty()) {
+            acquired = registry.retired.front();  // 复用最早退出的线程的缓冲区（导出时已经复制了指针的仍能安全读取）
+            registry.retired.pop_front();
+            std::lock_guard<std::mutex> bufferLock(acquired->mutex);
+            acquired->next = 0;
+            acquired->wrapped = false;
+        } else {
+            return nullptr;
+        }
+        {
+            std::lock_guard<std::mutex> bufferLock(acquired->mutex);
+            acquired->tid = registry.nextTid++;
+            acquired->threadName = pendingName;
+        }
+        registry.live.push_back(acquired);
+        buffer = acquired;
+        return buffer.get();
+    }
+
+    ~ThreadTraceState() {
+        if (!buffer) {
+            return;
+        }
+        TraceRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (size_t i = 0; i < registry.live.size(); ++i) {
+            if (registry.live[i] == buffer) {
+                registry.live.erase(registry.live.begin() + i);
+                break;
+            }
+        }
+        registry.retired.push_back(buffer);
+    }
+};
+
+static thread_local ThreadTraceState t_trace;
+
+void SetTraceSampleRate(uint32_t everyN) {
+    g_traceSampleRate.store(everyN, std::memory_order_relaxed);
+}
+
+uint32_t GetTraceSampleRate() {
+    return g_traceSampleRate.load(std::memory_order_relaxed);
+}
+
+void SetTraceThreadName(const std::string& name) {
+    ThreadTraceState& state = t_trace;
+    state.pendingName = name;
+    if (state.buffer) {
+        std::lock_guard<std::mutex> lock(state.buffer->mutex);
+        state.buffer->threadName = name;
+    }
+}
+
+TraceSampleScope::TraceSampleScope() : previous_(t_trace.sampled) {
+    uint32_t rate = g_traceSampleRate.load(std::memory_order_relaxed);
+    // 所有线程共用一个计数，每N条取1条
+    t_trace.sampled = rate != 0 && (g_traceSampleCounter.fetch_add(1, std::memory_order_relaxed) % rate) == 0;
+}
+
+TraceSampleScope::~TraceSampleScope() {
+    t_trace.sampled = previous_;
+}
+
+bool IsTraceSampled() {
+    return t_trace.sampled;
+}
+
+TraceSpan::TraceSpan(const char* name, const char* argName, int64_t argValue)
+    : name_(name), argName_(argName), argValue_(argValue), startUs_(0), active_(t_trace.sampled) {
+    if (active_) {
+        startUs_ = TraceNowUs();
+    }
+}
+
+void TraceSpan::SetArg(const char* argName, int64_t argValue) {
+    argName_ = argName;
+    argValue_ = argValue;
+}
+
+// 把一个区段写入当前线程的缓冲区
+static void AppendTraceEvent(const TraceEvent& event) {
+    TraceBuffer* buffer = t_trace.Buffer();
+    if (buffer == nullptr) {
+        g_traceDroppedSpans.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->events[buffer->next] = event;
+    buffer->next = (buffer->next + 1) % buffer->events.size();
+    if (buffer->next == 0) {
+        buffer->wrapped = true;
+    }
+}
+
+void TraceSpan::End() {
+    if (!active_) {
+        return;
+    }
+    active_ = false;
+    uint64_t endUs = TraceNowUs();
+    AppendTraceEvent({name_, argName_, argValue_, startUs_, endUs - startUs_});
+}
+
+void RecordTraceSpan(const char* name, std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point end, const char* argName, int64_t argValue) {
+    uint64_t startUs = TraceTimeUs(start);
+    uint64_t endUs = TraceTimeUs(end);
+    AppendTraceEvent({name, argName, argValue, startUs, endUs > startUs ? endUs - startUs : 0});
+}
+
+// JSON字符串转义（线程名里有客户端地址，区段名都是常量）
+static void AppendJSONString(std::string& out, const std::string& text) {
+    out += '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+std::string ExportTraceJSON() {
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    {
+        TraceRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffers = registry.live;
+        buffers.insert(buffers.end(), registry.retired.begin(), registry.retired.end());
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char line[256];
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        if (!buffer->threadName.empty()) {
+            snprintf(line, sizeof(line), "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                     first ? "" : ",", buffer->tid);
+            out += line;
+            AppendJSONString(out, buffer->threadName);
+            out += "}}";
+            first = false;
+        }
+        // 按写入顺序输出（环已经写满时从最旧的一条开始）
+        size_t count = buffer->wrapped ? buffer->events.size() : buffer->next;
+        size_t begin = buffer->wrapped ? buffer->next : 0;
+        for (size_t i = 0; i < count; ++i) {
+            const TraceEvent& event = buffer->events[(begin + i) % buffer->events.size()];
+            snprintf(line, sizeof(line), "%s{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu",
+                     first ? "" : ",", event.name, buffer->tid, static_cast<unsigned long long>(event.startUs),
+                     static_cast<unsigned long long>(event.durationUs));
+            out += line;
+            if (event.argName) {
+                snprintf(line, sizeof(line), ",\"args\":{\"%s\":%lld}", event.argName,
+                         static_cast<long long>(event.argValue));
+                out += line;
+            }
+            out += '}';
+            first = false;
+        }
+    }
+    snprintf(line, sizeof(line), "],\"otherData\":{\"droppedSpans\":%llu}}\n",
+             static_cast<unsigned long long>(g_traceDroppedSpans.load(std::memory_order_relaxed)));
+    out += line;
+    return out;
+}
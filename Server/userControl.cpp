@@ -1,6 +1,11 @@
 #include "headers/userControl.h"
 #include "headers/logger.h"
 #include "headers/socket.h"
+#include "headers/offlineStore.h"
+#include "headers/accountStore.h"
+#include "headers/groupTimeline.h"
+#include "headers/aiService.h"
+#include "headers/trace.h"
 #include <cstdint>
 #include <mutex>
 #include <algorithm>
@@ -9,10 +14,9 @@
 // 全局变量定义
 std::map<uint8_t, std::string> g_userCredentials;
 std::map<uint8_t, ClientSession*> g_userSessions;
-std::map<uint8_t, std::vector<Packet>> g_offlineMessages;
 std::map<std::string, std::vector<uint8_t>> g_groupChat;
 std::map<uint8_t, std::string> g_userName;
-std::mutex g_sessionMutex;
+InstrumentedMutex g_sessionMutex("g_sessionMutex");
 
 // ClientSession 类成员函数实现
 ClientSession::ClientSession(SOCKET fd, const std::string& ip, unsigned short port)
@@ -20,7 +24,8 @@ ClientSession::ClientSession(SOCKET fd, const std::string& ip, unsigned short po
       client_ip(ip), 
       client_port(port), 
       userid(0),
-      lastHeartbeatTime(std::chrono::steady_clock::now())  // 初始化心跳时间
+      lastHeartbeatTime(std::chrono::steady_clock::now()),  // 初始化心跳时间
+      sendChannel(OpenSendChannel(fd))
 {
     std::string logmessage = "客户端连接: IP = " + client_ip + ", 端口 = " + std::to_string(client_port);
     WriteLog(LogLevel::CONNECTION, logmessage);
@@ -37,15 +42,14 @@ void ClientSession::setID(uint8_t id) {
 */
 
 /*
-注意：现在一旦服务器关停，所有的账户信息都会被抹除，如果想要永久记录，除非手
-动输入，否则可能需要通过构建数据库例如使用SQLite，然而这样工作量就太大了，因此
-目前只能先这样了。当然也可以通过读取文件的方式在重启服务器的时候重新创建，然而
-那样并不是一个很好的解决方案，如果用户量增多，重新创建用户对象的时间会难以估量
+注意：账号、用户名和群聊的每次修改都会在g_sessionMutex内追加一条预写日志（见accountStore），
+释放锁之后再等待日志落盘。服务器重启时先内存映射最近的快照，再只重放快照之后的日志尾部，
+所以重启不会丢失账户信息，启动时间也不会随着历史修改次数增长
 */
 
 // 检查用户是否存在
 bool CheckExist(uint8_t userID) {
-    std::lock_guard<std::mutex> lock(g_sessionMutex);
+    InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
     if (g_userSessions.count(userID)) {
         return true;
     }
@@ -53,7 +57,7 @@ bool CheckExist(uint8_t userID) {
 }
 // 检查用户是否在线
 bool CheckOnline(uint8_t userID) {
-    std::lock_guard<std::mutex> lock(g_sessionMutex);
+    InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
     // 先检查是否存在，避免 map 自动创建条目
     if (!g_userSessions.count(userID)) {
         return false;
@@ -65,7 +69,8 @@ bool CheckOnline(uint8_t userID) {
 }
 // 先检查是否存在，再检查是否在线
 int CheckUser(uint8_t userID) {
-    std::lock_guard<std::mutex> lock(g_sessionMutex);
+    TraceSpan traceSpan("CheckUser");
+    InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
     // 直接访问 g_userSessions，避免重复加锁
     if (!g_userSessions.count(userID)) {
         return 0;  // 用户不存在
@@ -79,8 +84,9 @@ int CheckUser(uint8_t userID) {
 // 注册函数: 1. 添加账户密码键值对 2. 给id绑定一个空的会话指针
 bool Signup(uint8_t userID, const std::string &password) {
     bool success = false;
+    uint64_t lsn = 0;
     {
-        std::lock_guard<std::mutex> lock(g_sessionMutex);
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
         // 直接检查 g_userSessions，避免调用 CheckExist 导致重复加锁
         if (g_userSessions.count(userID)) {
             success = false;
@@ -88,15 +94,29 @@ bool Signup(uint8_t userID, const std::string &password) {
             g_userCredentials[userID] = password;
             g_userSessions[userID] = nullptr;
             g_userName[userID] = "Anonymous";
+            lsn = g_accountStore.LogSignup(userID, password);
             success = true;
         }
     }
     
+    // 在释放锁后等待日志落盘（组提交，多个请求共享一次刷盘）
+    // 写盘失败时撤销内存中的注册（期间没有被别的操作改过才撤销），告诉客户端注册失败
+    if (success && !g_accountStore.WaitDurable(lsn)) {
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        if (g_userSessions.count(userID) && g_userSessions[userID] == nullptr && g_userCredentials[userID] == password) {
+            g_userCredentials.erase(userID);
+            g_userName.erase(userID);
+            g_userSessions.erase(userID);
+        }
+        WriteLogFmt(LogLevel::WARN, LogFmt::SIGNUP_NOT_DURABLE, userID);
+        return false;
+    }
+    
     // 在释放锁后记录日志
     if (success) {
-        WriteLog(LogLevel::PROCESS, "账号创建成功: " + std::to_string(userID));
+        WriteLogFmt(LogLevel::PROCESS, LogFmt::SIGNUP_DONE, userID);
     } else {
-        WriteLog(LogLevel::PROCESS, "账号创建失败 - ID已存在: " + std::to_string(userID));
+        WriteLogFmt(LogLevel::PROCESS, LogFmt::SIGNUP_EXISTS, userID);
     }
     
     return success;
@@ -104,7 +124,7 @@ bool Signup(uint8_t userID, const std::string &password) {
 
 // 登录函数:1. 验证登录凭证，2. 将id与这个会话线程绑定
 bool LoginConnect(uint8_t userID, const std::string &Password, ClientSession* session) {
-    std::lock_guard<std::mutex> lock(g_sessionMutex);
+    InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
     // 直接检查 g_userSessions，避免调用 CheckExist 导致重复加锁
     if (g_userSessions.count(userID)) {
         if (g_userSessions[userID] != nullptr) {
@@ -120,44 +140,52 @@ bool LoginConnect(uint8_t userID, const std::string &Password, ClientSession* se
 
 // 下线函数: 删除会话，把id绑定的会话指针改为空指针（这个函数只在会话登录了账户的情况下才要调用）
 void LogOff(uint8_t userID) {
-    std::lock_guard<std::mutex> lock(g_sessionMutex);
-    // 直接检查 g_userSessions，避免调用 CheckExist 导致重复加锁
-    if (g_userSessions.count(userID)) {
-        delete g_userSessions[userID];
-        g_userSessions[userID] = nullptr;
+    {
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        // 直接检查 g_userSessions，避免调用 CheckExist 导致重复加锁
+        if (g_userSessions.count(userID)) {
+            delete g_userSessions[userID];
+            g_userSessions[userID] = nullptr;
+        }
     }
+    // 群聊之后的新消息留在时间线上，等下次上线补发
+    g_groupTimeline.MemberOffline(userID);
 }
 
 // 强制用户下线并断开连接
 void ForceDisconnect(uint8_t userID) {
     ClientSession* session = nullptr;
     SOCKET clientSocket = INVALID_SOCKET;
+    std::shared_ptr<SendChannel> sendChannel;
     
     // 获取session并关闭socket（在锁外执行IO操作）
     {
-        std::lock_guard<std::mutex> lock(g_sessionMutex);
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
         if (g_userSessions.count(userID) && g_userSessions[userID] != nullptr) {
             session = g_userSessions[userID];
             clientSocket = session->socket_fd;
+            sendChannel = session->sendChannel;
         }
     }
     
     // 关闭socket连接（不持锁）
     if (clientSocket != INVALID_SOCKET) {
         shutdown(clientSocket, SD_BOTH);
+        CloseSendChannel(sendChannel);
         closesocket(clientSocket);
     }
     
     // 清理session
     if (session) {
-        std::lock_guard<std::mutex> lock(g_sessionMutex);
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
         // 再次检查，防止期间被其他线程删除
         if (g_userSessions.count(userID) && g_userSessions[userID] == session) {
             delete g_userSessions[userID];
             g_userSessions[userID] = nullptr;
-            WriteLog(LogLevel::CONNECTION, "强制下线用户: " + std::to_string(userID));
+            WriteLogFmt(LogLevel::CONNECTION, LogFmt::FORCE_DISCONNECT, userID);
         }
     }
+    g_groupTimeline.MemberOffline(userID);
 }
 
 // 彻底删除用户（包括账号、数据、连接）
@@ -166,8 +194,10 @@ void DeleteUser(uint8_t userID) {
     ForceDisconnect(userID);
     
     // 2. 删除所有用户数据（持锁操作）
+    uint64_t lsn = 0;
     {
-        std::lock_guard<std::mutex> lock(g_sessionMutex);
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        lsn = g_accountStore.LogDeleteUser(userID);
         
         // 删除账号密码
         if (g_userCredentials.count(userID)) {
@@ -179,11 +209,6 @@ void DeleteUser(uint8_t userID) {
             g_userName.erase(userID);
         }
         
-        // 删除离线消息
-        if (g_offlineMessages.count(userID)) {
-            g_offlineMessages.erase(userID);
-        }
-        
         // 从所有群聊中移除该用户
         for (auto& group : g_groupChat) {
             auto& memberList = group.second;
@@ -202,96 +227,113 @@ void DeleteUser(uint8_t userID) {
         }
     }
     
-    WriteLog(LogLevel::INFO, "已彻底删除用户: " + std::to_string(userID));
+    // 3. 删除离线消息（离线存储有自己的锁）
+    g_offlineStore.DropUser(userID);
+    g_groupTimeline.DropMember(userID);
+    g_aiService.ClearContext(userID);
+    if (!g_accountStore.WaitDurable(lsn)) {
+        // 数据已经删掉，内存中无法恢复；快照只包含已落盘的记录，重启后账号会回来（可以再删一次）
+        WriteLogFmt(LogLevel::FATAL, LogFmt::USER_DELETE_NOT_DURABLE, userID);
+        return;
+    }
+    
+    WriteLogFmt(LogLevel::INFO, LogFmt::USER_DELETED, userID);
 }
 
 // 创建群聊函数
 bool CreateGroup(std::string &groupName, std::vector<uint8_t> &memberList) {
-    std::lock_guard<std::mutex> lock(g_sessionMutex);
-    // 先检查群聊存不存在
-    if (g_groupChat.count(groupName)) {
-        WriteLog(LogLevel::PROCESS, "群聊已经存在");
+    uint64_t lsn = 0;
+    {
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        // 先检查群聊存不存在
+        if (g_groupChat.count(groupName)) {
+            WriteLogFmt(LogLevel::PROCESS, LogFmt::GROUP_EXISTS);
+            return false;
+        }
+        g_groupChat[groupName] = memberList;
+        lsn = g_accountStore.LogCreateGroup(groupName, memberList);
+    }
+    
+    // 在释放锁后等待日志落盘，写盘失败时撤销内存中的群聊
+    if (!g_accountStore.WaitDurable(lsn)) {
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        auto it = g_groupChat.find(groupName);
+        if (it != g_groupChat.end() && it->second == memberList) {
+            g_groupChat.erase(it);
+        }
+        WriteLogFmt(LogLevel::WARN, LogFmt::CREATE_GROUP_NOT_DURABLE, groupName);
         return false;
     }
-    g_groupChat[groupName] = memberList;
     return true;
 }
 
 
-// 存储离线消息: 如果发现接收者不在线，则把要发送的消息暂存到离线消息队列g_offlineMessages中
+// 存储离线消息: 如果发现接收者不在线，则把要发送的消息追加到磁盘上的离线消息日志中
+// 离线存储有自己的锁，这里不需要持有g_sessionMutex（ForwardToUser持锁时也会调用）
 void SaveOfflineMessages(uint8_t userID, Packet message) {
-    std::lock_guard<std::mutex> lock(g_sessionMutex);
-    // 直接添加到离线消息队列（如果key不存在，map会自动创建空vector）
-    g_offlineMessages[userID].push_back(message);
+    if (!g_offlineStore.Append(userID, message)) {
+        WriteLogFmt(LogLevel::WARN, LogFmt::OFFLINE_SAVE_FAILED, userID);
+    }
 }
 
 // 发送离线消息函数：当用户上线时，将所有离线消息推送给该用户
+// 消息从离线日志的内存映射中分批取出，用聚合写发出；发送失败时游标停在失败处，下次上线继续
 void SendOfflineMessages(uint8_t userID, ClientSession* session) {
-    std::vector<Packet> messagesToSend;
-    
-    // 复制离线消息到本地（最小化持锁时间）
-    {
-        std::lock_guard<std::mutex> lock(g_sessionMutex);
-        // 判断有没有离线消息（有key就有）
-        if (!g_offlineMessages.count(userID)) {
-            return;
-        }
-        messagesToSend = g_offlineMessages[userID];
-        // 先清空，发送失败再恢复
-        g_offlineMessages.erase(userID);
+    size_t pendingCount = g_offlineStore.PendingCount(userID);
+    if (pendingCount == 0) {
+        return;
     }
-    
-    int count = messagesToSend.size();
-    WriteLog(LogLevel::PASS, 
-             "推送离线消息给: " + std::to_string(userID) + 
-             ", 消息数量: " + std::to_string(count));
-    
-    // 逐条发送离线消息
-    int sentCount = 0;
-    for (size_t i = 0; i < messagesToSend.size(); ++i) {
-        if (!SendPacket(session->socket_fd, messagesToSend[i])) {
-            WriteLog(LogLevel::PASS, 
-                     "离线消息发送中断, 已发送: " + std::to_string(sentCount) + 
-                     " 条，剩余: " + std::to_string(messagesToSend.size() - i) + " 条");
-            
-            // 将未发送的消息重新保存
-            std::lock_guard<std::mutex> lock(g_sessionMutex);
-            for (size_t j = i; j < messagesToSend.size(); ++j) {
-                g_offlineMessages[userID].push_back(messagesToSend[j]);
-            }
-            return;
-        }
-        sentCount++;
+
+    WriteLogFmt(LogLevel::PASS, LogFmt::OFFLINE_PUSH_BEGIN, userID, pendingCount);
+
+    bool complete = true;
+    size_t sentCount = g_offlineStore.Deliver(userID, session->socket_fd, complete);
+
+    if (!complete) {
+        WriteLogFmt(LogLevel::PASS, LogFmt::OFFLINE_PUSH_INTERRUPTED, sentCount, g_offlineStore.PendingCount(userID));
+        return;
     }
-    
-    WriteLog(LogLevel::PASS, 
-             "离线消息推送完成, 共计: " + std::to_string(sentCount) + " 条");
+
+    WriteLogFmt(LogLevel::PASS, LogFmt::OFFLINE_PUSH_DONE, sentCount);
 }
 
 bool SetUserName(uint8_t userID, std::string& userName) {
     bool success = false;
+    uint64_t lsn = 0;
+    std::string oldName;
     {
-        std::lock_guard<std::mutex> lock(g_sessionMutex);
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
         // 直接检查 g_userSessions，避免调用 CheckExist 导致重复加锁
         if (g_userSessions.count(userID)) {
+            oldName = g_userName[userID];
             g_userName[userID] = userName;
-            
+            lsn = g_accountStore.LogSetName(userID, userName);
             success = true;
         }
     }
+    // 写盘失败时换回原来的用户名（期间没有再改过才换回）
+    if (success && !g_accountStore.WaitDurable(lsn)) {
+        InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
+        auto it = g_userName.find(userID);
+        if (it != g_userName.end() && it->second == userName) {
+            it->second = oldName;
+        }
+        WriteLogFmt(LogLevel::WARN, LogFmt::SET_NAME_NOT_DURABLE, userID);
+        return false;
+    }
     
     // 在释放锁后记录日志
     if (success) {
-        WriteLog(LogLevel::PROCESS, "用户" + std::to_string(userID) + "修改用户名为" + userName);
+        WriteLogFmt(LogLevel::PROCESS, LogFmt::SET_NAME_DONE, userID, userName);
     } else { 
-        WriteLog(LogLevel::PROCESS, "用户不存在，无法更改用户名"); 
+        WriteLogFmt(LogLevel::PROCESS, LogFmt::SET_NAME_MISSING);
     }
 
     return success;
 }
 
 std::string GetUserName(uint8_t userID) {
-    std::lock_guard<std::mutex> lock(g_sessionMutex);
+    InstrumentedLockGuard lock(g_sessionMutex, LOCK_SITE);
     // 如果用户名不存在，返回空字符串
     if (g_userName.count(userID)) {
         return g_userName[userID];